@@ -0,0 +1,65 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pytest
+
+from .helpers import QUERIES, run_benchmark
+
+pytestmark = pytest.mark.parametrize("query", QUERIES.keys())
+
+# Dense matrices for genome-wide queries at high resolution do not fit in memory
+MAX_DENSE_MATRIX_BINS = 20_000
+
+
+def fetch(f, query: str, **kwargs):
+    range1, range2 = QUERIES[query]
+    return f.fetch(range1, range2, **kwargs)
+
+
+def test_to_arrow(benchmark, dataset, query):
+    sel = fetch(dataset, query)
+    run_benchmark(benchmark, sel.to_arrow, num_pixels=sel.nnz())
+
+
+def test_to_arrow_bg2(benchmark, dataset, query):
+    sel = fetch(dataset, query, join=True)
+    run_benchmark(benchmark, sel.to_arrow, num_pixels=sel.nnz())
+
+
+def test_to_arrow_balanced(benchmark, dataset, query):
+    sel = fetch(dataset, query, normalization="weight" if dataset.is_cooler() else "ICE")
+    run_benchmark(benchmark, sel.to_arrow, num_pixels=sel.nnz())
+
+
+def test_to_numpy(benchmark, dataset, query):
+    num_rows, num_cols = dataset.nbins(), dataset.nbins()
+    sel = fetch(dataset, query)
+    if sel.coord1()[0] != "ALL":
+        num_rows = (sel.coord1()[2] - sel.coord1()[1]) // dataset.resolution()
+        num_cols = (sel.coord2()[2] - sel.coord2()[1]) // dataset.resolution()
+    if max(num_rows, num_cols) > MAX_DENSE_MATRIX_BINS:
+        pytest.skip("dense matrix is too large")
+
+    run_benchmark(benchmark, sel.to_numpy, num_pixels=sel.nnz())
+
+
+def test_to_csr(benchmark, dataset, query):
+    pytest.importorskip("scipy")
+    sel = fetch(dataset, query)
+    run_benchmark(benchmark, sel.to_csr, num_pixels=sel.nnz())
+
+
+def test_iter(benchmark, dataset, query):
+    sel = fetch(dataset, query)
+    run_benchmark(benchmark, lambda: sum(1 for _ in sel), num_pixels=sel.nnz())
+
+
+def test_describe(benchmark, dataset, query):
+    sel = fetch(dataset, query)
+    run_benchmark(benchmark, sel.describe, num_pixels=sel.nnz())
+
+
+def test_describe_exact(benchmark, dataset, query):
+    sel = fetch(dataset, query, count_type="float")
+    run_benchmark(benchmark, sel.describe, exact=True, keep_nans=True, num_pixels=sel.nnz())
@@ -0,0 +1,52 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import itertools
+
+import pytest
+
+import hictkpy
+
+from .helpers import GENERATED_RESOLUTION, record_throughput
+
+pytestmark = pytest.mark.parametrize("fmt", ["cool", "hic"])
+
+ROUNDS = 3
+CHUNK_SIZE = 500_000
+
+_counter = itertools.count()
+
+
+def make_writer(fmt: str, chromosomes, tmpdir):
+    path = tmpdir / f"out-{next(_counter)}.{fmt}"
+    if fmt == "cool":
+        return hictkpy.cooler.FileWriter(path, chromosomes, GENERATED_RESOLUTION, tmpdir=tmpdir)
+    return hictkpy.hic.FileWriter(path, chromosomes, GENERATED_RESOLUTION, tmpdir=tmpdir)
+
+
+def add_pixels(writer, df):
+    for start in range(0, len(df), CHUNK_SIZE):
+        writer.add_pixels(df[start : start + CHUNK_SIZE])
+
+
+def test_add_pixels(benchmark, generated_pixels, fmt, tmp_path):
+    chromosomes, df = generated_pixels
+
+    def setup():
+        return (make_writer(fmt, chromosomes, tmp_path), df), {}
+
+    benchmark.pedantic(add_pixels, setup=setup, rounds=ROUNDS)
+    record_throughput(benchmark, len(df))
+
+
+def test_finalize(benchmark, generated_pixels, fmt, tmp_path):
+    chromosomes, df = generated_pixels
+
+    def setup():
+        w = make_writer(fmt, chromosomes, tmp_path)
+        add_pixels(w, df)
+        return (w,), {}
+
+    benchmark.pedantic(lambda w: w.finalize(), setup=setup, rounds=ROUNDS)
+    record_throughput(benchmark, len(df))
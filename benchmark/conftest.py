@@ -0,0 +1,53 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pathlib
+
+import pytest
+
+import hictkpy
+
+from .helpers import (
+    DATASETS,
+    GENERATED_NNZ,
+    GENERATED_RESOLUTION,
+    REFERENCE_FILES,
+    REFERENCE_RESOLUTIONS,
+    generate_pixels,
+)
+
+
+@pytest.fixture(scope="session")
+def generated_pixels():
+    chromosomes = hictkpy.File(REFERENCE_FILES["cool"], REFERENCE_RESOLUTIONS[0]).chromosomes()
+    return chromosomes, generate_pixels(chromosomes, GENERATED_RESOLUTION, GENERATED_NNZ)
+
+
+@pytest.fixture(scope="session")
+def generated_files(generated_pixels, tmp_path_factory) -> dict[str, pathlib.Path]:
+    chromosomes, df = generated_pixels
+    tmpdir = tmp_path_factory.mktemp("generated")
+
+    paths = {"cool": tmpdir / "generated.cool", "hic": tmpdir / "generated.hic"}
+
+    w = hictkpy.cooler.FileWriter(paths["cool"], chromosomes, GENERATED_RESOLUTION, tmpdir=tmpdir)
+    w.add_pixels(df)
+    w.finalize()
+
+    w = hictkpy.hic.FileWriter(paths["hic"], chromosomes, GENERATED_RESOLUTION, tmpdir=tmpdir)
+    w.add_pixels(df)
+    w.finalize()
+
+    return paths
+
+
+@pytest.fixture(params=DATASETS, ids=[label for label, _, _ in DATASETS])
+def dataset(request, generated_files) -> hictkpy.File:
+    """
+    Open one of the reference files (at the given resolution) or one of the generated files.
+    """
+    _, fmt, resolution = request.param
+    if resolution is None:
+        return hictkpy.File(generated_files[fmt], GENERATED_RESOLUTION)
+    return hictkpy.File(REFERENCE_FILES[fmt], resolution)
@@ -0,0 +1,104 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pathlib
+import sys
+from typing import Optional
+
+testdir = pathlib.Path(__file__).resolve().parent.parent / "test"
+
+REFERENCE_FILES = {
+    "cool": testdir / "data" / "cooler_test_file.mcool",
+    "hic": testdir / "data" / "hic_test_file.hic",
+}
+REFERENCE_RESOLUTIONS = [100_000, 1_000_000]
+
+# Generated files cover a larger range of matrix densities than the reference files
+GENERATED_RESOLUTION = 10_000
+GENERATED_NNZ = 5_000_000
+
+
+def peak_rss_mb() -> Optional[float]:
+    """
+    Return the peak resident set size of the current process in MB (or None when this is not available).
+    The value is a high-water mark for the whole process: run benchmarks in isolation (e.g. with -k) to
+    attribute the peak RSS to a specific benchmark.
+    """
+    try:
+        import resource
+    except ModuleNotFoundError:
+        return None
+
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # ru_maxrss is expressed in bytes on macOS and in KB on Linux
+    if sys.platform == "darwin":
+        return rss / 1.0e6
+    return rss / 1.0e3
+
+
+def record_throughput(benchmark, num_pixels: int):
+    """
+    Record the throughput (pixels/s) and the peak RSS in the extra_info of the given benchmark.
+    """
+    benchmark.extra_info["num_pixels"] = num_pixels
+    benchmark.extra_info["peak_rss_mb"] = peak_rss_mb()
+
+    # stats are not available when benchmarks are disabled (e.g. with --benchmark-disable)
+    if benchmark.stats is not None and benchmark.stats.stats.mean > 0:
+        benchmark.extra_info["pixels_per_second"] = num_pixels / benchmark.stats.stats.mean
+
+
+def run_benchmark(benchmark, fx, *args, num_pixels: int, **kwargs):
+    """
+    Run fx(*args, **kwargs) using the given pytest-benchmark fixture and record its throughput.
+    """
+    result = benchmark(fx, *args, **kwargs)
+    record_throughput(benchmark, num_pixels)
+    return result
+
+
+def generate_pixels(chromosomes: dict[str, int], resolution: int, nnz: int, seed: int = 1234):
+    """
+    Generate random cis and trans COO pixels whose density decays with the distance from the diagonal.
+    """
+    import numpy as np
+    import pandas as pd
+
+    rng = np.random.default_rng(seed)
+
+    num_bins = np.array([(size + resolution - 1) // resolution for size in chromosomes.values()])
+    offsets = np.concatenate([[0], np.cumsum(num_bins)[:-1]])
+    tot_bins = int(num_bins.sum())
+
+    num_cis = int(nnz * 0.9)
+    chrom_ids = rng.choice(len(num_bins), size=num_cis, p=num_bins / tot_bins)
+    bin1_id = offsets[chrom_ids] + (rng.random(num_cis) * num_bins[chrom_ids]).astype(np.int64)
+    dist = rng.geometric(0.01, size=num_cis) - 1
+    bin2_id = np.minimum(bin1_id + dist, offsets[chrom_ids] + num_bins[chrom_ids] - 1)
+
+    num_trans = nnz - num_cis
+    trans1 = rng.integers(0, tot_bins, size=num_trans)
+    trans2 = rng.integers(0, tot_bins, size=num_trans)
+
+    bin1_id = np.concatenate([bin1_id, np.minimum(trans1, trans2)])
+    bin2_id = np.concatenate([bin2_id, np.maximum(trans1, trans2)])
+
+    df = pd.DataFrame({"bin1_id": bin1_id, "bin2_id": bin2_id})
+    df = df.drop_duplicates().sort_values(["bin1_id", "bin2_id"], ignore_index=True)
+    df["count"] = rng.integers(1, 100, size=len(df), dtype=np.int32)
+    return df
+
+
+DATASETS = [
+    *[(f"{fmt}-{res // 1000}kb", fmt, res) for fmt in REFERENCE_FILES for res in REFERENCE_RESOLUTIONS],
+    *[(f"generated-{fmt}-{GENERATED_RESOLUTION // 1000}kb", fmt, None) for fmt in REFERENCE_FILES],
+]
+
+QUERIES = {
+    "cis-1mb": ("chr2L:5,000,000-6,000,000", None),
+    "cis-10mb": ("chr2L:5,000,000-15,000,000", None),
+    "cis-chrom": ("chr2L", None),
+    "trans": ("chr2L", "chrX"),
+    "genome-wide": (None, None),
+}
@@ -4,6 +4,8 @@
 
 #include "hictkpy/bin_table.hpp"
 
+#include <BS_thread_pool.hpp>
+#include <Python.h>
 #include <arrow/array.h>
 #include <arrow/buffer.h>
 #include <arrow/builder.h>
@@ -16,6 +18,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <future>
 #include <hictk/bin.hpp>
 #include <hictk/bin_table.hpp>
 #include <hictk/genomic_interval.hpp>
@@ -29,6 +32,8 @@
 #include <variant>
 #include <vector>
 
+#include "hictkpy/common.hpp"
+#include "hictkpy/pixel.hpp"
 #include "hictkpy/reference.hpp"
 #include "hictkpy/to_pyarrow.hpp"
 
@@ -185,24 +190,133 @@ std::string BinTable::repr() const {
   return df;
 }
 
-nb::object BinTable::bin_ids_to_coords(std::vector<std::uint64_t> bin_ids) const {
-  std::vector<std::int32_t> chrom_ids(bin_ids.size());
-  std::vector<std::uint32_t> start_pos(bin_ids.size());
-  std::vector<std::uint32_t> end_pos(bin_ids.size());
+// Convert the given objects to columns of an arrow::RecordBatch.
+// Objects can be anything accepted by pyarrow.table(), including Python sequences, numpy arrays,
+// pandas Series and pyarrow (Chunked)Arrays. Numeric columns are not copied whenever possible and
+// pandas.Categorical are mapped to dictionary-encoded columns.
+[[nodiscard]] static std::shared_ptr<arrow::RecordBatch> import_columns(
+    const std::vector<std::pair<const char*, nb::object>>& columns) {
+  nb::dict data{};
+  for (const auto& [name, col] : columns) {
+    data[name] = col;
+  }
+
+  const auto table = import_pyarrow_table(data);
+  auto batch = table->CombineChunksToBatch();
+  if (!batch.ok()) {
+    throw std::runtime_error(fmt::format(FMT_STRING("failed to read columns from table: {}"),
+                                         batch.status().message()));
+  }
+  return batch.MoveValueUnsafe();
+}
+
+// Run fx(first, last) over [0, size) by splitting the range across up to n_threads threads
+template <typename Fx>
+static void parallel_for(std::size_t size, std::size_t n_threads, Fx fx) {
+  if (n_threads == 0) {
+    throw std::runtime_error("n_threads should be a positive number");
+  }
+
+  // NOLINTNEXTLINE(*-avoid-magic-numbers)
+  constexpr std::size_t min_chunk_size = 100'000;
+  n_threads = std::min(n_threads, (size + min_chunk_size - 1) / min_chunk_size);
+  if (n_threads < 2) {
+    fx(std::size_t{0}, size);
+    return;
+  }
 
+  BS::thread_pool tpool(conditional_static_cast<BS::concurrency_t>(n_threads));
+  std::vector<std::future<void>> workers(n_threads);
+  for (std::size_t i = 0; i < n_threads; ++i) {
+    const auto first = (size * i) / n_threads;
+    const auto last = (size * (i + 1)) / n_threads;
+    workers[i] = tpool.submit_task([&fx, first, last]() { fx(first, last); });
+  }
+  for (auto& worker : workers) {
+    worker.get();
+  }
+}
+
+[[nodiscard]] static std::shared_ptr<arrow::UInt64Array> import_bin_ids(const nb::object& bin_ids) {
+  const auto batch = import_columns({{"bin_id", bin_ids}});
+  return internal::get_numeric_column<std::uint64_t>(*batch, "bin_id");
+}
+
+// Map genomic coordinates to bin IDs. Chromosome names are resolved once for each dictionary
+// entry (or for each run of identical names), while the mapping from positions to bin IDs is
+// computed in closed-form for tables with fixed bins and with a binary search for tables with
+// variable bins.
+[[nodiscard]] static std::vector<std::uint64_t> map_coords_to_bin_ids(const hictk::BinTable& bins,
+                                                                      const nb::object& chroms,
+                                                                      const nb::object& positions,
+                                                                      std::size_t n_threads) {
+  const auto batch = import_columns({{"chrom", chroms}, {"pos", positions}});
+
+  [[maybe_unused]] const nb::gil_scoped_release gil{};
+  const auto chrom_ids =
+      internal::map_chrom_names_to_ids(bins.chromosomes(), batch->GetColumnByName("chrom"));
+  const auto pos_col = internal::get_numeric_column<std::uint32_t>(*batch, "pos");
+  const auto* pos = pos_col->raw_values();
+
+  std::vector<std::uint64_t> bin_ids(chrom_ids.size());
   std::visit(
-      [&](const auto& bins) {
-        for (std::size_t i = 0; i < bin_ids.size(); ++i) {
-          const auto bin = bins.at(bin_ids[i]);
-          chrom_ids[i] = static_cast<std::int32_t>(bin.chrom().id());
-          start_pos[i] = bin.start();
-          end_pos[i] = bin.end();
-        }
+      [&](const auto& bins_) {
+        parallel_for(bin_ids.size(), n_threads, [&](std::size_t first, std::size_t last) {
+          for (auto i = first; i < last; ++i) {
+            bin_ids[i] = bins_.map_to_bin_id(chrom_ids[i], pos[i]);
+          }
+        });
       },
-      _bins->get());
+      bins.get());
+
+  return bin_ids;
+}
+
+// Map bin IDs to their genomic coordinates
+static void map_bin_ids_to_coords(const hictk::BinTable& bins, std::size_t size,
+                                  const std::uint64_t* bin_ids, std::int32_t* chrom_ids,
+                                  std::uint32_t* start_pos, std::uint32_t* end_pos,
+                                  std::size_t n_threads) {
+  const auto chrom_id_offset = static_cast<std::uint32_t>(bins.chromosomes().at(0).is_all());
+
+  std::visit(
+      [&](const auto& bins_) {
+        parallel_for(size, n_threads, [&](std::size_t first, std::size_t last) {
+          // NOLINTBEGIN(*-pro-bounds-pointer-arithmetic)
+          for (auto i = first; i < last; ++i) {
+            const auto bin = bins_.at(bin_ids[i]);
+            chrom_ids[i] = static_cast<std::int32_t>(bin.chrom().id() - chrom_id_offset);
+            start_pos[i] = bin.start();
+            end_pos[i] = bin.end();
+          }
+          // NOLINTEND(*-pro-bounds-pointer-arithmetic)
+        });
+      },
+      bins.get());
+}
+
+nb::object BinTable::bin_ids_to_coords(const nb::object& bin_ids, std::size_t n_threads) const {
+  // Make sure scalars (including numpy integers) are handled by bin_id_to_coord()
+  if (PyIndex_Check(bin_ids.ptr()) != 0 && PySequence_Check(bin_ids.ptr()) == 0) {
+    return nb::cast(bin_id_to_coord(nb::cast<std::uint64_t>(bin_ids)));
+  }
+
+  const auto bin_ids_col = import_bin_ids(bin_ids);
+  const auto n = static_cast<std::size_t>(bin_ids_col->length());
+
+  std::vector<std::uint64_t> bin_ids_(bin_ids_col->raw_values(), bin_ids_col->raw_values() + n);
+  std::vector<std::int32_t> chrom_ids(n);
+  std::vector<std::uint32_t> start_pos(n);
+  std::vector<std::uint32_t> end_pos(n);
+
+  {
+    [[maybe_unused]] const nb::gil_scoped_release gil{};
+    map_bin_ids_to_coords(*_bins, n, bin_ids_.data(), chrom_ids.data(), start_pos.data(),
+                          end_pos.data(), n_threads);
+  }
 
   return make_bin_table_df(chrom_names(), std::move(chrom_ids), std::move(start_pos),
-                           std::move(end_pos), std::move(bin_ids));
+                           std::move(end_pos), std::move(bin_ids_));
 }
 
 hictk::Bin BinTable::bin_id_to_coord(std::uint64_t bin_id) const { return _bins->at(bin_id); }
@@ -211,27 +325,25 @@ hictk::Bin BinTable::coord_to_bin(std::string_view chrom, std::uint32_t pos) con
   return _bins->at(chrom, pos);
 }
 
-nanobind::object BinTable::coords_to_bins(const std::vector<std::string>& chroms,
-                                          const std::vector<std::uint32_t>& positions) const {
-  if (chroms.size() != positions.size()) {
-    throw std::runtime_error("chroms and positions should have the same size");
+nanobind::object BinTable::coords_to_bins(const nb::object& chroms, const nb::object& positions,
+                                          std::size_t n_threads) const {
+  if (nb::isinstance<nb::str>(chroms)) {
+    return nb::cast(coord_to_bin(nb::cast<std::string_view>(chroms),
+                                 nb::cast<std::uint32_t>(positions)));
   }
-  std::vector<std::uint64_t> bin_ids(chroms.size());
-  std::vector<std::int32_t> chrom_ids(chroms.size());
-  std::vector<std::uint32_t> start_pos(chroms.size());
-  std::vector<std::uint32_t> end_pos(chroms.size());
 
-  std::visit(
-      [&](const auto& bins) {
-        for (std::size_t i = 0; i < chroms.size(); ++i) {
-          const auto bin = bins.at(chroms[i], positions[i]);
-          bin_ids[i] = bin.id();
-          chrom_ids[i] = static_cast<std::int32_t>(bin.chrom().id());
-          start_pos[i] = bin.start();
-          end_pos[i] = bin.end();
-        }
-      },
-      _bins->get());
+  auto bin_ids = map_coords_to_bin_ids(*_bins, chroms, positions, n_threads);
+  const auto n = bin_ids.size();
+
+  std::vector<std::int32_t> chrom_ids(n);
+  std::vector<std::uint32_t> start_pos(n);
+  std::vector<std::uint32_t> end_pos(n);
+
+  {
+    [[maybe_unused]] const nb::gil_scoped_release gil{};
+    map_bin_ids_to_coords(*_bins, n, bin_ids.data(), chrom_ids.data(), start_pos.data(),
+                          end_pos.data(), n_threads);
+  }
 
   return make_bin_table_df(chrom_names(), std::move(chrom_ids), std::move(start_pos),
                            std::move(end_pos), std::move(bin_ids));
@@ -241,27 +353,16 @@ std::int64_t BinTable::coord_to_bin_id(std::string_view chrom, std::uint32_t pos
   return static_cast<std::int64_t>(_bins->at(chrom, pos).id());
 }
 
-auto BinTable::coords_to_bin_ids(const std::vector<std::string>& chroms,
-                                 const std::vector<std::uint32_t>& positions) const -> BinIDsVec {
+auto BinTable::coords_to_bin_ids(const nb::object& chroms, const nb::object& positions,
+                                 std::size_t n_threads) const -> BinIDsVec {
   auto np = import_module_checked("numpy");
 
-  if (chroms.size() != positions.size()) {
-    throw std::runtime_error("chroms and positions should have the same size");
-  }
+  const auto bin_ids = map_coords_to_bin_ids(*_bins, chroms, positions, n_threads);
 
   auto np_array =
-      np.attr("empty")(static_cast<std::int64_t>(chroms.size()), nb::arg("dtype") = "int");
+      np.attr("empty")(static_cast<std::int64_t>(bin_ids.size()), nb::arg("dtype") = "int64");
   auto buffer = nb::cast<BinIDsVec>(np_array);
-  auto bin_ids = buffer.view();
-
-  std::visit(
-      [&](const auto& bins) {
-        for (std::size_t i = 0; i < chroms.size(); ++i) {
-          bin_ids(static_cast<std::int64_t>(i)) =
-              static_cast<std::int64_t>(bins.at(chroms[i], positions[i]).id());
-        }
-      },
-      _bins->get());
+  std::copy(bin_ids.begin(), bin_ids.end(), buffer.data());
 
   return buffer;
 }
@@ -290,16 +391,13 @@ auto BinTable::coords_to_bin_ids(const std::vector<std::string>& chroms,
   return df;
 }
 
-nb::object BinTable::merge_coords(nb::object df) const {
+nb::object BinTable::merge_coords(nb::object df, std::size_t n_threads) const {
   import_pyarrow_checked();
   auto pd = import_module_checked("pandas");
 
-  // TODO avoid potentially copying data here
-  using Buffer64T = nb::ndarray<nb::numpy, nb::shape<-1>, std::int64_t>;
-  auto bin1_ids = nb::cast<Buffer64T>(df.attr("__getitem__")("bin1_id").attr("to_numpy")());
-  auto bin2_ids = nb::cast<Buffer64T>(df.attr("__getitem__")("bin2_id").attr("to_numpy")());
-
-  const auto n = bin1_ids.size();
+  const auto bin1_ids = import_bin_ids(df.attr("__getitem__")("bin1_id"));
+  const auto bin2_ids = import_bin_ids(df.attr("__getitem__")("bin2_id"));
+  const auto n = static_cast<std::size_t>(bin1_ids->length());
 
   std::vector<std::int32_t> chrom1_ids(n);
   std::vector<std::uint32_t> starts1(n);
@@ -308,23 +406,13 @@ nb::object BinTable::merge_coords(nb::object df) const {
   std::vector<std::uint32_t> starts2(n);
   std::vector<std::uint32_t> ends2(n);
 
-  std::visit(
-      [&](const auto& bins) {
-        for (std::size_t i = 0; i < n; ++i) {
-          const auto bin1 =
-              bins.at(static_cast<std::uint64_t>(bin1_ids(static_cast<std::int64_t>(i))));
-          chrom1_ids[i] = static_cast<std::int32_t>(bin1.chrom().id());
-          starts1[i] = bin1.start();
-          ends1[i] = bin1.end();
-
-          const auto bin2 =
-              bins.at(static_cast<std::uint64_t>(bin2_ids(static_cast<std::int64_t>(i))));
-          chrom2_ids[i] = static_cast<std::int32_t>(bin2.chrom().id());
-          starts2[i] = bin2.start();
-          ends2[i] = bin2.end();
-        }
-      },
-      _bins->get());
+  {
+    [[maybe_unused]] const nb::gil_scoped_release gil{};
+    map_bin_ids_to_coords(*_bins, n, bin1_ids->raw_values(), chrom1_ids.data(), starts1.data(),
+                          ends1.data(), n_threads);
+    map_bin_ids_to_coords(*_bins, n, bin2_ids->raw_values(), chrom2_ids.data(), starts2.data(),
+                          ends2.data(), n_threads);
+  }
 
   auto coord_df =
       make_bg2_pixels_df(chrom_names(), std::move(chrom1_ids), std::move(starts1), std::move(ends1),
@@ -488,40 +576,53 @@ void BinTable::bind(nb::module_& m) {
   bt.def("get", &BinTable::bin_id_to_coord, nb::arg("bin_id"),
          "Get the genomic coordinate given a bin ID.",
          nb::sig("def get(self, bin_id: int) -> hictkpy.Bin"), nb::rv_policy::move);
-  bt.def("get", &BinTable::bin_ids_to_coords, nb::arg("bin_ids"),
-         "Get the genomic coordinates given a sequence of bin IDs. "
+  bt.def("get", &BinTable::bin_ids_to_coords, nb::arg("bin_ids"), nb::arg("n_threads") = 1,
+         "Get the genomic coordinates given a sequence of bin IDs (e.g. a list, numpy array, "
+         "pandas.Series or pyarrow.Array). "
          "Genomic coordinates are returned as a pandas.DataFrame with columns [\"chrom\", "
-         "\"start\", \"end\"].",
-         nb::sig("def get(self, bin_ids: collections.abc.Sequence[int]) -> pandas.DataFrame"),
+         "\"start\", \"end\"]. Use n_threads to map large sequences using multiple threads.",
+         nb::sig("def get(self, bin_ids: collections.abc.Sequence[int] | numpy.ndarray | "
+                 "pandas.Series | pyarrow.Array, n_threads: int = 1) -> pandas.DataFrame"),
          nb::rv_policy::take_ownership);
 
   bt.def("get", &BinTable::coord_to_bin, nb::arg("chrom"), nb::arg("pos"),
          "Get the bin overlapping the given genomic coordinate.",
          nb::sig("def get(self, chrom: str, pos: int) -> hictkpy.Bin"), nb::rv_policy::move);
   bt.def("get", &BinTable::coords_to_bins, nb::arg("chroms"), nb::arg("pos"),
+         nb::arg("n_threads") = 1,
          "Get the bins overlapping the given genomic coordinates. "
+         "Coordinates can be given as sequences, numpy arrays, pandas.Series (including "
+         "categorical Series of chromosome names) or pyarrow.Arrays. "
          "Bins are returned as a pandas.DataFrame with columns [\"chrom\", "
-         "\"start\", \"end\"].",
-         nb::sig("def get(self, chroms: collections.abc.Sequence[str], pos: "
-                 "collections.abc.Sequence[int]) -> pandas.DataFrame"),
+         "\"start\", \"end\"]. Use n_threads to map large sequences using multiple threads.",
+         nb::sig("def get(self, chroms: collections.abc.Sequence[str] | numpy.ndarray | "
+                 "pandas.Series | pyarrow.Array, pos: collections.abc.Sequence[int] | "
+                 "numpy.ndarray | pandas.Series | pyarrow.Array, n_threads: int = 1) -> "
+                 "pandas.DataFrame"),
          nb::rv_policy::take_ownership);
 
   bt.def("get_id", &BinTable::coord_to_bin_id, nb::arg("chrom"), nb::arg("pos"),
          "Get the ID of the bin overlapping the given genomic coordinate.");
   bt.def("get_ids", &BinTable::coords_to_bin_ids, nb::arg("chroms"), nb::arg("pos"),
-         "Get the IDs of the bins overlapping the given genomic coordinates.",
-         nb::sig("def get_ids(self, chroms: collections.abc.Sequence[str], pos: "
-                 "collections.abc.Sequence[int]) -> numpy.ndarray[dtype=int64]"),
+         nb::arg("n_threads") = 1,
+         "Get the IDs of the bins overlapping the given genomic coordinates. "
+         "Coordinates can be given as sequences, numpy arrays, pandas.Series (including "
+         "categorical Series of chromosome names) or pyarrow.Arrays. "
+         "Use n_threads to map large sequences using multiple threads.",
+         nb::sig("def get_ids(self, chroms: collections.abc.Sequence[str] | numpy.ndarray | "
+                 "pandas.Series | pyarrow.Array, pos: collections.abc.Sequence[int] | "
+                 "numpy.ndarray | pandas.Series | pyarrow.Array, n_threads: int = 1) -> "
+                 "numpy.ndarray[dtype=int64]"),
          nb::rv_policy::take_ownership);
 
-  bt.def("merge", &BinTable::merge_coords, nb::arg("df"),
+  bt.def("merge", &BinTable::merge_coords, nb::arg("df"), nb::arg("n_threads") = 1,
          "Merge genomic coordinates corresponding to the given bin identifiers. "
          "Bin identifiers should be provided as a pandas.DataFrame with columns \"bin1_id\" and "
          "\"bin2_id\". "
          "Genomic coordinates are returned as a pandas.DataFrame containing the same data as the "
          "DataFrame given as input, plus columns [\"chrom1\", \"start1\", \"end1\", \"chrom2\", "
-         "\"start2\", \"end2\"].",
-         nb::sig("def merge(self, df: pandas.DataFrame) -> pandas.DataFrame"),
+         "\"start2\", \"end2\"]. Use n_threads to map large DataFrames using multiple threads.",
+         nb::sig("def merge(self, df: pandas.DataFrame, n_threads: int = 1) -> pandas.DataFrame"),
          nb::rv_policy::take_ownership);
 
   bt.def("to_df", &BinTable::to_df, nb::arg("range") = nb::none(), nb::arg("query_type") = "UCSC",
@@ -0,0 +1,310 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#include "hictkpy/cache_config.hpp"
+
+#include <fmt/format.h>
+#include <parallel_hashmap/phmap.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <hictk/bin_table.hpp>
+#include <hictk/file.hpp>
+#include <hictk/hic.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+
+#include "hictkpy/nanobind.hpp"
+#include "hictkpy/profiling.hpp"
+#include "hictkpy/query_cache.hpp"
+#include "hictkpy/weight_cache.hpp"
+
+namespace nb = nanobind;
+
+namespace hictkpy {
+
+namespace {
+struct FileCacheRegistry {
+  struct Entry {
+    std::weak_ptr<const hictk::BinTable> key{};
+    std::size_t size_bytes{};
+    // Set for .hic files whose block cache has yet to be sized
+    bool deferred{false};
+    std::optional<std::size_t> upper_bound{};
+  };
+
+  std::mutex mtx{};
+  CacheConfig config{};
+  phmap::flat_hash_map<const hictk::BinTable*, Entry> entries{};
+
+  // Should be called while holding mtx
+  [[nodiscard]] std::size_t size_bytes() {
+    phmap::erase_if(entries, [](const auto& kv) { return kv.second.key.expired(); });
+    std::size_t size = 0;
+    for (const auto& [_, entry] : entries) {
+      size += entry.size_bytes;
+    }
+    return size;
+  }
+};
+}  // namespace
+
+static FileCacheRegistry& get_registry() {
+  static FileCacheRegistry registry{};
+  return registry;
+}
+
+std::string CacheConfig::repr() const {
+  return fmt::format(FMT_STRING("CacheConfig(max_bytes={}, file_cache_bytes={}, "
+                                "weight_cache_bytes={}, query_cache_bytes={}, "
+                                "query_cache_compression_level={}, query_cache_spill_dir=\"{}\", "
+                                "query_cache_spill_bytes={})"),
+                     max_bytes, file_cache_bytes, weight_cache_bytes, query_cache_bytes,
+                     query_cache_compression_level, query_cache_spill_dir,
+                     query_cache_spill_bytes);
+}
+
+CacheConfig get_cache_config() {
+  auto& registry = get_registry();
+  [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+  return registry.config;
+}
+
+void set_cache_config(const CacheConfig& config) {
+  // Validate the query cache settings before touching the other caches
+  get_query_cache().set_settings({config.query_cache_bytes, config.query_cache_compression_level,
+                                  config.query_cache_spill_dir, config.query_cache_spill_bytes});
+
+  auto& registry = get_registry();
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+    registry.config = config;
+  }
+  get_weight_cache().set_capacity_bytes(config.weight_cache_bytes);
+}
+
+std::optional<std::size_t> available_file_cache_bytes() {
+  auto& registry = get_registry();
+  [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+  if (registry.config.max_bytes == 0) {
+    return {};
+  }
+  const auto size = registry.size_bytes();
+  return size >= registry.config.max_bytes ? 0 : registry.config.max_bytes - size;
+}
+
+std::optional<std::size_t> compute_file_cache_size(std::optional<std::size_t> requested) {
+  const auto config = get_cache_config();
+  if (!requested.has_value() && config.file_cache_bytes != 0) {
+    requested = config.file_cache_bytes;
+  }
+
+  const auto available = available_file_cache_bytes();
+  if (!available.has_value()) {
+    return requested;
+  }
+  if (!requested.has_value()) {
+    // let the caller pick the default size, clamping it later on to the available budget
+    return {};
+  }
+  return std::min(*requested, *available);
+}
+
+void register_file_cache(const std::shared_ptr<const hictk::BinTable>& bins,
+                         std::size_t size_bytes) {
+  if (!bins) {
+    return;
+  }
+
+  auto& registry = get_registry();
+  [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+  registry.entries.insert_or_assign(bins.get(), FileCacheRegistry::Entry{bins, size_bytes});
+}
+
+std::size_t get_file_cache_size(const std::shared_ptr<const hictk::BinTable>& bins) {
+  auto& registry = get_registry();
+  [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+  auto match = registry.entries.find(bins.get());
+  if (match == registry.entries.end() || match->second.key.expired()) {
+    return 0;
+  }
+  return match->second.size_bytes;
+}
+
+std::size_t compute_worker_file_cache_size(const std::shared_ptr<const hictk::BinTable>& bins,
+                                           std::size_t num_workers) {
+  assert(num_workers != 0);
+  auto size_bytes = get_file_cache_size(bins);
+  if (size_bytes == 0) {
+    const auto requested = compute_file_cache_size({});
+    const auto available = available_file_cache_bytes();
+    if (!requested.has_value() && !available.has_value()) {
+      return 0;
+    }
+    size_bytes = requested.value_or(available.value_or(0));
+  }
+  return std::max(size_bytes / num_workers, std::size_t{1});
+}
+
+void register_deferred_file_cache(const std::shared_ptr<const hictk::BinTable>& bins,
+                                  std::size_t size_bytes, std::optional<std::size_t> upper_bound) {
+  if (!bins) {
+    return;
+  }
+
+  auto& registry = get_registry();
+  [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+  registry.entries.insert_or_assign(bins.get(),
+                                    FileCacheRegistry::Entry{bins, size_bytes, true, upper_bound});
+}
+
+void optimize_deferred_file_cache(const hictk::File& f) {
+  if (!f.is_hic()) {
+    return;
+  }
+
+  const auto bins = f.bins_ptr();
+  auto& registry = get_registry();
+  const auto upper_bound = [&]() -> std::optional<std::optional<std::size_t>> {
+    [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+    auto match = registry.entries.find(bins.get());
+    if (match == registry.entries.end() || !match->second.deferred) {
+      return {};
+    }
+    match->second.deferred = false;
+    return match->second.upper_bound;
+  }();
+
+  if (!upper_bound.has_value()) {
+    return;
+  }
+
+  // Reported as a separate operation, as this happens when e.g. calling File.fetch()
+  [[maybe_unused]] const profiling::Operation op{"File.optimize_cache"};
+  [[maybe_unused]] const profiling::Stage stage{"optimize_cache"};
+  // File objects are never constructed as const objects: sizing the cache only affects the block
+  // cache owned by the file (which is guarded by the file lock held by the caller)
+  auto& hf = const_cast<hictk::hic::File&>(f.get<hictk::hic::File>());  // NOLINT
+  if (upper_bound->has_value()) {
+    hf.optimize_cache_size(std::max(**upper_bound, std::size_t{1}));
+  } else {
+    hf.optimize_cache_size();
+  }
+  register_file_cache(bins, hf.cache_capacity());
+}
+
+nb::dict get_cache_stats() {
+  auto& registry = get_registry();
+  const auto [num_files, file_cache_bytes, max_bytes] = [&]() {
+    [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+    const auto size = registry.size_bytes();
+    return std::make_tuple(registry.entries.size(), size, registry.config.max_bytes);
+  }();
+
+  const auto& weight_cache = get_weight_cache();
+  const auto weight_stats = weight_cache.stats();
+
+  nb::dict files{};
+  files["num_files"] = num_files;
+  files["size_bytes"] = file_cache_bytes;
+  files["capacity_bytes"] = max_bytes;
+
+  nb::dict weights{};
+  weights["num_entries"] = weight_cache.size();
+  weights["size_bytes"] = weight_cache.size_bytes();
+  weights["capacity_bytes"] = weight_cache.capacity_bytes();
+  weights["hits"] = weight_stats.hits;
+  weights["misses"] = weight_stats.misses;
+  weights["evictions"] = weight_stats.evictions;
+  weights["invalidations"] = weight_stats.invalidations;
+
+  const auto& query_cache = get_query_cache();
+  const auto query_stats = query_cache.stats();
+
+  nb::dict queries{};
+  queries["num_entries"] = query_cache.size();
+  queries["size_bytes"] = query_cache.size_bytes();
+  queries["capacity_bytes"] = query_cache.capacity_bytes();
+  queries["num_spilled_entries"] = query_cache.num_spilled_entries();
+  queries["spilled_bytes"] = query_cache.spilled_bytes();
+  queries["hits"] = query_stats.hits;
+  queries["misses"] = query_stats.misses;
+  queries["evictions"] = query_stats.evictions;
+  queries["invalidations"] = query_stats.invalidations;
+  queries["spill_hits"] = query_stats.spill_hits;
+
+  nb::dict stats{};
+  stats["files"] = files;
+  stats["weights"] = weights;
+  stats["queries"] = queries;
+  return stats;
+}
+
+void CacheConfig::bind(nb::module_& m) {
+  auto cfg = nb::class_<CacheConfig>(
+      m, "CacheConfig",
+      "Class representing the settings used to size the caches used when reading interactions.");
+
+  cfg.def(
+      "__init__",
+      [](CacheConfig* c, std::size_t max_bytes, std::size_t file_cache_bytes,
+         std::size_t weight_cache_bytes, std::size_t query_cache_bytes,
+         int query_cache_compression_level, std::optional<std::string> query_cache_spill_dir,
+         std::size_t query_cache_spill_bytes) {
+        new (c) CacheConfig{max_bytes,
+                            file_cache_bytes,
+                            weight_cache_bytes,
+                            query_cache_bytes,
+                            query_cache_compression_level,
+                            query_cache_spill_dir.value_or(""),
+                            query_cache_spill_bytes};
+      },
+      nb::arg("max_bytes") = 0, nb::arg("file_cache_bytes") = 0,
+      nb::arg("weight_cache_bytes") = WeightCache::default_capacity_bytes,
+      nb::arg("query_cache_bytes") = 0, nb::arg("query_cache_compression_level") = 0,
+      nb::arg("query_cache_spill_dir") = nb::none(), nb::arg("query_cache_spill_bytes") = 0,
+      "Construct a CacheConfig object.\n"
+      "max_bytes: upper bound on the total size of the caches owned by open files (0 means no "
+      "limit).\n"
+      "file_cache_bytes: cache size used by files opened without specifying cache_size (0 means "
+      "that the default size for the file format is used).\n"
+      "weight_cache_bytes: capacity of the cache shared by all files to store balancing weights.\n"
+      "query_cache_bytes: capacity of the cache shared by all files to store the results of "
+      "PixelSelector.to_numpy() and PixelSelector.to_arrow() (0 means that query results are not "
+      "cached).\n"
+      "query_cache_compression_level: level used to compress the dense matrices stored in the "
+      "query cache (0 means no compression, 12 means maximum compression).\n"
+      "query_cache_spill_dir: folder where dense matrices evicted from the query cache are "
+      "written (None means that evicted matrices are discarded).\n"
+      "query_cache_spill_bytes: maximum size of the matrices spilled to query_cache_spill_dir.");
+  cfg.def("__repr__", &CacheConfig::repr, nb::rv_policy::move);
+  cfg.def_rw("max_bytes", &CacheConfig::max_bytes);
+  cfg.def_rw("file_cache_bytes", &CacheConfig::file_cache_bytes);
+  cfg.def_rw("weight_cache_bytes", &CacheConfig::weight_cache_bytes);
+  cfg.def_rw("query_cache_bytes", &CacheConfig::query_cache_bytes);
+  cfg.def_rw("query_cache_compression_level", &CacheConfig::query_cache_compression_level);
+  cfg.def_rw("query_cache_spill_dir", &CacheConfig::query_cache_spill_dir);
+  cfg.def_rw("query_cache_spill_bytes", &CacheConfig::query_cache_spill_bytes);
+
+  m.def("get_cache_config", &get_cache_config, "Get the current cache settings.");
+  m.def("set_cache_config", &set_cache_config, nb::arg("config"),
+        "Update the cache settings.\n"
+        "The new settings only affect the files opened after calling this function, with the "
+        "exception of the settings of the weight and query caches, which are applied "
+        "immediately.");
+  m.def("cache_stats", &get_cache_stats,
+        "Get statistics about the caches used by hictkpy as a dictionary.\n"
+        "The \"files\" entry reports the number of open files and the total size of their caches. "
+        "The \"weights\" entry reports the size and the hit, miss, and eviction counters of the "
+        "cache storing balancing weights. The \"queries\" entry reports the same information "
+        "for the cache storing query results, together with the number of entries invalidated "
+        "because the underlying file changed and the number of entries spilled to disk.",
+        nb::rv_policy::take_ownership);
+}
+
+}  // namespace hictkpy
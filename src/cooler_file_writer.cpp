@@ -8,26 +8,38 @@
 #include <fmt/std.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <future>
 #include <hictk/cooler/cooler.hpp>
 #include <hictk/file.hpp>
+#include <hictk/pixel.hpp>
 #include <hictk/reference.hpp>
 #include <hictk/tmpdir.hpp>
 #include <hictk/type_traits.hpp>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include "hictkpy/bin_table.hpp"
 #include "hictkpy/common.hpp"
+#include "hictkpy/locking.hpp"
 #include "hictkpy/nanobind.hpp"
+#include "hictkpy/pairs.hpp"
 #include "hictkpy/pixel.hpp"
+#include "hictkpy/profiling.hpp"
 #include "hictkpy/reference.hpp"
+#include "hictkpy/task_queue.hpp"
+#include "hictkpy/to_pyarrow.hpp"
 
 namespace nb = nanobind;
 
@@ -35,11 +47,15 @@ namespace hictkpy {
 
 CoolerFileWriter::CoolerFileWriter(std::filesystem::path path_, const hictkpy::BinTable &bins_,
                                    std::string_view assembly, const std::filesystem::path &tmpdir,
-                                   std::uint32_t compression_lvl)
+                                   std::uint32_t compression_lvl, std::size_t n_threads,
+                                   std::size_t async_queue_bytes)
     : _path(std::move(path_)),
       _tmpdir(tmpdir, true),
       _w(create_file(_path.string(), *bins_.get(), assembly, _tmpdir())),
-      _compression_lvl(compression_lvl) {
+      _compression_lvl(compression_lvl),
+      _tpool(init_tpool(n_threads)),
+      _queue(async_queue_bytes == 0 ? nullptr
+                                    : std::make_unique<BoundedTaskQueue>(async_queue_bytes)) {
   if (std::filesystem::exists(_path)) {
     throw std::runtime_error(
         fmt::format(FMT_STRING("unable to create .cool file \"{}\": file already exists"), path()));
@@ -51,9 +67,10 @@ CoolerFileWriter::CoolerFileWriter(std::filesystem::path path_, const hictkpy::B
 CoolerFileWriter::CoolerFileWriter(std::filesystem::path path_, const ChromosomeDict &chromosomes_,
                                    std::uint32_t resolution_, std::string_view assembly,
                                    const std::filesystem::path &tmpdir,
-                                   std::uint32_t compression_lvl)
+                                   std::uint32_t compression_lvl, std::size_t n_threads,
+                                   std::size_t async_queue_bytes)
     : CoolerFileWriter(std::move(path_), BinTable{chromosomes_, resolution_}, assembly, tmpdir,
-                       compression_lvl) {}
+                       compression_lvl, n_threads, async_queue_bytes) {}
 
 const std::filesystem::path &CoolerFileWriter::path() const noexcept { return _path; }
 
@@ -87,38 +104,107 @@ void CoolerFileWriter::add_pixels(const nb::object &df) {
         "caught attempt to add_pixels to a .cool file that has already been finalized!");
   }
 
-  const auto cell_id = fmt::to_string(_w->cells().size());
-  auto attrs = hictk::cooler::Attributes::init(_w->resolution());
-  attrs.assembly = _w->attributes().assembly;
-
-  auto lck = std::make_optional<nb::gil_scoped_acquire>();
-  const auto coo_format = nb::cast<bool>(df.attr("columns").attr("__contains__")("bin1_id"));
+  [[maybe_unused]] const profiling::Operation op{"cooler.FileWriter.add_pixels"};
+  auto table = [&]() {
+    [[maybe_unused]] const profiling::Stage gil_acquired{"gil_acquired"};
+    [[maybe_unused]] const nb::gil_scoped_acquire gil{};
+    [[maybe_unused]] const profiling::Stage stage{"import"};
+    return import_pyarrow_table(df);
+  }();
+  profiling::add_counter("pixels", table->num_rows());
 
-  const auto dtype = df.attr("__getitem__")("count").attr("dtype");
-  const auto dtype_str = nb::cast<std::string>(dtype.attr("__str__")());
-  const auto var = map_dtype_to_type(dtype_str);
+  const auto coo_format = table_is_coo(*table);
+  const auto var = infer_count_type(*table);
 
   std::visit(
       [&](const auto &n) {
         using N = remove_cvref_t<decltype(n)>;
-        const auto pixels = coo_format ? coo_df_to_thin_pixels<N>(df, true)
-                                       : bg2_df_to_thin_pixels<N>(_w->bins(), df, true);
-        lck.reset();
+        auto pixels = [&]() {
+          [[maybe_unused]] const profiling::Stage stage{"convert"};
+          return coo_format ? coo_table_to_thin_pixels<N>(*table, false)
+                            : bg2_table_to_thin_pixels<N>(_w->bins(), *table, false);
+        }();
+        table.reset();
+
+        {
+          [[maybe_unused]] const profiling::Stage stage{"sort"};
+          sort_pixels(pixels);
+        }
+        [[maybe_unused]] const profiling::Stage stage{"write"};
+        submit_cell(std::move(pixels));
+      },
+      var);
+}
+
+void CoolerFileWriter::add_pairs(const std::filesystem::path &path_, std::size_t chunk_size,
+                                 bool one_based, bool drop_unknown_chroms) {
+  if (!_w.has_value()) {
+    throw std::runtime_error(
+        "caught attempt to add_pairs to a .cool file that has already been finalized!");
+  }
+
+  // NOLINTNEXTLINE(*-unchecked-optional-access)
+  PairsReader reader(path_, _w->bins_ptr(), one_based, drop_unknown_chroms, _tpool.get());
+  SPDLOG_INFO(FMT_STRING("reading pairs from file {}..."), reader.path());
+
+  // Each chunk of pairs is binned, sorted, and written to a temporary cell. Cells are merged by
+  // finalize()
+  std::vector<hictk::ThinPixel<std::int32_t>> pixels{};
+  while (reader.next_chunk(pixels, chunk_size)) {
+    sort_pixels(pixels);
+    internal::merge_duplicate_pixels(pixels);
+    submit_cell(std::move(pixels));
+    pixels = {};
+  }
 
-        auto clr = _w->create_cell<N>(cell_id, std::move(attrs),
-                                      hictk::cooler::DEFAULT_HDF5_CACHE_SIZE * 4, 1);
+  SPDLOG_INFO(FMT_STRING("read {} records from file {} ({} records were dropped)"),
+              reader.num_records(), reader.path(), reader.num_dropped_records());
+}
+
+template <typename N>
+void CoolerFileWriter::submit_cell(std::vector<hictk::ThinPixel<N>> pixels) {
+  auto cell_id = fmt::to_string(_num_cells++);
 
-        SPDLOG_INFO(FMT_STRING("adding {} pixels of type {} to file \"{}\"..."), pixels.size(),
-                    dtype_str, clr.uri());
-        clr.append_pixels(pixels.begin(), pixels.end());
+  if (!_queue) {
+    write_cell(cell_id, pixels);
+    return;
+  }
 
-        clr.flush();
+  const auto size_bytes = pixels.size() * sizeof(hictk::ThinPixel<N>);
+  _queue->submit(
+      [this, cell_id = std::move(cell_id), pixels = std::move(pixels)]() {
+        write_cell(cell_id, pixels);
       },
-      var);
+      size_bytes);
 }
 
-hictk::File CoolerFileWriter::finalize(std::string_view log_lvl_str, std::size_t chunk_size,
-                                       std::size_t update_freq) {
+template <typename N>
+void CoolerFileWriter::write_cell(const std::string &cell_id,
+                                  const std::vector<hictk::ThinPixel<N>> &pixels) {
+  assert(_w.has_value());
+  // NOLINTBEGIN(*-unchecked-optional-access)
+  auto attrs = hictk::cooler::Attributes::init(_w->resolution());
+  attrs.assembly = _w->attributes().assembly;
+
+  std::unique_lock hdf5_lck(*get_hdf5_mutex(), std::defer_lock);
+  {
+    [[maybe_unused]] const profiling::Stage stage{"lock_wait"};
+    hdf5_lck.lock();
+  }
+  auto clr = _w->create_cell<N>(cell_id, std::move(attrs),
+                                hictk::cooler::DEFAULT_HDF5_CACHE_SIZE * 4, 1);
+
+  SPDLOG_INFO(FMT_STRING("adding {} pixels of type {} to file \"{}\"..."), pixels.size(),
+              map_type_to_dtype<N>(), clr.uri());
+  clr.append_pixels(pixels.begin(), pixels.end());
+
+  clr.flush();
+  // NOLINTEND(*-unchecked-optional-access)
+}
+
+FileHandle CoolerFileWriter::finalize(std::string_view log_lvl_str, std::size_t chunk_size,
+                                      std::size_t update_freq) {
+  [[maybe_unused]] const profiling::Operation op{"cooler.FileWriter.finalize"};
   if (_finalized) {
     throw std::runtime_error(
         fmt::format(FMT_STRING("finalize() was already called on file \"{}\""), _path));
@@ -128,14 +214,28 @@ hictk::File CoolerFileWriter::finalize(std::string_view log_lvl_str, std::size_t
     throw std::runtime_error("chunk_size must be greater than 0");
   }
 
+  if (_queue) {
+    // wait for pending pixels to be written to file and re-throw errors (if any)
+    [[maybe_unused]] const profiling::Stage stage{"queue_wait"};
+    _queue->wait();
+    _queue.reset();
+  }
+
   assert(_w.has_value());
   // NOLINTBEGIN(*-unchecked-optional-access)
   const auto log_lvl = spdlog::level::from_str(normalize_log_lvl(log_lvl_str));
   const auto previous_lvl = spdlog::default_logger()->level();
   spdlog::default_logger()->set_level(log_lvl);
 
+  std::unique_lock hdf5_lck(*get_hdf5_mutex(), std::defer_lock);
+  {
+    [[maybe_unused]] const profiling::Stage stage{"lock_wait"};
+    hdf5_lck.lock();
+  }
+
   SPDLOG_INFO(FMT_STRING("finalizing file \"{}\"..."), _path);
   try {
+    [[maybe_unused]] const profiling::Stage stage{"merge"};
     std::visit(
         [&](const auto &num) {
           using N = remove_cvref_t<decltype(num)>;
@@ -156,7 +256,82 @@ hictk::File CoolerFileWriter::finalize(std::string_view log_lvl_str, std::size_t
   std::filesystem::remove(sclr_path);  // NOLINT
   // NOLINTEND(*-unchecked-optional-access)
 
-  return hictk::File{_path.string()};
+  return FileHandle{hictk::File{_path.string()}};
+}
+
+std::unique_ptr<BS::thread_pool> CoolerFileWriter::init_tpool(std::size_t n_threads) {
+  if (n_threads == 0) {
+    throw std::runtime_error("n_threads should be a positive number");
+  }
+  if (n_threads == 1) {
+    return {};
+  }
+  return std::make_unique<BS::thread_pool>(conditional_static_cast<BS::concurrency_t>(n_threads));
+}
+
+template <typename N>
+void CoolerFileWriter::sort_pixels(std::vector<hictk::ThinPixel<N>> &pixels) {
+  // NOLINTNEXTLINE(*-avoid-magic-numbers)
+  constexpr std::size_t min_chunk_size = 100'000;
+  const auto num_chunks =
+      !_tpool ? std::size_t{1}
+              : std::min(static_cast<std::size_t>(_tpool->get_thread_count()),
+                         (pixels.size() + min_chunk_size - 1) / min_chunk_size);
+
+  if (num_chunks < 2) {
+    internal::sort_pixels(pixels);
+    return;
+  }
+
+  if (std::is_sorted(pixels.begin(), pixels.end())) {
+    return;
+  }
+
+  // Sort chunks of pixels in parallel, then merge pairs of adjacent chunks until a single chunk is
+  // left
+  std::vector<std::size_t> offsets(num_chunks + 1);
+  for (std::size_t i = 0; i < offsets.size(); ++i) {
+    offsets[i] = (pixels.size() * i) / num_chunks;
+  }
+
+  auto first = pixels.begin();
+  std::vector<std::future<void>> workers{};
+  const auto wait = [&]() {
+    _tpool->wait();
+    for (auto &worker : workers) {
+      worker.get();
+    }
+    workers.clear();
+  };
+
+  for (std::size_t i = 0; i < num_chunks; ++i) {
+    workers.emplace_back(_tpool->submit_task([&, i]() {
+      std::sort(first + static_cast<std::ptrdiff_t>(offsets[i]),
+                first + static_cast<std::ptrdiff_t>(offsets[i + 1]));
+    }));
+  }
+  wait();
+
+  while (offsets.size() > 2) {
+    std::vector<std::size_t> merged_offsets{};
+    for (std::size_t i = 0; i + 2 < offsets.size(); i += 2) {
+      workers.emplace_back(_tpool->submit_task([&, i]() {
+        std::inplace_merge(first + static_cast<std::ptrdiff_t>(offsets[i]),
+                           first + static_cast<std::ptrdiff_t>(offsets[i + 1]),
+                           first + static_cast<std::ptrdiff_t>(offsets[i + 2]));
+      }));
+      merged_offsets.push_back(offsets[i]);
+    }
+    if (offsets.size() % 2 == 0) {
+      // odd number of chunks: the last chunk is merged during the next round
+      merged_offsets.push_back(offsets[offsets.size() - 2]);
+    }
+    merged_offsets.push_back(offsets.back());
+    wait();
+    offsets = std::move(merged_offsets);
+  }
+
+  assert(std::is_sorted(pixels.begin(), pixels.end()));
 }
 
 hictk::cooler::SingleCellFile CoolerFileWriter::create_file(std::string_view path,
@@ -184,18 +359,21 @@ void CoolerFileWriter::bind(nb::module_ &m) {
 
   // NOLINTBEGIN(*-avoid-magic-numbers)
   writer.def(nb::init<std::filesystem::path, const ChromosomeDict &, std::uint32_t,
-                      std::string_view, const std::filesystem::path &, std::uint32_t>(),
+                      std::string_view, const std::filesystem::path &, std::uint32_t,
+                      std::size_t, std::size_t>(),
              nb::arg("path"), nb::arg("chromosomes"), nb::arg("resolution"),
              nb::arg("assembly") = "unknown",
              nb::arg("tmpdir") = hictk::internal::TmpDir::default_temp_directory_path(),
-             nb::arg("compression_lvl") = 6,
+             nb::arg("compression_lvl") = 6, nb::arg("n_threads") = 1,
+             nb::arg("async_queue_bytes") = 0,
              "Open a .cool file for writing given a list of chromosomes with their sizes and a "
              "resolution.");
   writer.def(nb::init<std::filesystem::path, const hictkpy::BinTable &, std::string_view,
-                      const std::filesystem::path &, std::uint32_t>(),
+                      const std::filesystem::path &, std::uint32_t, std::size_t, std::size_t>(),
              nb::arg("path"), nb::arg("bins"), nb::arg("assembly") = "unknown",
              nb::arg("tmpdir") = hictk::internal::TmpDir::default_temp_directory_path(),
-             nb::arg("compression_lvl") = 6,
+             nb::arg("compression_lvl") = 6, nb::arg("n_threads") = 1,
+             nb::arg("async_queue_bytes") = 0,
              "Open a .cool file for writing given a table of bins.");
   // NOLINTEND(*-avoid-magic-numbers)
 
@@ -212,11 +390,27 @@ void CoolerFileWriter::bind(nb::module_ &m) {
 
   writer.def("add_pixels", &hictkpy::CoolerFileWriter::add_pixels,
              nb::call_guard<nb::gil_scoped_release>(),
-             nb::sig("def add_pixels(self, pixels: pandas.DataFrame)"), nb::arg("pixels"),
-             "Add pixels from a pandas DataFrame containing pixels in COO or BG2 format (i.e. "
-             "either with columns=[bin1_id, bin2_id, count] or with columns=[chrom1, start1, end1, "
-             "chrom2, start2, end2, count].");
+             nb::sig("def add_pixels(self, pixels: pandas.DataFrame | pyarrow.Table | "
+                    "pyarrow.RecordBatch)"),
+             nb::arg("pixels"),
+             "Add pixels from a pandas DataFrame, pyarrow Table or RecordBatch (or any object "
+             "implementing the __arrow_c_stream__ protocol) containing pixels in COO or BG2 format "
+             "(i.e. either with columns=[bin1_id, bin2_id, count] or with columns=[chrom1, start1, "
+             "end1, chrom2, start2, end2, count]). Chromosome columns can be dictionary-encoded "
+             "(e.g. pandas.Categorical).");
   // NOLINTBEGIN(*-avoid-magic-numbers)
+  writer.def("add_pairs", &hictkpy::CoolerFileWriter::add_pairs,
+             nb::call_guard<nb::gil_scoped_release>(), nb::arg("path"),
+             nb::arg("chunk_size") = 10'000'000, nb::arg("one_based") = true,
+             nb::arg("drop_unknown_chroms") = false,
+             "Add interactions from a file in 4DN-DCIC pairs format (.pairs). Files can be either "
+             "uncompressed or compressed with bgzip.\n"
+             "Pairs are read, binned, and written to file in chunks of chunk_size pixels: when "
+             "the writer was created with n_threads > 1, decompression and parsing are done in "
+             "parallel.\n"
+             "Positions are assumed to be one-based unless one_based=False. Records referring to "
+             "chromosomes that are not in the table of bins raise an exception, unless "
+             "drop_unknown_chroms=True.");
   writer.def("finalize", &hictkpy::CoolerFileWriter::finalize,
              nb::call_guard<nb::gil_scoped_release>(), nb::arg("log_lvl") = "WARN",
              nb::arg("chunk_size") = 500'000, nb::arg("update_frequency") = 10'000'000,
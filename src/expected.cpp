@@ -0,0 +1,262 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#ifdef _WIN32
+// Workaround bug several symbol redefinition errors due to something including <winsock.h>
+#include <winsock2.h>
+#endif
+
+#include "hictkpy/expected.hpp"
+
+#include <arrow/array.h>
+#include <arrow/buffer.h>
+#include <arrow/table.h>
+#include <arrow/type.h>
+
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <hictk/balancing/weights.hpp>
+#include <hictk/cooler/pixel_selector.hpp>
+#include <hictk/hic/pixel_selector.hpp>
+#include <hictk/pixel.hpp>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace hictkpy {
+
+// In-place iterative radix-2 FFT. The size of data should be a power of 2
+static void fft(std::vector<std::complex<double>>& data, bool inverse) {
+  const auto n = data.size();
+  assert(n != 0 && (n & (n - 1)) == 0);
+
+  for (std::size_t i = 1, j = 0; i < n; ++i) {
+    auto bit = n >> 1;
+    for (; (j & bit) != 0; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(data[i], data[j]);
+    }
+  }
+
+  // twiddle factors are computed directly instead of by repeated multiplication, so that rounding
+  // errors do not accumulate for large inputs
+  constexpr double pi = 3.14159265358979323846;
+  const auto sign = inverse ? 1.0 : -1.0;
+  std::vector<std::complex<double>> twiddles(n / 2);
+  for (std::size_t k = 0; k < twiddles.size(); ++k) {
+    twiddles[k] = std::polar(1.0, sign * 2 * pi * static_cast<double>(k) / static_cast<double>(n));
+  }
+
+  for (std::size_t len = 2; len <= n; len <<= 1) {
+    const auto half = len / 2;
+    const auto stride = n / len;
+    for (std::size_t i = 0; i < n; i += len) {
+      for (std::size_t j = 0; j < half; ++j) {
+        const auto u = data[i + j];
+        const auto v = data[i + j + half] * twiddles[j * stride];
+        data[i + j] = u + v;
+        data[i + j + half] = u - v;
+      }
+    }
+  }
+}
+
+// Count the number of pairs of bins from the given (sorted) list that are d bins apart.
+// This is the autocorrelation of the indicator vector of the given bins, which is computed in
+// O(num_bins * log(num_bins)) using FFTs. Short lists are processed directly, as the quadratic
+// algorithm is faster for them
+[[nodiscard]] static std::vector<std::uint64_t> count_pairs_by_distance(
+    const std::vector<std::uint64_t>& bins, std::uint64_t num_bins) {
+  std::vector<std::uint64_t> counts(num_bins, 0);
+  if (bins.size() < 2048) {
+    for (std::size_t i = 0; i < bins.size(); ++i) {
+      ++counts.front();
+      for (std::size_t j = i + 1; j < bins.size(); ++j) {
+        ++counts[bins[j] - bins[i]];
+      }
+    }
+    return counts;
+  }
+
+  // zero-pad the indicator vector to avoid wrapping around
+  std::size_t size = 1;
+  while (size < 2 * num_bins) {
+    size <<= 1;
+  }
+  std::vector<std::complex<double>> data(size);
+  for (const auto i : bins) {
+    data[i] = 1.0;
+  }
+
+  fft(data, false);
+  for (auto& x : data) {
+    x = std::norm(x);
+  }
+  fft(data, true);
+
+  for (std::size_t d = 0; d < counts.size(); ++d) {
+    const auto n = std::round(data[d].real() / static_cast<double>(size));
+    counts[d] = n > 0 ? static_cast<std::uint64_t>(n) : 0;
+  }
+  return counts;
+}
+
+[[nodiscard]] static std::vector<std::uint64_t> compute_n_valid(
+    std::uint64_t num_bins, const hictk::balancing::Weights& weights,
+    std::uint64_t weights_offset) {
+  std::vector<std::uint64_t> n_valid(num_bins);
+  for (std::uint64_t diag = 0; diag < num_bins; ++diag) {
+    n_valid[diag] = num_bins - diag;
+  }
+
+  if (weights.empty() || weights.is_vector_of_ones()) {
+    return n_valid;
+  }
+
+  std::vector<std::uint64_t> masked_bins{};
+  std::vector<std::uint64_t> valid_bins{};
+  for (std::uint64_t i = 0; i < num_bins; ++i) {
+    const auto w =
+        weights.at(weights_offset + i, hictk::balancing::Weights::Type::MULTIPLICATIVE);
+    if (std::isfinite(w)) {
+      valid_bins.push_back(i);
+    } else {
+      masked_bins.push_back(i);
+    }
+  }
+
+  if (masked_bins.empty()) {
+    return n_valid;
+  }
+
+  // Count pairs of valid bins directly when most bins are masked
+  if (valid_bins.size() < masked_bins.size()) {
+    return count_pairs_by_distance(valid_bins, num_bins);
+  }
+
+  // Otherwise, subtract the number of pixels overlapping one or more masked bins:
+  // for each diagonal d, this is the number of masked bins in [0, num_bins - d) plus the number of
+  // masked bins in [d, num_bins), minus the number of pairs of masked bins d bins apart.
+  std::vector<std::uint64_t> num_masked_before(num_bins + 1, 0);
+  for (const auto i : masked_bins) {
+    ++num_masked_before[i + 1];
+  }
+  for (std::size_t i = 1; i < num_masked_before.size(); ++i) {
+    num_masked_before[i] += num_masked_before[i - 1];
+  }
+
+  const auto num_masked = static_cast<std::uint64_t>(masked_bins.size());
+  const auto masked_pairs = count_pairs_by_distance(masked_bins, num_bins);
+  for (std::uint64_t diag = 0; diag < num_bins; ++diag) {
+    const auto num_invalid = num_masked_before[num_bins - diag] +
+                             (num_masked - num_masked_before[diag]) - masked_pairs[diag];
+    assert(num_invalid <= n_valid[diag]);
+    n_valid[diag] -= num_invalid;
+  }
+
+  return n_valid;
+}
+
+ExpectedAccumulator::ExpectedAccumulator(std::uint64_t num_bins,
+                                         const hictk::balancing::Weights& weights,
+                                         std::uint64_t weights_offset)
+    : _sum(num_bins, 0), _n_valid(compute_n_valid(num_bins, weights, weights_offset)) {}
+
+std::uint64_t ExpectedAccumulator::num_diagonals() const noexcept { return _sum.size(); }
+
+double ExpectedAccumulator::sum(std::uint64_t diag) const noexcept {
+  assert(diag < _sum.size());
+  return _sum[diag];
+}
+
+std::uint64_t ExpectedAccumulator::n_valid(std::uint64_t diag) const noexcept {
+  assert(diag < _n_valid.size());
+  return _n_valid[diag];
+}
+
+double ExpectedAccumulator::avg(std::uint64_t diag) const noexcept {
+  if (n_valid(diag) == 0) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  return sum(diag) / static_cast<double>(n_valid(diag));
+}
+
+void ExpectedAccumulator::truncate(std::uint64_t num_diagonals) {
+  if (num_diagonals < _sum.size()) {
+    _sum.resize(num_diagonals);
+    _n_valid.resize(num_diagonals);
+  }
+}
+
+std::shared_ptr<arrow::Table> ExpectedAccumulator::to_arrow() const {
+  const auto size = static_cast<std::int64_t>(num_diagonals());
+
+  std::vector<std::int64_t> dist(_sum.size());
+  std::vector<std::int64_t> n_valid_(_sum.size());
+  std::vector<double> avg_(_sum.size());
+  for (std::uint64_t diag = 0; diag < _sum.size(); ++diag) {
+    dist[diag] = static_cast<std::int64_t>(diag);
+    n_valid_[diag] = static_cast<std::int64_t>(n_valid(diag));
+    avg_[diag] = avg(diag);
+  }
+
+  auto schema = arrow::schema({arrow::field("dist", arrow::int64(), false),
+                               arrow::field("n_valid", arrow::int64(), false),
+                               arrow::field("count.sum", arrow::float64(), false),
+                               arrow::field("count.avg", arrow::float64(), false)});
+
+  return arrow::Table::Make(
+      std::move(schema),
+      {std::make_shared<arrow::Int64Array>(size, arrow::Buffer::FromVector(std::move(dist)),
+                                           nullptr, 0, 0),
+       std::make_shared<arrow::Int64Array>(size, arrow::Buffer::FromVector(std::move(n_valid_)),
+                                           nullptr, 0, 0),
+       std::make_shared<arrow::DoubleArray>(size, arrow::Buffer::FromVector(_sum), nullptr, 0, 0),
+       std::make_shared<arrow::DoubleArray>(size, arrow::Buffer::FromVector(std::move(avg_)),
+                                            nullptr, 0, 0)});
+}
+
+static void validate_expected_query(const hictk::PixelCoordinates& coord1,
+                                    const hictk::PixelCoordinates& coord2) {
+  if (!coord1 || !coord2) {
+    throw std::runtime_error("expected values cannot be computed for genome-wide queries");
+  }
+  if (coord1.bin1.chrom() != coord2.bin1.chrom()) {
+    throw std::runtime_error("expected values cannot be computed for trans queries");
+  }
+  if (coord1 != coord2) {
+    throw std::runtime_error(
+        "expected values can only be computed for cis queries where range1 and range2 are "
+        "identical");
+  }
+}
+
+ExpectedAccumulator make_expected_accumulator(const hictk::cooler::PixelSelector& sel) {
+  validate_expected_query(sel.coord1(), sel.coord2());
+  const auto& coords = sel.coord1();
+  // weights for Cooler files are indexed by absolute bin IDs
+  return {coords.bin2.id() - coords.bin1.id() + 1, sel.weights(), coords.bin1.id()};
+}
+
+ExpectedAccumulator make_expected_accumulator(const hictk::hic::PixelSelector& sel) {
+  validate_expected_query(sel.coord1(), sel.coord2());
+  const auto& coords = sel.coord1();
+  // weights for .hic files are indexed by bin IDs relative to the chromosome
+  return {coords.bin2.id() - coords.bin1.id() + 1, sel.weights1(), coords.bin1.rel_id()};
+}
+
+ExpectedAccumulator make_expected_accumulator(
+    [[maybe_unused]] const hictk::hic::PixelSelectorAll& sel) {
+  throw std::runtime_error("expected values cannot be computed for genome-wide queries");
+}
+
+}  // namespace hictkpy
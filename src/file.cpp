@@ -7,71 +7,226 @@
 #include <winsock2.h>
 #endif
 
+#include <BS_thread_pool.hpp>
+#include <arrow/array.h>
+#include <arrow/buffer.h>
+#include <arrow/array/util.h>
+#include <arrow/chunked_array.h>
+#include <arrow/scalar.h>
+#include <arrow/table.h>
+#include <arrow/type.h>
 #include <fmt/format.h>
+#include <parallel_hashmap/phmap.h>
 
 #include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <future>
+#include <hictk/balancing/ice.hpp>
 #include <hictk/balancing/methods.hpp>
+#include <hictk/balancing/scale.hpp>
+#include <hictk/balancing/vc.hpp>
 #include <hictk/balancing/weights.hpp>
 #include <hictk/bin_table.hpp>
+#include <hictk/chromosome.hpp>
+#include <hictk/cooler/common.hpp>
 #include <hictk/cooler/cooler.hpp>
+#include <hictk/cooler/uri.hpp>
 #include <hictk/cooler/validation.hpp>
 #include <hictk/file.hpp>
 #include <hictk/genomic_interval.hpp>
 #include <hictk/hic.hpp>
 #include <hictk/hic/common.hpp>
+#include <hictk/hic/file_writer.hpp>
 #include <hictk/hic/validation.hpp>
+#include <hictk/pixel.hpp>
+#include <hictk/tmpdir.hpp>
+#include <hictk/transformers/common.hpp>
+#include <hictk/transformers/to_dataframe.hpp>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include <variant>
 #include <vector>
 
+#include "hictkpy/band_selector.hpp"
 #include "hictkpy/bin_table.hpp"
+#include "hictkpy/cache_config.hpp"
+#include "hictkpy/common.hpp"
+#include "hictkpy/expected.hpp"
+#include "hictkpy/locking.hpp"
 #include "hictkpy/nanobind.hpp"
 #include "hictkpy/pixel_selector.hpp"
+#include "hictkpy/profiling.hpp"
+#include "hictkpy/query_cache.hpp"
 #include "hictkpy/reference.hpp"
+#include "hictkpy/snippets.hpp"
 #include "hictkpy/to_pyarrow.hpp"
+#include "hictkpy/weight_cache.hpp"
 
 namespace nb = nanobind;
 
 namespace hictkpy::file {
-static void ctor(hictk::File *fp, const std::filesystem::path &path,
-                 std::optional<std::int32_t> resolution, std::string_view matrix_type,
-                 std::string_view matrix_unit) {
-  const auto resolution_ = static_cast<std::uint32_t>(resolution.value_or(0));
-  try {
-    new (fp) hictk::File{path.string(), resolution_,
-                         hictk::hic::ParseMatrixTypeStr(std::string{matrix_type}),
-                         hictk::hic::ParseUnitStr(std::string{matrix_unit})};
-    // TODO all the exceptions should ideally be handled on the hictk side
-    //      but this will have to do until the next release of hictk
-  } catch (const HighFive::Exception &e) {
-    std::string_view msg{e.what()};
-    if (msg.find("Unable to open the group \"/resolutions/0\"") != std::string_view::npos) {
-      throw std::runtime_error(
-          "resolution is required and cannot be None when opening .mcool files");
-    }
-    throw;
-  } catch (const std::runtime_error &e) {
-    std::string_view msg{e.what()};
-    if (msg.find("resolution cannot be 0 when opening .hic files") != std::string_view::npos) {
-      throw std::runtime_error("resolution is required and cannot be None when opening .hic files");
+// Capacity of the block cache of .hic files opened lazily, used until interactions are first read
+// from the file. This matches the lower bound used by hictk when sizing block caches
+static constexpr std::size_t lazy_block_cache_capacity{10'000'000};
+
+// Open the .hic file at the given path and size its block cache.
+// Picking the optimal cache size requires reading the footer and block index of the longest
+// chromosome: when lazy=true, this is deferred until interactions are first read from the file
+[[nodiscard]] static hictk::hic::File open_hic_file(const std::string &path,
+                                                    std::uint32_t resolution,
+                                                    hictk::hic::MatrixType matrix_type,
+                                                    hictk::hic::MatrixUnit matrix_unit,
+                                                    std::optional<std::size_t> cache_size,
+                                                    std::optional<std::size_t> available_cache_size,
+                                                    bool lazy) {
+  if (cache_size.has_value()) {
+    [[maybe_unused]] const profiling::Stage stage{"open"};
+    hictk::hic::File hf(path, resolution, matrix_type, matrix_unit,
+                        std::max(*cache_size, std::size_t{1}));
+    register_file_cache(hf.bins_ptr(), hf.cache_capacity());
+    return hf;
+  }
+
+  if (lazy) {
+    const auto capacity =
+        std::max(std::min(lazy_block_cache_capacity,
+                          available_cache_size.value_or(lazy_block_cache_capacity)),
+                 std::size_t{1});
+    [[maybe_unused]] const profiling::Stage stage{"open"};
+    hictk::hic::File hf(path, resolution, matrix_type, matrix_unit, capacity);
+    register_deferred_file_cache(hf.bins_ptr(), hf.cache_capacity(), available_cache_size);
+    return hf;
+  }
+
+  // a block cache capacity of 0 means that hictk should pick the cache size. When the cache budget
+  // is bounded, pass a placeholder capacity instead, so that the block index is only read once
+  auto hf = [&]() {
+    [[maybe_unused]] const profiling::Stage stage{"open"};
+    return hictk::hic::File(path, resolution, matrix_type, matrix_unit,
+                            available_cache_size.has_value() ? 1 : 0);
+  }();
+  if (available_cache_size.has_value()) {
+    [[maybe_unused]] const profiling::Stage stage{"optimize_cache"};
+    hf.optimize_cache_size(std::max(*available_cache_size, std::size_t{1}));
+  }
+  register_file_cache(hf.bins_ptr(), hf.cache_capacity());
+  return hf;
+}
+
+// Open the file with the given URI, sizing its cache based on cache_size and on the current
+// CacheConfig (see cache_config.hpp for more details).
+// This mirrors the logic used by the hictk::File constructor
+[[nodiscard]] static hictk::File open_file(const std::string &uri, std::uint32_t resolution,
+                                           hictk::hic::MatrixType matrix_type,
+                                           hictk::hic::MatrixUnit matrix_unit,
+                                           std::optional<std::size_t> cache_size,
+                                           bool lazy = false) {
+  const auto cache_size_ = compute_file_cache_size(cache_size);
+  const auto available_cache_size = available_file_cache_bytes();
+
+  const auto path = hictk::cooler::parse_cooler_uri(uri).file_path;
+  if (hictk::hic::utils::is_hic_file(path)) {
+    if (resolution == 0) {
+      throw std::runtime_error("resolution cannot be 0 when opening .hic files.");
     }
-    throw;
+    return hictk::File{open_hic_file(path, resolution, matrix_type, matrix_unit, cache_size_,
+                                     available_cache_size, lazy)};
+  }
+
+  if (matrix_type != hictk::hic::MatrixType::observed) {
+    throw std::runtime_error(
+        "matrix type should always be \"observed\" when reading Cooler files.");
+  }
+
+  if (matrix_unit != hictk::hic::MatrixUnit::BP) {
+    throw std::runtime_error("matrix unit should always be \"BP\" when reading Cooler files.");
+  }
+
+  auto cooler_cache_size =
+      cache_size_.value_or(hictk::cooler::DEFAULT_HDF5_CACHE_SIZE * 4);  // NOLINT
+  if (!cache_size_.has_value() && available_cache_size.has_value()) {
+    cooler_cache_size = std::min(cooler_cache_size, *available_cache_size);
+  }
+
+  [[maybe_unused]] const profiling::Stage stage{"open"};
+  hictk::cooler::File clr(hictk::cooler::utils::is_cooler(uri)
+                              ? uri
+                              : fmt::format(FMT_STRING("{}::/resolutions/{}"), uri, resolution),
+                          cooler_cache_size);
+  register_file_cache(clr.bins_ptr(), cooler_cache_size);
+  return hictk::File{std::move(clr)};
+}
+
+FileHandle open(const std::filesystem::path &path, std::optional<std::uint32_t> resolution,
+                hictk::hic::MatrixType matrix_type, hictk::hic::MatrixUnit matrix_unit,
+                std::optional<std::size_t> cache_size, bool lazy) {
+  [[maybe_unused]] const profiling::Operation op{"File.__init__"};
+  ensure_local_uri(path);
+  const auto resolution_ = resolution.value_or(0);
+
+  // Opening .hic files does not require synchronization, as each File object owns its file handle
+  std::unique_lock<FileMutex> lck{};
+  if (!hictk::hic::utils::is_hic_file(path)) {
+    [[maybe_unused]] const profiling::Stage stage{"lock_wait"};
+    lck = std::unique_lock(*get_hdf5_mutex());
   }
 
-  if (resolution.has_value() && fp->resolution() != resolution_) {
+  // TODO all the exceptions should ideally be handled on the hictk side
+  //      but this will have to do until the next release of hictk
+  auto f = [&]() {
+    try {
+      return open_file(path.string(), resolution_, matrix_type, matrix_unit, cache_size, lazy);
+    } catch (const HighFive::Exception &e) {
+      std::string_view msg{e.what()};
+      if (msg.find("Unable to open the group \"/resolutions/0\"") != std::string_view::npos) {
+        throw std::runtime_error(
+            "resolution is required and cannot be None when opening .mcool files");
+      }
+      throw;
+    } catch (const std::runtime_error &e) {
+      std::string_view msg{e.what()};
+      if (msg.find("resolution cannot be 0 when opening .hic files") != std::string_view::npos) {
+        throw std::runtime_error(
+            "resolution is required and cannot be None when opening .hic files");
+      }
+      throw;
+    }
+  }();
+
+  if (resolution.has_value() && f.resolution() != resolution_) {
     // TODO this should also be handled by hictk
     throw std::runtime_error(
         fmt::format(FMT_STRING("resolution mismatch for file \"{}\": expected {}, found {}"),
-                    fp->uri(), resolution_, fp->resolution()));
+                    f.uri(), resolution_, f.resolution()));
   }
+
+  return FileHandle{std::move(f)};
+}
+
+static void ctor(FileHandle *fp, const std::filesystem::path &path,
+                 std::optional<std::int32_t> resolution, std::string_view matrix_type,
+                 std::string_view matrix_unit, std::optional<std::size_t> cache_size, bool lazy) {
+  std::optional<std::uint32_t> resolution_{};
+  if (resolution.has_value()) {
+    resolution_ = static_cast<std::uint32_t>(*resolution);
+  }
+
+  new (fp) FileHandle{open(path, resolution_,
+                           hictk::hic::ParseMatrixTypeStr(std::string{matrix_type}),
+                           hictk::hic::ParseUnitStr(std::string{matrix_unit}), cache_size, lazy)};
 }
 
 static std::string repr(const hictk::File &f) {
@@ -84,35 +239,180 @@ bool is_cooler(const std::filesystem::path &uri) {
 
 bool is_hic(const std::filesystem::path &uri) { return hictk::hic::utils::is_hic_file(uri); }
 
-static hictkpy::PixelSelector fetch(const hictk::File &f, std::optional<std::string_view> range1,
-                                    std::optional<std::string_view> range2,
-                                    std::optional<std::string_view> normalization,
-                                    std::string_view count_type, bool join,
-                                    std::string_view query_type) {
-  if (count_type != "float" && count_type != "int") {
-    throw std::runtime_error(R"(count_type should be either "float" or "int")");
+void ensure_local_uri(const std::filesystem::path &uri) {
+  const auto uri_ = uri.string();
+  const auto pos = uri_.find("://");
+  // single-letter prefixes are most likely drive letters (e.g. C://data/file.hic)
+  if (pos == std::string::npos || pos < 2) {
+    return;
+  }
+
+  const std::string_view scheme{uri_.data(), pos};
+  const auto is_scheme =
+      std::isalpha(static_cast<unsigned char>(scheme.front())) &&
+      std::all_of(scheme.begin(), scheme.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '+' || c == '-' || c == '.';
+      });
+  if (is_scheme) {
+    throw std::runtime_error(fmt::format(
+        FMT_STRING("unable to open \"{}\": reading files from remote URIs ({}://) is not "
+                   "supported. Please download the file or mount the remote storage locally"),
+        uri_, scheme));
+  }
+}
+
+namespace {
+// Keep track of the selectors referring to each open file.
+// Selectors hold a token shared by all selectors referring to the same file: the file has live
+// selectors as long as the token has not expired.
+// Selectors over .cool files refer to datasets owned by the file they were created from, so
+// operations re-opening files (e.g. balance()) must not run while such selectors are alive.
+struct SelectorRegistry {
+  std::mutex mtx{};
+  // Keys are the bin tables of open files
+  phmap::flat_hash_map<const hictk::BinTable *, std::weak_ptr<const void>> tokens{};
+};
+}  // namespace
+
+static SelectorRegistry &get_selector_registry() {
+  static SelectorRegistry registry{};
+  return registry;
+}
+
+[[nodiscard]] static std::shared_ptr<const void> get_selector_token(const hictk::File &f) {
+  auto &registry = get_selector_registry();
+  [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+  const auto *key = f.bins_ptr().get();
+  if (auto match = registry.tokens.find(key); match != registry.tokens.end()) {
+    if (auto token = match->second.lock(); token) {
+      return token;
+    }
   }
 
+  phmap::erase_if(registry.tokens, [](const auto &kv) { return kv.second.expired(); });
+  auto token = std::make_shared<const bool>(true);
+  registry.tokens.insert_or_assign(key, token);
+  return token;
+}
+
+[[nodiscard]] static bool has_live_selectors(const hictk::File &f) {
+  auto &registry = get_selector_registry();
+  [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+  const auto match = registry.tokens.find(f.bins_ptr().get());
+  return match != registry.tokens.end() && !match->second.expired();
+}
+
+// Selectors over .cool files must be destroyed while holding the HDF5 lock, as their destructor
+// closes HDF5 datasets.
+// The returned selector also holds the token used to track selectors referring to f
+// (see SelectorRegistry)
+template <typename SelT>
+static std::shared_ptr<const SelT> wrap_selector(const hictk::File &f, SelT &&sel) {
+  auto sel_ptr = [&]() {
+    if constexpr (std::is_same_v<SelT, hictk::cooler::PixelSelector>) {
+      return make_shared_locked(std::forward<SelT>(sel), get_hdf5_mutex());
+    } else {
+      return std::make_shared<const SelT>(std::forward<SelT>(sel));
+    }
+  }();
+
+  // The token must be released after the selector has been destroyed
+  using Owner = std::pair<std::shared_ptr<const void>, std::shared_ptr<const SelT>>;
+  auto owner = std::make_shared<const Owner>(get_selector_token(f), std::move(sel_ptr));
+  return {owner, owner->second.get()};
+}
+
+// Normalized description of a query, used to look up results in the query cache.
+// Genome-wide queries are represented by empty intervals
+[[nodiscard]] static std::string make_query_cache_key(
+    const hictk::File &f, const std::optional<hictk::GenomicInterval> &gi1,
+    const std::optional<hictk::GenomicInterval> &gi2,
+    const hictk::balancing::Method &normalization, std::string_view count_type, bool join,
+    std::optional<std::int64_t> max_distance) {
+  const auto format_interval = [](const std::optional<hictk::GenomicInterval> &gi) {
+    if (!gi.has_value()) {
+      return std::string{"ALL"};
+    }
+    return fmt::format(FMT_STRING("{}:{}-{}"), gi->chrom().name(), gi->start(), gi->end());
+  };
+
+  // .hic files can be opened multiple times with different matrix types and units
+  const auto [matrix_type, matrix_unit] = [&]() -> std::pair<int, int> {
+    if (f.is_hic()) {
+      const auto &hf = f.get<hictk::hic::File>();
+      return {static_cast<int>(hf.matrix_type()), static_cast<int>(hf.matrix_unit())};
+    }
+    return {-1, -1};
+  }();
+
+  return fmt::format(FMT_STRING("{}{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}"),
+                     QueryCache::make_key_prefix(f), matrix_type, matrix_unit,
+                     format_interval(gi1), format_interval(gi2), normalization.to_string(),
+                     count_type, join, max_distance.value_or(-1));
+}
+
+hictkpy::PixelSelector fetch(const hictk::File &f, std::optional<std::string_view> range1,
+                             std::optional<std::string_view> range2,
+                             std::optional<std::string_view> normalization,
+                             std::string_view count_type, bool join, std::string_view query_type,
+                             std::optional<std::int64_t> max_distance, std::size_t n_threads,
+                             std::string_view bin_id_type) {
+  PixelSelector::validate_count_type(count_type);
+
   if (query_type != "UCSC" && query_type != "BED") {
     throw std::runtime_error("query_type should be either UCSC or BED");
   }
 
-  const hictk::balancing::Method normalization_method{normalization.value_or("NONE")};
+  if (n_threads == 0) {
+    throw std::runtime_error("n_threads should be a positive number");
+  }
+
+  if (bin_id_type != "uint64" && bin_id_type != "uint32") {
+    throw std::runtime_error("bin_id_type should be either uint64 or uint32");
+  }
+  const auto narrow_bin_ids = bin_id_type == "uint32";
+  if (narrow_bin_ids && f.nbins() > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("bin_id_type=\"uint32\" is not supported for files with more than "
+                               "{} bins: file has {} bins"),
+                    std::numeric_limits<std::uint32_t>::max(), f.nbins()));
+  }
 
-  if (normalization_method != hictk::balancing::Method::NONE()) {
-    count_type = "float";
+  if (max_distance.has_value()) {
+    if (*max_distance < 0) {
+      throw std::runtime_error("max_distance cannot be negative");
+    }
+    if (f.resolution() == 0) {
+      throw std::runtime_error("max_distance is not supported for files with variable bin sizes");
+    }
+    if (!range1.has_value() || range1->empty()) {
+      throw std::runtime_error("max_distance is not supported for genome-wide queries");
+    }
   }
 
+  const hictk::balancing::Method normalization_method{normalization.value_or("NONE")};
+
+  // This is required because constructing a PixelSelector may require reading from file
+  [[maybe_unused]] const auto lck = std::scoped_lock(*get_file_mutex(f));
+  optimize_deferred_file_cache(f);
+
+  count_type = PixelSelector::promote_count_type(
+      count_type, normalization_method != hictk::balancing::Method::NONE());
+
   if (!range1.has_value() || range1->empty()) {
     assert(!range2.has_value() || range2->empty());
-    return std::visit(
+    auto sel = std::visit(
         [&](const auto &ff) {
-          auto sel = ff.fetch(normalization_method);
-          using SelT = decltype(sel);
-          return hictkpy::PixelSelector(std::make_shared<const SelT>(std::move(sel)), count_type,
-                                        join);
+          return hictkpy::PixelSelector(wrap_selector(f, ff.fetch(normalization_method)),
+                                        count_type, join);
         },
         f.get());
+    sel.cache_key =
+        make_query_cache_key(f, {}, {}, normalization_method, count_type, join, max_distance);
+    sel.cache_path = f.path();
+    sel.n_threads = n_threads;
+    sel.narrow_bin_ids = narrow_bin_ids;
+    return sel;
   }
 
   if (!range2.has_value() || range2->empty()) {
@@ -126,16 +426,350 @@ static hictkpy::PixelSelector fetch(const hictk::File &f, std::optional<std::str
   const auto gi2 =
       hictk::GenomicInterval::parse(f.chromosomes(), std::string{*range2}, query_type_);
 
-  return std::visit(
+  auto selector = std::visit(
       [&](const auto &ff) {
         auto sel = ff.fetch(gi1.chrom().name(), gi1.start(), gi1.end(), gi2.chrom().name(),
                             gi2.start(), gi2.end(), normalization_method);
-
-        using SelT = decltype(sel);
-        return hictkpy::PixelSelector(std::make_shared<const SelT>(std::move(sel)), count_type,
-                                      join);
+        if (max_distance.has_value()) {
+          using SelT = decltype(sel);
+          // max_distance is expressed in bp
+          const auto max_distance_bins = static_cast<std::uint64_t>(*max_distance) / f.resolution();
+          return hictkpy::PixelSelector(std::make_shared<const BandPixelSelector<SelT>>(
+                                            wrap_selector(f, std::move(sel)), max_distance_bins),
+                                        count_type, join);
+        }
+        return hictkpy::PixelSelector(wrap_selector(f, std::move(sel)), count_type, join);
       },
       f.get());
+  selector.cache_key =
+      make_query_cache_key(f, gi1, gi2, normalization_method, count_type, join, max_distance);
+  selector.cache_path = f.path();
+  selector.narrow_bin_ids = narrow_bin_ids;
+  return selector;
+}
+
+// Pixels are buffered in a std::deque (instead of a std::vector), so that growing the buffer never
+// copies pixels that have already been read
+template <typename N>
+using PixelBuffer = std::deque<hictk::ThinPixel<N>>;
+
+template <typename N>
+[[nodiscard]] static std::shared_ptr<arrow::Table> make_query_table(
+    PixelBuffer<N> pixels, std::shared_ptr<const hictk::BinTable> bins,
+    hictk::transformers::DataFrameFormat format, hictk::transformers::QuerySpan span,
+    std::uint64_t query_id) {
+  auto table = hictk::transformers::ToDataFrame(pixels.begin(), pixels.end(), format,
+                                                std::move(bins), span)();
+  // Release the buffer as soon as pixels have been converted
+  PixelBuffer<N>{}.swap(pixels);
+
+  std::vector<std::uint64_t> query_ids(static_cast<std::size_t>(table->num_rows()), query_id);
+  auto query_id_col = std::make_shared<arrow::UInt64Array>(
+      table->num_rows(), arrow::Buffer::FromVector(std::move(query_ids)), nullptr, 0, 0);
+
+  auto result = table->AddColumn(0, arrow::field("query_id", arrow::uint64(), false),
+                                 std::make_shared<arrow::ChunkedArray>(std::move(query_id_col)));
+  if (!result.ok()) {
+    throw std::runtime_error(result.status().ToString());
+  }
+  return result.MoveValueUnsafe();
+}
+
+template <typename N>
+[[nodiscard]] static std::shared_ptr<arrow::Table> fetch_query_table(
+    const hictk::File &f, FileMutex &mtx, const hictk::GenomicInterval &gi1,
+    const hictk::GenomicInterval &gi2, const hictk::balancing::Method &normalization,
+    hictk::transformers::DataFrameFormat format, hictk::transformers::QuerySpan span,
+    std::uint64_t query_id) {
+  PixelBuffer<N> pixels{};
+  std::shared_ptr<const hictk::BinTable> bins{};
+  {
+    // Only reading interactions requires synchronization: converting pixels to an arrow::Table
+    // can proceed in parallel with queries running on other threads
+    [[maybe_unused]] const auto lck = std::scoped_lock(mtx);
+    std::visit(
+        [&](const auto &ff) {
+          const auto sel = ff.fetch(gi1.chrom().name(), gi1.start(), gi1.end(), gi2.chrom().name(),
+                                    gi2.start(), gi2.end(), normalization);
+          pixels.assign(sel.template begin<N>(), sel.template end<N>());
+          bins = sel.bins_ptr();
+        },
+        f.get());
+  }
+
+  return make_query_table<N>(std::move(pixels), std::move(bins), format, span, query_id);
+}
+
+static nb::object fetch_many(const hictk::File &f, const std::vector<std::string> &ranges1,
+                             std::optional<std::vector<std::string>> ranges2,
+                             std::optional<std::string_view> normalization,
+                             std::string_view count_type, bool join, std::string_view query_type,
+                             std::string_view query_span, std::size_t n_threads) {
+  std::ignore = import_pyarrow_checked();
+
+  PixelSelector::validate_count_type(count_type);
+
+  if (query_type != "UCSC" && query_type != "BED") {
+    throw std::runtime_error("query_type should be either UCSC or BED");
+  }
+
+  if (ranges2.has_value() && ranges2->size() != ranges1.size()) {
+    throw std::runtime_error(fmt::format(
+        FMT_STRING("ranges1 and ranges2 should have the same length: found {} and {} queries"),
+        ranges1.size(), ranges2->size()));
+  }
+
+  if (n_threads == 0) {
+    throw std::runtime_error("n_threads should be a positive number");
+  }
+
+  const hictk::balancing::Method normalization_method{normalization.value_or("NONE")};
+  count_type = PixelSelector::promote_count_type(
+      count_type, normalization_method != hictk::balancing::Method::NONE());
+
+  const auto count = PixelSelector::parse_count_type(count_type);
+  const auto format = join ? PixelSelector::PixelFormat::BG2 : PixelSelector::PixelFormat::COO;
+  const auto span = PixelSelector::parse_span(query_span);
+  const auto query_type_ =
+      query_type == "UCSC" ? hictk::GenomicInterval::Type::UCSC : hictk::GenomicInterval::Type::BED;
+
+  auto table = [&]() {
+    [[maybe_unused]] const nb::gil_scoped_release release{};
+
+    std::vector<std::pair<hictk::GenomicInterval, hictk::GenomicInterval>> queries{};
+    queries.reserve(ranges1.size());
+    for (std::size_t i = 0; i < ranges1.size(); ++i) {
+      const auto &range2 = ranges2.has_value() ? (*ranges2)[i] : ranges1[i];
+      queries.emplace_back(hictk::GenomicInterval::parse(f.chromosomes(), ranges1[i], query_type_),
+                           hictk::GenomicInterval::parse(f.chromosomes(), range2, query_type_));
+    }
+
+    const auto mtx = get_file_mutex(f);
+    {
+      [[maybe_unused]] const auto lck = std::scoped_lock(*mtx);
+      optimize_deferred_file_cache(f);
+    }
+
+    return std::visit(
+        [&]([[maybe_unused]] auto count_) -> std::shared_ptr<arrow::Table> {
+          using N = std::conditional_t<std::is_same_v<decltype(count_), long double>, double,
+                                       decltype(count_)>;
+          if (queries.empty()) {
+            return make_query_table<N>(PixelBuffer<N>{}, f.bins_ptr(), format, span, 0);
+          }
+
+          std::vector<std::shared_ptr<arrow::Table>> tables(queries.size());
+          {
+            BS::thread_pool tpool(
+                conditional_static_cast<BS::concurrency_t>(std::min(n_threads, queries.size())));
+            std::vector<std::future<void>> workers(queries.size());
+            for (std::size_t i = 0; i < queries.size(); ++i) {
+              workers[i] = tpool.submit_task([&, i]() {
+                const auto &[gi1, gi2] = queries[i];
+                tables[i] = fetch_query_table<N>(f, *mtx, gi1, gi2, normalization_method, format,
+                                                 span, static_cast<std::uint64_t>(i));
+              });
+            }
+            // Rethrow exceptions (if any) only after all workers have returned
+            tpool.wait();
+            for (auto &worker : workers) {
+              worker.get();
+            }
+          }
+
+          auto result = arrow::ConcatenateTables(tables);
+          if (!result.ok()) {
+            throw std::runtime_error(result.status().ToString());
+          }
+          return result.MoveValueUnsafe();
+        },
+        count);
+  }();
+
+  return export_pyarrow_table(std::move(table));
+}
+
+[[nodiscard]] static std::shared_ptr<arrow::Table> make_expected_cis_table(
+    const ExpectedAccumulator &expected, std::string_view chrom_name) {
+  auto table = expected.to_arrow();
+  auto chrom_col =
+      arrow::MakeArrayFromScalar(arrow::StringScalar(std::string{chrom_name}), table->num_rows());
+  if (!chrom_col.ok()) {
+    throw std::runtime_error(chrom_col.status().ToString());
+  }
+
+  auto result =
+      table->AddColumn(0, arrow::field("chrom", arrow::utf8(), false),
+                       std::make_shared<arrow::ChunkedArray>(chrom_col.MoveValueUnsafe()));
+  if (!result.ok()) {
+    throw std::runtime_error(result.status().ToString());
+  }
+  return result.MoveValueUnsafe();
+}
+
+template <typename FileT>
+[[nodiscard]] static std::shared_ptr<arrow::Table> compute_expected_cis(
+    const FileT &f, const hictk::Chromosome &chrom, const hictk::balancing::Method &normalization) {
+  const auto sel =
+      f.fetch(chrom.name(), 0, chrom.size(), chrom.name(), 0, chrom.size(), normalization);
+  return make_expected_cis_table(compute_expected(sel), chrom.name());
+}
+
+static nb::object expected_cis(const hictk::File &f, std::optional<std::string_view> normalization,
+                               std::size_t n_threads) {
+  std::ignore = import_pyarrow_checked();
+
+  if (n_threads == 0) {
+    throw std::runtime_error("n_threads should be a positive number");
+  }
+
+  const hictk::balancing::Method normalization_method{normalization.value_or("NONE")};
+
+  auto table = [&]() {
+    [[maybe_unused]] const nb::gil_scoped_release release{};
+
+    std::vector<hictk::Chromosome> chroms{};
+    for (const auto &chrom : f.chromosomes()) {
+      if (!chrom.is_all()) {
+        chroms.emplace_back(chrom);
+      }
+    }
+
+    if (chroms.empty()) {
+      return make_expected_cis_table(ExpectedAccumulator{}, "");
+    }
+
+    std::vector<std::shared_ptr<arrow::Table>> tables(chroms.size());
+
+    // Reading Cooler files is serialized process-wide (see get_hdf5_mutex()), so there is nothing
+    // to gain by processing chromosomes in parallel
+    const auto num_workers = f.is_hic() ? std::min(n_threads, chroms.size()) : std::size_t{1};
+    if (num_workers == 1) {
+      const auto mtx = get_file_mutex(f);
+      for (std::size_t i = 0; i < chroms.size(); ++i) {
+        [[maybe_unused]] const auto lck = std::scoped_lock(*mtx);
+        optimize_deferred_file_cache(f);
+        tables[i] = std::visit(
+            [&](const auto &ff) {
+              return compute_expected_cis(ff, chroms[i], normalization_method);
+            },
+            f.get());
+      }
+    } else {
+      const auto &hf = f.get<hictk::hic::File>();
+      {
+        [[maybe_unused]] const auto lck = std::scoped_lock(*get_file_mutex(f));
+        optimize_deferred_file_cache(f);
+      }
+      // Workers split the cache budget of f
+      const auto cache_capacity = compute_worker_file_cache_size(f.bins_ptr(), num_workers);
+      BS::thread_pool tpool(conditional_static_cast<BS::concurrency_t>(num_workers));
+      std::vector<std::future<void>> workers(num_workers);
+      for (std::size_t i = 0; i < num_workers; ++i) {
+        workers[i] = tpool.submit_task([&, i]() {
+          // Each worker reads interactions using its own file handle: this way, workers do not have
+          // to synchronize access to the file stream and block cache
+          const hictk::hic::File hf_(hf.path(), hf.resolution(), hf.matrix_type(),
+                                     hf.matrix_unit(), cache_capacity);
+          for (std::size_t j = i; j < chroms.size(); j += num_workers) {
+            tables[j] = compute_expected_cis(hf_, chroms[j], normalization_method);
+          }
+        });
+      }
+      // Rethrow exceptions (if any) only after all workers have returned
+      tpool.wait();
+      for (auto &worker : workers) {
+        worker.get();
+      }
+    }
+
+    auto result = arrow::ConcatenateTables(tables);
+    if (!result.ok()) {
+      throw std::runtime_error(result.status().ToString());
+    }
+    return result.MoveValueUnsafe();
+  }();
+
+  return export_pyarrow_table(std::move(table)).attr("to_pandas")(nb::arg("self_destruct") = true);
+}
+
+// Move the given row-major buffer into a numpy array with the given shape
+[[nodiscard]] static nb::object make_numpy_array(std::vector<double> data,
+                                                 const std::vector<std::size_t> &shape) {
+  using Array = nb::ndarray<nb::numpy, nb::c_contig, double>;
+
+  // NOLINTNEXTLINE
+  auto *data_ptr = new std::vector<double>(std::move(data));
+
+  auto capsule = nb::capsule(data_ptr, [](void *vect_ptr) noexcept {
+    delete reinterpret_cast<std::vector<double> *>(vect_ptr);  // NOLINT
+  });
+
+  return nb::cast(Array{data_ptr->data(), shape.size(), shape.data(), capsule},
+                  nb::rv_policy::take_ownership);
+}
+
+[[nodiscard]] static std::vector<hictk::GenomicInterval> parse_anchors(
+    const hictk::File &f, const std::vector<std::string> &anchors,
+    hictk::GenomicInterval::Type query_type) {
+  std::vector<hictk::GenomicInterval> intervals(anchors.size());
+  std::transform(anchors.begin(), anchors.end(), intervals.begin(), [&](const auto &anchor) {
+    auto gi = hictk::GenomicInterval::parse(f.chromosomes(), anchor, query_type);
+    if (gi.chrom().is_all()) {
+      throw std::runtime_error(
+          fmt::format(FMT_STRING("invalid anchor \"{}\": anchors should not overlap with "
+                                 "chromosome \"{}\""),
+                      anchor, gi.chrom().name()));
+    }
+    return gi;
+  });
+  return intervals;
+}
+
+static nb::object snippets(const hictk::File &f, const std::vector<std::string> &anchors1,
+                           std::optional<std::vector<std::string>> anchors2, std::int64_t flank,
+                           std::optional<std::string_view> normalization,
+                           std::string_view query_type, bool pileup, std::size_t n_threads) {
+  if (f.resolution() == 0) {
+    throw std::runtime_error("snippets are not supported for files with variable bin sizes");
+  }
+  if (flank < 0) {
+    throw std::runtime_error("flank cannot be negative");
+  }
+  if (anchors2.has_value() && anchors2->size() != anchors1.size()) {
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("anchors1 and anchors2 should have the same size: found {} and {} "
+                               "anchors respectively"),
+                    anchors1.size(), anchors2->size()));
+  }
+  if (query_type != "UCSC" && query_type != "BED") {
+    throw std::runtime_error("query_type should be either UCSC or BED");
+  }
+  if (n_threads == 0) {
+    throw std::runtime_error("n_threads should be a positive number");
+  }
+
+  const hictk::balancing::Method normalization_method{normalization.value_or("NONE")};
+  const auto query_type_ =
+      query_type == "UCSC" ? hictk::GenomicInterval::Type::UCSC : hictk::GenomicInterval::Type::BED;
+
+  // flank is expressed in bp
+  const auto flank_bins = static_cast<std::uint64_t>(flank) / f.resolution();
+  const auto width = static_cast<std::size_t>((2 * flank_bins) + 1);
+
+  auto data = [&]() {
+    [[maybe_unused]] const nb::gil_scoped_release release{};
+    const auto intervals1 = parse_anchors(f, anchors1, query_type_);
+    const auto intervals2 = anchors2.has_value() ? parse_anchors(f, *anchors2, query_type_)
+                                                 : intervals1;
+    const auto windows = make_snippet_windows(f, intervals1, intervals2, flank_bins);
+    return fetch_snippets(f, windows, width, normalization_method, pileup, n_threads);
+  }();
+
+  if (pileup) {
+    return make_numpy_array(std::move(data), {width, width});
+  }
+  return make_numpy_array(std::move(data), {anchors1.size(), width, width});
 }
 
 static nb::dict get_cooler_attrs(const hictk::cooler::File &clr) {
@@ -211,7 +845,10 @@ static nb::dict attributes(const hictk::File &f) {
 }
 
 static std::vector<std::string> avail_normalizations(const hictk::File &f) {
-  const auto norms_ = f.avail_normalizations();
+  const auto norms_ = [&]() {
+    [[maybe_unused]] const auto lck = lock_file(*get_file_mutex(f));
+    return f.avail_normalizations();
+  }();
   std::vector<std::string> norms{norms_.size()};
   std::transform(norms_.begin(), norms_.end(), norms.begin(),
                  [](const auto &norm) { return norm.to_string(); });
@@ -219,6 +856,16 @@ static std::vector<std::string> avail_normalizations(const hictk::File &f) {
   return norms;
 }
 
+static bool has_normalization(const hictk::File &f, std::string_view normalization) {
+  [[maybe_unused]] const auto lck = lock_file(*get_file_mutex(f));
+  return f.has_normalization(normalization);
+}
+
+static std::shared_ptr<const std::vector<double>> read_weights(
+    const hictk::File &f, std::string_view normalization, hictk::balancing::Weights::Type type) {
+  return get_weight_cache().get(f, normalization, type);
+}
+
 static auto weights(const hictk::File &f, std::string_view normalization, bool divisive) {
   using WeightVector = nb::ndarray<nb::numpy, nb::shape<-1>, nb::c_contig, double>;
 
@@ -229,8 +876,9 @@ static auto weights(const hictk::File &f, std::string_view normalization, bool d
   const auto type = divisive ? hictk::balancing::Weights::Type::DIVISIVE
                              : hictk::balancing::Weights::Type::MULTIPLICATIVE;
 
+  // Weights are copied out of the weight cache, so that the array returned to Python is writeable
   // NOLINTNEXTLINE
-  auto *weights_ptr = new std::vector<double>(f.normalization(normalization).to_vector(type));
+  auto *weights_ptr = new std::vector<double>(*read_weights(f, normalization, type));
 
   auto capsule = nb::capsule(weights_ptr, [](void *vect_ptr) noexcept {
     delete reinterpret_cast<std::vector<double> *>(vect_ptr);  // NOLINT
@@ -267,7 +915,7 @@ static nb::object weights_df(const hictk::File &f, const std::vector<std::string
     names.emplace(normalization);
     fields.emplace_back(arrow::field(normalization, arrow::float64(), false));
     columns.emplace_back(std::make_shared<arrow::DoubleArray>(
-        f.nbins(), arrow::Buffer::FromVector(f.normalization(normalization).to_vector(type)),
+        f.nbins(), arrow::Buffer::FromVector(*read_weights(f, normalization, type)),
         nullptr, 0, 0));
   }
 
@@ -277,17 +925,172 @@ static nb::object weights_df(const hictk::File &f, const std::vector<std::string
       .attr("to_pandas")(nb::arg("self_destruct") = true);
 }
 
+template <typename Balancer>
+[[nodiscard]] static hictk::balancing::Weights run_balancer(
+    const hictk::File &f, std::string_view mode, const typename Balancer::Params &params,
+    bool rescale_marginals) {
+  auto type = Balancer::Type::gw;
+  if (mode == "cis") {
+    type = Balancer::Type::cis;
+  } else if (mode == "trans") {
+    type = Balancer::Type::trans;
+  }
+
+  return Balancer(f, type, params).get_weights(rescale_marginals);
+}
+
+// Write the given weights to the file backing f, then re-open f so that the new weights are visible
+// to the File object.
+// This should be called while holding the file lock.
+static void write_weights(hictk::File &f, const std::string &name,
+                          const hictk::balancing::Weights &weights, bool overwrite,
+                          std::size_t n_threads) {
+  const auto resolution = f.resolution();
+  const auto cache_size_bytes = f.is_hic() ? f.get<hictk::hic::File>().cache_capacity()
+                                           : get_file_cache_size(f.bins_ptr());
+
+  if (f.is_cooler()) {
+    // The file handle must be closed before the same file can be re-opened in read-write mode
+    const auto uri = f.uri();
+    f.get<hictk::cooler::File>().close();
+
+    const auto weights_ = weights.to_vector(hictk::balancing::Weights::Type::MULTIPLICATIVE);
+    hictk::cooler::File::write_weights(uri, name, weights_.begin(), weights_.end(), overwrite,
+                                       false);
+    f = open_file(uri, resolution, hictk::hic::MatrixType::observed, hictk::hic::MatrixUnit::BP,
+                  cache_size_bytes);
+    return;
+  }
+
+  const auto &hf = f.get<hictk::hic::File>();
+  const auto path = hf.path();
+  const auto matrix_type = hf.matrix_type();
+  const auto matrix_unit = hf.matrix_unit();
+
+  {
+    hictk::hic::internal::HiCFileWriter hfw(path, n_threads);
+    hfw.add_norm_vector(name, fmt::to_string(matrix_unit), resolution, weights, overwrite);
+    hfw.write_norm_vectors_and_norm_expected_values();
+  }
+  f = open_file(path, resolution, matrix_type, matrix_unit, cache_size_bytes);
+}
+
+static void balance(hictk::File &f, std::string_view method, std::string_view mode,
+                    std::optional<std::string> name, std::optional<double> tol,
+                    std::size_t max_iters, std::size_t ignore_diags, bool rescale_marginals,
+                    std::size_t n_threads, std::size_t chunk_size, bool in_memory,
+                    const std::filesystem::path &tmpdir, bool overwrite) {
+  if (method != "ICE" && method != "SCALE" && method != "VC") {
+    throw std::runtime_error(R"(method should be one of "ICE", "SCALE", or "VC")");
+  }
+
+  if (mode != "gw" && mode != "cis" && mode != "trans") {
+    throw std::runtime_error(R"(mode should be one of "gw", "cis", or "trans")");
+  }
+
+  if (n_threads == 0) {
+    throw std::runtime_error("n_threads should be a positive number");
+  }
+
+  if (chunk_size == 0) {
+    throw std::runtime_error("chunk_size should be a positive number");
+  }
+
+  const auto name_ = name.value_or(std::string{method});
+  if (name_.empty() || name_ == "NONE") {
+    throw std::runtime_error(R"(name cannot be empty or "NONE")");
+  }
+
+  if (has_live_selectors(f)) {
+    throw std::runtime_error(fmt::format(
+        FMT_STRING("cannot balance file \"{}\" while PixelSelectors created from it are alive. "
+                   "Please delete all PixelSelectors (including iterators and streams created "
+                   "from them) before calling balance()"),
+        f.uri()));
+  }
+
+  if (!overwrite && has_normalization(f, name_)) {
+    throw std::runtime_error(fmt::format(
+        FMT_STRING("file \"{}\" already contains weights for normalization \"{}\". Pass "
+                   "overwrite=True to replace the existing weights."),
+        f.uri(), name_));
+  }
+
+  // Interactions are stored in a temporary file when not balancing in-memory
+  std::unique_ptr<hictk::internal::TmpDir> tmp_dir{};
+  std::filesystem::path tmpfile{};
+  if (!in_memory && method != "VC") {
+    tmp_dir = std::make_unique<hictk::internal::TmpDir>(tmpdir, true);
+    tmpfile = (*tmp_dir)() / (std::filesystem::path{f.path()}.filename().string() + ".tmp");
+  }
+
+  run_without_gil(*get_file_mutex(f), [&]() {
+    const auto weights = [&]() {
+      if (method == "ICE") {
+        auto params = hictk::balancing::ICE::DefaultParams;
+        params.tol = tol.value_or(params.tol);
+        params.max_iters = max_iters;
+        params.num_masked_diags = ignore_diags;
+        params.tmpfile = tmpfile;
+        params.chunk_size = chunk_size;
+        params.threads = n_threads;
+        return run_balancer<hictk::balancing::ICE>(f, mode, params, rescale_marginals);
+      }
+      if (method == "SCALE") {
+        auto params = hictk::balancing::SCALE::DefaultParams;
+        params.tol = tol.value_or(params.tol);
+        params.max_iters = max_iters;
+        params.tmpfile = tmpfile;
+        params.chunk_size = chunk_size;
+        params.threads = n_threads;
+        return run_balancer<hictk::balancing::SCALE>(f, mode, params, rescale_marginals);
+      }
+      return run_balancer<hictk::balancing::VC>(f, mode, {}, rescale_marginals);
+    }();
+
+    write_weights(f, name_, weights, overwrite, n_threads);
+  });
+
+  get_weight_cache().erase(f);
+  get_query_cache().erase(f);
+}
+
+static nb::dict cache_stats(const hictk::File &f) {
+  nb::dict stats{};
+  if (f.is_hic()) {
+    const auto &hf = f.get<hictk::hic::File>();
+    [[maybe_unused]] const auto lck = lock_file(*get_file_mutex(f));
+    stats["capacity_bytes"] = hf.cache_capacity();
+    stats["hit_rate"] = hf.block_cache_hit_rate();
+  } else {
+    stats["capacity_bytes"] = get_file_cache_size(f.bins_ptr());
+    stats["hit_rate"] = nb::none();
+  }
+  return stats;
+}
+
 static std::filesystem::path get_path(const hictk::File &f) { return f.path(); }
 
 void declare_file_class(nb::module_ &m) {
-  auto file = nb::class_<hictk::File>(m, "File",
-                                      "Class representing a file handle to a .cool or .hic file.");
+  // File objects own a FileHandle (see locking.hpp), while functions and methods accepting File
+  // objects only need to know about hictk::File
+  nb::class_<hictk::File>(m, "_FileBase", "Base class of hictkpy.File.");
+  auto file = nb::class_<FileHandle, hictk::File>(
+      m, "File", "Class representing a file handle to a .cool or .hic file.");
 
-  file.def("__init__", &file::ctor, nb::arg("path"), nb::arg("resolution") = nb::none(),
+  file.def("__init__", &file::ctor, nb::call_guard<nb::gil_scoped_release>(), nb::arg("path"),
+           nb::arg("resolution") = nb::none(),
            nb::arg("matrix_type") = "observed", nb::arg("matrix_unit") = "BP",
+           nb::arg("cache_size") = nb::none(), nb::arg("lazy") = false,
            "Construct a file object to a .hic, .cool or .mcool file given the file path and "
            "resolution.\n"
-           "Resolution is ignored when opening single-resolution Cooler files.");
+           "Resolution is ignored when opening single-resolution Cooler files.\n"
+           "cache_size controls the size in bytes of the cache used to read interactions (i.e. "
+           "the block cache for .hic files and the HDF5 chunk cache for Cooler files). When not "
+           "provided, the cache size is determined based on the current CacheConfig settings.\n"
+           "When lazy=True and cache_size is not provided, sizing the block cache of .hic files "
+           "(which requires reading the block index of the longest chromosome) is deferred "
+           "until interactions are first read from the file.");
 
   file.def("__repr__", &file::repr, nb::rv_policy::move);
 
@@ -311,17 +1114,82 @@ void declare_file_class(nb::module_ &m) {
   file.def("attributes", &file::attributes, "Get file attributes as a dictionary.",
            nb::rv_policy::take_ownership);
 
-  file.def("fetch", &file::fetch, nb::keep_alive<0, 1>(), nb::arg("range1") = nb::none(),
-           nb::arg("range2") = nb::none(), nb::arg("normalization") = nb::none(),
-           nb::arg("count_type") = "int", nb::arg("join") = false, nb::arg("query_type") = "UCSC",
-           "Fetch interactions overlapping a region of interest.", nb::rv_policy::move);
+  file.def("fetch", &file::fetch, nb::call_guard<nb::gil_scoped_release>(), nb::keep_alive<0, 1>(),
+           nb::arg("range1") = nb::none(), nb::arg("range2") = nb::none(),
+           nb::arg("normalization") = nb::none(), nb::arg("count_type") = "int",
+           nb::arg("join") = false, nb::arg("query_type") = "UCSC",
+           nb::arg("max_distance") = nb::none(), nb::arg("n_threads") = 1,
+           nb::arg("bin_id_type") = "uint64",
+           "Fetch interactions overlapping a region of interest.\n"
+           "count_type should be one of \"int\", \"int32\", \"uint32\", \"float\", "
+           "\"float32\", or \"float64\". When fetching normalized interactions, integral types "
+           "are promoted to \"float\".\n"
+           "bin_id_type should be either \"uint64\" or \"uint32\". When \"uint32\", bin IDs in "
+           "the tables returned by PixelSelector.to_arrow() and to_df() are stored using 32-bit "
+           "integers.\n"
+           "When max_distance is provided, only interactions between bins that are at most "
+           "max_distance bp apart are fetched. Files are read one tile of the band at a time, so "
+           "that regions of the matrix outside of the band are never read. max_distance is only "
+           "supported for cis queries where range1 and range2 are identical.\n"
+           "When n_threads > 1, genome-wide queries on .hic files converted with "
+           "PixelSelector.to_arrow(), to_df(), and to_csr() are processed one chromosome pair at "
+           "a time using up to n_threads threads. Queries on .cool files are always streamed.",
+           nb::rv_policy::move);
+  file.def("fetch_many", &file::fetch_many, nb::arg("ranges1"), nb::arg("ranges2") = nb::none(),
+           nb::arg("normalization") = nb::none(), nb::arg("count_type") = "int",
+           nb::arg("join") = false, nb::arg("query_type") = "UCSC",
+           nb::arg("query_span") = "upper_triangle", nb::arg("n_threads") = 1,
+           "Fetch interactions overlapping a list of regions of interest.\n"
+           "Interactions are returned as a single pyarrow.Table, with an additional query_id "
+           "column mapping each interaction to the index of the query it belongs to.",
+           nb::sig("def fetch_many(self, ranges1: collections.abc.Sequence[str], ranges2: "
+                   "collections.abc.Sequence[str] | None = None, normalization: str | None = None, "
+                   "count_type: str = 'int', join: bool = False, query_type: str = 'UCSC', "
+                   "query_span: str = 'upper_triangle', n_threads: int = 1) -> pyarrow.Table"),
+           nb::rv_policy::take_ownership);
+
+  file.def("expected_cis", &file::expected_cis, nb::arg("normalization") = nb::none(),
+           nb::arg("n_threads") = 1,
+           "Compute the expected number of interactions as a function of the distance from the "
+           "diagonal for each chromosome.\n"
+           "Expected values are returned as a pandas.DataFrame with the same columns as "
+           "PixelSelector.expected() plus a chrom column. Each chromosome is processed with a "
+           "single pass over its interactions. When n_threads > 1, chromosomes from .hic files "
+           "are processed in parallel, while chromosomes from Cooler files are always processed "
+           "sequentially.",
+           nb::sig("def expected_cis(self, normalization: str | None = None, n_threads: int = 1) "
+                   "-> pandas.DataFrame"),
+           nb::rv_policy::take_ownership);
+
+  file.def("snippets", &file::snippets, nb::arg("anchors1"), nb::arg("anchors2") = nb::none(),
+           nb::kw_only(), nb::arg("flank"), nb::arg("normalization") = nb::none(),
+           nb::arg("query_type") = "UCSC", nb::arg("pileup") = false, nb::arg("n_threads") = 1,
+           "Fetch the square windows of interactions centered on pairs of anchors.\n"
+           "Each window spans 2 * (flank // resolution) + 1 bins and is centered on the bins "
+           "overlapping the midpoint of anchors1[i] and anchors2[i] (anchors2 defaults to "
+           "anchors1). Windows are returned as a numpy.ndarray of shape (len(anchors1), width, "
+           "width). Pixels outside the chromosome boundaries or overlapping masked bins are set "
+           "to NaN.\n"
+           "When pileup=True, return the average of all windows (ignoring NaNs) as a single "
+           "(width, width) matrix without materializing the individual windows.\n"
+           "Anchors are sorted and nearby windows are read with a single query, so that "
+           "interactions shared by overlapping windows are read only once. When n_threads > 1, "
+           "windows from .hic files are read in parallel, while windows from Cooler files are "
+           "always read sequentially.",
+           nb::sig("def snippets(self, anchors1: collections.abc.Sequence[str], anchors2: "
+                   "collections.abc.Sequence[str] | None = None, *, flank: int, normalization: "
+                   "str | None = None, query_type: str = 'UCSC', pileup: bool = False, "
+                   "n_threads: int = 1) -> numpy.ndarray[float]"),
+           nb::rv_policy::take_ownership);
 
   file.def("avail_normalizations", &file::avail_normalizations,
            "Get the list of available normalizations.", nb::rv_policy::move);
-  file.def("has_normalization", &hictk::File::has_normalization, nb::arg("normalization"),
+  file.def("has_normalization", &file::has_normalization, nb::arg("normalization"),
            "Check whether a given normalization is available.");
   file.def("weights", &file::weights, nb::arg("name"), nb::arg("divisive") = true,
-           "Fetch the balancing weights for the given normalization method.",
+           "Fetch the balancing weights for the given normalization method.\n"
+           "Weights are cached, and the array returned by this method is a copy of the cached "
+           "weights.",
            nb::sig("def weights(self, name: str, divisive: bool = True) -> "
                    "numpy.ndarray[float]"),
            nb::rv_policy::take_ownership);
@@ -332,6 +1200,27 @@ void declare_file_class(nb::module_ &m) {
       nb::sig("def weights(self, names: collections.abc.Sequence[str], divisive: bool = True) -> "
               "pandas.DataFrame"),
       nb::rv_policy::take_ownership);
+
+  file.def("cache_stats", &file::cache_stats,
+           "Get statistics about the cache used to read interactions as a dictionary.\n"
+           "The hit rate is only available for .hic files.",
+           nb::rv_policy::take_ownership);
+
+  file.def("balance", &file::balance, nb::arg("method") = "ICE", nb::arg("mode") = "gw",
+           nb::arg("name") = nb::none(), nb::arg("tol") = nb::none(), nb::arg("max_iters") = 200,
+           nb::arg("ignore_diags") = 2, nb::arg("rescale_marginals") = true,
+           nb::arg("n_threads") = 1, nb::arg("chunk_size") = 10'000'000,
+           nb::arg("in_memory") = true,
+           nb::arg("tmpdir") = hictk::internal::TmpDir::default_temp_directory_path(),
+           nb::arg("overwrite") = false,
+           "Balance the interaction matrix using one of the supported methods (ICE, SCALE, or VC) "
+           "and write the resulting weights back to the file.\n"
+           "mode should be one of \"gw\", \"cis\", or \"trans\". Weights are stored using "
+           "the given name (defaults to the method name). When in_memory=False, interactions are "
+           "stored in a compressed temporary file created inside tmpdir, and are read back in "
+           "chunks of chunk_size pixels at every iteration. ignore_diags only applies to ICE.\n"
+           "Raises an exception when PixelSelectors created from the file being balanced (or "
+           "objects depending on them, like iterators and Arrow streams) are still alive.");
 }
 
 }  // namespace hictkpy::file
@@ -5,15 +5,19 @@
 #include "hictkpy/hic_file_writer.hpp"
 
 #include <fmt/format.h>
+#include <fmt/std.h>
 #include <spdlog/spdlog.h>
 
+#include <BS_thread_pool.hpp>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <hictk/bin_table.hpp>
 #include <hictk/file.hpp>
+#include <hictk/pixel.hpp>
 #include <hictk/reference.hpp>
 #include <hictk/tmpdir.hpp>
-#include <optional>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -22,9 +26,14 @@
 
 #include "hictkpy/bin_table.hpp"
 #include "hictkpy/common.hpp"
+#include "hictkpy/locking.hpp"
 #include "hictkpy/nanobind.hpp"
+#include "hictkpy/pairs.hpp"
 #include "hictkpy/pixel.hpp"
+#include "hictkpy/profiling.hpp"
 #include "hictkpy/reference.hpp"
+#include "hictkpy/task_queue.hpp"
+#include "hictkpy/to_pyarrow.hpp"
 
 namespace nb = nanobind;
 
@@ -52,10 +61,14 @@ HiCFileWriter::HiCFileWriter(const std::filesystem::path &path_, const Chromosom
                              const std::vector<std::uint32_t> &resolutions_,
                              std::string_view assembly, std::size_t n_threads,
                              std::size_t chunk_size, const std::filesystem::path &tmpdir,
-                             std::uint32_t compression_lvl, bool skip_all_vs_all_matrix)
+                             std::uint32_t compression_lvl, bool skip_all_vs_all_matrix,
+                             std::size_t async_queue_bytes)
     : _tmpdir(tmpdir, true),
       _w(path_.string(), chromosome_dict_to_reference(chromosomes), resolutions_, assembly,
-         n_threads, chunk_size, _tmpdir(), compression_lvl, skip_all_vs_all_matrix) {
+         n_threads, chunk_size, _tmpdir(), compression_lvl, skip_all_vs_all_matrix),
+      _n_threads(n_threads),
+      _queue(async_queue_bytes == 0 ? nullptr
+                                    : std::make_unique<BoundedTaskQueue>(async_queue_bytes)) {
   SPDLOG_INFO(FMT_STRING("using \"{}\" folder to store temporary file(s)"), _tmpdir());
 }
 
@@ -63,30 +76,41 @@ HiCFileWriter::HiCFileWriter(const std::filesystem::path &path_, const Chromosom
                              std::uint32_t resolution, std::string_view assembly,
                              std::size_t n_threads, std::size_t chunk_size,
                              const std::filesystem::path &tmpdir, std::uint32_t compression_lvl,
-                             bool skip_all_vs_all_matrix)
+                             bool skip_all_vs_all_matrix, std::size_t async_queue_bytes)
     : HiCFileWriter(path_, chromosomes, std::vector<std::uint32_t>{resolution}, assembly, n_threads,
-                    chunk_size, tmpdir, compression_lvl, skip_all_vs_all_matrix) {}
+                    chunk_size, tmpdir, compression_lvl, skip_all_vs_all_matrix,
+                    async_queue_bytes) {}
 
 HiCFileWriter::HiCFileWriter(const std::filesystem::path &path_, const hictkpy::BinTable &bins_,
                              std::string_view assembly, std::size_t n_threads,
                              std::size_t chunk_size, const std::filesystem::path &tmpdir,
-                             std::uint32_t compression_lvl, bool skip_all_vs_all_matrix)
+                             std::uint32_t compression_lvl, bool skip_all_vs_all_matrix,
+                             std::size_t async_queue_bytes)
     : HiCFileWriter(path_, get_chromosomes_checked(*bins_.get()), bins_.get()->resolution(),
                     assembly, n_threads, chunk_size, tmpdir, compression_lvl,
-                    skip_all_vs_all_matrix) {}
+                    skip_all_vs_all_matrix, async_queue_bytes) {}
 
-hictk::File HiCFileWriter::finalize([[maybe_unused]] std::string_view log_lvl_str) {
+FileHandle HiCFileWriter::finalize([[maybe_unused]] std::string_view log_lvl_str) {
+  [[maybe_unused]] const profiling::Operation op{"hic.FileWriter.finalize"};
   if (_finalized) {
     throw std::runtime_error(
         fmt::format(FMT_STRING("finalize() was already called on file \"{}\""), _w.path()));
   }
 
+  if (_queue) {
+    // wait for pending pixels to be added to the file and re-throw errors (if any)
+    [[maybe_unused]] const profiling::Stage stage{"queue_wait"};
+    _queue->wait();
+    _queue.reset();
+  }
+
   const auto log_lvl = spdlog::level::from_str(normalize_log_lvl(log_lvl_str));
   const auto previous_lvl = spdlog::default_logger()->level();
   spdlog::default_logger()->set_level(log_lvl);
 
   SPDLOG_INFO(FMT_STRING("finalizing file \"{}\"..."), _w.path());
   try {
+    [[maybe_unused]] const profiling::Stage stage{"serialize"};
     _w.serialize();
     _finalized = true;
   } catch (...) {
@@ -96,7 +120,7 @@ hictk::File HiCFileWriter::finalize([[maybe_unused]] std::string_view log_lvl_st
   SPDLOG_INFO(FMT_STRING("successfully finalized \"{}\"!"), _w.path());
   spdlog::default_logger()->set_level(previous_lvl);
 
-  return hictk::File{std::string{_w.path()}, _w.resolutions().front()};
+  return FileHandle{hictk::File{std::string{_w.path()}, _w.resolutions().front()}};
 }
 
 std::filesystem::path HiCFileWriter::path() const noexcept {
@@ -128,12 +152,69 @@ void HiCFileWriter::add_pixels(const nb::object &df) {
         "caught attempt to add_pixels to a .hic file that has already been finalized!");
   }
 
-  auto lck = std::make_optional<nb::gil_scoped_acquire>();
-  const auto coo_format = nb::cast<bool>(df.attr("columns").attr("__contains__")("bin1_id"));
-  const auto pixels =
-      coo_format ? coo_df_to_thin_pixels<float>(df, false)
-                 : bg2_df_to_thin_pixels<float>(_w.bins(_w.resolutions().front()), df, false);
-  lck.reset();
+  [[maybe_unused]] const profiling::Operation op{"hic.FileWriter.add_pixels"};
+  auto table = [&]() {
+    [[maybe_unused]] const profiling::Stage gil_acquired{"gil_acquired"};
+    [[maybe_unused]] const nb::gil_scoped_acquire gil{};
+    [[maybe_unused]] const profiling::Stage stage{"import"};
+    return import_pyarrow_table(df);
+  }();
+  profiling::add_counter("pixels", table->num_rows());
+
+  auto pixels = [&]() {
+    [[maybe_unused]] const profiling::Stage stage{"convert"};
+    return table_is_coo(*table)
+               ? coo_table_to_thin_pixels<float>(*table, false)
+               : bg2_table_to_thin_pixels<float>(_w.bins(_w.resolutions().front()), *table, false);
+  }();
+  table.reset();
+
+  [[maybe_unused]] const profiling::Stage stage{"write"};
+  submit_pixels(std::move(pixels));
+}
+
+void HiCFileWriter::add_pairs(const std::filesystem::path &path_, std::size_t chunk_size,
+                              bool one_based, bool drop_unknown_chroms) {
+  if (_finalized) {
+    throw std::runtime_error(
+        "caught attempt to add_pairs to a .hic file that has already been finalized!");
+  }
+
+  // Threads are only used while reading pairs: pixels are added to the file by _w
+  std::unique_ptr<BS::thread_pool> tpool{};
+  if (_n_threads > 1) {
+    tpool =
+        std::make_unique<BS::thread_pool>(conditional_static_cast<BS::concurrency_t>(_n_threads));
+  }
+
+  PairsReader reader(
+      path_, std::make_shared<const hictk::BinTable>(_w.bins(_w.resolutions().front())),
+      one_based, drop_unknown_chroms, tpool.get());
+  SPDLOG_INFO(FMT_STRING("reading pairs from file {}..."), reader.path());
+
+  std::vector<hictk::ThinPixel<float>> pixels{};
+  while (reader.next_chunk(pixels, chunk_size)) {
+    internal::sort_pixels(pixels);
+    internal::merge_duplicate_pixels(pixels);
+    submit_pixels(std::move(pixels));
+    pixels = {};
+  }
+
+  SPDLOG_INFO(FMT_STRING("read {} records from file {} ({} records were dropped)"),
+              reader.num_records(), reader.path(), reader.num_dropped_records());
+}
+
+void HiCFileWriter::submit_pixels(std::vector<hictk::ThinPixel<float>> pixels) {
+  if (!_queue) {
+    write_pixels(pixels);
+    return;
+  }
+
+  const auto size_bytes = pixels.size() * sizeof(hictk::ThinPixel<float>);
+  _queue->submit([this, pixels = std::move(pixels)]() { write_pixels(pixels); }, size_bytes);
+}
+
+void HiCFileWriter::write_pixels(const std::vector<hictk::ThinPixel<float>> &pixels) {
   SPDLOG_INFO(FMT_STRING("adding {} pixels to file \"{}\"..."), pixels.size(), _w.path());
   _w.add_pixels(_w.resolutions().front(), pixels.begin(), pixels.end());
 }
@@ -151,33 +232,37 @@ void HiCFileWriter::bind(nb::module_ &m) {
   // NOLINTBEGIN(*-avoid-magic-numbers)
   writer.def(nb::init<const std::filesystem::path &, const ChromosomeDict &, std::uint32_t,
                       std::string_view, std::size_t, std::size_t, const std::filesystem::path &,
-                      std::uint32_t, bool>(),
+                      std::uint32_t, bool, std::size_t>(),
              nb::arg("path"), nb::arg("chromosomes"), nb::arg("resolution"),
              nb::arg("assembly") = "unknown", nb::arg("n_threads") = 1,
              nb::arg("chunk_size") = 10'000'000,
              nb::arg("tmpdir") = hictk::internal::TmpDir::default_temp_directory_path(),
              nb::arg("compression_lvl") = 10, nb::arg("skip_all_vs_all_matrix") = false,
+             nb::arg("async_queue_bytes") = 0,
              "Open a .hic file for writing given a list of chromosomes with their sizes and one "
              "resolution.");
 
   writer.def(
       nb::init<const std::filesystem::path &, const ChromosomeDict &,
                const std::vector<std::uint32_t> &, std::string_view, std::size_t, std::size_t,
-               const std::filesystem::path &, std::uint32_t, bool>(),
+               const std::filesystem::path &, std::uint32_t, bool, std::size_t>(),
       nb::arg("path"), nb::arg("chromosomes"), nb::arg("resolutions"),
       nb::arg("assembly") = "unknown", nb::arg("n_threads") = 1, nb::arg("chunk_size") = 10'000'000,
       nb::arg("tmpdir") = hictk::internal::TmpDir::default_temp_directory_path(),
       nb::arg("compression_lvl") = 10, nb::arg("skip_all_vs_all_matrix") = false,
+      nb::arg("async_queue_bytes") = 0,
       "Open a .hic file for writing given a list of chromosomes with their sizes and one or more "
       "resolutions.");
 
   writer.def(
       nb::init<const std::filesystem::path &, const hictkpy::BinTable &, std::string_view,
-               std::size_t, std::size_t, const std::filesystem::path &, std::uint32_t, bool>(),
+               std::size_t, std::size_t, const std::filesystem::path &, std::uint32_t, bool,
+               std::size_t>(),
       nb::arg("path"), nb::arg("bins"), nb::arg("assembly") = "unknown", nb::arg("n_threads") = 1,
       nb::arg("chunk_size") = 10'000'000,
       nb::arg("tmpdir") = hictk::internal::TmpDir::default_temp_directory_path(),
       nb::arg("compression_lvl") = 10, nb::arg("skip_all_vs_all_matrix") = false,
+      nb::arg("async_queue_bytes") = 0,
       "Open a .hic file for writing given a BinTable. Only BinTable with a fixed bin size are "
       "supported.");
   // NOLINTEND(*-avoid-magic-numbers)
@@ -196,10 +281,28 @@ void HiCFileWriter::bind(nb::module_ &m) {
 
   writer.def("add_pixels", &hictkpy::HiCFileWriter::add_pixels,
              nb::call_guard<nb::gil_scoped_release>(),
-             nb::sig("def add_pixels(self, pixels: pandas.DataFrame) -> None"), nb::arg("pixels"),
-             "Add pixels from a pandas DataFrame containing pixels in COO or BG2 format (i.e. "
-             "either with columns=[bin1_id, bin2_id, count] or with columns=[chrom1, start1, end1, "
-             "chrom2, start2, end2, count].");
+             nb::sig("def add_pixels(self, pixels: pandas.DataFrame | pyarrow.Table | "
+                    "pyarrow.RecordBatch) -> None"),
+             nb::arg("pixels"),
+             "Add pixels from a pandas DataFrame, pyarrow Table or RecordBatch (or any object "
+             "implementing the __arrow_c_stream__ protocol) containing pixels in COO or BG2 format "
+             "(i.e. either with columns=[bin1_id, bin2_id, count] or with columns=[chrom1, start1, "
+             "end1, chrom2, start2, end2, count]). Chromosome columns can be dictionary-encoded "
+             "(e.g. pandas.Categorical).");
+  // NOLINTBEGIN(*-avoid-magic-numbers)
+  writer.def("add_pairs", &hictkpy::HiCFileWriter::add_pairs,
+             nb::call_guard<nb::gil_scoped_release>(), nb::arg("path"),
+             nb::arg("chunk_size") = 10'000'000, nb::arg("one_based") = true,
+             nb::arg("drop_unknown_chroms") = false,
+             "Add interactions from a file in 4DN-DCIC pairs format (.pairs). Files can be either "
+             "uncompressed or compressed with bgzip.\n"
+             "Pairs are read, binned, and added to the file in chunks of chunk_size pixels: when "
+             "the writer was created with n_threads > 1, decompression and parsing are done in "
+             "parallel.\n"
+             "Positions are assumed to be one-based unless one_based=False. Records referring to "
+             "chromosomes that are not in the table of bins raise an exception, unless "
+             "drop_unknown_chroms=True.");
+  // NOLINTEND(*-avoid-magic-numbers)
   writer.def("finalize", &hictkpy::HiCFileWriter::finalize,
              nb::call_guard<nb::gil_scoped_release>(), nb::arg("log_lvl") = "WARN",
              "Write interactions to file.", nb::rv_policy::move);
@@ -8,6 +8,7 @@
 #include <hictk/version.hpp>
 
 #include "hictkpy/bin_table.hpp"
+#include "hictkpy/cache_config.hpp"
 #include "hictkpy/cooler_file_writer.hpp"
 #include "hictkpy/file.hpp"
 #include "hictkpy/hic_file_writer.hpp"
@@ -16,7 +17,9 @@
 #include "hictkpy/nanobind.hpp"
 #include "hictkpy/pixel.hpp"
 #include "hictkpy/pixel_selector.hpp"
+#include "hictkpy/profiling.hpp"
 #include "hictkpy/singlecell_file.hpp"
+#include "hictkpy/zoomify.hpp"
 
 namespace nb = nanobind;
 namespace hictkpy {
@@ -51,6 +54,8 @@ NB_MODULE(_hictkpy, m) {
 
   BinTable::bind(m);
 
+  CacheConfig::bind(m);
+
   PixelSelector::bind(m);
 
   file::declare_file_class(m);
@@ -60,6 +65,10 @@ NB_MODULE(_hictkpy, m) {
 
   CoolerFileWriter::bind(m);
   HiCFileWriter::bind(m);
+
+  zoomify::declare_zoomify_function(m);
+
+  profiling::declare_profiling_module(m);
 }
 
 }  // namespace hictkpy
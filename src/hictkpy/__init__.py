@@ -12,17 +12,23 @@ def _get_hictkpy_version() -> str:
 from ._hictkpy import (
     Bin,
     BinTable,
+    CacheConfig,
     File,
     MultiResFile,
     PixelSelector,
     __doc__,
     __hictk_version__,
+    cache_stats,
     cooler,
+    get_cache_config,
     hic,
     is_cooler,
     is_hic,
     is_mcool_file,
     is_scool_file,
+    profiling,
+    set_cache_config,
+    zoomify,
 )
 
 __version__ = _get_hictkpy_version()
@@ -30,6 +36,7 @@ __all__ = [
     "__doc__",
     "Bin",
     "BinTable",
+    "CacheConfig",
     "File",
     "MultiResFile",
     "PixelSelector",
@@ -37,7 +44,12 @@ __all__ = [
     "is_mcool_file",
     "is_scool_file",
     "is_hic",
+    "cache_stats",
+    "get_cache_config",
+    "set_cache_config",
+    "zoomify",
     "cooler",
     "hic",
+    "profiling",
     "__hictk_version__",
 ]
@@ -0,0 +1,239 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <hictk/balancing/weights.hpp>
+#include <hictk/bin_table.hpp>
+#include <hictk/cooler/pixel_selector.hpp>
+#include <hictk/hic/pixel_selector.hpp>
+#include <hictk/pixel.hpp>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "hictkpy/expected.hpp"
+#include "hictkpy/locking.hpp"
+
+namespace hictkpy {
+
+// Adapter restricting a square cis PixelSelector to the pixels that are at most max_distance bins
+// away from the diagonal.
+// The band is traversed in tiles of at least min_tile_size rows along the diagonal. Each tile is
+// fetched using a rectangular query that only spans the columns overlapping the band: this way,
+// rows of the Cooler index and .hic blocks that lie completely outside the band are never read.
+// The interface mirrors the subset of the hictk::cooler::PixelSelector and
+// hictk::hic::PixelSelector interfaces used by hictkpy and by the hictk transformers.
+template <typename SelT>
+class BandPixelSelector {
+  static_assert(std::is_same_v<SelT, hictk::cooler::PixelSelector> ||
+                std::is_same_v<SelT, hictk::hic::PixelSelector>);
+
+  std::shared_ptr<const SelT> _sel{};
+  std::uint64_t _max_distance{};
+
+ public:
+  static constexpr std::uint64_t min_tile_size{32};
+
+  template <typename N>
+  class iterator;
+
+  BandPixelSelector(std::shared_ptr<const SelT> sel, std::uint64_t max_distance)
+      : _sel(std::move(sel)), _max_distance(max_distance) {
+    assert(!!_sel);
+    const auto& coord1 = _sel->coord1();
+    const auto& coord2 = _sel->coord2();
+    if (!coord1 || coord1 != coord2) {
+      throw std::runtime_error(
+          "max_distance is only supported for cis queries where range1 and range2 are identical");
+    }
+    _max_distance = std::min(_max_distance, num_bins() - 1);
+  }
+
+  [[nodiscard]] const hictk::PixelCoordinates& coord1() const noexcept { return _sel->coord1(); }
+  [[nodiscard]] const hictk::PixelCoordinates& coord2() const noexcept { return _sel->coord2(); }
+  [[nodiscard]] const hictk::BinTable& bins() const noexcept { return _sel->bins(); }
+  [[nodiscard]] std::shared_ptr<const hictk::BinTable> bins_ptr() const noexcept {
+    return _sel->bins_ptr();
+  }
+
+  // Weights are indexed like the weights of the underlying selector (i.e. using absolute bin IDs
+  // for Cooler files and bin IDs relative to the chromosome for .hic files)
+  [[nodiscard]] const hictk::balancing::Weights& weights1() const noexcept {
+    if constexpr (std::is_same_v<SelT, hictk::cooler::PixelSelector>) {
+      return _sel->weights();
+    } else {
+      return _sel->weights1();
+    }
+  }
+  [[nodiscard]] const hictk::balancing::Weights& weights2() const noexcept {
+    if constexpr (std::is_same_v<SelT, hictk::cooler::PixelSelector>) {
+      return _sel->weights();
+    } else {
+      return _sel->weights2();
+    }
+  }
+
+  [[nodiscard]] const SelT& base() const noexcept { return *_sel; }
+  [[nodiscard]] std::uint64_t max_distance() const noexcept { return _max_distance; }
+  [[nodiscard]] std::uint64_t num_bins() const noexcept {
+    return coord1().bin2.id() - coord1().bin1.id() + 1;
+  }
+  [[nodiscard]] std::uint64_t num_diagonals() const noexcept { return _max_distance + 1; }
+
+  // Fetch the band overlapping a sub-region of the current query
+  [[nodiscard]] BandPixelSelector fetch(hictk::PixelCoordinates coord1_,
+                                        hictk::PixelCoordinates coord2_) const {
+    return {make_selector(_sel->fetch(std::move(coord1_), std::move(coord2_))), _max_distance};
+  }
+
+  template <typename N>
+  [[nodiscard]] auto begin() const -> iterator<N> {
+    return iterator<N>{_sel, _max_distance};
+  }
+  template <typename N>
+  [[nodiscard]] auto end() const -> iterator<N> {
+    return iterator<N>::at_end();
+  }
+
+  template <typename N>
+  class iterator {
+    using PixelIt = decltype(std::declval<const SelT&>().template begin<N>());
+
+    std::shared_ptr<const SelT> _sel{};
+    std::uint64_t _max_distance{};
+    std::uint64_t _tile_size{};
+    // First row of the tile that will be read next
+    std::uint64_t _next_row{};
+    std::uint64_t _last_row{};
+
+    std::shared_ptr<const SelT> _tile{};
+    std::optional<PixelIt> _it{};
+    std::optional<PixelIt> _last{};
+    hictk::ThinPixel<N> _value{};
+
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = hictk::ThinPixel<N>;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+    using iterator_category = std::input_iterator_tag;
+
+    iterator() = default;
+    iterator(std::shared_ptr<const SelT> sel, std::uint64_t max_distance)
+        : _sel(std::move(sel)),
+          _max_distance(max_distance),
+          _tile_size(std::max(max_distance, min_tile_size)),
+          _next_row(_sel->coord1().bin1.id()),
+          _last_row(_sel->coord1().bin2.id()) {
+      read_next_tile();
+      seek();
+    }
+
+    [[nodiscard]] static auto at_end() -> iterator { return {}; }
+
+    [[nodiscard]] bool operator==(const iterator& other) const noexcept {
+      if (!_tile || !other._tile) {
+        return !_tile && !other._tile;
+      }
+      return _tile == other._tile && *_it == *other._it;
+    }
+    [[nodiscard]] bool operator!=(const iterator& other) const noexcept {
+      return !(*this == other);
+    }
+
+    [[nodiscard]] auto operator*() const noexcept -> reference { return _value; }
+    [[nodiscard]] auto operator->() const noexcept -> pointer { return &_value; }
+
+    auto operator++() -> iterator& {
+      assert(!!_tile);
+      ++(*_it);
+      seek();
+      return *this;
+    }
+    auto operator++(int) -> iterator {
+      auto it = *this;
+      ++(*this);
+      return it;
+    }
+
+   private:
+    void read_next_tile() {
+      _it.reset();
+      _last.reset();
+      _tile.reset();
+      if (_next_row > _last_row) {
+        return;
+      }
+
+      const auto& bins = _sel->bins();
+      const auto first_row = _next_row;
+      const auto last_row = std::min(first_row + _tile_size - 1, _last_row);
+      const auto last_col = std::min(last_row + _max_distance, _last_row);
+      _next_row = last_row + 1;
+
+      _tile = make_selector(
+          _sel->fetch(hictk::PixelCoordinates{bins.at(first_row), bins.at(last_row)},
+                      hictk::PixelCoordinates{bins.at(first_row), bins.at(last_col)}));
+      _it = _tile->template begin<N>();
+      _last = _tile->template end<N>();
+    }
+
+    // Move to the next pixel overlapping the band, reading new tiles as needed
+    void seek() {
+      while (_tile) {
+        for (; *_it != *_last; ++(*_it)) {
+          const auto& p = **_it;
+          if (p.bin2_id >= p.bin1_id && p.bin2_id - p.bin1_id <= _max_distance) {
+            _value = p;
+            return;
+          }
+        }
+        read_next_tile();
+      }
+    }
+  };
+
+ private:
+  // Selectors over .cool files must be destroyed while holding the HDF5 lock, as their destructor
+  // closes HDF5 datasets
+  [[nodiscard]] static std::shared_ptr<const SelT> make_selector(SelT&& sel) {
+    if constexpr (std::is_same_v<SelT, hictk::cooler::PixelSelector>) {
+      return make_shared_locked(std::move(sel), get_hdf5_mutex());
+    } else {
+      return std::make_shared<const SelT>(std::move(sel));
+    }
+  }
+};
+
+template <typename T>
+struct remove_band_selector {
+  using type = T;
+};
+
+template <typename SelT>
+struct remove_band_selector<BandPixelSelector<SelT>> {
+  using type = SelT;
+};
+
+// Get the type of the selector wrapped by BandPixelSelector (or T itself for all other selectors)
+template <typename T>
+using remove_band_selector_t = typename remove_band_selector<T>::type;
+
+template <typename SelT>
+[[nodiscard]] inline ExpectedAccumulator make_expected_accumulator(
+    const BandPixelSelector<SelT>& sel) {
+  auto expected = make_expected_accumulator(sel.base());
+  expected.truncate(sel.num_diagonals());
+  return expected;
+}
+
+}  // namespace hictkpy
@@ -42,18 +42,20 @@ class BinTable {
   [[nodiscard]] std::string repr() const;
 
   [[nodiscard]] hictk::Bin bin_id_to_coord(std::uint64_t bin_id) const;
-  [[nodiscard]] nanobind::object bin_ids_to_coords(std::vector<std::uint64_t> bin_ids) const;
+  [[nodiscard]] nanobind::object bin_ids_to_coords(const nanobind::object& bin_ids,
+                                                   std::size_t n_threads) const;
 
   [[nodiscard]] hictk::Bin coord_to_bin(std::string_view chrom, std::uint32_t pos) const;
-  [[nodiscard]] nanobind::object coords_to_bins(const std::vector<std::string>& chroms,
-                                                const std::vector<std::uint32_t>& positions) const;
+  [[nodiscard]] nanobind::object coords_to_bins(const nanobind::object& chroms,
+                                                const nanobind::object& positions,
+                                                std::size_t n_threads) const;
 
   [[nodiscard]] std::int64_t coord_to_bin_id(std::string_view chrom, std::uint32_t pos) const;
-  [[nodiscard]] auto coords_to_bin_ids(const std::vector<std::string>& chroms,
-                                       const std::vector<std::uint32_t>& positions) const
-      -> BinIDsVec;
+  [[nodiscard]] auto coords_to_bin_ids(const nanobind::object& chroms,
+                                       const nanobind::object& positions,
+                                       std::size_t n_threads) const -> BinIDsVec;
 
-  [[nodiscard]] nanobind::object merge_coords(nanobind::object df) const;
+  [[nodiscard]] nanobind::object merge_coords(nanobind::object df, std::size_t n_threads) const;
 
   [[nodiscard]] nanobind::iterator make_iterable() const;
 
@@ -0,0 +1,89 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <hictk/bin_table.hpp>
+#include <hictk/file.hpp>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "hictkpy/nanobind.hpp"
+#include "hictkpy/weight_cache.hpp"
+
+namespace hictkpy {
+
+// Settings controlling the size of the caches used when reading interactions.
+// File objects own their block cache (.hic) or HDF5 chunk cache (.cool): CacheConfig::max_bytes
+// bounds the total size of the caches owned by the files that are currently open. Balancing
+// weights and query results are instead stored in LRU caches shared by all files (see WeightCache
+// and QueryCache).
+struct CacheConfig {
+  // Maximum total size of the caches of the open files (0 = no limit)
+  std::size_t max_bytes{0};
+  // Size of the cache of files opened without specifying cache_size
+  // (0 = use the default size for the given file format)
+  std::size_t file_cache_bytes{0};
+  // Capacity of the cache shared by all files to store balancing weights
+  std::size_t weight_cache_bytes{WeightCache::default_capacity_bytes};
+  // Capacity of the cache shared by all files to store query results (0 = disabled)
+  std::size_t query_cache_bytes{0};
+  // Level used to compress the dense matrices stored by the query cache (0 = no compression)
+  int query_cache_compression_level{0};
+  // Folder where the query cache spills dense matrices evicted from memory (empty = do not spill)
+  std::string query_cache_spill_dir{};
+  // Maximum size of the query cache entries spilled to disk
+  std::size_t query_cache_spill_bytes{0};
+
+  [[nodiscard]] std::string repr() const;
+
+  static void bind(nanobind::module_& m);
+};
+
+[[nodiscard]] CacheConfig get_cache_config();
+void set_cache_config(const CacheConfig& config);
+
+// Compute the cache size for a file that is about to be opened.
+// Returns the requested size (or the default size from CacheConfig), clamped to the cache budget
+// that is still available.
+// A return value of std::nullopt means that the file format default should be used.
+[[nodiscard]] std::optional<std::size_t> compute_file_cache_size(
+    std::optional<std::size_t> requested);
+// Return the cache budget that is still available (std::nullopt means unbounded).
+[[nodiscard]] std::optional<std::size_t> available_file_cache_bytes();
+
+// Keep track of the cache owned by the file with the given BinTable.
+// Caches are released once the BinTable is destroyed (i.e. after the file and all its selectors
+// have been destroyed).
+void register_file_cache(const std::shared_ptr<const hictk::BinTable>& bins,
+                         std::size_t size_bytes);
+// Return the cache size registered for the file with the given BinTable (0 if not registered)
+[[nodiscard]] std::size_t get_file_cache_size(const std::shared_ptr<const hictk::BinTable>& bins);
+
+// Compute the block cache capacity of each of the num_workers handles opened by worker threads
+// reading interactions from the .hic file with the given BinTable in parallel.
+// Workers split the cache budget of the file queries originate from, so that processing queries in
+// parallel does not increase the amount of memory used by caches. When the file is not registered,
+// workers split the budget that would be assigned to a newly opened file.
+// A return value of 0 means that hictk should pick the cache capacity.
+[[nodiscard]] std::size_t compute_worker_file_cache_size(
+    const std::shared_ptr<const hictk::BinTable>& bins, std::size_t num_workers);
+
+// Same as register_file_cache(), but for .hic files opened lazily.
+// The block cache of these files is sized the first time interactions are read from the file (see
+// optimize_deferred_file_cache()), as doing so requires reading the file footer and block index.
+// upper_bound is the cache budget that was available when the file was opened (std::nullopt means
+// unbounded)
+void register_deferred_file_cache(const std::shared_ptr<const hictk::BinTable>& bins,
+                                  std::size_t size_bytes, std::optional<std::size_t> upper_bound);
+// Size the block cache of the given file if this was deferred when opening the file: this is a
+// no-op for all other files.
+// This should be called while holding the file lock.
+void optimize_deferred_file_cache(const hictk::File& f);
+
+[[nodiscard]] nanobind::dict get_cache_stats();
+
+}  // namespace hictkpy
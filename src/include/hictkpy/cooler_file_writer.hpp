@@ -4,19 +4,27 @@
 
 #pragma once
 
+#include <BS_thread_pool.hpp>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <hictk/cooler/singlecell_cooler.hpp>
 #include <hictk/file.hpp>
+#include <hictk/pixel.hpp>
 #include <hictk/reference.hpp>
 #include <hictk/tmpdir.hpp>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "hictkpy/bin_table.hpp"
+#include "hictkpy/locking.hpp"
 #include "hictkpy/nanobind.hpp"
 #include "hictkpy/reference.hpp"
+#include "hictkpy/task_queue.hpp"
 
 namespace hictkpy {
 
@@ -25,16 +33,24 @@ class CoolerFileWriter {
   hictk::internal::TmpDir _tmpdir{};
   std::optional<hictk::cooler::SingleCellFile> _w{};
   std::uint32_t _compression_lvl{};
+  // Used to sort pixels in parallel. Operations involving HDF5 are always single-threaded
+  std::unique_ptr<BS::thread_pool> _tpool{};
+  std::atomic<std::size_t> _num_cells{};
   bool _finalized{false};
+  // Queue used to write pixels in the background. The queue should be destroyed first, as queued
+  // tasks refer to other members
+  std::unique_ptr<BoundedTaskQueue> _queue{};
 
  public:
   CoolerFileWriter() = delete;
   CoolerFileWriter(std::filesystem::path path_, const ChromosomeDict& chromosomes_,
                    std::uint32_t resolution_, std::string_view assembly,
-                   const std::filesystem::path& tmpdir, std::uint32_t compression_lvl);
+                   const std::filesystem::path& tmpdir, std::uint32_t compression_lvl,
+                   std::size_t n_threads, std::size_t async_queue_bytes);
   CoolerFileWriter(std::filesystem::path path_, const hictkpy::BinTable& bins_,
                    std::string_view assembly, const std::filesystem::path& tmpdir,
-                   std::uint32_t compression_lvl);
+                   std::uint32_t compression_lvl, std::size_t n_threads,
+                   std::size_t async_queue_bytes);
 
   [[nodiscard]] const std::filesystem::path& path() const noexcept;
   [[nodiscard]] std::uint32_t resolution() const noexcept;
@@ -43,14 +59,28 @@ class CoolerFileWriter {
   [[nodiscard]] std::shared_ptr<const hictk::BinTable> bins_ptr() const noexcept;
 
   void add_pixels(const nanobind::object& df);
+  void add_pairs(const std::filesystem::path& path_, std::size_t chunk_size, bool one_based,
+                 bool drop_unknown_chroms);
 
-  [[nodiscard]] hictk::File finalize(std::string_view log_lvl_str, std::size_t chunk_size,
-                                     std::size_t update_frequency);
+  [[nodiscard]] FileHandle finalize(std::string_view log_lvl_str, std::size_t chunk_size,
+                                    std::size_t update_frequency);
 
   [[nodiscard]] std::string repr() const;
   static void bind(nanobind::module_& m);
 
  private:
+  [[nodiscard]] static std::unique_ptr<BS::thread_pool> init_tpool(std::size_t n_threads);
+
+  template <typename N>
+  void sort_pixels(std::vector<hictk::ThinPixel<N>>& pixels);
+
+  template <typename N>
+  void write_cell(const std::string& cell_id, const std::vector<hictk::ThinPixel<N>>& pixels);
+
+  // Write pixels to a new cell, either directly or through the background queue
+  template <typename N>
+  void submit_cell(std::vector<hictk::ThinPixel<N>> pixels);
+
   [[nodiscard]] static hictk::cooler::SingleCellFile create_file(
       std::string_view path, const hictk::BinTable& bins, std::string_view assembly,
       const std::filesystem::path& tmpdir);
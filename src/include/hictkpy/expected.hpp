@@ -0,0 +1,118 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <hictk/balancing/weights.hpp>
+#include <hictk/cooler/pixel_selector.hpp>
+#include <hictk/hic/pixel_selector.hpp>
+#include <hictk/pixel.hpp>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "hictkpy/common.hpp"
+
+namespace arrow {
+class Table;
+}  // namespace arrow
+
+namespace hictkpy {
+
+// Accumulator used to compute the expected number of interactions as a function of the distance
+// from the diagonal (i.e. the average number of interactions of each diagonal) for the square cis
+// region spanning num_bins bins.
+// Both the per-diagonal sums and the number of valid pixels are stored in dense vectors indexed by
+// diagonal, so that each pixel is processed in constant time.
+// A pixel is valid when neither of its bins is masked, i.e. when the weights of both bins are
+// finite. Non-finite counts (e.g. the counts of pixels overlapping masked bins) are ignored.
+class ExpectedAccumulator {
+  std::vector<double> _sum{};
+  std::vector<std::uint64_t> _n_valid{};
+
+ public:
+  ExpectedAccumulator() = default;
+  // weights_offset is the index of the weight corresponding to the first bin in the region
+  ExpectedAccumulator(std::uint64_t num_bins, const hictk::balancing::Weights& weights,
+                      std::uint64_t weights_offset);
+
+  [[nodiscard]] std::uint64_t num_diagonals() const noexcept;
+  [[nodiscard]] double sum(std::uint64_t diag) const noexcept;
+  [[nodiscard]] std::uint64_t n_valid(std::uint64_t diag) const noexcept;
+  // Return NaN for diagonals without valid pixels
+  [[nodiscard]] double avg(std::uint64_t diag) const noexcept;
+
+  template <typename N>
+  void add(const hictk::ThinPixel<N>& p) noexcept {
+    const auto diag = distance(p);
+    const auto count = conditional_static_cast<double>(p.count);
+    if (diag < _sum.size() && std::isfinite(count)) {
+      _sum[diag] += count;
+    }
+  }
+
+  template <typename N>
+  [[nodiscard]] double observed_over_expected(const hictk::ThinPixel<N>& p) const noexcept {
+    const auto diag = distance(p);
+    const auto expected = diag < _sum.size() ? avg(diag) : 0.0;
+    if (expected == 0 || !std::isfinite(expected)) {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+    return conditional_static_cast<double>(p.count) / expected;
+  }
+
+  // Drop all diagonals past the first num_diagonals diagonals
+  void truncate(std::uint64_t num_diagonals);
+
+  // Return a table with columns dist, n_valid, count.sum and count.avg
+  [[nodiscard]] std::shared_ptr<arrow::Table> to_arrow() const;
+
+ private:
+  template <typename N>
+  [[nodiscard]] static std::uint64_t distance(const hictk::ThinPixel<N>& p) noexcept {
+    return p.bin1_id > p.bin2_id ? p.bin1_id - p.bin2_id : p.bin2_id - p.bin1_id;
+  }
+};
+
+// Construct an empty accumulator for the region targeted by the given selector.
+// Expected values can only be computed for square cis queries (e.g. chr1:0-10,000,000 vs
+// chr1:0-10,000,000): an exception is thrown when this is not the case.
+[[nodiscard]] ExpectedAccumulator make_expected_accumulator(
+    const hictk::cooler::PixelSelector& sel);
+[[nodiscard]] ExpectedAccumulator make_expected_accumulator(const hictk::hic::PixelSelector& sel);
+[[nodiscard]] ExpectedAccumulator make_expected_accumulator(
+    const hictk::hic::PixelSelectorAll& sel);
+
+// Compute expected values with a single pass over the pixels overlapping the given selector
+template <typename PixelSelectorT>
+[[nodiscard]] inline ExpectedAccumulator compute_expected(const PixelSelectorT& sel) {
+  auto expected = make_expected_accumulator(sel);
+  std::for_each(sel.template begin<double>(), sel.template end<double>(),
+                [&](const auto& p) { expected.add(p); });
+  return expected;
+}
+
+// Read the pixels overlapping the given selector and replace their counts with the ratio of
+// observed over expected interactions.
+// Expected values are computed while pixels are being read, so that pixels are decoded only once.
+template <typename PixelSelectorT>
+[[nodiscard]] inline std::vector<hictk::ThinPixel<double>> fetch_observed_over_expected(
+    const PixelSelectorT& sel) {
+  auto expected = make_expected_accumulator(sel);
+  std::vector<hictk::ThinPixel<double>> pixels{};
+  std::for_each(sel.template begin<double>(), sel.template end<double>(), [&](const auto& p) {
+    expected.add(p);
+    pixels.emplace_back(p);
+  });
+
+  for (auto& p : pixels) {
+    p.count = expected.observed_over_expected(p);
+  }
+  return pixels;
+}
+
+}  // namespace hictkpy
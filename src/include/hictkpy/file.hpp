@@ -4,15 +4,47 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <hictk/file.hpp>
+#include <hictk/hic/common.hpp>
+#include <optional>
+#include <string_view>
 
+#include "hictkpy/locking.hpp"
 #include "hictkpy/nanobind.hpp"
+#include "hictkpy/pixel_selector.hpp"
 
 namespace hictkpy::file {
 
 [[nodiscard]] bool is_cooler(const std::filesystem::path &uri);
 [[nodiscard]] bool is_hic(const std::filesystem::path &uri);
 
+// Throw an exception when the given URI refers to a remote file (e.g. s3:// or https:// URIs).
+// hictk reads .hic files through std::ifstream and Cooler files through the default HDF5 driver,
+// so only files on the local filesystem (or on filesystems mounted locally) can be opened
+void ensure_local_uri(const std::filesystem::path &uri);
+
+// Open a .hic, .cool or .mcool file (see File.__init__() for more details)
+[[nodiscard]] FileHandle open(
+    const std::filesystem::path &path, std::optional<std::uint32_t> resolution,
+    hictk::hic::MatrixType matrix_type = hictk::hic::MatrixType::observed,
+    hictk::hic::MatrixUnit matrix_unit = hictk::hic::MatrixUnit::BP,
+    std::optional<std::size_t> cache_size = {}, bool lazy = false);
+
+// Fetch interactions overlapping the given region(s) of interest (see File.fetch() for more
+// details). This should be called without holding the GIL
+[[nodiscard]] hictkpy::PixelSelector fetch(const hictk::File &f,
+                                           std::optional<std::string_view> range1,
+                                           std::optional<std::string_view> range2,
+                                           std::optional<std::string_view> normalization,
+                                           std::string_view count_type, bool join,
+                                           std::string_view query_type,
+                                           std::optional<std::int64_t> max_distance = {},
+                                           std::size_t n_threads = 1,
+                                           std::string_view bin_id_type = "uint64");
+
 void declare_file_class(nanobind::module_ &m);
 
 }  // namespace hictkpy::file
@@ -9,36 +9,46 @@
 #include <filesystem>
 #include <hictk/file.hpp>
 #include <hictk/hic/file_writer.hpp>
+#include <hictk/pixel.hpp>
 #include <hictk/reference.hpp>
 #include <hictk/tmpdir.hpp>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include "hictkpy/bin_table.hpp"
+#include "hictkpy/locking.hpp"
 #include "hictkpy/nanobind.hpp"
 #include "hictkpy/reference.hpp"
+#include "hictkpy/task_queue.hpp"
 
 namespace hictkpy {
 
 class HiCFileWriter {
   hictk::internal::TmpDir _tmpdir{};
   hictk::hic::internal::HiCFileWriter _w{};
+  std::size_t _n_threads{1};
   bool _finalized{false};
+  // Queue used to add pixels in the background. The queue should be destroyed first, as queued
+  // tasks refer to other members
+  std::unique_ptr<BoundedTaskQueue> _queue{};
 
  public:
   HiCFileWriter(const std::filesystem::path& path_, const ChromosomeDict& chromosomes,
                 const std::vector<std::uint32_t>& resolutions_, std::string_view assembly,
                 std::size_t n_threads, std::size_t chunk_size, const std::filesystem::path& tmpdir,
-                std::uint32_t compression_lvl, bool skip_all_vs_all_matrix);
+                std::uint32_t compression_lvl, bool skip_all_vs_all_matrix,
+                std::size_t async_queue_bytes);
   HiCFileWriter(const std::filesystem::path& path_, const ChromosomeDict& chromosomes,
                 std::uint32_t resolution, std::string_view assembly, std::size_t n_threads,
                 std::size_t chunk_size, const std::filesystem::path& tmpdir,
-                std::uint32_t compression_lvl, bool skip_all_vs_all_matrix);
+                std::uint32_t compression_lvl, bool skip_all_vs_all_matrix,
+                std::size_t async_queue_bytes);
   HiCFileWriter(const std::filesystem::path& path_, const hictkpy::BinTable& bins_,
                 std::string_view assembly, std::size_t n_threads, std::size_t chunk_size,
                 const std::filesystem::path& tmpdir, std::uint32_t compression_lvl,
-                bool skip_all_vs_all_matrix);
+                bool skip_all_vs_all_matrix, std::size_t async_queue_bytes);
 
   [[nodiscard]] std::filesystem::path path() const noexcept;
   [[nodiscard]] auto resolutions() const;
@@ -47,12 +57,19 @@ class HiCFileWriter {
   [[nodiscard]] hictkpy::BinTable bins(std::uint32_t resolution) const;
 
   void add_pixels(const nanobind::object& df);
+  void add_pairs(const std::filesystem::path& path_, std::size_t chunk_size, bool one_based,
+                 bool drop_unknown_chroms);
 
-  [[nodiscard]] hictk::File finalize(std::string_view log_lvl_str);
+  [[nodiscard]] FileHandle finalize(std::string_view log_lvl_str);
 
   [[nodiscard]] std::string repr() const;
 
   static void bind(nanobind::module_& m);
+
+ private:
+  void write_pixels(const std::vector<hictk::ThinPixel<float>>& pixels);
+  // Add pixels to the file, either directly or through the background queue
+  void submit_pixels(std::vector<hictk::ThinPixel<float>> pixels);
 };
 
 }  // namespace hictkpy
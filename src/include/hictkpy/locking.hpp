@@ -0,0 +1,100 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <hictk/bin_table.hpp>
+#include <hictk/file.hpp>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "hictkpy/nanobind.hpp"
+#include "hictkpy/profiling.hpp"
+
+namespace hictkpy {
+
+// Locks guarding file handles are recursive, as the same thread may need to re-acquire a lock it
+// already owns (e.g. when the last reference to a PixelSelector is released while reading pixels).
+// Threads should never block on these locks while holding the GIL: doing so may lead to deadlocks
+// when e.g. the thread owning the lock tries to log a message. Use lock_file() to acquire a lock
+// from a thread holding the GIL.
+using FileMutex = std::recursive_mutex;
+
+// hictkpy links against a build of HDF5 without thread-safety: all operations on
+// .cool/.mcool/.scool files must be serialized process-wide.
+[[nodiscard]] std::shared_ptr<FileMutex> get_hdf5_mutex();
+
+// PixelSelectors created from the same .hic file share the underlying file stream and the block and
+// weight caches. Said state is identified by the BinTable shared by the file and its selectors.
+[[nodiscard]] std::shared_ptr<FileMutex> get_hic_file_mutex(
+    const std::shared_ptr<const hictk::BinTable>& bins);
+
+// Get the mutex guarding the given file handle
+[[nodiscard]] std::shared_ptr<FileMutex> get_file_mutex(const hictk::File& f);
+
+// Acquire the given lock. When the lock is not immediately available, the GIL (if held) is released
+// while waiting.
+[[nodiscard]] inline std::unique_lock<FileMutex> lock_file(FileMutex& mtx) {
+  std::unique_lock lck(mtx, std::try_to_lock);
+  if (lck.owns_lock()) {
+    return lck;
+  }
+
+  [[maybe_unused]] const profiling::Stage lock_wait{"lock_wait"};
+  if (PyGILState_Check() != 0) {
+    [[maybe_unused]] const nanobind::gil_scoped_release release{};
+    lck.lock();
+  } else {
+    lck.lock();
+  }
+  return lck;
+}
+
+// Release the GIL and run fx() while holding the given lock.
+// The lock is acquired after releasing the GIL: failing to do so may lead to deadlocks when e.g. the
+// thread holding the lock tries to log a message
+// When profiling is enabled, the time spent waiting for the lock and running fx() are recorded as
+// stages "lock_wait" and "read", respectively.
+template <typename Fx>
+[[nodiscard]] inline auto run_without_gil(FileMutex& mtx, Fx&& fx) {
+  [[maybe_unused]] const profiling::Stage gil_released{"gil_released"};
+  [[maybe_unused]] const nanobind::gil_scoped_release release{};
+  std::unique_lock lck(mtx, std::defer_lock);
+  {
+    [[maybe_unused]] const profiling::Stage lock_wait{"lock_wait"};
+    lck.lock();
+  }
+  [[maybe_unused]] const profiling::Stage read{"read"};
+  return fx();
+}
+
+// Wrap obj in a shared_ptr whose deleter acquires the given lock before destroying obj.
+// This is required for objects whose destructor calls into e.g. HDF5.
+template <typename T>
+[[nodiscard]] inline std::shared_ptr<const T> make_shared_locked(T&& obj,
+                                                                 std::shared_ptr<FileMutex> mtx) {
+  return std::shared_ptr<const T>(new T(std::forward<T>(obj)),  // NOLINT(*-owning-memory)
+                                  [mtx = std::move(mtx)](const T* ptr) noexcept {
+                                    [[maybe_unused]] const auto lck = lock_file(*mtx);
+                                    delete ptr;  // NOLINT(*-owning-memory)
+                                  });
+}
+
+// File handle owned by hictkpy.File objects.
+// Like selectors over .cool files (see make_shared_locked()), Cooler files are closed while holding
+// the HDF5 lock, as closing a file closes the HDF5 objects it owns. Closing a file leaves it in an
+// empty state, so the destructor of hictk::File no longer calls into HDF5
+class FileHandle : public hictk::File {
+ public:
+  explicit FileHandle(hictk::File f);
+  FileHandle(const FileHandle& other) = delete;
+  FileHandle(FileHandle&& other) = default;
+  ~FileHandle() noexcept;
+
+  FileHandle& operator=(const FileHandle& other) = delete;
+  FileHandle& operator=(FileHandle&& other) = delete;
+};
+
+}  // namespace hictkpy
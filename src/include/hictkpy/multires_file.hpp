@@ -4,9 +4,63 @@
 
 #pragma once
 
+#include <parallel_hashmap/phmap.h>
+
+#include <cstdint>
 #include <filesystem>
+#include <hictk/multires_file.hpp>
+#include <hictk/reference.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
 
 #include "hictkpy/nanobind.hpp"
+#include "hictkpy/pixel_selector.hpp"
+
+namespace hictkpy {
+
+class MultiResFile {
+  hictk::MultiResFile _mrf;
+  // Python File objects opened through this MultiResFile, indexed by resolution.
+  // Handles are opened lazily and are only accessed while holding the GIL.
+  phmap::flat_hash_map<std::uint32_t, nanobind::object> _handles{};
+  // Whether handles should be opened lazily (see File.__init__() for more details)
+  bool _lazy{false};
+
+ public:
+  explicit MultiResFile(const std::filesystem::path& path, bool lazy = false);
+
+  [[nodiscard]] std::string repr() const;
+  [[nodiscard]] std::filesystem::path path() const;
+  [[nodiscard]] bool is_mcool() const noexcept;
+  [[nodiscard]] bool is_hic() const noexcept;
+  [[nodiscard]] const hictk::Reference& chromosomes() const noexcept;
+  [[nodiscard]] const std::vector<std::uint32_t>& resolutions() const noexcept;
+  [[nodiscard]] nanobind::dict attributes() const;
+
+  // Return the File object for the given resolution, opening it if necessary
+  [[nodiscard]] nanobind::object open(std::uint32_t resolution);
+
+  // Pick the coarsest resolution with at least target_shape bins along each dimension of the
+  // query. When no resolution is suitable, the finest resolution is returned.
+  [[nodiscard]] std::uint32_t select_resolution(
+      std::optional<std::string_view> range1, std::optional<std::string_view> range2,
+      std::optional<std::tuple<std::uint64_t, std::uint64_t>> target_shape,
+      std::string_view query_type) const;
+
+  [[nodiscard]] PixelSelector fetch(std::optional<std::string_view> range1,
+                                    std::optional<std::string_view> range2,
+                                    std::optional<std::string_view> normalization,
+                                    std::string_view count_type, bool join,
+                                    std::string_view query_type,
+                                    std::optional<std::tuple<std::uint64_t, std::uint64_t>>
+                                        target_shape,
+                                    std::optional<std::uint32_t> resolution);
+};
+
+}  // namespace hictkpy
 
 namespace hictkpy::multires_file {
 
@@ -0,0 +1,73 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <BS_thread_pool.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <hictk/bin_table.hpp>
+#include <hictk/pixel.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hictkpy {
+
+// Class to stream interactions from files in 4DN-DCIC pairs format (.pairs).
+// Files can be either uncompressed or compressed with bgzip. When a thread pool is provided,
+// BGZF blocks are decompressed and records are parsed in parallel.
+// Interactions are mapped to bins using the given BinTable, and each record contributes a count of
+// 1 to the pixel it overlaps.
+class PairsReader {
+  std::filesystem::path _path{};
+  std::ifstream _fs{};
+  std::shared_ptr<const hictk::BinTable> _bins{};
+  BS::thread_pool* _tpool{};
+  std::int64_t _offset{};
+  bool _drop_unknown_chroms{};
+  bool _bgzf{};
+  bool _eof{};
+
+  // Text following the last complete line read from the file
+  std::string _partial_line{};
+  std::string _text_buff{};
+
+  std::size_t _num_records{};
+  std::size_t _num_dropped_records{};
+
+ public:
+  PairsReader(std::filesystem::path path, std::shared_ptr<const hictk::BinTable> bins,
+              bool one_based, bool drop_unknown_chroms, BS::thread_pool* tpool = nullptr);
+
+  [[nodiscard]] const std::filesystem::path& path() const noexcept;
+  [[nodiscard]] std::size_t num_records() const noexcept;
+  [[nodiscard]] std::size_t num_dropped_records() const noexcept;
+
+  // Read the next chunk of (unsorted) pixels, replacing the content of buff.
+  // Chunks contain roughly chunk_size pixels (the last chunk may contain fewer pixels).
+  // Returns false once all records have been read.
+  template <typename N>
+  [[nodiscard]] bool next_chunk(std::vector<hictk::ThinPixel<N>>& buff, std::size_t chunk_size);
+
+ private:
+  [[nodiscard]] std::size_t num_threads() const noexcept;
+  [[nodiscard]] bool detect_bgzf();
+
+  // Read the next batch of complete lines into _text_buff
+  [[nodiscard]] bool read_text();
+  [[nodiscard]] bool read_text_plain(std::size_t batch_size);
+  [[nodiscard]] bool read_text_bgzf(std::size_t num_blocks);
+
+  template <typename N>
+  void parse_text(std::vector<hictk::ThinPixel<N>>& buff);
+  template <typename N>
+  [[nodiscard]] std::size_t parse_lines(std::string_view text,
+                                        std::vector<hictk::ThinPixel<N>>& buff) const;
+};
+
+}  // namespace hictkpy
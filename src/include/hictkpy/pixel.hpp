@@ -4,15 +4,27 @@
 
 #pragma once
 
+#include <arrow/array.h>
+#include <arrow/compute/cast.h>
+#include <arrow/record_batch.h>
+#include <arrow/table.h>
+#include <arrow/type.h>
+#include <arrow/type_traits.h>
 #include <fmt/compile.h>
 #include <fmt/format.h>
 
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <hictk/bin_table.hpp>
+#include <hictk/numeric_variant.hpp>
 #include <hictk/pixel.hpp>
+#include <hictk/reference.hpp>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include "hictkpy/nanobind.hpp"
@@ -65,84 +77,286 @@ inline void declare_pixel_class(nanobind::module_ &m, const std::string &suffix)
       });
 }
 
+namespace internal {
+
+[[nodiscard]] inline hictk::internal::NumericVariant map_arrow_type_to_type(
+    const arrow::DataType &type) {
+  switch (type.id()) {
+    case arrow::Type::UINT8:
+      return std::uint8_t{};
+    case arrow::Type::UINT16:
+      return std::uint16_t{};
+    case arrow::Type::UINT32:
+      return std::uint32_t{};
+    case arrow::Type::UINT64:
+      return std::uint64_t{};
+    case arrow::Type::INT8:
+      return std::int8_t{};
+    case arrow::Type::INT16:
+      return std::int16_t{};
+    case arrow::Type::INT32:
+      return std::int32_t{};
+    case arrow::Type::INT64:
+      return std::int64_t{};
+    case arrow::Type::HALF_FLOAT:
+      [[fallthrough]];
+    case arrow::Type::FLOAT:
+      return float{};
+    case arrow::Type::DOUBLE:
+      return double{};
+    default:
+      throw std::runtime_error(
+          fmt::format(FMT_STRING("Unable to map type {} to a numeric type."), type.ToString()));
+  }
+}
+
+// Get the column with the given name, casting it to T when necessary.
+// Casting is a no-op (i.e. no copy is made) when the column already has the requested type.
+template <typename T>
+[[nodiscard]] inline std::shared_ptr<arrow::NumericArray<typename arrow::CTypeTraits<T>::ArrowType>>
+get_numeric_column(const arrow::RecordBatch &batch, const std::string &name,
+                   const arrow::compute::CastOptions &opts = arrow::compute::CastOptions::Safe()) {
+  using ArrayT = arrow::NumericArray<typename arrow::CTypeTraits<T>::ArrowType>;
+
+  auto col = batch.GetColumnByName(name);
+  if (!col) {
+    throw std::runtime_error(fmt::format(FMT_STRING("unable to find column \"{}\""), name));
+  }
+  if (col->null_count() != 0) {
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("column \"{}\" contains {} null value(s)"), name, col->null_count()));
+  }
+
+  const auto type = arrow::CTypeTraits<T>::type_singleton();
+  if (!col->type()->Equals(*type)) {
+    auto res = arrow::compute::Cast(*col, type, opts);
+    if (!res.ok()) {
+      throw std::runtime_error(fmt::format(FMT_STRING("failed to cast column \"{}\" to {}: {}"),
+                                           name, type->ToString(), res.status().message()));
+    }
+    col = res.MoveValueUnsafe();
+  }
+
+  return std::static_pointer_cast<ArrayT>(col);
+}
+
+// Arrow does not have a type corresponding to long double
+template <typename N>
+using arrow_count_t = std::conditional_t<std::is_same_v<N, long double>, double, N>;
+
+template <typename N>
+[[nodiscard]] inline auto get_count_column(const arrow::RecordBatch &batch) {
+  // This is required to mimic the behavior of numpy, which casts integers to floats even when
+  // the conversion is lossy
+  auto opts = arrow::compute::CastOptions::Safe();
+  opts.allow_float_truncate = true;
+  return get_numeric_column<arrow_count_t<N>>(batch, "count", opts);
+}
+
+template <typename StringArrayT>
+inline void map_chrom_names_to_ids(const hictk::Reference &chroms, const StringArrayT &names,
+                                   std::vector<std::uint32_t> &buffer) {
+  // Pixels are usually grouped by chromosome: avoid hashing the chromosome name when possible
+  std::string_view prev_name{};
+  std::uint32_t prev_id{};
+  for (std::int64_t i = 0; i < names.length(); ++i) {
+    const auto name = names.GetView(i);
+    if (i == 0 || name != prev_name) {
+      prev_name = name;
+      prev_id = chroms.at(name).id();
+    }
+    buffer.push_back(prev_id);
+  }
+}
+
+// Map the chromosome names found in the given column to chromosome IDs.
+// When the column is dictionary-encoded (e.g. pandas.Categorical), chromosome names are looked up
+// only once for each dictionary entry.
+[[nodiscard]] inline std::vector<std::uint32_t> map_chrom_names_to_ids(
+    const hictk::Reference &chroms, const std::shared_ptr<arrow::Array> &col) {
+  if (col->null_count() != 0) {
+    throw std::runtime_error(fmt::format(
+        FMT_STRING("chromosome column contains {} null value(s)"), col->null_count()));
+  }
+
+  std::vector<std::uint32_t> buffer{};
+  if (col->length() == 0) {
+    return buffer;
+  }
+  buffer.reserve(static_cast<std::size_t>(col->length()));
+
+  switch (col->type_id()) {
+    case arrow::Type::STRING:
+      map_chrom_names_to_ids(chroms, static_cast<const arrow::StringArray &>(*col), buffer);
+      return buffer;
+    case arrow::Type::LARGE_STRING:
+      map_chrom_names_to_ids(chroms, static_cast<const arrow::LargeStringArray &>(*col), buffer);
+      return buffer;
+    case arrow::Type::STRING_VIEW:
+      map_chrom_names_to_ids(chroms, static_cast<const arrow::StringViewArray &>(*col), buffer);
+      return buffer;
+    case arrow::Type::DICTIONARY: {
+      const auto &dict = static_cast<const arrow::DictionaryArray &>(*col);
+      const auto dict_ids = map_chrom_names_to_ids(chroms, dict.dictionary());
+      for (std::int64_t i = 0; i < dict.length(); ++i) {
+        buffer.push_back(dict_ids[static_cast<std::size_t>(dict.GetValueIndex(i))]);
+      }
+      return buffer;
+    }
+    default:
+      throw std::runtime_error(fmt::format(
+          FMT_STRING("unable to map chromosome column of type {} to chromosomes: column should "
+                     "contain strings or be dictionary-encoded (i.e. categorical)"),
+          col->type()->ToString()));
+  }
+}
+
 template <typename N>
-inline std::vector<hictk::ThinPixel<N>> coo_df_to_thin_pixels(nanobind::object df, bool sorted) {
-  using BufferT1 = nanobind::ndarray<nanobind::numpy, nanobind::shape<-1>, std::uint64_t>;
-  using BufferT2 = nanobind::ndarray<nanobind::numpy, nanobind::shape<-1>, N>;
+inline void sort_pixels(std::vector<hictk::ThinPixel<N>> &pixels) {
+  // Detecting whether pixels are already sorted is much cheaper than sorting them
+  if (!std::is_sorted(pixels.begin(), pixels.end())) {
+    std::sort(pixels.begin(), pixels.end());
+  }
+}
+
+// Sum the counts of pixels sharing the same coordinates. Pixels should be sorted
+template <typename N>
+inline void merge_duplicate_pixels(std::vector<hictk::ThinPixel<N>> &pixels) {
+  if (pixels.empty()) {
+    return;
+  }
+
+  auto dest = pixels.begin();
+  for (auto it = pixels.begin() + 1; it != pixels.end(); ++it) {
+    if (it->bin1_id == dest->bin1_id && it->bin2_id == dest->bin2_id) {
+      dest->count += it->count;
+    } else {
+      *++dest = *it;
+    }
+  }
+  pixels.erase(++dest, pixels.end());
+}
 
-  auto bin1_ids_np = nanobind::cast<BufferT1>(df.attr("__getitem__")("bin1_id").attr("to_numpy")());
-  auto bin2_ids_np = nanobind::cast<BufferT1>(df.attr("__getitem__")("bin2_id").attr("to_numpy")());
-  auto counts_np = nanobind::cast<BufferT2>(df.attr("__getitem__")("count").attr("to_numpy")());
+}  // namespace internal
 
-  const auto bin1_ids = bin1_ids_np.view();
-  const auto bin2_ids = bin2_ids_np.view();
-  const auto counts = counts_np.view();
+// Check whether the given table has columns in COO format (i.e. bin1_id, bin2_id, count)
+[[nodiscard]] inline bool table_is_coo(const arrow::Table &table) {
+  return table.schema()->GetFieldIndex("bin1_id") != -1;
+}
 
-  std::vector<hictk::ThinPixel<N>> buffer(bin1_ids_np.size());
-  for (std::size_t i = 0; i < bin1_ids_np.size(); ++i) {
-    buffer[i] = hictk::ThinPixel<N>{bin1_ids(i), bin2_ids(i), counts(i)};
+[[nodiscard]] inline hictk::internal::NumericVariant infer_count_type(const arrow::Table &table) {
+  const auto field = table.schema()->GetFieldByName("count");
+  if (!field) {
+    throw std::runtime_error("unable to find column \"count\"");
+  }
+  return internal::map_arrow_type_to_type(*field->type());
+}
+
+template <typename N>
+inline std::vector<hictk::ThinPixel<N>> coo_table_to_thin_pixels(const arrow::Table &table,
+                                                                 bool sorted) {
+  std::vector<hictk::ThinPixel<N>> buffer{};
+  buffer.reserve(static_cast<std::size_t>(table.num_rows()));
+
+  arrow::TableBatchReader reader(table);
+  std::shared_ptr<arrow::RecordBatch> batch{};
+  while (true) {
+    const auto status = reader.ReadNext(&batch);
+    if (!status.ok()) {
+      throw std::runtime_error(status.ToString());
+    }
+    if (!batch) {
+      break;
+    }
+
+    const auto bin1_ids = internal::get_numeric_column<std::uint64_t>(*batch, "bin1_id");
+    const auto bin2_ids = internal::get_numeric_column<std::uint64_t>(*batch, "bin2_id");
+    const auto counts = internal::get_count_column<N>(*batch);
+
+    const auto *bin1_ids_ptr = bin1_ids->raw_values();
+    const auto *bin2_ids_ptr = bin2_ids->raw_values();
+    const auto *counts_ptr = counts->raw_values();
+    for (std::int64_t i = 0; i < batch->num_rows(); ++i) {
+      buffer.emplace_back(hictk::ThinPixel<N>{bin1_ids_ptr[i], bin2_ids_ptr[i], counts_ptr[i]});
+    }
   }
 
   if (sorted) {
-    std::sort(buffer.begin(), buffer.end());
+    internal::sort_pixels(buffer);
   }
 
   return buffer;
 }
 
 template <typename N>
-inline std::vector<hictk::ThinPixel<N>> bg2_df_to_thin_pixels(const hictk::BinTable &bin_table,
-                                                              nanobind::object df, bool sorted) {
-  using BufferT1 = nanobind::ndarray<nanobind::numpy, nanobind::shape<-1>, std::uint32_t>;
-  using BufferT2 = nanobind::ndarray<nanobind::numpy, nanobind::shape<-1>, N>;
-
-  auto chrom1 = nanobind::cast<nanobind::list>(df.attr("__getitem__")("chrom1").attr("tolist")());
-  auto start1_np = nanobind::cast<BufferT1>(df.attr("__getitem__")("start1").attr("to_numpy")());
-  auto end1_np = nanobind::cast<BufferT1>(df.attr("__getitem__")("end1").attr("to_numpy")());
-  auto chrom2 = nanobind::cast<nanobind::list>(df.attr("__getitem__")("chrom2").attr("tolist")());
-  auto start2_np = nanobind::cast<BufferT1>(df.attr("__getitem__")("start2").attr("to_numpy")());
-  auto end2_np = nanobind::cast<BufferT1>(df.attr("__getitem__")("end2").attr("to_numpy")());
-  auto counts_np = nanobind::cast<BufferT2>(df.attr("__getitem__")("count").attr("to_numpy")());
-
-  const auto start1 = start1_np.view();
-  const auto end1 = end1_np.view();
-  const auto start2 = start2_np.view();
-  const auto end2 = end2_np.view();
-  const auto counts = counts_np.view();
-
+inline std::vector<hictk::ThinPixel<N>> bg2_table_to_thin_pixels(const hictk::BinTable &bin_table,
+                                                                 const arrow::Table &table,
+                                                                 bool sorted) {
   const auto &reference = bin_table.chromosomes();
-  std::vector<hictk::ThinPixel<N>> buffer(start1_np.size());
-  for (std::size_t i = 0; i < start1_np.size(); ++i) {
-    if (end1(i) < start1(i) || end2(i) < start2(i)) {
-      throw std::runtime_error(fmt::format(
-          FMT_STRING("Found an invalid pixel {} {} {} {} {} {} {}: bin end position cannot be "
-                     "smaller than its start"),
-          nanobind::cast<nanobind::str>(chrom1[i]).c_str(), start1(i), end1(i),
-          nanobind::cast<nanobind::str>(chrom2[i]).c_str(), start2(i), end2(i), counts(i)));
-    }
 
-    auto bin1 =
-        bin_table.at(reference.at(nanobind::cast<nanobind::str>(chrom1[i]).c_str()), start1(i));
-    auto bin2 =
-        bin_table.at(reference.at(nanobind::cast<nanobind::str>(chrom2[i]).c_str()), start2(i));
+  std::vector<hictk::ThinPixel<N>> buffer{};
+  buffer.reserve(static_cast<std::size_t>(table.num_rows()));
 
-    if (bin_table.type() == hictk::BinTable::Type::fixed &&
-        (end1(i) - start1(i) > bin_table.resolution() ||
-         end2(i) - start2(i) > bin_table.resolution())) {
-      throw std::runtime_error(fmt::format(
-          FMT_STRING("Found an invalid pixel {} {} {} {} {} {} {}: pixel spans a "
-                     "distance greater than the bin size"),
-          nanobind::cast<nanobind::str>(chrom1[i]).c_str(), start1(i), end1(i),
-          nanobind::cast<nanobind::str>(chrom2[i]).c_str(), start2(i), end2(i), counts(i)));
+  arrow::TableBatchReader reader(table);
+  std::shared_ptr<arrow::RecordBatch> batch{};
+  while (true) {
+    const auto status = reader.ReadNext(&batch);
+    if (!status.ok()) {
+      throw std::runtime_error(status.ToString());
     }
+    if (!batch) {
+      break;
+    }
+
+    const auto get_chrom_column = [&](const std::string &name) {
+      auto col = batch->GetColumnByName(name);
+      if (!col) {
+        throw std::runtime_error(fmt::format(FMT_STRING("unable to find column \"{}\""), name));
+      }
+      return internal::map_chrom_names_to_ids(reference, col);
+    };
+
+    const auto chrom1_ids = get_chrom_column("chrom1");
+    const auto start1 = internal::get_numeric_column<std::uint32_t>(*batch, "start1");
+    const auto end1 = internal::get_numeric_column<std::uint32_t>(*batch, "end1");
+    const auto chrom2_ids = get_chrom_column("chrom2");
+    const auto start2 = internal::get_numeric_column<std::uint32_t>(*batch, "start2");
+    const auto end2 = internal::get_numeric_column<std::uint32_t>(*batch, "end2");
+    const auto counts = internal::get_count_column<N>(*batch);
+
+    for (std::int64_t i = 0; i < batch->num_rows(); ++i) {
+      const auto chrom1_id = chrom1_ids[static_cast<std::size_t>(i)];
+      const auto chrom2_id = chrom2_ids[static_cast<std::size_t>(i)];
+      const auto start1_ = start1->Value(i);
+      const auto end1_ = end1->Value(i);
+      const auto start2_ = start2->Value(i);
+      const auto end2_ = end2->Value(i);
+      const auto count = counts->Value(i);
 
-    buffer[i] =
-        hictk::Pixel<N>{hictk::PixelCoordinates{std::move(bin1), std::move(bin2)}, counts(i)}
-            .to_thin();
+      if (end1_ < start1_ || end2_ < start2_) {
+        throw std::runtime_error(fmt::format(
+            FMT_STRING("Found an invalid pixel {} {} {} {} {} {} {}: bin end position cannot be "
+                       "smaller than its start"),
+            reference.at(chrom1_id).name(), start1_, end1_, reference.at(chrom2_id).name(),
+            start2_, end2_, count));
+      }
+
+      if (bin_table.type() == hictk::BinTable::Type::fixed &&
+          (end1_ - start1_ > bin_table.resolution() || end2_ - start2_ > bin_table.resolution())) {
+        throw std::runtime_error(fmt::format(
+            FMT_STRING("Found an invalid pixel {} {} {} {} {} {} {}: pixel spans a "
+                       "distance greater than the bin size"),
+            reference.at(chrom1_id).name(), start1_, end1_, reference.at(chrom2_id).name(),
+            start2_, end2_, count));
+      }
+
+      buffer.emplace_back(hictk::ThinPixel<N>{bin_table.at(chrom1_id, start1_).id(),
+                                              bin_table.at(chrom2_id, start2_).id(), count});
+    }
   }
 
   if (sorted) {
-    std::sort(buffer.begin(), buffer.end());
+    internal::sort_pixels(buffer);
   }
 
   return buffer;
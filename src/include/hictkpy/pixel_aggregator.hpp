@@ -11,14 +11,75 @@
 #include <boost/accumulators/statistics.hpp>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
 #include <variant>
+#include <vector>
 
 namespace hictkpy {
 
+namespace internal {
+
+// Central moments of a sample.
+// Moments computed over disjoint shards of the same sample can be merged using the pairwise update
+// formulas from Chan et al. (1979) and Pébay (2008).
+struct CentralMoments {
+  std::size_t count{};
+  double mean{};
+  // sums of the 2nd, 3rd, and 4th powers of the deviations from the mean
+  double m2{};
+  double m3{};
+  double m4{};
+
+  template <typename It>
+  [[nodiscard]] static CentralMoments compute(It first, It last);
+  void merge(const CentralMoments& other) noexcept;
+
+  [[nodiscard]] double variance() const noexcept;
+  [[nodiscard]] double skewness() const noexcept;
+  [[nodiscard]] double kurtosis() const noexcept;
+};
+
+// Compute the central moments of a stream of values using a single pass and constant memory.
+// Values are buffered in small blocks: the moments of each block are computed with the two-pass
+// algorithm and are then merged into the moments of the values seen so far.
+class MomentsAccumulator {
+  std::vector<double> _block{};
+  CentralMoments _moments{};
+
+ public:
+  static constexpr std::size_t block_size{4096};
+
+  MomentsAccumulator();
+
+  template <typename N>
+  void operator()(N n);
+  [[nodiscard]] const CentralMoments& finalize();
+};
+
+// Statistics of a sample of finite values.
+// Values are processed in contiguous blocks: loops processing blocks are written such that
+// compilers can auto-vectorize them (i.e. without branches and using independent accumulators).
+template <typename N>
+struct BlockStats {
+  static constexpr std::size_t block_size{4096};
+  static constexpr std::size_t lanes{8};
+
+  std::size_t count{};
+  N sum{};
+  N min{std::numeric_limits<N>::max()};
+  N max{std::numeric_limits<N>::lowest()};
+  CentralMoments moments{};
+
+  void update(const std::vector<N>& block, bool compute_moments);
+  void merge(const BlockStats& other) noexcept;
+};
+
+}  // namespace internal
+
 struct Stats {
   std::optional<std::int64_t> nnz{};
   std::optional<std::variant<std::int64_t, double>> sum{};
@@ -53,6 +114,8 @@ class PixelAggregator {
   std::variant<Accumulator<std::int64_t>, Accumulator<double>> _accumulator{
       Accumulator<std::int64_t>{}};
   std::optional<KurtosisAccumulator> _kurtosis_accumulator{};
+  // Used to compute variance, skewness, and kurtosis when exact=true
+  std::optional<internal::MomentsAccumulator> _moments_accumulator{};
 
   bool _compute_count{true};
   bool _compute_sum{true};
@@ -78,9 +141,35 @@ class PixelAggregator {
   [[nodiscard]] Stats compute(const PixelSelector& sel,
                               const phmap::flat_hash_set<std::string>& metrics, bool exact);
 
+  // Compute statistics for a query split into num_shards disjoint shards.
+  // visit_shards(fx) should call fx(shard_idx, first, last) once for each shard, where first and
+  // last are pixel iterators. fx can be called concurrently from multiple threads.
+  // Partial statistics are merged in shard order, so that results do not depend on the order in
+  // which shards are visited.
+  // Only supported when non-finite values are either impossible or dropped
+  template <typename N, bool keep_nans, bool keep_infs, typename ShardVisitor>
+  [[nodiscard]] static Stats compute_sharded(std::size_t num_shards, ShardVisitor&& visit_shards,
+                                             const phmap::flat_hash_set<std::string>& metrics);
+
  private:
   static void validate_metrics(const phmap::flat_hash_set<std::string>& metrics);
 
+  // Slow path used when non-finite values should be taken into account
+  template <typename N, bool keep_nans, bool keep_infs, typename PixelSelector>
+  [[nodiscard]] Stats compute_with_non_finite(const PixelSelector& sel,
+                                              const phmap::flat_hash_set<std::string>& metrics,
+                                              bool exact);
+  // Fast path used when all values to be aggregated are guaranteed to be finite
+  template <typename N, bool keep_nans, bool keep_infs, typename It>
+  [[nodiscard]] static Stats compute_finite(It first, It last,
+                                            const phmap::flat_hash_set<std::string>& metrics);
+  template <typename N, bool keep_nans, bool keep_infs, typename It>
+  [[nodiscard]] static internal::BlockStats<N> accumulate_finite(It first, It last,
+                                                                 bool compute_moments);
+  template <typename N>
+  [[nodiscard]] static Stats extract_finite(const internal::BlockStats<N>& block_stats,
+                                            const phmap::flat_hash_set<std::string>& metrics);
+
   template <bool keep_nans, bool keep_infs, typename N>
   void update_finiteness_counters(N n) noexcept;
   template <bool keep_nans, bool keep_infs, bool skip_kurtosis, typename N, typename It,
@@ -99,6 +188,7 @@ class PixelAggregator {
   [[nodiscard]] bool mean_can_be_skipped(Accumulator<N>& accumulator) const;
   template <typename N>
   void disable_redundant_accumulators(Accumulator<N>& accumulator);
+  static void set_exact_moments(const internal::CentralMoments& moments, Stats& stats);
 
   template <bool keep_nans, bool keep_infs, typename N, typename It>
   void process_all_remaining_pixels(Accumulator<N>& accumulator, It&& first, It&& last);
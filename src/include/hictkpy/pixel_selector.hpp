@@ -4,7 +4,9 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <filesystem>
 #include <hictk/bin_table.hpp>
 #include <hictk/cooler/pixel_selector.hpp>
 #include <hictk/hic/pixel_selector.hpp>
@@ -13,30 +15,63 @@
 #include <hictk/transformers/common.hpp>
 #include <hictk/transformers/to_dataframe.hpp>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <tuple>
 #include <variant>
 #include <vector>
 
+#include "hictkpy/band_selector.hpp"
+#include "hictkpy/locking.hpp"
 #include "hictkpy/nanobind.hpp"
 
+namespace arrow {
+class RecordBatchReader;
+}  // namespace arrow
+
 namespace hictkpy {
 
+// Iterator over chunks of pixels returned by PixelSelector::iter_chunks()
+struct PixelChunkIterator {
+  struct Reader;  // defined in pixel_selector.cpp
+  std::shared_ptr<Reader> reader{};
+
+  [[nodiscard]] nanobind::dict next();
+};
+
 struct PixelSelector {
   // clang-format off
   using SelectorVar =
     std::variant<std::shared_ptr<const hictk::cooler::PixelSelector>,
                  std::shared_ptr<const hictk::hic::PixelSelector>,
-                 std::shared_ptr<const hictk::hic::PixelSelectorAll>>;
+                 std::shared_ptr<const hictk::hic::PixelSelectorAll>,
+                 std::shared_ptr<const BandPixelSelector<hictk::cooler::PixelSelector>>,
+                 std::shared_ptr<const BandPixelSelector<hictk::hic::PixelSelector>>>;
   // clang-format on
   using PixelVar = hictk::internal::NumericVariant;
   using QuerySpan = hictk::transformers::QuerySpan;
   using PixelFormat = hictk::transformers::DataFrameFormat;
+  // Transformation applied to interactions while they are being read
+  enum class Transform : std::uint_fast8_t { NONE, OBSERVED_OVER_EXPECTED };
+
+  static constexpr std::size_t default_batch_size{256'000};
 
   SelectorVar selector{};
   PixelVar pixel_count{std::int32_t{0}};
   hictk::transformers::DataFrameFormat pixel_format{hictk::transformers::DataFrameFormat::COO};
+  // Mutex guarding the state shared with other selectors referring to the same file.
+  // See get_hdf5_mutex() and get_hic_file_mutex() for more details.
+  std::shared_ptr<FileMutex> mtx{std::make_shared<FileMutex>()};
+  // Normalized description of the query used to look up results in the query cache (empty for
+  // selectors whose results should not be cached), and path to the file the selector refers to.
+  // See QueryCache for more details.
+  std::string cache_key{};
+  std::filesystem::path cache_path{};
+  // Number of threads used to process genome-wide queries one chromosome pair at a time
+  std::size_t n_threads{1};
+  // Whether bin IDs in the tables returned by to_arrow() and to_df() should be stored as uint32
+  bool narrow_bin_ids{false};
 
   PixelSelector() = default;
 
@@ -46,6 +81,10 @@ struct PixelSelector {
                 bool join);
   PixelSelector(std::shared_ptr<const hictk::hic::PixelSelectorAll> sel_, std::string_view type,
                 bool join);
+  PixelSelector(std::shared_ptr<const BandPixelSelector<hictk::cooler::PixelSelector>> sel_,
+                std::string_view type, bool join);
+  PixelSelector(std::shared_ptr<const BandPixelSelector<hictk::hic::PixelSelector>> sel_,
+                std::string_view type, bool join);
 
   [[nodiscard]] std::string repr() const;
 
@@ -55,12 +94,27 @@ struct PixelSelector {
   [[nodiscard]] auto get_coord2() const -> GenomicCoordTuple;
 
   [[nodiscard]] nanobind::iterator make_iterable() const;
-  [[nodiscard]] nanobind::object to_arrow(std::string_view span) const;
-  [[nodiscard]] nanobind::object to_df(std::string_view span) const;
-  [[nodiscard]] nanobind::object to_pandas(std::string_view span) const;
+  [[nodiscard]] PixelChunkIterator iter_chunks(std::size_t chunk_size) const;
+  [[nodiscard]] nanobind::object to_arrow(
+      std::string_view span, std::optional<std::string_view> transform = {},
+      const std::optional<std::vector<std::string>>& columns = {}) const;
+  [[nodiscard]] nanobind::object to_arrow_stream(std::size_t batch_size) const;
+  [[nodiscard]] nanobind::object arrow_c_stream(const nanobind::any& requested_schema) const;
+  [[nodiscard]] nanobind::object to_df(
+      std::string_view span, const std::optional<std::vector<std::string>>& columns = {}) const;
+  [[nodiscard]] nanobind::object to_pandas(
+      std::string_view span, const std::optional<std::vector<std::string>>& columns = {}) const;
   [[nodiscard]] nanobind::object to_coo(std::string_view span) const;
   [[nodiscard]] nanobind::object to_csr(std::string_view span) const;
   [[nodiscard]] nanobind::object to_numpy(std::string_view span) const;
+  // Write interactions to the given buffer (see PixelSelector.to_numpy() for more details)
+  [[nodiscard]] nanobind::object to_numpy(std::string_view span, const nanobind::object& out,
+                                          std::optional<std::string_view> transform = {}) const;
+
+  // Compute the average number of interactions for each diagonal of a cis query
+  [[nodiscard]] nanobind::object expected() const;
+  // Return interactions using banded storage (see PixelSelector.to_band() for more details)
+  [[nodiscard]] nanobind::object to_band() const;
 
   [[nodiscard]] nanobind::dict describe(const std::vector<std::string>& metrics, bool keep_nans,
                                         bool keep_infs, bool exact) const;
@@ -75,6 +129,13 @@ struct PixelSelector {
 
   [[nodiscard]] static auto parse_span(std::string_view span) -> QuerySpan;
   [[nodiscard]] static auto parse_count_type(std::string_view type) -> PixelVar;
+  // Validate the count_type passed to File.fetch() and related methods
+  static void validate_count_type(std::string_view type);
+  // Normalized interactions cannot be represented with integers: promote integral count types to
+  // "float" when fetching normalized interactions
+  [[nodiscard]] static std::string_view promote_count_type(std::string_view type,
+                                                           bool normalized) noexcept;
+  [[nodiscard]] static auto parse_transform(std::optional<std::string_view> transform) -> Transform;
   [[nodiscard]] static std::string_view count_type_to_str(const PixelVar& var);
 
   static void bind(nanobind::module_& m);
@@ -86,6 +147,18 @@ struct PixelSelector {
 
   [[nodiscard]] const hictk::BinTable& bins() const noexcept;
   // NOLINTEND(bugprone-exception-escape)
+
+  [[nodiscard]] std::shared_ptr<arrow::RecordBatchReader> make_record_batch_reader(
+      std::size_t batch_size) const;
+
+  // Return the key used to cache the result of the given operation (empty if caching is disabled
+  // for the current selector)
+  [[nodiscard]] std::string make_query_cache_key(std::string_view operation,
+                                                 std::string_view params) const;
+
+  // Release the GIL and run fx() while holding the lock on the underlying file
+  template <typename Fx>
+  [[nodiscard]] auto run_without_gil(Fx&& fx) const;
 };
 
 }  // namespace hictkpy
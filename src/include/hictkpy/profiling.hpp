@@ -0,0 +1,110 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "hictkpy/nanobind.hpp"
+
+namespace hictkpy::profiling {
+
+// Opt-in profiler recording how long the stages of PixelSelector operations and FileWriter calls
+// take.
+// Each top-level operation (e.g. PixelSelector.to_arrow()) running while profiling is enabled
+// produces one QueryStats object. Stages and counters are attached to the operation running on the
+// current thread, so that stages can be recorded from functions that know nothing about the
+// operation being profiled (e.g. run_without_gil()).
+// When profiling is disabled, Operation, Stage and add_counter() only cost a relaxed atomic load or
+// a thread_local check.
+
+using Clock = std::chrono::steady_clock;
+
+struct StageEvent {
+  std::string name{};
+  // Time since the profiler epoch in microseconds
+  std::int64_t start_us{};
+  std::int64_t duration_us{};
+};
+
+struct QueryStats {
+  std::string operation{};
+  std::uint64_t thread_id{};
+  std::int64_t start_us{};
+  std::int64_t duration_us{};
+  // Whether the thread starting the operation was holding the GIL
+  bool started_with_gil{};
+  // Stages in the order they were exited
+  std::vector<StageEvent> stages{};
+  std::vector<std::pair<std::string, std::int64_t>> counters{};
+
+  // Total time spent in the given stage (0 if the stage was never entered)
+  [[nodiscard]] std::int64_t stage_duration_us(std::string_view name) const noexcept;
+  // Time spent holding the GIL. This is computed from the time spent in stage "gil_released" for
+  // operations started while holding the GIL, and from the time spent in stage "gil_acquired"
+  // otherwise
+  [[nodiscard]] std::int64_t gil_held_us() const noexcept;
+
+  [[nodiscard]] std::string repr() const;
+  // Map stage names to the total time spent in each stage in seconds (including "gil_held")
+  [[nodiscard]] nanobind::dict stages_to_dict() const;
+  [[nodiscard]] nanobind::dict counters_to_dict() const;
+  [[nodiscard]] nanobind::dict to_dict() const;
+};
+
+[[nodiscard]] bool is_enabled() noexcept;
+// Start recording queries. Only the most recent max_queries queries are kept
+void enable(std::size_t max_queries);
+void disable() noexcept;
+// Discard all queries recorded so far and reset the profiler epoch
+void reset();
+
+[[nodiscard]] std::vector<QueryStats> get_queries();
+
+// RAII object profiling a top-level operation.
+// Operations nested inside another operation running on the same thread (e.g. to_arrow() called by
+// to_pandas()) are not recorded separately.
+class Operation {
+  std::unique_ptr<QueryStats> _stats{};
+  Clock::time_point _start{};
+
+ public:
+  explicit Operation(std::string_view name);
+  Operation(const Operation& other) = delete;
+  Operation(Operation&& other) noexcept = delete;
+  ~Operation() noexcept;
+
+  Operation& operator=(const Operation& other) = delete;
+  Operation& operator=(Operation&& other) noexcept = delete;
+};
+
+// RAII object profiling a stage of the operation running on the current thread (if any)
+class Stage {
+  QueryStats* _stats{};
+  std::string_view _name{};
+  Clock::time_point _start{};
+
+ public:
+  explicit Stage(std::string_view name) noexcept;
+  Stage(const Stage& other) = delete;
+  Stage(Stage&& other) noexcept = delete;
+  ~Stage() noexcept;
+
+  Stage& operator=(const Stage& other) = delete;
+  Stage& operator=(Stage&& other) noexcept = delete;
+};
+
+// Increment the given counter of the operation running on the current thread (if any)
+void add_counter(std::string_view name, std::int64_t value) noexcept;
+
+void declare_profiling_module(nanobind::module_& m);
+
+}  // namespace hictkpy::profiling
@@ -0,0 +1,182 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <parallel_hashmap/phmap.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <hictk/file.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace arrow {
+class Table;
+}  // namespace arrow
+
+namespace hictkpy {
+
+// Byte-bounded LRU cache mapping normalized queries to their results.
+// Keys are built from the file URI and resolution, the parsed query ranges, the normalization, the
+// count type, and the parameters of the method producing the result (e.g. the query span passed to
+// PixelSelector.to_numpy()). As such, queries like "chr1:0-1,000,000" and "chr1:0-1000000" share
+// the same cache entries.
+// The cache is shared by all File objects and is disabled by default (see
+// CacheConfig::query_cache_bytes). Entries are invalidated as soon as the modification time of the
+// file they were read from changes.
+// Dense matrices can be compressed and can be spilled to disk when they are evicted from memory.
+// Arrow tables are stored as they are, so that cache hits can be served without copying any data.
+class QueryCache {
+ public:
+  // Raw bytes of a row-major dense matrix (compressed with DEFLATE when compressed=true)
+  struct DenseMatrix {
+    std::int64_t num_rows{};
+    std::int64_t num_cols{};
+    std::size_t uncompressed_bytes{};
+    bool compressed{false};
+    std::vector<std::uint8_t> data{};
+  };
+
+  // arrow::Table objects are immutable, so the same table can be handed out multiple times
+  using Table = std::shared_ptr<arrow::Table>;
+  using Value = std::variant<Table, std::shared_ptr<const DenseMatrix>>;
+
+  struct Settings {
+    // Capacity of the in-memory cache (0 = caching is disabled)
+    std::size_t capacity_bytes{0};
+    // Level used to compress dense matrices (0 = no compression, 12 = maximum compression)
+    int compression_level{0};
+    // Folder where dense matrices evicted from memory are written (empty = do not spill to disk)
+    std::filesystem::path spill_dir{};
+    std::size_t spill_capacity_bytes{0};
+  };
+
+  struct Stats {
+    std::size_t hits{};
+    std::size_t misses{};
+    std::size_t evictions{};
+    std::size_t invalidations{};
+    std::size_t spill_hits{};
+  };
+
+  static constexpr int max_compression_level{12};
+
+ private:
+  struct Entry {
+    std::string key{};
+    std::filesystem::file_time_type mtime{};
+    Value value{};
+    std::size_t size_bytes{};
+  };
+
+  // Dense matrix evicted from memory and written to disk. matrix.data is always empty.
+  // unwritten points to the evicted matrix until it has been written to disk: entries can be served
+  // from memory until then
+  struct SpilledEntry {
+    std::string key{};
+    std::filesystem::file_time_type mtime{};
+    std::filesystem::path path{};
+    DenseMatrix matrix{};
+    std::size_t size_bytes{};
+    std::shared_ptr<const DenseMatrix> unwritten{};
+  };
+
+  struct PendingWrite {
+    std::string key{};
+    std::filesystem::path path{};
+    std::shared_ptr<const DenseMatrix> matrix{};
+  };
+
+  mutable std::mutex _mtx{};
+  Settings _settings{};
+  std::list<Entry> _entries{};  // most recently used entries come first
+  phmap::flat_hash_map<std::string, std::list<Entry>::iterator> _index{};
+  std::size_t _size_bytes{};
+  std::list<SpilledEntry> _spilled_entries{};  // most recently spilled entries come first
+  phmap::flat_hash_map<std::string, std::list<SpilledEntry>::iterator> _spill_index{};
+  std::size_t _spilled_bytes{};
+  // Disk I/O is queued while holding _mtx and carried out by process_pending_io() once released
+  std::vector<PendingWrite> _pending_writes{};
+  std::vector<std::filesystem::path> _pending_removals{};
+  // Used to generate file names that are unique across processes sharing the same spill_dir
+  std::uint64_t _session_id{};
+  std::uint64_t _spill_counter{};
+  Stats _stats{};
+
+ public:
+  QueryCache();
+  QueryCache(const QueryCache& other) = delete;
+  QueryCache(QueryCache&& other) noexcept = delete;
+  ~QueryCache() noexcept;
+
+  QueryCache& operator=(const QueryCache& other) = delete;
+  QueryCache& operator=(QueryCache&& other) noexcept = delete;
+
+  [[nodiscard]] bool enabled() const noexcept;
+
+  // Look up the result for the given key. path should point to the file the result was read from
+  [[nodiscard]] std::optional<Value> get(const std::string& key, const std::filesystem::path& path);
+  void put(std::string key, const std::filesystem::path& path, Value value);
+
+  // Copy (and possibly compress) the given row-major matrix using the current compression level.
+  // This does not require holding the GIL
+  [[nodiscard]] std::shared_ptr<const DenseMatrix> encode(const void* data, std::size_t size_bytes,
+                                                          std::int64_t num_rows,
+                                                          std::int64_t num_cols) const;
+  // Write the content of matrix to the given buffer, which should be matrix.uncompressed_bytes
+  // long
+  static void decode(const DenseMatrix& matrix, void* buffer);
+
+  [[nodiscard]] std::size_t size() const noexcept;
+  [[nodiscard]] std::size_t size_bytes() const noexcept;
+  [[nodiscard]] std::size_t capacity_bytes() const noexcept;
+  [[nodiscard]] std::size_t num_spilled_entries() const noexcept;
+  [[nodiscard]] std::size_t spilled_bytes() const noexcept;
+  [[nodiscard]] Stats stats() const noexcept;
+
+  // Apply the given settings, evicting entries as needed. Setting capacity_bytes to 0 clears the
+  // cache
+  void set_settings(Settings settings);
+  void clear();
+  // Drop all entries referring to the file with the given URI
+  void erase(const hictk::File& f);
+
+  [[nodiscard]] static std::string make_key_prefix(const hictk::File& f);
+
+ private:
+  [[nodiscard]] static std::optional<std::filesystem::file_time_type> get_mtime(
+      const std::filesystem::path& path) noexcept;
+  [[nodiscard]] static std::size_t compute_size_bytes(const std::string& key, const Value& value);
+
+  // Read the matrix of an entry returned by take_spilled_entry() and delete its file
+  [[nodiscard]] static std::optional<Value> load_spilled_entry(const SpilledEntry& entry);
+  [[nodiscard]] static bool write_spilled_matrix(const std::filesystem::path& path,
+                                                 const DenseMatrix& matrix);
+
+  // The following methods should be called while holding _mtx
+  void insert(Entry entry);
+  // Remove the spilled entry matching the given key from the index and return it. The caller is
+  // responsible for deleting the corresponding file (see load_spilled_entry())
+  [[nodiscard]] std::optional<SpilledEntry> take_spilled_entry(
+      const std::string& key, std::filesystem::file_time_type mtime);
+  void evict_lru();
+  void spill(Entry& entry);
+  void erase_entry(std::list<Entry>::iterator it);
+  void erase_spilled_entry(std::list<SpilledEntry>::iterator it);
+  void clear_spilled_entries();
+
+  // Carry out the I/O queued by the methods above. This should be called without holding _mtx
+  void process_pending_io();
+};
+
+[[nodiscard]] QueryCache& get_query_cache();
+
+}  // namespace hictkpy
@@ -0,0 +1,47 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <hictk/balancing/methods.hpp>
+#include <hictk/file.hpp>
+#include <hictk/genomic_interval.hpp>
+#include <vector>
+
+namespace hictkpy {
+
+// Square window of interactions centered on a pair of anchors.
+// The window spans width bins starting from bin row0 of chrom1 and bin col0 of chrom2, where bin
+// offsets are relative to the first bin of each chromosome. Offsets can be negative or extend past
+// the end of the chromosomes, in which case the corresponding rows/columns are filled with NaNs.
+struct SnippetWindow {
+  std::uint32_t chrom1_id{};
+  std::uint32_t chrom2_id{};
+  std::int64_t row0{};
+  std::int64_t col0{};
+};
+
+// Build windows of 2 * flank_bins + 1 bins centered on the bins overlapping the midpoint of the
+// given anchors. anchors1 and anchors2 should have the same size
+[[nodiscard]] std::vector<SnippetWindow> make_snippet_windows(
+    const hictk::File& f, const std::vector<hictk::GenomicInterval>& anchors1,
+    const std::vector<hictk::GenomicInterval>& anchors2, std::uint64_t flank_bins);
+
+// Fetch the interactions overlapping the given windows.
+// Return a row-major stack of windows.size() matrices of width x width pixels or, when pileup=true,
+// a single width x width matrix with the average of the (finite) values of all windows.
+// Windows are sorted and grouped into clusters of nearby windows, so that the interactions shared
+// by overlapping windows are read and decoded only once.
+// Interactions from .hic files are read using up to n_threads threads, while interactions from
+// Cooler files are always read sequentially.
+// This should be called without holding the GIL
+[[nodiscard]] std::vector<double> fetch_snippets(const hictk::File& f,
+                                                 const std::vector<SnippetWindow>& windows,
+                                                 std::uint64_t width,
+                                                 const hictk::balancing::Method& normalization,
+                                                 bool pileup, std::size_t n_threads);
+
+}  // namespace hictkpy
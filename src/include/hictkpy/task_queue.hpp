@@ -0,0 +1,70 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace hictkpy {
+
+// Queue of tasks executed in order by a single background thread.
+// The amount of memory held by queued tasks is bounded: submit() blocks until enough capacity is
+// available. Exceptions thrown by tasks are captured and re-thrown by the next call to submit() or
+// wait(); once a task has failed, all remaining tasks are discarded.
+// Threads calling submit() or wait() should not hold the GIL, as tasks may need to acquire it
+// (e.g. to log messages).
+class BoundedTaskQueue {
+ public:
+  using Task = std::function<void()>;
+
+ private:
+  struct QueuedTask {
+    Task task{};
+    std::size_t size{};
+  };
+
+  std::size_t _capacity{};
+  std::size_t _pending_bytes{};
+  std::deque<QueuedTask> _tasks{};
+  std::exception_ptr _exception{};
+  bool _busy{false};
+  bool _stop{false};
+
+  mutable std::mutex _mtx{};
+  std::condition_variable _task_done_cv{};
+  std::condition_variable _task_queued_cv{};
+  std::thread _worker{};
+
+ public:
+  explicit BoundedTaskQueue(std::size_t capacity_bytes);
+  BoundedTaskQueue(const BoundedTaskQueue&) = delete;
+  BoundedTaskQueue(BoundedTaskQueue&&) noexcept = delete;
+  // Pending tasks are discarded
+  ~BoundedTaskQueue() noexcept;
+
+  BoundedTaskQueue& operator=(const BoundedTaskQueue&) = delete;
+  BoundedTaskQueue& operator=(BoundedTaskQueue&&) noexcept = delete;
+
+  [[nodiscard]] std::size_t capacity() const noexcept;
+  [[nodiscard]] std::size_t pending_bytes() const;
+
+  // Enqueue a task holding size_bytes bytes of memory.
+  // Tasks larger than the queue capacity are accepted once the queue is empty.
+  void submit(Task task, std::size_t size_bytes);
+  // Wait for all queued tasks to be processed
+  void wait();
+
+ private:
+  void run();
+  void rethrow_exception_unlocked();
+};
+
+}  // namespace hictkpy
@@ -9,6 +9,7 @@
 #include "hictkpy/nanobind.hpp"
 
 namespace arrow {
+class RecordBatchReader;
 class Table;
 
 }  // namespace arrow
@@ -17,4 +18,19 @@ namespace hictkpy {
 
 [[nodiscard]] nanobind::object export_pyarrow_table(std::shared_ptr<arrow::Table> arrow_table);
 
+// Export the given reader as a PyCapsule wrapping an ArrowArrayStream.
+// The returned object is suitable for implementing the __arrow_c_stream__ protocol.
+// When owner is provided, the exported stream holds a reference to it until the stream is released
+// by its consumer. This should be used when the reader accesses resources owned by a Python object.
+[[nodiscard]] nanobind::object export_arrow_c_stream(
+    std::shared_ptr<arrow::RecordBatchReader> reader, nanobind::object owner = nanobind::none());
+// Export the given reader as a pyarrow.RecordBatchReader (see export_arrow_c_stream())
+[[nodiscard]] nanobind::object export_pyarrow_record_batch_reader(
+    std::shared_ptr<arrow::RecordBatchReader> reader, nanobind::object owner = nanobind::none());
+
+// Import any object that can be converted to a pyarrow.Table as an arrow::Table.
+// This includes pandas.DataFrame, pyarrow.Table, pyarrow.RecordBatch and objects implementing the
+// __arrow_c_stream__ protocol.
+[[nodiscard]] std::shared_ptr<arrow::Table> import_pyarrow_table(const nanobind::object& df);
+
 }  // namespace hictkpy
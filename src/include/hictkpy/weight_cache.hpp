@@ -0,0 +1,85 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <parallel_hashmap/phmap.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <hictk/balancing/weights.hpp>
+#include <hictk/file.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace hictkpy {
+
+// Byte-bounded LRU cache mapping (file, normalization, weight type) to the genome-wide vector of
+// balancing weights.
+// Files are identified by their URI, resolution, and (for .hic files) matrix type and unit.
+// The cache is shared by all File objects: opening the same file multiple times does not require
+// reading and decoding the same weights over and over again. Entries are invalidated as soon as the
+// modification time of the file they were read from changes.
+class WeightCache {
+ public:
+  using Value = std::shared_ptr<const std::vector<double>>;
+
+  struct Stats {
+    std::size_t hits{};
+    std::size_t misses{};
+    std::size_t evictions{};
+    std::size_t invalidations{};
+  };
+
+ private:
+  struct Entry {
+    std::string key{};
+    std::filesystem::file_time_type mtime{};
+    Value weights{};
+  };
+
+  mutable std::mutex _mtx{};
+  std::list<Entry> _entries{};  // most recently used entries come first
+  phmap::flat_hash_map<std::string, std::list<Entry>::iterator> _index{};
+  std::size_t _size_bytes{};
+  std::size_t _capacity_bytes{};
+  Stats _stats{};
+
+ public:
+  static constexpr std::size_t default_capacity_bytes{128ULL << 20U};
+
+  explicit WeightCache(std::size_t capacity_bytes = default_capacity_bytes);
+
+  // Return the weights for the given normalization, reading them from f in case of cache misses.
+  // Reading from f happens while holding the file lock.
+  [[nodiscard]] Value get(const hictk::File& f, std::string_view normalization,
+                          hictk::balancing::Weights::Type type);
+
+  [[nodiscard]] std::size_t size() const noexcept;
+  [[nodiscard]] std::size_t size_bytes() const noexcept;
+  [[nodiscard]] std::size_t capacity_bytes() const noexcept;
+  [[nodiscard]] Stats stats() const noexcept;
+
+  void set_capacity_bytes(std::size_t capacity_bytes);
+  void clear() noexcept;
+  // Drop all entries referring to the file with the given URI
+  void erase(const hictk::File& f);
+
+ private:
+  [[nodiscard]] static std::string make_key(const hictk::File& f, std::string_view normalization,
+                                            hictk::balancing::Weights::Type type);
+  [[nodiscard]] static std::string make_key_prefix(const hictk::File& f);
+  [[nodiscard]] static std::size_t entry_size_bytes(const Entry& entry) noexcept;
+  void evict_lru();
+};
+
+[[nodiscard]] WeightCache& get_weight_cache();
+
+}  // namespace hictkpy
@@ -0,0 +1,32 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <hictk/file.hpp>
+#include <optional>
+#include <vector>
+
+#include "hictkpy/multires_file.hpp"
+#include "hictkpy/nanobind.hpp"
+
+namespace hictkpy::zoomify {
+
+// Create a multi-resolution file (.mcool or .hic, depending on the extension of dest) with
+// interactions from src, coarsened to the given resolutions (see hictkpy.zoomify() for more
+// details). This should be called without holding the GIL
+[[nodiscard]] hictkpy::MultiResFile zoomify(const hictk::File& src,
+                                            const std::filesystem::path& dest,
+                                            std::vector<std::uint32_t> resolutions, bool overwrite,
+                                            std::size_t n_threads, std::size_t chunk_size,
+                                            const std::filesystem::path& tmpdir,
+                                            std::optional<std::uint32_t> compression_lvl,
+                                            bool skip_all_vs_all_matrix);
+
+void declare_zoomify_function(nanobind::module_& m);
+
+}  // namespace hictkpy::zoomify
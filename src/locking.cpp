@@ -0,0 +1,70 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#include "hictkpy/locking.hpp"
+
+#include <parallel_hashmap/phmap.h>
+
+#include <hictk/bin_table.hpp>
+#include <hictk/cooler/cooler.hpp>
+#include <hictk/file.hpp>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace hictkpy {
+
+std::shared_ptr<FileMutex> get_hdf5_mutex() {
+  static const auto mtx = std::make_shared<FileMutex>();
+  return mtx;
+}
+
+std::shared_ptr<FileMutex> get_hic_file_mutex(const std::shared_ptr<const hictk::BinTable>& bins) {
+  if (!bins) {
+    // selectors without a BinTable are empty and do not share state with any other selector
+    return std::make_shared<FileMutex>();
+  }
+
+  struct Entry {
+    std::weak_ptr<const hictk::BinTable> key{};
+    std::shared_ptr<FileMutex> mtx{};
+  };
+
+  static std::mutex registry_mtx{};
+  static phmap::flat_hash_map<const hictk::BinTable*, Entry> registry{};
+
+  [[maybe_unused]] const auto lck = std::scoped_lock(registry_mtx);
+
+  // Purge entries referring to files that have been closed
+  phmap::erase_if(registry, [](const auto& kv) { return kv.second.key.expired(); });
+
+  auto [it, inserted] = registry.try_emplace(bins.get(), Entry{bins, nullptr});
+  if (inserted) {
+    it->second.mtx = std::make_shared<FileMutex>();
+  }
+
+  return it->second.mtx;
+}
+
+std::shared_ptr<FileMutex> get_file_mutex(const hictk::File& f) {
+  if (f.is_cooler()) {
+    return get_hdf5_mutex();
+  }
+  return get_hic_file_mutex(f.bins_ptr());
+}
+
+FileHandle::FileHandle(hictk::File f) : hictk::File(std::move(f)) {}
+
+FileHandle::~FileHandle() noexcept {
+  if (!is_cooler()) {
+    return;
+  }
+  try {
+    [[maybe_unused]] const auto lck = lock_file(*get_hdf5_mutex());
+    get<hictk::cooler::File>().close();
+  } catch (...) {  // NOLINT
+  }
+}
+
+}  // namespace hictkpy
@@ -6,29 +6,59 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <hictk/cooler/multires_cooler.hpp>
 #include <hictk/cooler/validation.hpp>
+#include <hictk/genomic_interval.hpp>
+#include <hictk/hic.hpp>
 #include <hictk/multires_file.hpp>
+#include <hictk/reference.hpp>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <vector>
 
+#include "hictkpy/file.hpp"
 #include "hictkpy/nanobind.hpp"
+#include "hictkpy/pixel_selector.hpp"
+#include "hictkpy/profiling.hpp"
 #include "hictkpy/reference.hpp"
 
 namespace nb = nanobind;
 
-namespace hictkpy::multires_file {
+namespace hictkpy {
 
-static void ctor(hictk::MultiResFile* fp, const std::filesystem::path& path) {
-  new (fp) hictk::MultiResFile{path.string()};
+[[nodiscard]] static hictk::MultiResFile open_multires_file(const std::filesystem::path& path) {
+  [[maybe_unused]] const profiling::Operation op{"MultiResFile.__init__"};
+  file::ensure_local_uri(path);
+  [[maybe_unused]] const profiling::Stage stage{"open"};
+  return hictk::MultiResFile{path.string()};
 }
 
-static std::string repr(const hictk::MultiResFile& mrf) {
-  return fmt::format(FMT_STRING("MultiResFile({})"), mrf.path());
+MultiResFile::MultiResFile(const std::filesystem::path& path, bool lazy)
+    : _mrf(open_multires_file(path)), _lazy(lazy) {}
+
+std::string MultiResFile::repr() const {
+  return fmt::format(FMT_STRING("MultiResFile({})"), _mrf.path());
 }
 
-static std::filesystem::path get_path(const hictk::MultiResFile& mrf) { return mrf.path(); }
+std::filesystem::path MultiResFile::path() const { return _mrf.path(); }
+
+bool MultiResFile::is_mcool() const noexcept { return _mrf.is_mcool(); }
 
-[[nodiscard]] static auto get_resolutions(const hictk::MultiResFile& f) {
+bool MultiResFile::is_hic() const noexcept { return _mrf.is_hic(); }
+
+const hictk::Reference& MultiResFile::chromosomes() const noexcept { return _mrf.chromosomes(); }
+
+const std::vector<std::uint32_t>& MultiResFile::resolutions() const noexcept {
+  return _mrf.resolutions();
+}
+
+[[nodiscard]] static auto get_resolutions(const MultiResFile& f) {
   using WeightVector = nb::ndarray<nb::numpy, nb::shape<-1>, nb::c_contig, std::uint32_t>;
 
   // NOLINTNEXTLINE
@@ -70,40 +100,173 @@ static nb::dict get_attrs(const hictk::cooler::MultiResFile& mclr) {
   return py_attrs;
 }
 
-static nb::dict attributes(const hictk::MultiResFile& f) {
-  auto attrs = f.is_hic() ? get_attrs(f.open(f.resolutions().front()).get<hictk::hic::File>())
-                          : get_attrs(hictk::cooler::MultiResFile{f.path()});
-  attrs["resolutions"] = get_resolutions(f);
+nb::dict MultiResFile::attributes() const {
+  // Reading the attributes of .hic files does not require sizing the block cache (which involves
+  // reading the block index of the longest chromosome): open the file with a minimal block cache
+  auto attrs = _mrf.is_hic()
+                   ? get_attrs(hictk::hic::File{_mrf.path(), _mrf.resolutions().front(),
+                                                _mrf.matrix_type(), _mrf.matrix_unit(), 1})
+                   : get_attrs(hictk::cooler::MultiResFile{_mrf.path()});
+  attrs["resolutions"] = get_resolutions(*this);
 
   return attrs;
 }
 
+nb::object MultiResFile::open(std::uint32_t resolution) {
+  if (auto match = _handles.find(resolution); match != _handles.end()) {
+    return match->second;
+  }
+
+  const auto& resolutions = _mrf.resolutions();
+  if (std::find(resolutions.begin(), resolutions.end(), resolution) == resolutions.end()) {
+    throw std::runtime_error(fmt::format(FMT_STRING("file \"{}\" does not have resolution {}"),
+                                         _mrf.path(), resolution));
+  }
+
+  auto f = [&]() {
+    [[maybe_unused]] const nb::gil_scoped_release release{};
+    return file::open(_mrf.path(), resolution, _mrf.matrix_type(), _mrf.matrix_unit(), {},
+                      _lazy);
+  }();
+
+  auto handle = nb::cast(std::move(f), nb::rv_policy::move);
+  _handles.emplace(resolution, handle);
+  return handle;
+}
+
+// Compute the number of bins overlapping the given range at the given resolution.
+// When no range is given, the number of bins for the entire genome is returned.
+[[nodiscard]] static std::uint64_t compute_num_bins(const hictk::Reference& chroms,
+                                                    const std::optional<hictk::GenomicInterval>& gi,
+                                                    std::uint32_t resolution) {
+  const auto div_ceil = [](std::uint64_t n, std::uint64_t d) { return (n + d - 1) / d; };
+
+  if (!gi.has_value()) {
+    std::uint64_t num_bins = 0;
+    for (const auto& chrom : chroms) {
+      if (!chrom.is_all()) {
+        num_bins += div_ceil(chrom.size(), resolution);
+      }
+    }
+    return num_bins;
+  }
+
+  return div_ceil(gi->end(), resolution) - (gi->start() / resolution);
+}
+
+std::uint32_t MultiResFile::select_resolution(
+    std::optional<std::string_view> range1, std::optional<std::string_view> range2,
+    std::optional<std::tuple<std::uint64_t, std::uint64_t>> target_shape,
+    std::string_view query_type) const {
+  auto resolutions = _mrf.resolutions();
+  if (resolutions.empty()) {
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("file \"{}\" does not contain any resolution"), _mrf.path()));
+  }
+  std::sort(resolutions.begin(), resolutions.end());
+
+  if (!target_shape.has_value()) {
+    return resolutions.front();
+  }
+
+  if (query_type != "UCSC" && query_type != "BED") {
+    throw std::runtime_error("query_type should be either UCSC or BED");
+  }
+
+  const auto query_type_ =
+      query_type == "UCSC" ? hictk::GenomicInterval::Type::UCSC : hictk::GenomicInterval::Type::BED;
+
+  std::optional<hictk::GenomicInterval> gi1{};
+  std::optional<hictk::GenomicInterval> gi2{};
+  if (range1.has_value() && !range1->empty()) {
+    if (!range2.has_value() || range2->empty()) {
+      range2 = range1;
+    }
+    gi1 = hictk::GenomicInterval::parse(_mrf.chromosomes(), std::string{*range1}, query_type_);
+    gi2 = hictk::GenomicInterval::parse(_mrf.chromosomes(), std::string{*range2}, query_type_);
+  }
+
+  const auto [num_rows, num_cols] = *target_shape;
+  const auto it = std::find_if(resolutions.rbegin(), resolutions.rend(), [&](const auto res) {
+    return compute_num_bins(_mrf.chromosomes(), gi1, res) >= num_rows &&
+           compute_num_bins(_mrf.chromosomes(), gi2, res) >= num_cols;
+  });
+
+  return it == resolutions.rend() ? resolutions.front() : *it;
+}
+
+PixelSelector MultiResFile::fetch(
+    std::optional<std::string_view> range1, std::optional<std::string_view> range2,
+    std::optional<std::string_view> normalization, std::string_view count_type, bool join,
+    std::string_view query_type,
+    std::optional<std::tuple<std::uint64_t, std::uint64_t>> target_shape,
+    std::optional<std::uint32_t> resolution) {
+  if (resolution.has_value() && target_shape.has_value()) {
+    throw std::runtime_error("resolution and target_shape are mutually exclusive");
+  }
+
+  const auto resolution_ = resolution.has_value()
+                               ? *resolution
+                               : select_resolution(range1, range2, target_shape, query_type);
+
+  const auto handle = open(resolution_);
+  const auto& f = nb::cast<const hictk::File&>(handle);
+
+  [[maybe_unused]] const nb::gil_scoped_release release{};
+  return file::fetch(f, range1, range2, normalization, count_type, join, query_type);
+}
+
+}  // namespace hictkpy
+
+namespace hictkpy::multires_file {
+
 bool is_mcool_file(const std::filesystem::path& path) {
   return bool(hictk::cooler::utils::is_multires_file(path.string()));
 }
 
 void declare_multires_file_class(nb::module_& m) {
-  auto mres_file = nb::class_<hictk::MultiResFile>(
+  auto mres_file = nb::class_<MultiResFile>(
       m, "MultiResFile", "Class representing a file handle to a .hic or .mcool file");
-  mres_file.def("__init__", &multires_file::ctor, nb::arg("path"),
-                "Open a multi-resolution Cooler file (.mcool) or .hic file.");
+  mres_file.def(nb::init<const std::filesystem::path&, bool>(), nb::arg("path"),
+                nb::arg("lazy") = false,
+                "Open a multi-resolution Cooler file (.mcool) or .hic file.\n"
+                "lazy is forwarded to the File objects opened for each resolution (see "
+                "File.__init__() for more details).");
 
-  mres_file.def("__repr__", &multires_file::repr, nb::rv_policy::move);
+  mres_file.def("__repr__", &MultiResFile::repr, nb::rv_policy::move);
 
-  mres_file.def("path", &multires_file::get_path, "Get the file path.", nb::rv_policy::move);
-  mres_file.def("is_mcool", &hictk::MultiResFile::is_mcool,
-                "Test whether the file is in .mcool format.");
-  mres_file.def("is_hic", &hictk::MultiResFile::is_hic, "Test whether the file is in .hic format.");
-  mres_file.def("chromosomes", &get_chromosomes_from_object<hictk::MultiResFile>,
+  mres_file.def("path", &MultiResFile::path, "Get the file path.", nb::rv_policy::move);
+  mres_file.def("is_mcool", &MultiResFile::is_mcool, "Test whether the file is in .mcool format.");
+  mres_file.def("is_hic", &MultiResFile::is_hic, "Test whether the file is in .hic format.");
+  mres_file.def("chromosomes", &get_chromosomes_from_object<MultiResFile>,
                 nb::arg("include_ALL") = false,
                 "Get chromosomes sizes as a dictionary mapping names to sizes.",
                 nb::rv_policy::take_ownership);
   mres_file.def("resolutions", &get_resolutions, "Get the list of available resolutions.",
                 nb::rv_policy::take_ownership);
-  mres_file.def("attributes", &multires_file::attributes, "Get file attributes as a dictionary.",
+  mres_file.def("attributes", &MultiResFile::attributes, "Get file attributes as a dictionary.",
                 nb::rv_policy::take_ownership);
-  mres_file.def("__getitem__", &hictk::MultiResFile::open,
-                "Open the Cooler or .hic file corresponding to the resolution given as input.",
+  mres_file.def("__getitem__", &MultiResFile::open, nb::arg("resolution"),
+                "Open the Cooler or .hic file corresponding to the resolution given as input.\n"
+                "File objects are opened lazily and are cached: accessing the same resolution "
+                "multiple times returns the same File object.",
+                nb::sig("def __getitem__(self, resolution: int) -> hictkpy.File"));
+  mres_file.def("fetch", &MultiResFile::fetch, nb::keep_alive<0, 1>(),
+                nb::arg("range1") = nb::none(), nb::arg("range2") = nb::none(),
+                nb::arg("normalization") = nb::none(), nb::arg("count_type") = "int",
+                nb::arg("join") = false, nb::arg("query_type") = "UCSC",
+                nb::arg("target_shape") = nb::none(), nb::arg("resolution") = nb::none(),
+                "Fetch interactions overlapping a region of interest.\n"
+                "When target_shape=(rows, cols) is provided, interactions are fetched from the "
+                "coarsest resolution with at least rows and cols bins along the first and second "
+                "dimension of the query, respectively (falling back to the finest resolution when "
+                "no resolution is suitable). When neither target_shape nor resolution are "
+                "provided, interactions are fetched from the finest resolution.\n"
+                "See File.fetch() for more details.",
+                nb::sig("def fetch(self, range1: str | None = None, range2: str | None = None, "
+                        "normalization: str | None = None, count_type: str = 'int', join: bool = "
+                        "False, query_type: str = 'UCSC', target_shape: tuple[int, int] | None = "
+                        "None, resolution: int | None = None) -> hictkpy.PixelSelector"),
                 nb::rv_policy::move);
 }
 
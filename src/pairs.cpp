@@ -0,0 +1,421 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#include "hictkpy/pairs.hpp"
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+#include <libdeflate.h>
+
+#include <BS_thread_pool.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <hictk/bin_table.hpp>
+#include <hictk/numeric_utils.hpp>
+#include <hictk/pixel.hpp>
+#include <ios>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace hictkpy {
+
+// NOLINTBEGIN(*-avoid-magic-numbers)
+// Amount of (uncompressed) text processed by each thread when reading plain-text files
+static constexpr std::size_t plain_text_batch_size = 4ULL << 20ULL;
+// Number of BGZF blocks processed by each thread. Blocks contain up to 64 KiB of text
+static constexpr std::size_t bgzf_blocks_per_batch = 64;
+static constexpr std::size_t bgzf_header_size = 12;
+static constexpr std::size_t bgzf_footer_size = 8;
+// NOLINTEND(*-avoid-magic-numbers)
+
+// Run fx(i) for i in [0, size) using the given thread pool (when available)
+template <typename Fx>
+static void parallel_for(BS::thread_pool* tpool, std::size_t size, Fx fx) {
+  if (!tpool || size < 2) {
+    for (std::size_t i = 0; i < size; ++i) {
+      fx(i);
+    }
+    return;
+  }
+
+  std::vector<std::future<void>> workers(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    workers[i] = tpool->submit_task([&, i]() { fx(i); });
+  }
+  // Rethrow exceptions (if any) only after all workers have returned
+  tpool->wait();
+  for (auto& worker : workers) {
+    worker.get();
+  }
+}
+
+PairsReader::PairsReader(std::filesystem::path path, std::shared_ptr<const hictk::BinTable> bins,
+                         bool one_based, bool drop_unknown_chroms, BS::thread_pool* tpool)
+    : _path(std::move(path)),
+      _fs(_path, std::ios::in | std::ios::binary),
+      _bins(std::move(bins)),
+      _tpool(tpool),
+      _offset(one_based ? -1 : 0),
+      _drop_unknown_chroms(drop_unknown_chroms) {
+  if (!_fs) {
+    throw std::runtime_error(fmt::format(FMT_STRING("failed to open file {}"), _path));
+  }
+  if (!_bins) {
+    throw std::runtime_error("bins cannot be null");
+  }
+  _bgzf = detect_bgzf();
+}
+
+const std::filesystem::path& PairsReader::path() const noexcept { return _path; }
+
+std::size_t PairsReader::num_records() const noexcept { return _num_records; }
+
+std::size_t PairsReader::num_dropped_records() const noexcept { return _num_dropped_records; }
+
+std::size_t PairsReader::num_threads() const noexcept {
+  return !_tpool ? std::size_t{1} : static_cast<std::size_t>(_tpool->get_thread_count());
+}
+
+template <typename N>
+bool PairsReader::next_chunk(std::vector<hictk::ThinPixel<N>>& buff, std::size_t chunk_size) {
+  buff.clear();
+  if (chunk_size == 0) {
+    throw std::runtime_error("chunk_size should be a positive number");
+  }
+
+  while (buff.size() < chunk_size && read_text()) {
+    parse_text(buff);
+  }
+
+  return !buff.empty();
+}
+
+bool PairsReader::detect_bgzf() {
+  std::array<char, bgzf_header_size> header{};
+  _fs.read(header.data(), static_cast<std::streamsize>(header.size()));
+  const auto num_bytes = static_cast<std::size_t>(_fs.gcount());
+  _fs.clear();
+  _fs.seekg(0);
+
+  const auto is_gzip = num_bytes >= 3 && static_cast<std::uint8_t>(header[0]) == 0x1f &&
+                       static_cast<std::uint8_t>(header[1]) == 0x8b && header[2] == 8;
+  if (!is_gzip) {
+    return false;
+  }
+
+  // BGZF blocks are gzip members with the FEXTRA flag set (the BC subfield is validated when
+  // reading each block)
+  const auto has_extra_field = num_bytes == header.size() && (header[3] & 4) != 0;
+  if (!has_extra_field) {
+    throw std::runtime_error(fmt::format(
+        FMT_STRING("file {} appears to be compressed with gzip: only uncompressed files and files "
+                   "compressed with bgzip are supported"),
+        _path));
+  }
+
+  return true;
+}
+
+bool PairsReader::read_text() {
+  if (_eof) {
+    return false;
+  }
+
+  const auto num_threads_ = num_threads();
+  const auto success = _bgzf ? read_text_bgzf(bgzf_blocks_per_batch * num_threads_)
+                             : read_text_plain(plain_text_batch_size * num_threads_);
+  if (!success) {
+    // Process the last line (which may not be terminated by a newline)
+    _eof = true;
+    _text_buff = std::move(_partial_line);
+    _partial_line.clear();
+    return !_text_buff.empty();
+  }
+
+  // Only complete lines are returned: move the trailing partial line (if any) to _partial_line
+  const auto pos = _text_buff.rfind('\n');
+  if (pos == std::string::npos) {
+    _partial_line = std::move(_text_buff);
+    _text_buff.clear();
+  } else {
+    _partial_line.assign(_text_buff, pos + 1);
+    _text_buff.resize(pos + 1);
+  }
+  return true;
+}
+
+bool PairsReader::read_text_plain(std::size_t batch_size) {
+  _text_buff = std::move(_partial_line);
+  _partial_line.clear();
+
+  const auto offset = _text_buff.size();
+  _text_buff.resize(offset + batch_size);
+  _fs.read(_text_buff.data() + offset, static_cast<std::streamsize>(batch_size));
+  const auto num_bytes = static_cast<std::size_t>(_fs.gcount());
+  if (_fs.bad()) {
+    throw std::runtime_error(fmt::format(FMT_STRING("failed to read from file {}"), _path));
+  }
+
+  _text_buff.resize(offset + num_bytes);
+  if (num_bytes == 0) {
+    _partial_line = std::move(_text_buff);
+    _text_buff.clear();
+    return false;
+  }
+  return true;
+}
+
+[[nodiscard]] static std::uint32_t read_le_uint(const char* ptr, std::size_t num_bytes) {
+  std::uint32_t n = 0;
+  for (std::size_t i = 0; i < num_bytes; ++i) {
+    n |= std::uint32_t{static_cast<std::uint8_t>(ptr[i])} << (8 * i);
+  }
+  return n;
+}
+
+// Read the next BGZF block (including its header and footer) from the given stream.
+// Returns an empty buffer upon reaching EOF
+[[nodiscard]] static std::string read_bgzf_block(std::ifstream& fs,
+                                                 const std::filesystem::path& path) {
+  std::string block(bgzf_header_size, '\0');
+  fs.read(block.data(), static_cast<std::streamsize>(block.size()));
+  if (fs.gcount() == 0) {
+    return {};
+  }
+
+  const auto throw_invalid_block = [&](std::string_view reason) {
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("file {} contains an invalid BGZF block: {}"), path, reason));
+  };
+
+  if (static_cast<std::size_t>(fs.gcount()) != block.size()) {
+    throw_invalid_block("block header is truncated");
+  }
+
+  if (static_cast<std::uint8_t>(block[0]) != 0x1f || static_cast<std::uint8_t>(block[1]) != 0x8b ||
+      (block[3] & 4) == 0) {
+    throw_invalid_block("block is not a gzip member with extra fields");
+  }
+
+  const auto xlen = read_le_uint(block.data() + 10, 2);
+  block.resize(bgzf_header_size + xlen);
+  fs.read(block.data() + bgzf_header_size, static_cast<std::streamsize>(xlen));
+  if (static_cast<std::size_t>(fs.gcount()) != xlen) {
+    throw_invalid_block("block header is truncated");
+  }
+
+  // Look for the BC subfield, storing the total block size minus 1
+  std::size_t block_size = 0;
+  for (std::size_t i = bgzf_header_size; i + 4 <= block.size();) {
+    const auto slen = read_le_uint(block.data() + i + 2, 2);
+    if (block[i] == 'B' && block[i + 1] == 'C' && slen == 2 && i + 6 <= block.size()) {
+      block_size = read_le_uint(block.data() + i + 4, 2) + std::size_t{1};
+      break;
+    }
+    i += 4 + slen;
+  }
+
+  if (block_size < block.size() + bgzf_footer_size) {
+    throw_invalid_block("unable to find a valid BC subfield");
+  }
+
+  const auto offset = block.size();
+  block.resize(block_size);
+  fs.read(block.data() + offset, static_cast<std::streamsize>(block_size - offset));
+  if (static_cast<std::size_t>(fs.gcount()) != block_size - offset) {
+    throw_invalid_block("block is truncated");
+  }
+
+  return block;
+}
+
+namespace {
+struct DecompressorDeleter {
+  void operator()(libdeflate_decompressor* ptr) const noexcept {
+    libdeflate_free_decompressor(ptr);
+  }
+};
+}  // namespace
+
+bool PairsReader::read_text_bgzf(std::size_t num_blocks) {
+  // Reading blocks is sequential, while decompression is done in parallel
+  std::vector<std::string> blocks{};
+  std::vector<std::size_t> offsets{_partial_line.size()};
+  for (std::size_t i = 0; i < num_blocks; ++i) {
+    auto block = read_bgzf_block(_fs, _path);
+    if (block.empty()) {
+      break;
+    }
+    const auto isize = read_le_uint(block.data() + block.size() - 4, 4);
+    if (isize == 0) {
+      // e.g. the EOF marker block
+      continue;
+    }
+    offsets.push_back(offsets.back() + isize);
+    blocks.emplace_back(std::move(block));
+  }
+
+  if (blocks.empty()) {
+    return false;
+  }
+
+  _text_buff = std::move(_partial_line);
+  _partial_line.clear();
+  _text_buff.resize(offsets.back());
+
+  const auto num_threads_ = std::min(num_threads(), blocks.size());
+  parallel_for(_tpool, num_threads_, [&](std::size_t tid) {
+    const std::unique_ptr<libdeflate_decompressor, DecompressorDeleter> decompressor{
+        libdeflate_alloc_decompressor()};
+    if (!decompressor) {
+      throw std::bad_alloc();
+    }
+
+    for (auto i = (blocks.size() * tid) / num_threads_;
+         i < (blocks.size() * (tid + 1)) / num_threads_; ++i) {
+      const auto& block = blocks[i];
+      const auto isize = offsets[i + 1] - offsets[i];
+      std::size_t num_bytes{};
+      const auto status =
+          libdeflate_gzip_decompress(decompressor.get(), block.data(), block.size(),
+                                     _text_buff.data() + offsets[i], isize, &num_bytes);
+      if (status != LIBDEFLATE_SUCCESS || num_bytes != isize) {
+        throw std::runtime_error(
+            fmt::format(FMT_STRING("failed to decompress BGZF block from file {}"), _path));
+      }
+    }
+  });
+
+  return true;
+}
+
+template <typename N>
+void PairsReader::parse_text(std::vector<hictk::ThinPixel<N>>& buff) {
+  const std::string_view text{_text_buff};
+  if (text.empty()) {
+    return;
+  }
+
+  // Split text into roughly equally-sized chunks of complete lines
+  const auto num_threads_ = std::min(num_threads(), (text.size() / plain_text_batch_size) + 1);
+  std::vector<std::size_t> offsets{0};
+  for (std::size_t i = 1; i < num_threads_; ++i) {
+    const auto pos = text.find('\n', std::max(offsets.back(), (text.size() * i) / num_threads_));
+    if (pos == std::string_view::npos) {
+      break;
+    }
+    offsets.push_back(pos + 1);
+  }
+  offsets.push_back(text.size());
+
+  const auto initial_size = buff.size();
+  std::vector<std::vector<hictk::ThinPixel<N>>> buffers(offsets.size() - 1);
+  std::atomic<std::size_t> num_dropped_records{};
+  parallel_for(_tpool, buffers.size(), [&](std::size_t i) {
+    num_dropped_records += parse_lines(text.substr(offsets[i], offsets[i + 1] - offsets[i]),
+                                       i == 0 ? buff : buffers[i]);
+  });
+
+  for (std::size_t i = 1; i < buffers.size(); ++i) {
+    buff.insert(buff.end(), buffers[i].begin(), buffers[i].end());
+  }
+  _num_dropped_records += num_dropped_records;
+  _num_records += (buff.size() - initial_size) + num_dropped_records;
+}
+
+template <typename N>
+std::size_t PairsReader::parse_lines(std::string_view text,
+                                     std::vector<hictk::ThinPixel<N>>& buff) const {
+  std::size_t num_dropped_records = 0;
+  const auto& chroms = _bins->chromosomes();
+
+  const auto next_token = [](std::string_view& line) {
+    const auto pos = line.find('\t');
+    const auto tok = line.substr(0, pos);
+    line.remove_prefix(pos == std::string_view::npos ? line.size() : pos + 1);
+    return tok;
+  };
+
+  while (!text.empty()) {
+    const auto pos = text.find('\n');
+    auto line = text.substr(0, pos);
+    text.remove_prefix(pos == std::string_view::npos ? text.size() : pos + 1);
+
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+
+    // Skip header lines
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+
+    try {
+      const auto original_line = line;
+      std::ignore = next_token(line);  // readID
+      const auto chrom1 = next_token(line);
+      const auto pos1 = next_token(line);
+      const auto chrom2 = next_token(line);
+      const auto pos2 = next_token(line);
+      if (pos2.empty()) {
+        throw std::runtime_error(fmt::format(
+            FMT_STRING("line \"{}\" is not in 4DN-DCIC pair format: expected 5 or more fields"),
+            original_line));
+      }
+
+      const auto chrom1_it = chroms.find(chrom1);
+      const auto chrom2_it = chroms.find(chrom2);
+      if (chrom1_it == chroms.end() || chrom2_it == chroms.end()) {
+        if (_drop_unknown_chroms) {
+          ++num_dropped_records;
+          continue;
+        }
+        throw std::runtime_error(fmt::format(
+            FMT_STRING("line \"{}\" refers to chromosome \"{}\", which is not in the BinTable. "
+                       "Pass drop_unknown_chroms=True to ignore such records."),
+            original_line, chrom1_it == chroms.end() ? chrom1 : chrom2));
+      }
+
+      const auto parse_pos = [&](std::string_view tok) {
+        const auto p = hictk::internal::parse_numeric_or_throw<std::int64_t>(tok) + _offset;
+        if (p < 0 || p > std::int64_t{std::numeric_limits<std::uint32_t>::max()}) {
+          throw std::runtime_error(
+              fmt::format(FMT_STRING("line \"{}\" contains an invalid position \"{}\""),
+                          original_line, tok));
+        }
+        return static_cast<std::uint32_t>(p);
+      };
+
+      auto bin1_id = _bins->at(*chrom1_it, parse_pos(pos1)).id();
+      auto bin2_id = _bins->at(*chrom2_it, parse_pos(pos2)).id();
+      if (bin1_id > bin2_id) {
+        std::swap(bin1_id, bin2_id);
+      }
+      buff.emplace_back(hictk::ThinPixel<N>{bin1_id, bin2_id, N{1}});
+    } catch (const std::exception& e) {
+      throw std::runtime_error(
+          fmt::format(FMT_STRING("failed to parse pairs from file {}: {}"), _path, e.what()));
+    }
+  }
+
+  return num_dropped_records;
+}
+
+template bool PairsReader::next_chunk(std::vector<hictk::ThinPixel<std::int32_t>>&, std::size_t);
+template bool PairsReader::next_chunk(std::vector<hictk::ThinPixel<float>>&, std::size_t);
+
+}  // namespace hictkpy
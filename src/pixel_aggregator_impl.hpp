@@ -8,11 +8,14 @@
 #include <parallel_hashmap/phmap.h>
 
 #include <algorithm>
+#include <array>
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics.hpp>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
 #include <limits>
 #include <numeric>
 #include <stdexcept>
@@ -21,6 +24,7 @@
 #include <type_traits>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include "hictkpy/common.hpp"
 
@@ -47,64 +51,184 @@ template <bool keep_nans, bool keep_infs, typename N>
   return false;
 }
 
-template <typename N>
-[[nodiscard]] inline double compute_variance_exact(const std::vector<N>& values, double mean) {
-  if (values.size() < 2 || std::isnan(mean)) {
-    return std::numeric_limits<double>::quiet_NaN();
-  }
-
-  return std::accumulate(values.begin(), values.end(), 0.0, [&](double accumulator, const auto n) {
-    const auto nn = conditional_static_cast<double>(n);
-    return accumulator + (((nn - mean) * (nn - mean)) / static_cast<double>(values.size() - 1));
+template <typename It>
+inline CentralMoments CentralMoments::compute(It first, It last) {
+  CentralMoments moments{};
+  moments.count = static_cast<std::size_t>(std::distance(first, last));
+  if (moments.count == 0) {
+    return moments;
+  }
+
+  moments.mean = std::accumulate(first, last, 0.0) / static_cast<double>(moments.count);
+  std::for_each(first, last, [&](const auto n) {
+    const auto delta = conditional_static_cast<double>(n) - moments.mean;
+    const auto delta2 = delta * delta;
+    moments.m2 += delta2;
+    moments.m3 += delta2 * delta;
+    moments.m4 += delta2 * delta2;
   });
-}
 
-template <typename N>
-[[nodiscard]] inline std::tuple<double, double, double> compute_central_moments(
-    const std::vector<N>& values, double mean) {
-  assert(!values.empty());
+  return moments;
+}
 
-  double m2 = 0.0;
-  double m3 = 0.0;
-  double m4 = 0.0;
+inline void CentralMoments::merge(const CentralMoments& other) noexcept {
+  if (other.count == 0) {
+    return;
+  }
+  if (count == 0) {
+    *this = other;
+    return;
+  }
+
+  const auto n1 = static_cast<double>(count);
+  const auto n2 = static_cast<double>(other.count);
+  const auto n = n1 + n2;
+
+  const auto delta = other.mean - mean;
+  const auto delta_n = delta / n;
+  const auto delta_n2 = delta_n * delta_n;
+  const auto term1 = delta * delta_n * n1 * n2;
+
+  // NOLINTBEGIN(*-avoid-magic-numbers)
+  const auto m4_ = m4 + other.m4 + (term1 * delta_n2 * ((n1 * n1) - (n1 * n2) + (n2 * n2))) +
+                   (6.0 * delta_n2 * ((n1 * n1 * other.m2) + (n2 * n2 * m2))) +
+                   (4.0 * delta_n * ((n1 * other.m3) - (n2 * m3)));
+  const auto m3_ = m3 + other.m3 + (term1 * delta_n * (n1 - n2)) +
+                   (3.0 * delta_n * ((n1 * other.m2) - (n2 * m2)));
+  // NOLINTEND(*-avoid-magic-numbers)
+  const auto m2_ = m2 + other.m2 + term1;
+
+  count += other.count;
+  mean += delta_n * n2;
+  m2 = m2_;
+  m3 = m3_;
+  m4 = m4_;
+}
 
-  for (const auto n : values) {
-    const auto delta = conditional_static_cast<double>(n) - mean;
-    m2 += delta * delta;
-    m3 += delta * delta * delta;
-    m4 += delta * delta * delta * delta;
+inline double CentralMoments::variance() const noexcept {
+  if (count < 2 || std::isnan(mean)) {
+    return std::numeric_limits<double>::quiet_NaN();
   }
-
-  const auto size_fp = static_cast<double>(values.size());
-  return {m2 / size_fp, m3 / size_fp, m4 / size_fp};
+  return m2 / static_cast<double>(count - 1);
 }
 
-template <typename N>
-[[nodiscard]] inline double compute_skewness_exact(const std::vector<N>& values, double mean) {
-  if (values.size() < 2 || std::isnan(mean)) {
+inline double CentralMoments::skewness() const noexcept {
+  if (count < 2 || std::isnan(mean) || m2 == 0) {
     return std::numeric_limits<double>::quiet_NaN();
   }
+  const auto count_fp = static_cast<double>(count);
+  return (m3 / count_fp) / std::pow(m2 / count_fp, 1.5);  // NOLINT(*-avoid-magic-numbers)
+}
 
-  const auto [m2, m3, _] = compute_central_moments(values, mean);
-  if (m2 == 0) {
+inline double CentralMoments::kurtosis() const noexcept {
+  if (count < 2 || std::isnan(mean) || m2 == 0) {
     return std::numeric_limits<double>::quiet_NaN();
   }
-
-  return m3 / std::pow(m2, 1.5);  // NOLINT(*-avoid-magic-numbers)
+  const auto count_fp = static_cast<double>(count);
+  const auto variance_ = m2 / count_fp;
+  return ((m4 / count_fp) / (variance_ * variance_)) - 3.0;  // NOLINT(*-avoid-magic-numbers)
 }
 
+inline MomentsAccumulator::MomentsAccumulator() { _block.reserve(block_size); }
+
 template <typename N>
-[[nodiscard]] inline double compute_kurtosis_exact(const std::vector<N>& values, double mean) {
-  if (values.size() < 2 || std::isnan(mean)) {
-    return std::numeric_limits<double>::quiet_NaN();
+inline void MomentsAccumulator::operator()(N n) {
+  _block.push_back(conditional_static_cast<double>(n));
+  if (HICTKPY_UNLIKELY(_block.size() == block_size)) {
+    _moments.merge(CentralMoments::compute(_block.begin(), _block.end()));
+    _block.clear();
   }
+}
 
-  const auto [m2, _, m4] = compute_central_moments(values, mean);
-  if (m2 == 0) {
-    return std::numeric_limits<double>::quiet_NaN();
+inline const CentralMoments& MomentsAccumulator::finalize() {
+  if (!_block.empty()) {
+    _moments.merge(CentralMoments::compute(_block.begin(), _block.end()));
+    _block.clear();
   }
+  return _moments;
+}
+
+template <typename N>
+inline void BlockStats<N>::update(const std::vector<N>& block, bool compute_moments) {
+  if (block.empty()) {
+    return;
+  }
+
+  const auto size = block.size();
+
+  std::array<N, lanes> sums{};
+  std::array<N, lanes> mins{};
+  std::array<N, lanes> maxs{};
+  mins.fill(std::numeric_limits<N>::max());
+  maxs.fill(std::numeric_limits<N>::lowest());
+
+  std::size_t i = 0;
+  for (; i + lanes <= size; i += lanes) {
+    for (std::size_t j = 0; j < lanes; ++j) {
+      const auto n = block[i + j];
+      sums[j] += n;
+      mins[j] = n < mins[j] ? n : mins[j];
+      maxs[j] = n > maxs[j] ? n : maxs[j];
+    }
+  }
+  for (; i < size; ++i) {
+    const auto n = block[i];
+    sums[0] += n;
+    mins[0] = n < mins[0] ? n : mins[0];
+    maxs[0] = n > maxs[0] ? n : maxs[0];
+  }
+
+  const auto block_sum = std::accumulate(sums.begin(), sums.end(), N{});
+  sum += block_sum;
+  count += size;
+  min = std::min(min, *std::min_element(mins.begin(), mins.end()));
+  max = std::max(max, *std::max_element(maxs.begin(), maxs.end()));
+
+  if (!compute_moments) {
+    return;
+  }
+
+  CentralMoments block_moments{};
+  block_moments.count = size;
+  block_moments.mean = conditional_static_cast<double>(block_sum) / static_cast<double>(size);
+
+  std::array<double, lanes> m2s{};
+  std::array<double, lanes> m3s{};
+  std::array<double, lanes> m4s{};
+  i = 0;
+  for (; i + lanes <= size; i += lanes) {
+    for (std::size_t j = 0; j < lanes; ++j) {
+      const auto delta = conditional_static_cast<double>(block[i + j]) - block_moments.mean;
+      const auto delta2 = delta * delta;
+      m2s[j] += delta2;
+      m3s[j] += delta2 * delta;
+      m4s[j] += delta2 * delta2;
+    }
+  }
+  for (; i < size; ++i) {
+    const auto delta = conditional_static_cast<double>(block[i]) - block_moments.mean;
+    const auto delta2 = delta * delta;
+    m2s[0] += delta2;
+    m3s[0] += delta2 * delta;
+    m4s[0] += delta2 * delta2;
+  }
+
+  block_moments.m2 = std::accumulate(m2s.begin(), m2s.end(), 0.0);
+  block_moments.m3 = std::accumulate(m3s.begin(), m3s.end(), 0.0);
+  block_moments.m4 = std::accumulate(m4s.begin(), m4s.end(), 0.0);
+  moments.merge(block_moments);
+}
 
-  return (m4 / (m2 * m2)) - 3.0;  // NOLINT(*-avoid-magic-numbers)
+template <typename N>
+inline void BlockStats<N>::merge(const BlockStats& other) noexcept {
+  if (other.count == 0) {
+    return;
+  }
+  count += other.count;
+  sum += other.sum;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+  moments.merge(other.moments);
 }
 
 }  // namespace internal
@@ -117,7 +241,62 @@ inline Stats PixelAggregator::compute(const PixelSelector& sel,
 
   validate_metrics(metrics);
 
+  if constexpr (std::is_integral_v<N> || (!keep_nans && !keep_infs)) {
+    // non-finite values are either impossible or dropped.
+    // The block-based kernel computes exact moments, so it is only used to compute variance,
+    // skewness, and kurtosis when exact=true: estimates are always computed using the accumulators
+    const auto compute_moments = metrics.contains("variance") || metrics.contains("skewness") ||
+                                 metrics.contains("kurtosis");
+    if (exact || !compute_moments) {
+      if (metrics.empty()) {
+        throw std::runtime_error("provide one or more statistics to be computed");
+      }
+      return compute_finite<N, keep_nans, keep_infs>(sel.template begin<N>(),
+                                                     sel.template end<N>(), metrics);
+    }
+  }
+  return compute_with_non_finite<N, keep_nans, keep_infs>(sel, metrics, exact);
+}
+
+template <typename N, bool keep_nans, bool keep_infs, typename ShardVisitor>
+inline Stats PixelAggregator::compute_sharded(std::size_t num_shards, ShardVisitor&& visit_shards,
+                                              const phmap::flat_hash_set<std::string>& metrics) {
+  static_assert(std::is_same_v<N, std::int64_t> || std::is_same_v<N, double>);
+  static_assert(std::is_integral_v<N> || (!keep_nans && !keep_infs));
+
+  validate_metrics(metrics);
+  if (metrics.empty()) {
+    throw std::runtime_error("provide one or more statistics to be computed");
+  }
+
+  const auto compute_moments =
+      metrics.contains("variance") || metrics.contains("skewness") || metrics.contains("kurtosis");
+
+  std::vector<internal::BlockStats<N>> shard_stats(num_shards);
+  visit_shards([&](std::size_t shard_idx, auto first, auto last) {
+    assert(shard_idx < shard_stats.size());
+    shard_stats[shard_idx] =
+        accumulate_finite<N, keep_nans, keep_infs>(std::move(first), std::move(last),
+                                                   compute_moments);
+  });
+
+  internal::BlockStats<N> block_stats{};
+  for (const auto& stats : shard_stats) {
+    block_stats.merge(stats);
+  }
+  return extract_finite(block_stats, metrics);
+}
+
+template <typename N, bool keep_nans, bool keep_infs, typename PixelSelector>
+inline Stats PixelAggregator::compute_with_non_finite(
+    const PixelSelector& sel, const phmap::flat_hash_set<std::string>& metrics, bool exact) {
   reset<N>(metrics);
+
+  if (exact && (metrics.contains("variance") || metrics.contains("skewness") ||
+                metrics.contains("kurtosis"))) {
+    _moments_accumulator.emplace();
+  }
+
   auto first = sel.template begin<N>();
   auto last = sel.template end<N>();
 
@@ -180,38 +359,30 @@ inline Stats PixelAggregator::compute(const PixelSelector& sel,
   if (_neg_inf_found || _pos_inf_found || _nan_found) {
     return stats;
   }
-  if (!exact && nnz.value_or(10'000) >= 10'000) {  // NOLINT(*-avoid-magic-numbers)
-    // exact computation is not required and sample size is big enough
+  if (!stats.variance.has_value() && !stats.skewness.has_value() && !stats.kurtosis.has_value()) {
+    // all requested metrics have already been computed exactly
     return stats;
   }
 
-  if (!stats.variance.has_value() && !stats.skewness.has_value() && !stats.kurtosis.has_value()) {
-    // all requested metrics have already been computed exactly
+  if (_moments_accumulator.has_value()) {
+    // exact moments have been computed while traversing pixels
+    set_exact_moments(_moments_accumulator->finalize(), stats);
     return stats;
   }
 
-  std::vector<N> values;
-  values.reserve(*nnz);
+  if (nnz.value_or(10'000) >= 10'000) {  // NOLINT(*-avoid-magic-numbers)
+    // exact computation is not required and sample size is big enough
+    return stats;
+  }
+
+  // sample size is small enough that computing the exact moments is cheap
+  internal::MomentsAccumulator moments{};
   std::for_each(sel.template begin<N>(), sel.template end<N>(), [&](const auto& pixel) {
     if (!internal::drop_value<keep_nans, keep_infs>(pixel.count)) {
-      values.push_back(pixel.count);
+      moments(pixel.count);
     }
   });
-
-  const auto mean =
-      std::visit([&](const auto& accumulator) { return extract_mean(accumulator); }, _accumulator);
-
-  if (stats.variance.has_value()) {
-    stats.variance = internal::compute_variance_exact(values, mean);
-  }
-
-  if (stats.skewness.has_value()) {
-    stats.skewness = internal::compute_skewness_exact(values, mean);
-  }
-
-  if (stats.kurtosis.has_value()) {
-    stats.kurtosis = internal::compute_kurtosis_exact(values, mean);
-  }
+  set_exact_moments(moments.finalize(), stats);
 
   return stats;
 }
@@ -226,6 +397,78 @@ inline void PixelAggregator::validate_metrics(const phmap::flat_hash_set<std::st
   }
 }
 
+template <typename N, bool keep_nans, bool keep_infs, typename It>
+inline Stats PixelAggregator::compute_finite(It first, It last,
+                                             const phmap::flat_hash_set<std::string>& metrics) {
+  const auto compute_moments =
+      metrics.contains("variance") || metrics.contains("skewness") || metrics.contains("kurtosis");
+
+  const auto block_stats = accumulate_finite<N, keep_nans, keep_infs>(
+      std::move(first), std::move(last), compute_moments);
+  return extract_finite(block_stats, metrics);
+}
+
+template <typename N, bool keep_nans, bool keep_infs, typename It>
+inline internal::BlockStats<N> PixelAggregator::accumulate_finite(It first, It last,
+                                                                  bool compute_moments) {
+  internal::BlockStats<N> block_stats{};
+  std::vector<N> block{};
+  block.reserve(internal::BlockStats<N>::block_size);
+
+  for (; first != last; ++first) {
+    const auto n = first->count;
+    if (HICTKPY_UNLIKELY(internal::drop_value<keep_nans, keep_infs>(n))) {
+      continue;
+    }
+    block.push_back(n);
+    if (HICTKPY_UNLIKELY(block.size() == internal::BlockStats<N>::block_size)) {
+      block_stats.update(block, compute_moments);
+      block.clear();
+    }
+  }
+  block_stats.update(block, compute_moments);
+  return block_stats;
+}
+
+template <typename N>
+inline Stats PixelAggregator::extract_finite(const internal::BlockStats<N>& block_stats,
+                                             const phmap::flat_hash_set<std::string>& metrics) {
+  Stats stats{};
+  if (metrics.contains("nnz")) {
+    stats.nnz = static_cast<std::int64_t>(block_stats.count);
+  }
+  if (metrics.contains("sum")) {
+    stats.sum = block_stats.sum;
+  }
+
+  if (HICTKPY_UNLIKELY(block_stats.count == 0)) {
+    return stats;
+  }
+
+  if (metrics.contains("min")) {
+    stats.min = block_stats.min;
+  }
+  if (metrics.contains("max")) {
+    stats.max = block_stats.max;
+  }
+  if (metrics.contains("mean")) {
+    stats.mean = conditional_static_cast<double>(block_stats.sum) /
+                 static_cast<double>(block_stats.count);
+  }
+
+  if (metrics.contains("variance")) {
+    stats.variance = block_stats.moments.variance();
+  }
+  if (metrics.contains("skewness")) {
+    stats.skewness = block_stats.moments.skewness();
+  }
+  if (metrics.contains("kurtosis")) {
+    stats.kurtosis = block_stats.moments.kurtosis();
+  }
+
+  return stats;
+}
+
 template <bool keep_nans, bool keep_infs, typename N>
 inline void PixelAggregator::update_finiteness_counters(N n) noexcept {
   static_assert(std::is_arithmetic_v<N>);
@@ -273,6 +516,9 @@ inline std::pair<It, std::size_t> PixelAggregator::process_pixels_until_true(
     }
     accumulator(n);
     ++nnz;
+    if (_moments_accumulator.has_value()) {
+      (*_moments_accumulator)(n);
+    }
 
     if constexpr (!skip_kurtosis && std::is_integral_v<N>) {
       assert(_kurtosis_accumulator.has_value());
@@ -331,6 +577,21 @@ inline void PixelAggregator::disable_redundant_accumulators(Accumulator<N>& accu
     accumulator.template drop<boost::accumulators::tag::kurtosis>();
     _kurtosis_accumulator.reset();
   }
+  // moments are undefined in presence of non-finite values
+  _moments_accumulator.reset();
+}
+
+inline void PixelAggregator::set_exact_moments(const internal::CentralMoments& moments,
+                                               Stats& stats) {
+  if (stats.variance.has_value()) {
+    stats.variance = moments.variance();
+  }
+  if (stats.skewness.has_value()) {
+    stats.skewness = moments.skewness();
+  }
+  if (stats.kurtosis.has_value()) {
+    stats.kurtosis = moments.kurtosis();
+  }
 }
 
 template <bool keep_nans, bool keep_infs, typename N, typename It>
@@ -383,6 +644,7 @@ inline void PixelAggregator::reset(const phmap::flat_hash_set<std::string>& metr
       _compute_kurtosis = false;
     }
   }
+  _moments_accumulator.reset();
 
   std::visit(
       [&](auto& accumulator) {
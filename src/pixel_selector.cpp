@@ -7,26 +7,46 @@
 #include <winsock2.h>
 #endif
 
+#include <BS_thread_pool.hpp>
+#include <arrow/array.h>
+#include <arrow/buffer.h>
+#include <arrow/builder.h>
+#include <arrow/chunked_array.h>
+#include <arrow/record_batch.h>
+#include <arrow/status.h>
 #include <arrow/table.h>
+#include <arrow/type.h>
 #include <fmt/format.h>
 #include <fmt/ranges.h>
 #include <parallel_hashmap/phmap.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <hictk/balancing/weights.hpp>
 #include <hictk/bin_table.hpp>
 #include <hictk/cooler/pixel_selector.hpp>
 #include <hictk/fmt.hpp>
+#include <hictk/hic.hpp>
 #include <hictk/hic/pixel_selector.hpp>
 #include <hictk/pixel.hpp>
 #include <hictk/transformers/common.hpp>
 #include <hictk/transformers/join_genomic_coords.hpp>
 #include <hictk/transformers/to_dataframe.hpp>
 #include <hictk/transformers/to_dense_matrix.hpp>
-#include <hictk/transformers/to_sparse_matrix.hpp>
 #include <hictkpy/common.hpp>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -36,10 +56,15 @@
 #include <variant>
 #include <vector>
 
+#include "hictkpy/cache_config.hpp"
 #include "hictkpy/common.hpp"
+#include "hictkpy/expected.hpp"
+#include "hictkpy/locking.hpp"
 #include "hictkpy/nanobind.hpp"
 #include "hictkpy/pixel_aggregator.hpp"
 #include "hictkpy/pixel_selector.hpp"
+#include "hictkpy/profiling.hpp"
+#include "hictkpy/query_cache.hpp"
 #include "hictkpy/to_pyarrow.hpp"
 
 namespace nb = nanobind;
@@ -50,19 +75,56 @@ PixelSelector::PixelSelector(std::shared_ptr<const hictk::cooler::PixelSelector>
                              std::string_view type, bool join)
     : selector(std::move(sel_)),
       pixel_count(parse_count_type(type)),
-      pixel_format(join ? PixelFormat::BG2 : PixelFormat::COO) {}
+      pixel_format(join ? PixelFormat::BG2 : PixelFormat::COO),
+      mtx(get_hdf5_mutex()) {}
 
 PixelSelector::PixelSelector(std::shared_ptr<const hictk::hic::PixelSelector> sel_,
                              std::string_view type, bool join)
     : selector(std::move(sel_)),
       pixel_count(parse_count_type(type)),
-      pixel_format(join ? PixelFormat::BG2 : PixelFormat::COO) {}
+      pixel_format(join ? PixelFormat::BG2 : PixelFormat::COO),
+      mtx(get_hic_file_mutex(std::get<std::shared_ptr<const hictk::hic::PixelSelector>>(selector)
+                                 ->bins_ptr())) {}
 
 PixelSelector::PixelSelector(std::shared_ptr<const hictk::hic::PixelSelectorAll> sel_,
                              std::string_view type, bool join)
     : selector(std::move(sel_)),
       pixel_count(parse_count_type(type)),
-      pixel_format(join ? PixelFormat::BG2 : PixelFormat::COO) {}
+      pixel_format(join ? PixelFormat::BG2 : PixelFormat::COO),
+      mtx(get_hic_file_mutex(std::get<std::shared_ptr<const hictk::hic::PixelSelectorAll>>(selector)
+                                 ->bins_ptr())) {}
+
+PixelSelector::PixelSelector(
+    std::shared_ptr<const BandPixelSelector<hictk::cooler::PixelSelector>> sel_,
+    std::string_view type, bool join)
+    : selector(std::move(sel_)),
+      pixel_count(parse_count_type(type)),
+      pixel_format(join ? PixelFormat::BG2 : PixelFormat::COO),
+      mtx(get_hdf5_mutex()) {}
+
+PixelSelector::PixelSelector(
+    std::shared_ptr<const BandPixelSelector<hictk::hic::PixelSelector>> sel_,
+    std::string_view type, bool join)
+    : selector(std::move(sel_)),
+      pixel_count(parse_count_type(type)),
+      pixel_format(join ? PixelFormat::BG2 : PixelFormat::COO),
+      mtx(get_hic_file_mutex(
+          std::get<std::shared_ptr<const BandPixelSelector<hictk::hic::PixelSelector>>>(selector)
+              ->bins_ptr())) {}
+
+template <typename Fx>
+inline auto PixelSelector::run_without_gil(Fx&& fx) const {
+  assert(mtx);
+  return hictkpy::run_without_gil(*mtx, std::forward<Fx>(fx));
+}
+
+std::string PixelSelector::make_query_cache_key(std::string_view operation,
+                                                std::string_view params) const {
+  if (cache_key.empty()) {
+    return {};
+  }
+  return fmt::format(FMT_STRING("{}\t{}\t{}"), cache_key, operation, params);
+}
 
 std::string PixelSelector::repr() const {
   if (!coord1()) {
@@ -175,6 +237,192 @@ nb::iterator PixelSelector::make_iterable() const {
       selector);
 }
 
+template <typename T>
+[[nodiscard]] static nb::object make_numpy_array(std::vector<T> data) {
+  using Array = nb::ndarray<nb::numpy, nb::shape<-1>, nb::c_contig, T>;
+
+  // NOLINTNEXTLINE
+  auto* data_ptr = new std::vector<T>(std::move(data));
+
+  auto capsule = nb::capsule(data_ptr, [](void* vect_ptr) noexcept {
+    delete reinterpret_cast<std::vector<T>*>(vect_ptr);  // NOLINT
+  });
+
+  return nb::cast(Array{data_ptr->data(), {data_ptr->size()}, capsule},
+                  nb::rv_policy::take_ownership);
+}
+
+struct PixelChunkIterator::Reader {
+  Reader() = default;
+  Reader(const Reader&) = delete;
+  Reader(Reader&&) = delete;
+  virtual ~Reader() = default;
+  Reader& operator=(const Reader&) = delete;
+  Reader& operator=(Reader&&) = delete;
+
+  // Return std::nullopt once all pixels have been read
+  [[nodiscard]] virtual std::optional<nb::dict> next() = 0;
+};
+
+template <typename N, typename SelT>
+class PixelChunkReader : public PixelChunkIterator::Reader {
+  using PixelIt = decltype(std::declval<const SelT&>().template begin<N>());
+
+  std::shared_ptr<const SelT> _sel{};
+  std::shared_ptr<FileMutex> _mtx{};
+  std::optional<PixelIt> _first{};
+  std::optional<PixelIt> _last{};
+  std::size_t _chunk_size{};
+  bool _join{};
+
+ public:
+  PixelChunkReader(std::shared_ptr<const SelT> sel, std::shared_ptr<FileMutex> mtx,
+                   std::size_t chunk_size, bool join)
+      : _sel(std::move(sel)),
+        _mtx(std::move(mtx)),
+        _first(_sel->template begin<N>()),
+        _last(_sel->template end<N>()),
+        _chunk_size(chunk_size),
+        _join(join) {
+    assert(_chunk_size != 0);
+  }
+
+  PixelChunkReader(const PixelChunkReader&) = delete;
+  PixelChunkReader(PixelChunkReader&&) = delete;
+
+  ~PixelChunkReader() noexcept override {
+    try {
+      [[maybe_unused]] const auto lck = lock_file(*_mtx);
+      _first.reset();
+      _last.reset();
+      _sel.reset();
+    } catch (...) {  // NOLINT
+    }
+  }
+
+  PixelChunkReader& operator=(const PixelChunkReader&) = delete;
+  PixelChunkReader& operator=(PixelChunkReader&&) = delete;
+
+  [[nodiscard]] std::optional<nb::dict> next() override {
+    std::vector<std::uint64_t> bin1_ids{};
+    std::vector<std::uint64_t> bin2_ids{};
+    std::vector<N> counts{};
+
+    std::vector<std::uint32_t> chrom1_ids{};
+    std::vector<std::uint32_t> starts1{};
+    std::vector<std::uint32_t> ends1{};
+    std::vector<std::uint32_t> chrom2_ids{};
+    std::vector<std::uint32_t> starts2{};
+    std::vector<std::uint32_t> ends2{};
+
+    {
+      [[maybe_unused]] const nb::gil_scoped_release release{};
+      {
+        [[maybe_unused]] const auto lck = std::scoped_lock(*_mtx);
+        if (!_first.has_value()) {
+          return {};
+        }
+
+        bin1_ids.reserve(_chunk_size);
+        bin2_ids.reserve(_chunk_size);
+        counts.reserve(_chunk_size);
+        for (; *_first != *_last && counts.size() < _chunk_size; ++(*_first)) {
+          const auto& p = **_first;
+          bin1_ids.push_back(p.bin1_id);
+          bin2_ids.push_back(p.bin2_id);
+          counts.push_back(p.count);
+        }
+
+        if (*_first == *_last) {
+          // release resources held by the iterators as soon as possible
+          _first.reset();
+          _last.reset();
+        }
+      }
+
+      if (counts.empty()) {
+        return {};
+      }
+
+      if (_join) {
+        const auto& bins = _sel->bins();
+        // chromosome IDs should refer to the list of chromosomes returned by File.chromosomes()
+        const auto chrom_id_offset =
+            static_cast<std::uint32_t>(bins.chromosomes().at(0).is_all());
+        const auto map_coords = [&](const auto& bin_ids, auto& chrom_ids, auto& starts,
+                                    auto& ends) {
+          chrom_ids.resize(bin_ids.size());
+          starts.resize(bin_ids.size());
+          ends.resize(bin_ids.size());
+          for (std::size_t i = 0; i < bin_ids.size(); ++i) {
+            const auto bin = bins.at(bin_ids[i]);
+            chrom_ids[i] = bin.chrom().id() - chrom_id_offset;
+            starts[i] = bin.start();
+            ends[i] = bin.end();
+          }
+        };
+        map_coords(bin1_ids, chrom1_ids, starts1, ends1);
+        map_coords(bin2_ids, chrom2_ids, starts2, ends2);
+      }
+    }
+
+    nb::dict chunk{};
+    chunk["bin1_id"] = make_numpy_array(std::move(bin1_ids));
+    chunk["bin2_id"] = make_numpy_array(std::move(bin2_ids));
+    if (_join) {
+      chunk["chrom1_id"] = make_numpy_array(std::move(chrom1_ids));
+      chunk["start1"] = make_numpy_array(std::move(starts1));
+      chunk["end1"] = make_numpy_array(std::move(ends1));
+      chunk["chrom2_id"] = make_numpy_array(std::move(chrom2_ids));
+      chunk["start2"] = make_numpy_array(std::move(starts2));
+      chunk["end2"] = make_numpy_array(std::move(ends2));
+    }
+    chunk["count"] = make_numpy_array(std::move(counts));
+
+    return chunk;
+  }
+};
+
+nb::dict PixelChunkIterator::next() {
+  if (!reader) {
+    throw nb::stop_iteration();
+  }
+
+  auto chunk = reader->next();
+  if (!chunk.has_value()) {
+    reader.reset();
+    throw nb::stop_iteration();
+  }
+
+  return std::move(*chunk);
+}
+
+PixelChunkIterator PixelSelector::iter_chunks(std::size_t chunk_size) const {
+  std::ignore = import_module_checked("numpy");
+
+  if (chunk_size == 0) {
+    throw std::runtime_error("chunk_size should be a positive number");
+  }
+
+  const auto join = pixel_format == PixelFormat::BG2;
+  return run_without_gil([&]() {
+    return std::visit(
+        [&](const auto& sel_ptr) -> PixelChunkIterator {
+          assert(!!sel_ptr);
+          using SelT = remove_cvref_t<decltype(*sel_ptr)>;
+          return std::visit(
+              [&]([[maybe_unused]] auto count) -> PixelChunkIterator {
+                using N = std::conditional_t<std::is_same_v<decltype(count), long double>, double,
+                                             decltype(count)>;
+                return {std::make_shared<PixelChunkReader<N, SelT>>(sel_ptr, mtx, chunk_size,
+                                                                    join)};
+              },
+              pixel_count);
+        },
+        selector);
+  });
+}
+
 template <typename N, typename PixelSelector>
 [[nodiscard]] static std::shared_ptr<arrow::Table> make_bg2_arrow_df(
     const PixelSelector& sel, hictk::transformers::QuerySpan span) {
@@ -199,99 +447,1429 @@ template <typename N, typename PixelSelector>
   }
 }
 
-nb::object PixelSelector::to_arrow(std::string_view span) const {
+namespace {
+// Pixels read from the chromosome pair (chrom1, chrom2) after applying the query span.
+// Pixels are grouped based on the chromosome overlapping their bin1_id
+template <typename N>
+struct ChromosomePairPixels {
+  std::vector<hictk::ThinPixel<N>> rows1{};  // bin1_id overlaps chrom1
+  std::vector<hictk::ThinPixel<N>> rows2{};  // bin1_id overlaps chrom2 (trans pairs only)
+};
+
+// Partition of a genome-wide query into the chromosome pairs (chrom1 <= chrom2) it overlaps.
+// Pairs are listed in the order in which they appear in the upper triangle of the matrix
+struct GenomeWidePartition {
+  std::vector<hictk::Chromosome> chromosomes{};
+  std::vector<std::uint64_t> first_bins{};
+  std::vector<std::uint64_t> num_bins{};
+  std::vector<std::pair<std::size_t, std::size_t>> pairs{};
+
+  [[nodiscard]] std::size_t pair_index(std::size_t i, std::size_t j) const noexcept {
+    assert(i <= j);
+    const auto n = chromosomes.size();
+    return ((i * ((2 * n) - i + 1)) / 2) + (j - i);
+  }
+};
+}  // namespace
+
+[[nodiscard]] static GenomeWidePartition partition_genome_wide_query(const hictk::BinTable& bins) {
+  GenomeWidePartition partition{};
+  for (const auto& chrom : bins.chromosomes()) {
+    if (chrom.is_all()) {
+      continue;
+    }
+    const auto first_bin = bins.at(chrom, 0).id();
+    const auto last_bin = bins.at(chrom, chrom.size() - 1).id();
+    partition.chromosomes.push_back(chrom);
+    partition.first_bins.push_back(first_bin);
+    partition.num_bins.push_back(last_bin - first_bin + 1);
+  }
+
+  for (std::size_t i = 0; i < partition.chromosomes.size(); ++i) {
+    for (std::size_t j = i; j < partition.chromosomes.size(); ++j) {
+      partition.pairs.emplace_back(i, j);
+    }
+  }
+  return partition;
+}
+
+// Rethrow exceptions (if any) only after all workers have returned
+static void wait_for_workers(BS::thread_pool& tpool, std::vector<std::future<void>>& workers) {
+  tpool.wait();
+  for (auto& worker : workers) {
+    worker.get();
+  }
+}
+
+// Apply the query span to the pixels of a chromosome pair. The pixels of each group remain sorted
+// by bin1_id, and pixels sharing the same bin1_id remain sorted by bin2_id once grouped by row
+template <typename N, typename PixelIt>
+static void append_chromosome_pair_pixels(PixelIt first, PixelIt last, bool cis,
+                                          hictk::transformers::QuerySpan span,
+                                          ChromosomePairPixels<N>& dest) {
+  using QuerySpan = hictk::transformers::QuerySpan;
+  auto& mirrored_pixels = cis ? dest.rows1 : dest.rows2;
+  std::for_each(first, last, [&](const hictk::ThinPixel<N>& p) {
+    const auto diagonal = p.bin1_id == p.bin2_id;
+    if (diagonal || span != QuerySpan::lower_triangle) {
+      dest.rows1.push_back(p);
+    }
+    if (!diagonal && span != QuerySpan::upper_triangle) {
+      mirrored_pixels.push_back(hictk::ThinPixel<N>{p.bin2_id, p.bin1_id, p.count});
+    }
+  });
+}
+
+// Call fx(k, first, last) with the pixels of each chromosome pair in the partition, where k is the
+// index of the pair and [first, last) are iterators over its pixels.
+// Chromosome pairs are decoded in parallel, and fx is called concurrently from up to num_workers
+// threads. Each worker reads from its own file handle, so that workers do not need to synchronize
+// with each other or with selectors referring to the same file. Workers split the cache budget of
+// the file the query originates from (see compute_worker_file_cache_size()).
+// Like hictk::hic::File::fetch(), no interactions are read when the file does not have the
+// requested normalization vectors (missing vectors for individual chromosomes are handled by hictk)
+template <typename N, typename Fx>
+static void visit_chromosome_pairs(const hictk::hic::PixelSelectorAll& sel,
+                                   const std::filesystem::path& path,
+                                   const GenomeWidePartition& partition, BS::thread_pool& tpool,
+                                   std::size_t num_workers, Fx&& fx) {
+  std::atomic<std::size_t> next_pair{0};
+
+  std::vector<std::future<void>> workers(std::min(num_workers, partition.pairs.size()));
+  const auto cache_capacity = compute_worker_file_cache_size(sel.bins_ptr(), workers.size());
+  for (auto& worker : workers) {
+    worker = tpool.submit_task([&]() {
+      const hictk::hic::File hf(path.string(), sel.resolution(), sel.matrix_type(), sel.unit(),
+                                cache_capacity);
+      const auto& norm = sel.normalization();
+      if (norm != hictk::balancing::Method::NONE() && !hf.has_normalization(norm.to_string())) {
+        return;
+      }
+      for (auto k = next_pair++; k < partition.pairs.size(); k = next_pair++) {
+        const auto& [i, j] = partition.pairs[k];
+        const auto& chrom1 = partition.chromosomes[i];
+        const auto& chrom2 = partition.chromosomes[j];
+        const auto pair_sel =
+            hf.fetch(chrom1.name(), 0, chrom1.size(), chrom2.name(), 0, chrom2.size(), norm);
+        fx(k, pair_sel.template begin<N>(), pair_sel.template end<N>());
+      }
+    });
+  }
+  wait_for_workers(tpool, workers);
+}
+
+template <typename N, typename SelT>
+[[nodiscard]] static std::vector<ChromosomePairPixels<N>> read_chromosome_pairs(
+    const SelT& sel, const std::filesystem::path& path, const GenomeWidePartition& partition,
+    hictk::transformers::QuerySpan span, BS::thread_pool& tpool, std::size_t num_workers) {
+  std::vector<ChromosomePairPixels<N>> blocks(partition.pairs.size());
+  visit_chromosome_pairs<N>(sel, path, partition, tpool, num_workers,
+                            [&](std::size_t k, auto first, auto last) {
+                              const auto& [i, j] = partition.pairs[k];
+                              append_chromosome_pair_pixels(std::move(first), std::move(last),
+                                                            i == j, span, blocks[k]);
+                            });
+  return blocks;
+}
+
+// Merge the pixels whose bin1_id overlaps the chrom_idx-th chromosome into a single vector sorted
+// by (bin1_id, bin2_id).
+// Groups are visited in the order in which their columns appear in the matrix, so a stable
+// counting sort on bin1_id is enough to sort pixels. Groups are freed as soon as they are merged
+template <typename N>
+[[nodiscard]] static std::vector<hictk::ThinPixel<N>> stitch_chromosome_stripe(
+    std::vector<ChromosomePairPixels<N>>& blocks, const GenomeWidePartition& partition,
+    std::size_t chrom_idx) {
+  std::vector<std::vector<hictk::ThinPixel<N>>*> groups{};
+  for (std::size_t i = 0; i < chrom_idx; ++i) {
+    groups.push_back(&blocks[partition.pair_index(i, chrom_idx)].rows2);
+  }
+  for (std::size_t j = chrom_idx; j < partition.chromosomes.size(); ++j) {
+    groups.push_back(&blocks[partition.pair_index(chrom_idx, j)].rows1);
+  }
+
+  const auto first_bin = partition.first_bins[chrom_idx];
+  const auto row = [&](const hictk::ThinPixel<N>& p) {
+    assert(p.bin1_id >= first_bin);
+    return static_cast<std::size_t>(p.bin1_id - first_bin);
+  };
+
+  std::vector<std::size_t> offsets(static_cast<std::size_t>(partition.num_bins[chrom_idx]) + 1, 0);
+  for (const auto* group : groups) {
+    for (const auto& p : *group) {
+      ++offsets[row(p) + 1];
+    }
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  std::vector<hictk::ThinPixel<N>> pixels(offsets.back());
+  for (auto* group : groups) {
+    for (const auto& p : *group) {
+      pixels[offsets[row(p)]++] = p;
+    }
+    *group = {};
+  }
+  return pixels;
+}
+
+// Process a genome-wide query one chromosome pair at a time.
+// Once all pairs have been read, the pixels whose bin1_id overlaps each chromosome are stitched
+// together and passed to fx(chrom_idx, pixels). fx is called concurrently from up to n_threads
+// threads, and pixels passed to fx are sorted by (bin1_id, bin2_id) and already reflect the query
+// span.
+// Concatenating the pixels in chromosome order yields the same result as the genome-wide query,
+// without having to sort the entire query.
+// on_read(nnz) is called once all pairs have been read and before stitching begins, where nnz is
+// the total number of pixels that will be passed to fx
+template <typename N, typename SelT, typename OnRead, typename Fx>
+static void visit_genome_wide_stripes(const SelT& sel, const std::filesystem::path& path,
+                                      const GenomeWidePartition& partition,
+                                      hictk::transformers::QuerySpan span, std::size_t n_threads,
+                                      OnRead&& on_read, Fx&& fx) {
+  const auto num_workers = std::max(std::size_t{1}, std::min(n_threads, partition.pairs.size()));
+  BS::thread_pool tpool(conditional_static_cast<BS::concurrency_t>(num_workers));
+  auto blocks = read_chromosome_pairs<N>(sel, path, partition, span, tpool, num_workers);
+
+  std::size_t nnz{};
+  for (const auto& block : blocks) {
+    nnz += block.rows1.size() + block.rows2.size();
+  }
+  on_read(nnz);
+
+  [[maybe_unused]] const profiling::Stage stage{"stitch"};
+  std::vector<std::future<void>> workers(partition.chromosomes.size());
+  for (std::size_t i = 0; i < workers.size(); ++i) {
+    workers[i] = tpool.submit_task(
+        [&, i]() { fx(i, stitch_chromosome_stripe(blocks, partition, i)); });
+  }
+  wait_for_workers(tpool, workers);
+}
+
+template <typename N, typename SelT, typename Fx>
+static void visit_genome_wide_stripes(const SelT& sel, const std::filesystem::path& path,
+                                      const GenomeWidePartition& partition,
+                                      hictk::transformers::QuerySpan span, std::size_t n_threads,
+                                      Fx&& fx) {
+  visit_genome_wide_stripes<N>(
+      sel, path, partition, span, n_threads, [](std::size_t) {}, std::forward<Fx>(fx));
+}
+
+template <typename N, typename SelT>
+[[nodiscard]] static std::shared_ptr<arrow::Table> make_genome_wide_arrow_df(
+    const SelT& sel, const std::filesystem::path& path, hictk::transformers::DataFrameFormat format,
+    hictk::transformers::QuerySpan span, std::size_t n_threads) {
+  if constexpr (std::is_same_v<N, long double>) {
+    return make_genome_wide_arrow_df<double>(sel, path, format, span, n_threads);
+  } else {
+    const auto partition = partition_genome_wide_query(sel.bins());
+    std::vector<std::shared_ptr<arrow::Table>> tables(partition.chromosomes.size());
+    visit_genome_wide_stripes<N>(
+        sel, path, partition, span, n_threads,
+        [&](std::size_t i, const std::vector<hictk::ThinPixel<N>>& pixels) {
+          // pixels already reflect the query span and are sorted: convert them as they are
+          tables[i] = hictk::transformers::ToDataFrame(
+              pixels.begin(), pixels.end(), format, sel.bins_ptr(),
+              hictk::transformers::QuerySpan::upper_triangle)();
+        });
+
+    auto result = arrow::ConcatenateTables(tables);
+    if (!result.ok()) {
+      throw std::runtime_error(result.status().ToString());
+    }
+    return result.MoveValueUnsafe();
+  }
+}
+
+template <typename SelT>
+inline constexpr bool is_partitionable_selector_v =
+    std::is_same_v<SelT, hictk::hic::PixelSelectorAll>;
+
+// Genome-wide queries on .hic files can be processed one chromosome pair at a time when they are
+// not being transformed.
+// Queries on .cool files are always streamed: reads are serialized by the HDF5 lock, so processing
+// chromosome pairs separately would only increase peak memory usage
+[[nodiscard]] static bool can_partition_genome_wide_query(const PixelSelector::SelectorVar& sel,
+                                                          std::size_t n_threads) noexcept {
+  if (n_threads < 2) {
+    return false;
+  }
+  return std::holds_alternative<std::shared_ptr<const hictk::hic::PixelSelectorAll>>(sel);
+}
+
+namespace {
+// Columns that can be requested through PixelSelector.to_arrow(columns=...)
+enum class PixelColumn : std::uint_fast8_t {
+  BIN1_ID,
+  BIN2_ID,
+  CHROM1,
+  START1,
+  END1,
+  CHROM2,
+  START2,
+  END2,
+  COUNT
+};
+
+// Map bin IDs to genomic coordinates.
+// Coordinates of fixed-size bins are computed arithmetically from bin IDs, while bins of variable
+// size are looked up in the bin table
+class BinCoordinateMapper {
+  const hictk::BinTable* _bins{};
+  std::uint32_t _resolution{};
+  // ID of the first bin of each chromosome (excluding chromosome "All"), followed by the number of
+  // bins in the table
+  std::vector<std::uint64_t> _offsets{};
+  std::vector<std::uint32_t> _chrom_sizes{};
+  // Chromosome "All" is not included in the chromosome dictionary (see ToDataFrame)
+  std::int32_t _chrom_id_offset{};
+
+ public:
+  struct Coordinates {
+    std::int32_t chrom_id{};
+    std::uint32_t start{};
+    std::uint32_t end{};
+  };
+
+  explicit BinCoordinateMapper(const hictk::BinTable& bins)
+      : _bins(&bins),
+        _resolution(bins.type() == hictk::BinTable::Type::fixed ? bins.resolution() : 0),
+        _chrom_id_offset(static_cast<std::int32_t>(bins.chromosomes().at(0).is_all())) {
+    for (const auto& chrom : bins.chromosomes()) {
+      if (!chrom.is_all()) {
+        _offsets.push_back(bins.at(chrom, 0).id());
+        _chrom_sizes.push_back(chrom.size());
+      }
+    }
+    _offsets.push_back(bins.size());
+  }
+
+  // chrom_idx is used as a hint to avoid searching for the chromosome overlapping bin_id when
+  // mapping consecutive bins from the same chromosome
+  [[nodiscard]] Coordinates map(std::uint64_t bin_id, std::size_t& chrom_idx) const {
+    if (_resolution == 0) {
+      const auto bin = _bins->at(bin_id);
+      return {static_cast<std::int32_t>(bin.chrom().id()) - _chrom_id_offset, bin.start(),
+              bin.end()};
+    }
+
+    assert(bin_id < _offsets.back());
+    if (bin_id < _offsets[chrom_idx] || bin_id >= _offsets[chrom_idx + 1]) {
+      const auto it = std::upper_bound(_offsets.begin(), _offsets.end(), bin_id);
+      chrom_idx = static_cast<std::size_t>(std::distance(_offsets.begin(), it)) - 1;
+    }
+
+    const auto start = (bin_id - _offsets[chrom_idx]) * _resolution;
+    const auto end = std::min(start + _resolution, std::uint64_t{_chrom_sizes[chrom_idx]});
+    return {static_cast<std::int32_t>(chrom_idx), static_cast<std::uint32_t>(start),
+            static_cast<std::uint32_t>(end)};
+  }
+};
+}  // namespace
+
+static constexpr std::array<std::string_view, 9> pixel_column_names{
+    "bin1_id", "bin2_id", "chrom1", "start1", "end1", "chrom2", "start2", "end2", "count"};
+
+[[nodiscard]] static std::vector<PixelColumn> parse_pixel_columns(
+    const std::vector<std::string>& columns) {
+  if (columns.empty()) {
+    throw std::runtime_error("columns should contain at least one column name");
+  }
+
+  std::vector<PixelColumn> parsed_columns{};
+  for (const auto& name : columns) {
+    const auto it = std::find(pixel_column_names.begin(), pixel_column_names.end(), name);
+    if (it == pixel_column_names.end()) {
+      throw std::runtime_error(
+          fmt::format(FMT_STRING("unknown column \"{}\". Valid columns are: {}"), name,
+                      fmt::join(pixel_column_names, ", ")));
+    }
+    const auto col = static_cast<PixelColumn>(std::distance(pixel_column_names.begin(), it));
+    if (std::find(parsed_columns.begin(), parsed_columns.end(), col) != parsed_columns.end()) {
+      throw std::runtime_error(
+          fmt::format(FMT_STRING("column \"{}\" was requested more than once"), name));
+    }
+    parsed_columns.push_back(col);
+  }
+  return parsed_columns;
+}
+
+[[nodiscard]] static std::shared_ptr<arrow::Array> make_chrom_dictionary(
+    const hictk::BinTable& bins) {
+  arrow::StringBuilder builder{};
+  for (const auto& chrom : bins.chromosomes()) {
+    if (chrom.is_all()) {
+      continue;
+    }
+    if (auto status = builder.Append(std::string{chrom.name()}); !status.ok()) {
+      throw std::runtime_error(status.ToString());
+    }
+  }
+
+  auto result = builder.Finish();
+  if (!result.ok()) {
+    throw std::runtime_error(result.status().ToString());
+  }
+  return result.MoveValueUnsafe();
+}
+
+// Compute the chromosome (field=CHROM1/CHROM2), start or end position of the bins with the given
+// IDs. Chromosomes are dictionary-encoded using the given dictionary
+[[nodiscard]] static std::shared_ptr<arrow::ChunkedArray> map_bin_ids(
+    const arrow::ChunkedArray& bin_ids, const BinCoordinateMapper& mapper, PixelColumn field,
+    const std::shared_ptr<arrow::Array>& chrom_dictionary) {
+  const auto chrom_dict_type = dictionary(arrow::int32(), arrow::utf8());
+  const auto is_chrom = field == PixelColumn::CHROM1 || field == PixelColumn::CHROM2;
+  const auto is_start = field == PixelColumn::START1 || field == PixelColumn::START2;
+
+  arrow::ArrayVector chunks{};
+  std::size_t chrom_idx{};
+  for (const auto& chunk : bin_ids.chunks()) {
+    assert(chunk->type_id() == arrow::Type::UINT64);
+    const auto& ids = static_cast<const arrow::UInt64Array&>(*chunk);
+    const auto num_rows = static_cast<std::size_t>(ids.length());
+
+    if (is_chrom) {
+      std::vector<std::int32_t> buff(num_rows);
+      for (std::size_t i = 0; i < num_rows; ++i) {
+        buff[i] = mapper.map(ids.Value(static_cast<std::int64_t>(i)), chrom_idx).chrom_id;
+      }
+      chunks.emplace_back(std::make_shared<arrow::DictionaryArray>(
+          chrom_dict_type,
+          std::make_shared<arrow::Int32Array>(ids.length(),
+                                              arrow::Buffer::FromVector(std::move(buff)), nullptr,
+                                              0, 0),
+          chrom_dictionary));
+      continue;
+    }
+
+    std::vector<std::uint32_t> buff(num_rows);
+    for (std::size_t i = 0; i < num_rows; ++i) {
+      const auto coords = mapper.map(ids.Value(static_cast<std::int64_t>(i)), chrom_idx);
+      buff[i] = is_start ? coords.start : coords.end;
+    }
+    chunks.emplace_back(std::make_shared<arrow::UInt32Array>(
+        ids.length(), arrow::Buffer::FromVector(std::move(buff)), nullptr, 0, 0));
+  }
+
+  return std::make_shared<arrow::ChunkedArray>(
+      std::move(chunks), is_chrom ? chrom_dict_type : arrow::uint32());
+}
+
+// Build a table with the given columns from a table of pixels in COO format.
+// Genomic coordinates are computed directly from bin IDs, so that only the requested columns are
+// ever materialized
+[[nodiscard]] static std::shared_ptr<arrow::Table> project_pixel_table(
+    const arrow::Table& table, const hictk::BinTable& bins,
+    const std::vector<PixelColumn>& columns) {
+  const BinCoordinateMapper mapper(bins);
+  const auto chrom_dictionary = make_chrom_dictionary(bins);
+
+  arrow::FieldVector fields{};
+  std::vector<std::shared_ptr<arrow::ChunkedArray>> data{};
+  for (const auto col : columns) {
+    const std::string name{pixel_column_names[static_cast<std::size_t>(col)]};
+    switch (col) {
+      case PixelColumn::BIN1_ID:
+        [[fallthrough]];
+      case PixelColumn::BIN2_ID:
+        [[fallthrough]];
+      case PixelColumn::COUNT:
+        fields.emplace_back(table.schema()->GetFieldByName(name));
+        data.emplace_back(table.GetColumnByName(name));
+        break;
+      default: {
+        const auto first_anchor = col == PixelColumn::CHROM1 || col == PixelColumn::START1 ||
+                                  col == PixelColumn::END1;
+        const auto& bin_ids = *table.GetColumnByName(first_anchor ? "bin1_id" : "bin2_id");
+        data.emplace_back(map_bin_ids(bin_ids, mapper, col, chrom_dictionary));
+        fields.emplace_back(arrow::field(name, data.back()->type(), false));
+      }
+    }
+    assert(fields.back() && data.back());
+  }
+
+  return arrow::Table::Make(arrow::schema(std::move(fields)), std::move(data), table.num_rows());
+}
+
+// Replace the uint64 bin1_id and bin2_id columns of the given table with uint32 columns.
+// Callers should make sure that all bin IDs fit in 32 bits
+[[nodiscard]] static std::shared_ptr<arrow::Table> narrow_bin_id_columns(
+    std::shared_ptr<arrow::Table> table) {
+  for (const auto* name : {"bin1_id", "bin2_id"}) {
+    const auto i = table->schema()->GetFieldIndex(name);
+    if (i < 0) {
+      continue;
+    }
+
+    arrow::ArrayVector chunks{};
+    for (const auto& chunk : table->column(i)->chunks()) {
+      assert(chunk->type_id() == arrow::Type::UINT64);
+      const auto& bin_ids = static_cast<const arrow::UInt64Array&>(*chunk);
+      std::vector<std::uint32_t> buff(static_cast<std::size_t>(bin_ids.length()));
+      std::transform(bin_ids.raw_values(), bin_ids.raw_values() + bin_ids.length(), buff.begin(),
+                     [](std::uint64_t bin_id) { return static_cast<std::uint32_t>(bin_id); });
+      chunks.emplace_back(std::make_shared<arrow::UInt32Array>(
+          bin_ids.length(), arrow::Buffer::FromVector(std::move(buff)), nullptr, 0, 0));
+    }
+
+    auto result =
+        table->SetColumn(i, arrow::field(name, arrow::uint32(), false),
+                         std::make_shared<arrow::ChunkedArray>(std::move(chunks), arrow::uint32()));
+    if (!result.ok()) {
+      throw std::runtime_error(result.status().ToString());
+    }
+    table = result.MoveValueUnsafe();
+  }
+  return table;
+}
+
+nb::object PixelSelector::to_arrow(std::string_view span, std::optional<std::string_view> transform,
+                                   const std::optional<std::vector<std::string>>& columns) const {
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.to_arrow"};
   std::ignore = import_pyarrow_checked();
 
   const auto query_span = parse_span(span);
-  auto table = std::visit(
-      [&](const auto& sel_ptr) -> std::shared_ptr<arrow::Table> {
-        assert(!!sel_ptr);
-        return std::visit(
-            [&]([[maybe_unused]] auto count) -> std::shared_ptr<arrow::Table> {
-              using N = decltype(count);
-              if (pixel_format == PixelFormat::BG2) {
-                return make_bg2_arrow_df<N>(*sel_ptr, query_span);
-              }
-              assert(pixel_format == PixelFormat::COO);
-              return make_coo_arrow_df<N>(*sel_ptr, query_span);
-            },
-            pixel_count);
-      },
-      selector);
+  const auto transform_ = parse_transform(transform);
+  const auto projection =
+      columns.has_value() ? parse_pixel_columns(*columns) : std::vector<PixelColumn>{};
+  // Projections are computed from tables in COO format
+  const auto format = projection.empty() ? pixel_format : PixelFormat::COO;
+
+  auto& cache = get_query_cache();
+  auto key = make_query_cache_key(
+      "to_arrow",
+      fmt::format(FMT_STRING("{}\t{}\t{}\t{}"), span, static_cast<int>(transform_),
+                  narrow_bin_ids ? "uint32" : "uint64",
+                  columns.has_value() ? fmt::format(FMT_STRING("{}"), fmt::join(*columns, ","))
+                                      : std::string{}));
+  if (auto cached = cache.get(key, cache_path); cached.has_value()) {
+    if (auto* table = std::get_if<QueryCache::Table>(&*cached); table) {
+      profiling::add_counter("query_cache_hits", 1);
+      profiling::add_counter("pixels", (*table)->num_rows());
+      return export_pyarrow_table(*table);
+    }
+  }
 
+  const auto partition_query =
+      transform_ == Transform::NONE && can_partition_genome_wide_query(selector, n_threads);
+
+  auto table = run_without_gil([&]() {
+    auto table_ = std::visit(
+        [&](const auto& sel_ptr) -> std::shared_ptr<arrow::Table> {
+          assert(!!sel_ptr);
+          using SelT = remove_cvref_t<decltype(*sel_ptr)>;
+          if constexpr (is_partitionable_selector_v<SelT>) {
+            if (partition_query) {
+              return std::visit(
+                  [&]([[maybe_unused]] auto count) {
+                    return make_genome_wide_arrow_df<decltype(count)>(
+                        *sel_ptr, cache_path, format, query_span, n_threads);
+                  },
+                  pixel_count);
+            }
+          }
+          if (transform_ == Transform::OBSERVED_OVER_EXPECTED) {
+            const auto pixels = fetch_observed_over_expected(*sel_ptr);
+            return hictk::transformers::ToDataFrame(pixels.begin(), pixels.end(), format,
+                                                    sel_ptr->bins_ptr(), query_span)();
+          }
+          return std::visit(
+              [&]([[maybe_unused]] auto count) -> std::shared_ptr<arrow::Table> {
+                using N = decltype(count);
+                if (format == PixelFormat::BG2) {
+                  return make_bg2_arrow_df<N>(*sel_ptr, query_span);
+                }
+                assert(format == PixelFormat::COO);
+                return make_coo_arrow_df<N>(*sel_ptr, query_span);
+              },
+              pixel_count);
+        },
+        selector);
+    if (!projection.empty()) {
+      table_ = project_pixel_table(*table_, bins(), projection);
+    }
+    if (narrow_bin_ids) {
+      return narrow_bin_id_columns(std::move(table_));
+    }
+    return table_;
+  });
+
+  profiling::add_counter("pixels", table->num_rows());
+  cache.put(std::move(key), cache_path, table);
   return export_pyarrow_table(std::move(table));
 }
 
-nb::object PixelSelector::to_pandas(std::string_view span) const {
+// Lazily convert the pixels produced by a hictk PixelSelector to record batches of at most
+// batch_size rows.
+// All operations touching the underlying selector (including destroying the pixel iterators) are
+// performed while holding the lock on the file.
+template <typename N, typename SelT>
+class PixelRecordBatchReader : public arrow::RecordBatchReader {
+  using PixelIt = decltype(std::declval<const SelT&>().template begin<N>());
+
+  std::shared_ptr<const SelT> _sel{};
+  std::shared_ptr<FileMutex> _mtx{};
+  std::optional<PixelIt> _first{};
+  std::optional<PixelIt> _last{};
+
+  PixelSelector::PixelFormat _format{PixelSelector::PixelFormat::COO};
+  std::size_t _batch_size{};
+  std::vector<hictk::ThinPixel<N>> _buffer{};
+  std::shared_ptr<arrow::Schema> _schema{};
+
+ public:
+  PixelRecordBatchReader(std::shared_ptr<const SelT> sel, std::shared_ptr<FileMutex> mtx,
+                         PixelSelector::PixelFormat format, std::size_t batch_size)
+      : _sel(std::move(sel)),
+        _mtx(std::move(mtx)),
+        _first(_sel->template begin<N>()),
+        _last(_sel->template end<N>()),
+        _format(format),
+        _batch_size(batch_size),
+        _schema(make_table()->schema()) {
+    assert(_batch_size != 0);
+  }
+
+  PixelRecordBatchReader(const PixelRecordBatchReader&) = delete;
+  PixelRecordBatchReader(PixelRecordBatchReader&&) = delete;
+
+  ~PixelRecordBatchReader() noexcept override {
+    try {
+      [[maybe_unused]] const auto lck = lock_file(*_mtx);
+      _first.reset();
+      _last.reset();
+      _sel.reset();
+    } catch (...) {  // NOLINT
+    }
+  }
+
+  PixelRecordBatchReader& operator=(const PixelRecordBatchReader&) = delete;
+  PixelRecordBatchReader& operator=(PixelRecordBatchReader&&) = delete;
+
+  [[nodiscard]] std::shared_ptr<arrow::Schema> schema() const override { return _schema; }
+
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch>* batch) override {
+    assert(batch);
+    try {
+      _buffer.clear();
+      {
+        // The GIL is usually released by the consumer before calling ReadNext()
+        [[maybe_unused]] const auto lck = lock_file(*_mtx);
+        if (_first.has_value()) {
+          for (; *_first != *_last && _buffer.size() < _batch_size; ++(*_first)) {
+            _buffer.emplace_back(**_first);
+          }
+        }
+      }
+
+      if (_buffer.empty()) {
+        *batch = nullptr;
+        return arrow::Status::OK();
+      }
+
+      auto result = make_table()->CombineChunksToBatch();
+      if (!result.ok()) {
+        return result.status();
+      }
+      *batch = result.MoveValueUnsafe();
+      return arrow::Status::OK();
+    } catch (const std::exception& e) {
+      return arrow::Status::UnknownError(e.what());
+    }
+  }
+
+  arrow::Status Close() override {
+    _buffer.clear();
+    _buffer.shrink_to_fit();
+    return arrow::Status::OK();
+  }
+
+ private:
+  [[nodiscard]] std::shared_ptr<arrow::Table> make_table() const {
+    return hictk::transformers::ToDataFrame(_buffer.begin(), _buffer.end(), _format,
+                                            _sel->bins_ptr(),
+                                            hictk::transformers::QuerySpan::upper_triangle, false,
+                                            true, _batch_size)();
+  }
+};
+
+std::shared_ptr<arrow::RecordBatchReader> PixelSelector::make_record_batch_reader(
+    std::size_t batch_size) const {
+  if (batch_size == 0) {
+    throw std::runtime_error("batch_size should be a positive number");
+  }
+
+  return run_without_gil([&]() {
+    return std::visit(
+        [&](const auto& sel_ptr) -> std::shared_ptr<arrow::RecordBatchReader> {
+          assert(!!sel_ptr);
+          using SelT = remove_cvref_t<decltype(*sel_ptr)>;
+          return std::visit(
+              [&]([[maybe_unused]] auto count) -> std::shared_ptr<arrow::RecordBatchReader> {
+                using N = std::conditional_t<std::is_same_v<decltype(count), long double>, double,
+                                             decltype(count)>;
+                return std::make_shared<PixelRecordBatchReader<N, SelT>>(sel_ptr, mtx,
+                                                                         pixel_format, batch_size);
+              },
+              pixel_count);
+        },
+        selector);
+  });
+}
+
+nb::object PixelSelector::to_arrow_stream(std::size_t batch_size) const {
+  std::ignore = import_pyarrow_checked();
+  // The stream outlives this call: hold a reference to the Python PixelSelector (which in turn
+  // keeps the File alive), as the underlying hictk selector refers to datasets owned by the File
+  return export_pyarrow_record_batch_reader(make_record_batch_reader(batch_size),
+                                            nb::find(*this));
+}
+
+nb::object PixelSelector::arrow_c_stream([[maybe_unused]] const nb::any& requested_schema) const {
+  // Requests for a different schema are ignored, as suggested by the specification of the
+  // PyCapsule interface for producers that do not support casting
+  return export_arrow_c_stream(make_record_batch_reader(default_batch_size), nb::find(*this));
+}
+
+nb::object PixelSelector::to_pandas(std::string_view span,
+                                    const std::optional<std::vector<std::string>>& columns) const {
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.to_pandas"};
   import_module_checked("pandas");
-  return to_arrow(span).attr("to_pandas")(nb::arg("self_destruct") = true);
+  auto table = to_arrow(span, {}, columns);
+  [[maybe_unused]] const profiling::Stage stage{"to_pandas"};
+  return table.attr("to_pandas")(nb::arg("self_destruct") = true);
+}
+
+nb::object PixelSelector::to_df(std::string_view span,
+                                const std::optional<std::vector<std::string>>& columns) const {
+  return to_pandas(span, columns);
 }
 
-nb::object PixelSelector::to_df(std::string_view span) const { return to_pandas(span); }
+namespace {
+// Shape of the matrix returned by to_numpy() and offsets used to map bin IDs to rows/columns.
+// This mirrors the logic used by hictk::transformers::ToDenseMatrix
+struct DenseMatrixLayout {
+  std::int64_t num_rows{};
+  std::int64_t num_cols{};
+  std::int64_t row_offset{};
+  std::int64_t col_offset{};
+};
+}  // namespace
+
+template <typename PixelSelectorT>
+[[nodiscard]] static DenseMatrixLayout compute_dense_matrix_layout(const PixelSelectorT& sel) {
+  if constexpr (hictk::transformers::internal::has_coord1_member_fx<PixelSelectorT>) {
+    const auto num_bins = [&](const hictk::PixelCoordinates& coords) {
+      if (coords.bin2.end() == coords.bin1.start()) {
+        return static_cast<std::int64_t>(sel.bins().size());
+      }
+      return static_cast<std::int64_t>(coords.bin2.id() - coords.bin1.id() + 1);
+    };
+    const auto offset = [](const hictk::PixelCoordinates& coords) {
+      constexpr auto bad_bin_id = std::numeric_limits<std::uint64_t>::max();
+      return static_cast<std::int64_t>(coords.bin1.id() == bad_bin_id ? 0 : coords.bin1.id());
+    };
+    return {num_bins(sel.coord1()), num_bins(sel.coord2()), offset(sel.coord1()),
+            offset(sel.coord2())};
+  } else {
+    const auto num_bins = static_cast<std::int64_t>(sel.bins().size());
+    return {num_bins, num_bins, 0, 0};
+  }
+}
 
-template <typename N, typename PixelSelector>
-[[nodiscard]] static nb::object make_csr_matrix(std::shared_ptr<const PixelSelector> sel,
-                                                hictk::transformers::QuerySpan span) {
-  if constexpr (std::is_same_v<N, long double>) {
-    return make_csr_matrix<double>(std::move(sel), span);
+// Mask rows/columns whose weights are not finite
+[[nodiscard]] static std::vector<bool> compute_weight_mask(const hictk::balancing::Weights& weights,
+                                                           std::int64_t offset,
+                                                           std::int64_t size) {
+  std::vector<bool> mask(static_cast<std::size_t>(size), false);
+  if (weights.empty() || weights.is_vector_of_ones()) {
+    return mask;
+  }
+
+  for (std::size_t i = 0; i < mask.size(); ++i) {
+    mask[i] = !std::isfinite(weights.at(static_cast<std::size_t>(offset) + i,
+                                        hictk::balancing::Weights::Type::MULTIPLICATIVE));
+  }
+  return mask;
+}
+
+template <typename N, typename PixelSelectorT, typename MatrixView>
+static void fill_dense_matrix(const PixelSelectorT& sel, hictk::transformers::QuerySpan span,
+                              const DenseMatrixLayout& layout, MatrixView& matrix,
+                              PixelSelector::Transform transform) {
+  using QuerySpan = hictk::transformers::QuerySpan;
+  using Transform = PixelSelector::Transform;
+  // Weights for Cooler files are indexed by absolute bin IDs, while weights for .hic files are
+  // indexed by bin IDs relative to the chromosome (except when fetching genome-wide interactions)
+  constexpr bool absolute_weight_ids =
+      std::is_same_v<remove_band_selector_t<PixelSelectorT>, hictk::cooler::PixelSelector> ||
+      std::is_same_v<PixelSelectorT, hictk::hic::PixelSelectorAll>;
+  constexpr bool has_weights = hictk::transformers::internal::has_weights_member_fx<PixelSelectorT>;
+
+  const auto& weights1 = [&]() -> const auto& {
+    if constexpr (has_weights) {
+      return sel.weights();
+    } else {
+      return sel.weights1();
+    }
+  }();
+  const auto& weights2 = [&]() -> const auto& {
+    if constexpr (has_weights) {
+      return sel.weights();
+    } else {
+      return sel.weights2();
+    }
+  }();
+
+  if constexpr (!std::is_floating_point_v<N>) {
+    if (!weights1.is_vector_of_ones() || !weights2.is_vector_of_ones()) {
+      throw std::runtime_error(
+          "invalid parameters: count_type should be of floating-point type when fetching "
+          "normalized interactions");
+    }
+  }
+
+  // Computing O/E values requires reading all pixels before the first value can be written
+  std::vector<hictk::ThinPixel<double>> oe_pixels{};
+  if constexpr (std::is_same_v<N, double>) {
+    if (transform == Transform::OBSERVED_OVER_EXPECTED) {
+      oe_pixels = fetch_observed_over_expected(sel);
+    }
   } else {
-    return nb::cast(hictk::transformers::ToSparseMatrix(std::move(sel), N{}, span)());
+    assert(transform == Transform::NONE);
+  }
+
+  // Initialize the matrix with zeros (or NaNs for rows/columns that cannot be balanced)
+  const auto [weights_offset1, weights_offset2] = [&]() -> std::pair<std::int64_t, std::int64_t> {
+    if constexpr (absolute_weight_ids) {
+      return {layout.row_offset, layout.col_offset};
+    } else {
+      return {static_cast<std::int64_t>(sel.coord1().bin1.rel_id()),
+              static_cast<std::int64_t>(sel.coord2().bin1.rel_id())};
+    }
+  }();
+  std::vector<bool> row_mask(static_cast<std::size_t>(layout.num_rows), false);
+  std::vector<bool> col_mask(static_cast<std::size_t>(layout.num_cols), false);
+  if constexpr (std::is_floating_point_v<N>) {
+    row_mask = compute_weight_mask(weights1, weights_offset1, layout.num_rows);
+    col_mask = compute_weight_mask(weights2, weights_offset2, layout.num_cols);
+  }
+  for (std::int64_t i = 0; i < layout.num_rows; ++i) {
+    for (std::int64_t j = 0; j < layout.num_cols; ++j) {
+      if constexpr (std::is_floating_point_v<N>) {
+        const auto masked =
+            row_mask[static_cast<std::size_t>(i)] || col_mask[static_cast<std::size_t>(j)];
+        matrix(i, j) = masked ? std::numeric_limits<N>::quiet_NaN() : N{0};
+      } else {
+        matrix(i, j) = N{0};
+      }
+    }
+  }
+
+  const auto populate_lower_triangle =
+      span == QuerySpan::lower_triangle || span == QuerySpan::full;
+  const auto populate_upper_triangle =
+      span == QuerySpan::upper_triangle || span == QuerySpan::full;
+  const auto matrix_setter = [](MatrixView& m, std::int64_t i1, std::int64_t i2,
+                                N count) noexcept { m(i1, i2) = count; };
+
+  if constexpr (std::is_same_v<N, double>) {
+    if (transform == Transform::OBSERVED_OVER_EXPECTED) {
+      hictk::transformers::internal::fill_matrix(
+          oe_pixels.begin(), oe_pixels.end(),
+          hictk::transformers::internal::selector_is_symmetric_upper(sel), matrix, matrix,
+          layout.num_rows, layout.num_cols, layout.row_offset, layout.col_offset,
+          populate_lower_triangle, populate_upper_triangle, matrix_setter);
+      return;
+    }
+  }
+
+  if constexpr (hictk::transformers::internal::has_coord1_member_fx<PixelSelectorT>) {
+    if (sel.coord1().bin1.chrom() == sel.coord2().bin1.chrom() && sel.coord1() != sel.coord2()) {
+      auto coord3 = sel.coord1();
+      auto coord4 = sel.coord2();
+      coord3.bin1 = std::min(coord3.bin1, coord4.bin1);
+      coord3.bin2 = std::max(coord3.bin2, coord4.bin2);
+      coord4 = coord3;
+
+      const auto new_sel = sel.fetch(coord3, coord4);
+      hictk::transformers::internal::fill_matrix(
+          new_sel.template begin<N>(), new_sel.template end<N>(),
+          hictk::transformers::internal::selector_is_symmetric_upper(new_sel), matrix, matrix,
+          layout.num_rows, layout.num_cols, layout.row_offset, layout.col_offset,
+          populate_lower_triangle, populate_upper_triangle, matrix_setter);
+      return;
+    }
   }
+
+  hictk::transformers::internal::fill_matrix(
+      sel.template begin<N>(), sel.template end<N>(),
+      hictk::transformers::internal::selector_is_symmetric_upper(sel), matrix, matrix,
+      layout.num_rows, layout.num_cols, layout.row_offset, layout.col_offset,
+      populate_lower_triangle, populate_upper_triangle, matrix_setter);
 }
 
-nb::object PixelSelector::to_csr(std::string_view span) const {
-  import_module_checked("scipy");
+namespace {
+// Row/column/data buffers of a sparse matrix in COO format
+template <typename I, typename N>
+struct CooBuffers {
+  std::vector<I> row{};
+  std::vector<I> col{};
+  std::vector<N> data{};
+  // Whether pixels were appended in non-decreasing row order
+  bool sorted_by_row{true};
+
+  void push_back(std::int64_t i1, std::int64_t i2, N count) {
+    sorted_by_row = sorted_by_row && (row.empty() || static_cast<std::int64_t>(row.back()) <= i1);
+    row.push_back(static_cast<I>(i1));
+    col.push_back(static_cast<I>(i2));
+    data.push_back(count);
+  }
+};
+}  // namespace
+
+// long double is not supported by scipy.sparse
+template <typename N>
+using sparse_count_t = std::conditional_t<std::is_same_v<N, long double>, double, N>;
+
+// Use 32-bit indices whenever the matrix shape allows it: this halves the memory footprint of the
+// index buffers and avoids a copy when handing them to scipy, which prefers int32 indices
+[[nodiscard]] static bool sparse_indices_fit_int32(const DenseMatrixLayout& layout) noexcept {
+  constexpr auto max_index = static_cast<std::int64_t>(std::numeric_limits<std::int32_t>::max());
+  return layout.num_rows <= max_index && layout.num_cols <= max_index;
+}
+
+// Stream pixels overlapping the given selector into COO buffers with a single pass.
+// Rows/columns are mapped to matrix coordinates using the same logic as fill_dense_matrix()
+template <typename I, typename N, typename PixelSelectorT>
+[[nodiscard]] static CooBuffers<I, N> fetch_coo_buffers(const PixelSelectorT& sel,
+                                                       hictk::transformers::QuerySpan span,
+                                                       const DenseMatrixLayout& layout) {
+  using QuerySpan = hictk::transformers::QuerySpan;
+  constexpr bool has_weights = hictk::transformers::internal::has_weights_member_fx<PixelSelectorT>;
+
+  if constexpr (!std::is_floating_point_v<N>) {
+    const auto balanced = [&]() {
+      if constexpr (has_weights) {
+        return !sel.weights().is_vector_of_ones();
+      } else {
+        return !sel.weights1().is_vector_of_ones() || !sel.weights2().is_vector_of_ones();
+      }
+    }();
+    if (balanced) {
+      throw std::runtime_error(
+          "invalid parameters: count_type should be of floating-point type when fetching "
+          "normalized interactions");
+    }
+  }
+
+  const auto populate_lower_triangle =
+      span == QuerySpan::lower_triangle || span == QuerySpan::full;
+  const auto populate_upper_triangle =
+      span == QuerySpan::upper_triangle || span == QuerySpan::full;
+  const auto matrix_setter = [](CooBuffers<I, N>& buffers, std::int64_t i1, std::int64_t i2,
+                                N count) { buffers.push_back(i1, i2, count); };
+
+  CooBuffers<I, N> buffers{};
+  if constexpr (hictk::transformers::internal::has_coord1_member_fx<PixelSelectorT>) {
+    const auto cis = sel.coord1().bin1.chrom() == sel.coord2().bin1.chrom();
+    if (!cis && span == QuerySpan::lower_triangle) {
+      throw std::runtime_error(
+          "invalid parameters: trans queries do not support query_span=\"lower_triangle\"");
+    }
+    if (cis && sel.coord1() != sel.coord2()) {
+      auto coord3 = sel.coord1();
+      auto coord4 = sel.coord2();
+      coord3.bin1 = std::min(coord3.bin1, coord4.bin1);
+      coord3.bin2 = std::max(coord3.bin2, coord4.bin2);
+      coord4 = coord3;
+
+      const auto new_sel = sel.fetch(coord3, coord4);
+      hictk::transformers::internal::fill_matrix(
+          new_sel.template begin<N>(), new_sel.template end<N>(),
+          hictk::transformers::internal::selector_is_symmetric_upper(new_sel), buffers, buffers,
+          layout.num_rows, layout.num_cols, layout.row_offset, layout.col_offset,
+          populate_lower_triangle, populate_upper_triangle, matrix_setter);
+      return buffers;
+    }
+  }
+
+  hictk::transformers::internal::fill_matrix(
+      sel.template begin<N>(), sel.template end<N>(),
+      hictk::transformers::internal::selector_is_symmetric_upper(sel), buffers, buffers,
+      layout.num_rows, layout.num_cols, layout.row_offset, layout.col_offset,
+      populate_lower_triangle, populate_upper_triangle, matrix_setter);
+  return buffers;
+}
+
+// Same as fetch_coo_buffers(), but processing a genome-wide query one chromosome pair at a time.
+// Stripes are concatenated in chromosome order, so the resulting buffers are sorted by row
+template <typename I, typename N, typename SelT>
+[[nodiscard]] static CooBuffers<I, N> fetch_genome_wide_coo_buffers(
+    const SelT& sel, const std::filesystem::path& path, hictk::transformers::QuerySpan span,
+    std::size_t n_threads) {
+  const auto partition = partition_genome_wide_query(sel.bins());
+
+  // Stripes are appended to the (preallocated) buffers in chromosome order as soon as all the
+  // stripes preceding them have been appended, and are freed right after. This way only the stripes
+  // that are waiting for their turn coexist with the buffers, instead of the entire query
+  std::mutex mtx{};
+  std::vector<std::optional<std::vector<hictk::ThinPixel<N>>>> stripes(
+      partition.chromosomes.size());
+  std::size_t next_stripe{0};
+  CooBuffers<I, N> buffers{};
+
+  visit_genome_wide_stripes<N>(
+      sel, path, partition, span, n_threads,
+      [&](std::size_t nnz) {
+        buffers.row.reserve(nnz);
+        buffers.col.reserve(nnz);
+        buffers.data.reserve(nnz);
+      },
+      [&](std::size_t i, std::vector<hictk::ThinPixel<N>> pixels) {
+        [[maybe_unused]] const auto lck = std::scoped_lock(mtx);
+        stripes[i] = std::move(pixels);
+        for (; next_stripe < stripes.size() && stripes[next_stripe].has_value(); ++next_stripe) {
+          for (const auto& p : *stripes[next_stripe]) {
+            buffers.push_back(static_cast<std::int64_t>(p.bin1_id),
+                              static_cast<std::int64_t>(p.bin2_id), p.count);
+          }
+          stripes[next_stripe] = std::vector<hictk::ThinPixel<N>>{};
+        }
+      });
+  assert(buffers.sorted_by_row);
+  return buffers;
+}
+
+[[nodiscard]] static nb::tuple make_sparse_matrix_shape(const DenseMatrixLayout& layout) {
+  return nb::make_tuple(layout.num_rows, layout.num_cols);
+}
+
+template <typename I, typename N>
+[[nodiscard]] static nb::object make_scipy_coo_matrix(CooBuffers<I, N> buffers,
+                                                      const DenseMatrixLayout& layout) {
+  auto ss = nb::module_::import_("scipy.sparse");
+  auto data = make_numpy_array(std::move(buffers.data));
+  auto row = make_numpy_array(std::move(buffers.row));
+  auto col = make_numpy_array(std::move(buffers.col));
+
+  return ss.attr("coo_matrix")(nb::make_tuple(data, nb::make_tuple(row, col)),
+                               nb::arg("shape") = make_sparse_matrix_shape(layout),
+                               nb::arg("copy") = false);
+}
+
+// Build the CSR representation of the given COO buffers using a counting sort on the row indices.
+// This is a no-op for buffers that are already sorted by row (e.g. for queries on the upper
+// triangle), in which case col and data are moved into the CSR matrix without copying.
+// Both indices and indptr use the Index type: scipy requires the two arrays to share the same
+// dtype and would otherwise copy both of them
+template <typename Index, typename I, typename N>
+[[nodiscard]] static nb::object make_scipy_csr_matrix(CooBuffers<I, N> buffers,
+                                                      const DenseMatrixLayout& layout) {
+  const auto nnz = buffers.data.size();
+
+  std::vector<Index> indptr(static_cast<std::size_t>(layout.num_rows) + 1, 0);
+  for (const auto i : buffers.row) {
+    ++indptr[static_cast<std::size_t>(i) + 1];
+  }
+  for (std::size_t i = 1; i < indptr.size(); ++i) {
+    indptr[i] += indptr[i - 1];
+  }
+  assert(static_cast<std::size_t>(indptr.back()) == nnz);
+
+  std::vector<Index> indices{};
+  std::vector<N> data{};
+  if (buffers.sorted_by_row) {
+    if constexpr (std::is_same_v<Index, I>) {
+      indices = std::move(buffers.col);
+    } else {
+      indices.assign(buffers.col.begin(), buffers.col.end());
+      buffers.col = {};
+    }
+    data = std::move(buffers.data);
+  } else {
+    indices.resize(nnz);
+    data.resize(nnz);
+    auto offsets = indptr;
+    for (std::size_t k = 0; k < nnz; ++k) {
+      const auto j = static_cast<std::size_t>(offsets[static_cast<std::size_t>(buffers.row[k])]++);
+      indices[j] = static_cast<Index>(buffers.col[k]);
+      data[j] = buffers.data[k];
+    }
+  }
+  buffers = {};
+
+  auto ss = nb::module_::import_("scipy.sparse");
+  return ss.attr("csr_matrix")(
+      nb::make_tuple(make_numpy_array(std::move(data)), make_numpy_array(std::move(indices)),
+                     make_numpy_array(std::move(indptr))),
+      nb::arg("shape") = make_sparse_matrix_shape(layout), nb::arg("copy") = false);
+}
+
+nb::object PixelSelector::to_coo(std::string_view span) const {
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.to_coo"};
+  std::ignore = import_module_checked("scipy");
   const auto query_span = parse_span(span);
 
   return std::visit(
-      [&](auto sel_ptr) -> nb::object {
+      [&](const auto& sel_ptr) -> nb::object {
+        assert(!!sel_ptr);
+        const auto layout = compute_dense_matrix_layout(*sel_ptr);
         return std::visit(
             [&]([[maybe_unused]] auto count) -> nb::object {
-              using N = decltype(count);
-              return make_csr_matrix<N>(std::move(sel_ptr), query_span);
+              using N = sparse_count_t<decltype(count)>;
+              const auto make_matrix = [&]([[maybe_unused]] auto index) {
+                using I = decltype(index);
+                auto buffers = run_without_gil(
+                    [&]() { return fetch_coo_buffers<I, N>(*sel_ptr, query_span, layout); });
+                profiling::add_counter("pixels", static_cast<std::int64_t>(buffers.data.size()));
+                [[maybe_unused]] const profiling::Stage stage{"export"};
+                return make_scipy_coo_matrix(std::move(buffers), layout);
+              };
+              if (sparse_indices_fit_int32(layout)) {
+                return make_matrix(std::int32_t{});
+              }
+              return make_matrix(std::int64_t{});
             },
             pixel_count);
       },
       selector);
 }
 
-nb::object PixelSelector::to_coo(std::string_view span) const {
-  import_module_checked("scipy");
-  return to_csr(span).attr("tocoo")(false);
+nb::object PixelSelector::to_csr(std::string_view span) const {
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.to_csr"};
+  std::ignore = import_module_checked("scipy");
+  const auto query_span = parse_span(span);
+  const auto partition_query = can_partition_genome_wide_query(selector, n_threads);
+
+  return std::visit(
+      [&](const auto& sel_ptr) -> nb::object {
+        assert(!!sel_ptr);
+        using SelT = remove_cvref_t<decltype(*sel_ptr)>;
+        const auto layout = compute_dense_matrix_layout(*sel_ptr);
+        return std::visit(
+            [&]([[maybe_unused]] auto count) -> nb::object {
+              using N = sparse_count_t<decltype(count)>;
+              const auto make_matrix = [&]([[maybe_unused]] auto index) {
+                using I = decltype(index);
+                auto buffers = run_without_gil([&]() {
+                  if constexpr (is_partitionable_selector_v<SelT>) {
+                    if (partition_query) {
+                      return fetch_genome_wide_coo_buffers<I, N>(*sel_ptr, cache_path, query_span,
+                                                                 n_threads);
+                    }
+                  }
+                  return fetch_coo_buffers<I, N>(*sel_ptr, query_span, layout);
+                });
+                const auto nnz = static_cast<std::int64_t>(buffers.data.size());
+                profiling::add_counter("pixels", nnz);
+                [[maybe_unused]] const profiling::Stage stage{"export"};
+                // indptr stores offsets into the indices/data arrays, so both arrays switch to
+                // 64-bit integers when either nnz or the matrix shape does not fit in 32 bits
+                if (nnz <= std::numeric_limits<I>::max()) {
+                  return make_scipy_csr_matrix<I>(std::move(buffers), layout);
+                }
+                return make_scipy_csr_matrix<std::int64_t>(std::move(buffers), layout);
+              };
+              if (sparse_indices_fit_int32(layout)) {
+                return make_matrix(std::int32_t{});
+              }
+              return make_matrix(std::int64_t{});
+            },
+            pixel_count);
+      },
+      selector);
 }
 
+template <typename T>
+inline constexpr bool is_band_selector_v = !std::is_same_v<remove_band_selector_t<T>, T>;
+
 template <typename N, typename PixelSelector>
-[[nodiscard]] static nb::object make_numpy_matrix(std::shared_ptr<const PixelSelector> sel,
-                                                  hictk::transformers::QuerySpan span) {
+[[nodiscard]] static auto make_numpy_matrix(std::shared_ptr<const PixelSelector> sel,
+                                            hictk::transformers::QuerySpan span) {
   if constexpr (std::is_same_v<N, long double>) {
     return make_numpy_matrix<double>(std::move(sel), span);
+  } else if constexpr (is_band_selector_v<PixelSelector>) {
+    // hictk::transformers::ToDenseMatrix only supports the selectors defined by hictk
+    const auto layout = compute_dense_matrix_layout(*sel);
+    using MatrixT = Eigen::Matrix<N, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    MatrixT matrix(layout.num_rows, layout.num_cols);
+    fill_dense_matrix<N>(*sel, span, layout, matrix, hictkpy::PixelSelector::Transform::NONE);
+    return matrix;
   } else {
-    return nb::cast(hictk::transformers::ToDenseMatrix(std::move(sel), N{}, span)());
+    return hictk::transformers::ToDenseMatrix(std::move(sel), N{}, span)();
   }
 }
 
 nb::object PixelSelector::to_numpy(std::string_view span) const {
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.to_numpy"};
   std::ignore = import_module_checked("numpy");
 
   const auto query_span = parse_span(span);
 
+  auto& cache = get_query_cache();
+  auto key = make_query_cache_key("to_numpy", span);
+
   return std::visit(
       [&](auto sel_ptr) -> nb::object {
         return std::visit(
             [&]([[maybe_unused]] auto count) -> nb::object {
               using N = decltype(count);
-              return make_numpy_matrix<N>(std::move(sel_ptr), query_span);
+              using MatrixT = decltype(make_numpy_matrix<N>(sel_ptr, query_span));
+              using Scalar = typename MatrixT::Scalar;
+
+              if (auto cached = cache.get(key, cache_path); cached.has_value()) {
+                using DenseMatrix = std::shared_ptr<const QueryCache::DenseMatrix>;
+                if (auto* dense = std::get_if<DenseMatrix>(&*cached); dense) {
+                  profiling::add_counter("query_cache_hits", 1);
+                  MatrixT matrix((*dense)->num_rows, (*dense)->num_cols);
+                  assert((*dense)->uncompressed_bytes ==
+                         static_cast<std::size_t>(matrix.size()) * sizeof(Scalar));
+                  QueryCache::decode(**dense, matrix.data());
+                  [[maybe_unused]] const profiling::Stage stage{"export"};
+                  return nb::cast(std::move(matrix));
+                }
+              }
+
+              auto matrix =
+                  run_without_gil([&]() { return make_numpy_matrix<N>(sel_ptr, query_span); });
+              if (!key.empty() && cache.enabled()) {
+                // Matrices are copied into the cache, as numpy arrays returned to callers can be
+                // modified in-place
+                auto dense = [&]() {
+                  [[maybe_unused]] const nb::gil_scoped_release release{};
+                  return cache.encode(matrix.data(),
+                                      static_cast<std::size_t>(matrix.size()) * sizeof(Scalar),
+                                      matrix.rows(), matrix.cols());
+                }();
+                cache.put(std::move(key), cache_path, std::move(dense));
+              }
+              [[maybe_unused]] const profiling::Stage stage{"export"};
+              return nb::cast(std::move(matrix));
             },
             pixel_count);
       },
       selector);
 }
 
+// Cast out to a 2D matrix of type N with the shape described by layout
+template <typename N>
+[[nodiscard]] static auto cast_dense_matrix(const nb::object& out,
+                                            const DenseMatrixLayout& layout) {
+  using MatrixT = nb::ndarray<N, nb::ndim<2>, nb::device::cpu>;
+
+  // Casting without implicit conversions ensures that data is written to the buffer
+  // owned by out instead of to a temporary copy
+  MatrixT matrix{};
+  if (!nb::try_cast(out, matrix, false)) {
+    const auto found = nb::hasattr(out, "dtype") ? nb::cast<std::string>(nb::str(out.attr("dtype")))
+                                                 : nb::cast<std::string>(nb::str(out.type()));
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("out should be a writable 2D array with dtype {} (found {})"),
+                    map_type_to_dtype<N>(), found));
+  }
+
+  if (static_cast<std::int64_t>(matrix.shape(0)) != layout.num_rows ||
+      static_cast<std::int64_t>(matrix.shape(1)) != layout.num_cols) {
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("out has the wrong shape: expected ({}, {}), found ({}, {})"),
+                    layout.num_rows, layout.num_cols, matrix.shape(0), matrix.shape(1)));
+  }
+
+  return matrix;
+}
+
+nb::object PixelSelector::to_numpy(std::string_view span, const nb::object& out,
+                                   std::optional<std::string_view> transform) const {
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.to_numpy"};
+  const auto transform_ = parse_transform(transform);
+  if (out.is_none() && transform_ == Transform::NONE) {
+    return to_numpy(span);
+  }
+
+  auto np = import_module_checked("numpy");
+
+  const auto query_span = parse_span(span);
+  auto out_ = out;
+
+  std::visit(
+      [&](const auto& sel_ptr) {
+        assert(!!sel_ptr);
+        using SelT = remove_cvref_t<decltype(*sel_ptr)>;
+
+        const auto layout = compute_dense_matrix_layout(*sel_ptr);
+        if constexpr (hictk::transformers::internal::has_coord1_member_fx<SelT>) {
+          if (sel_ptr->coord1().bin1.chrom() != sel_ptr->coord2().bin1.chrom() &&
+              query_span == hictk::transformers::QuerySpan::lower_triangle) {
+            throw std::runtime_error(
+                "invalid parameters: trans queries do not support "
+                "query_span=\"lower_triangle\"");
+          }
+        }
+
+        const auto fill = [&]([[maybe_unused]] auto count) {
+          using N = std::conditional_t<std::is_same_v<decltype(count), long double>, double,
+                                       decltype(count)>;
+          auto matrix = cast_dense_matrix<N>(out_, layout);
+          auto view = matrix.view();
+          run_without_gil(
+              [&]() { fill_dense_matrix<N>(*sel_ptr, query_span, layout, view, transform_); });
+        };
+
+        if (transform_ == Transform::OBSERVED_OVER_EXPECTED) {
+          // O/E values are always returned as float64
+          if (out_.is_none()) {
+            out_ = np.attr("empty")(nb::make_tuple(layout.num_rows, layout.num_cols),
+                                    nb::arg("dtype") = "float64");
+          }
+          fill(double{});
+          return;
+        }
+
+        std::visit(fill, pixel_count);
+      },
+      selector);
+
+  return out_;
+}
+
+// Fill matrix with the interactions overlapping the band using banded storage, i.e. such that
+// matrix(i, k) stores the interactions between the i-th and (i + k)-th bins of the query
+template <typename N, typename SelT, typename MatrixView>
+static void fill_band_matrix(const BandPixelSelector<SelT>& sel, MatrixView& matrix) {
+  const auto num_bins = static_cast<std::int64_t>(sel.num_bins());
+  const auto num_diagonals = static_cast<std::int64_t>(sel.num_diagonals());
+  const auto first_bin_id = static_cast<std::int64_t>(sel.coord1().bin1.id());
+
+  if constexpr (!std::is_floating_point_v<N>) {
+    if (!sel.weights1().is_vector_of_ones()) {
+      throw std::runtime_error(
+          "invalid parameters: count_type should be of floating-point type when fetching "
+          "normalized interactions");
+    }
+  }
+
+  std::vector<bool> mask(static_cast<std::size_t>(num_bins), false);
+  if constexpr (std::is_floating_point_v<N>) {
+    const auto weights_offset =
+        std::is_same_v<SelT, hictk::cooler::PixelSelector>
+            ? first_bin_id
+            : static_cast<std::int64_t>(sel.coord1().bin1.rel_id());
+    mask = compute_weight_mask(sel.weights1(), weights_offset, num_bins);
+  }
+
+  // Initialize the matrix with zeros (or NaNs for pixels overlapping bins that cannot be balanced).
+  // Entries past the end of the query are always set to 0
+  for (std::int64_t i = 0; i < num_bins; ++i) {
+    for (std::int64_t k = 0; k < num_diagonals; ++k) {
+      const auto j = i + k;
+      const auto masked = j < num_bins && (mask[static_cast<std::size_t>(i)] ||
+                                           mask[static_cast<std::size_t>(j)]);
+      if constexpr (std::is_floating_point_v<N>) {
+        matrix(i, k) = masked ? std::numeric_limits<N>::quiet_NaN() : N{0};
+      } else {
+        matrix(i, k) = N{0};
+      }
+    }
+  }
+
+  std::for_each(sel.template begin<N>(), sel.template end<N>(), [&](const auto& p) {
+    const auto i = static_cast<std::int64_t>(p.bin1_id) - first_bin_id;
+    const auto k = static_cast<std::int64_t>(p.bin2_id - p.bin1_id);
+    assert(i >= 0 && i < num_bins);
+    assert(k >= 0 && k < num_diagonals);
+    matrix(i, k) = p.count;
+  });
+}
+
+nb::object PixelSelector::to_band() const {
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.to_band"};
+  auto np = import_module_checked("numpy");
+
+  return std::visit(
+      [&](const auto& sel_ptr) -> nb::object {
+        assert(!!sel_ptr);
+        using SelT = remove_cvref_t<decltype(*sel_ptr)>;
+        if constexpr (!is_band_selector_v<SelT>) {
+          throw std::runtime_error(
+              "to_band() can only be called on selectors returned by File.fetch() with "
+              "max_distance");
+        } else {
+          return std::visit(
+              [&]([[maybe_unused]] auto count) -> nb::object {
+                using N = std::conditional_t<std::is_same_v<decltype(count), long double>, double,
+                                             decltype(count)>;
+                const DenseMatrixLayout layout{
+                    static_cast<std::int64_t>(sel_ptr->num_bins()),
+                    static_cast<std::int64_t>(sel_ptr->num_diagonals()), 0, 0};
+                auto out = np.attr("empty")(nb::make_tuple(layout.num_rows, layout.num_cols),
+                                            nb::arg("dtype") = std::string{map_type_to_dtype<N>()});
+                auto matrix = cast_dense_matrix<N>(out, layout);
+                auto view = matrix.view();
+                run_without_gil([&]() { fill_band_matrix<N>(*sel_ptr, view); });
+                return out;
+              },
+              pixel_count);
+        }
+      },
+      selector);
+}
+
+nb::object PixelSelector::expected() const {
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.expected"};
+  std::ignore = import_pyarrow_checked();
+
+  auto table = run_without_gil([&]() {
+    return std::visit(
+        [&](const auto& sel_ptr) {
+          assert(!!sel_ptr);
+          return compute_expected(*sel_ptr).to_arrow();
+        },
+        selector);
+  });
+
+  return export_pyarrow_table(std::move(table))
+      .attr("to_pandas")(nb::arg("self_destruct") = true);
+}
+
+// Aggregate the pixels of a genome-wide query one chromosome pair at a time: the statistics of
+// each pair are computed independently and are then merged.
+// Pairs are read and aggregated by up to n_threads threads
+template <typename N, typename SelT>
+[[nodiscard]] static Stats aggregate_genome_wide_pixels(
+    const SelT& sel, const std::filesystem::path& path, std::size_t n_threads,
+    const phmap::flat_hash_set<std::string>& metrics) {
+  const auto partition = partition_genome_wide_query(sel.bins());
+  const auto num_workers = std::max(std::size_t{1}, std::min(n_threads, partition.pairs.size()));
+  BS::thread_pool tpool(conditional_static_cast<BS::concurrency_t>(num_workers));
+  return PixelAggregator::compute_sharded<N, false, false>(
+      partition.pairs.size(),
+      [&](auto&& fx) {
+        visit_chromosome_pairs<N>(sel, path, partition, tpool, num_workers,
+                                  std::forward<decltype(fx)>(fx));
+      },
+      metrics);
+}
+
+// Genome-wide queries are sharded by chromosome pair when n_threads > 1
 template <typename N, typename PixelSelector>
-[[nodiscard]] static Stats aggregate_pixels(const PixelSelector& sel, bool keep_nans,
-                                            bool keep_infs, bool exact,
+[[nodiscard]] static Stats aggregate_pixels(const PixelSelector& sel,
+                                            const std::filesystem::path& path,
+                                            std::size_t n_threads, bool keep_nans, bool keep_infs,
+                                            bool exact,
                                             const phmap::flat_hash_set<std::string>& metrics) {
   static_assert(!std::is_same_v<PixelSelector, hictk::PixelSelector>);
+  if constexpr (is_partitionable_selector_v<PixelSelector>) {
+    // Sharding is only supported when non-finite values are either impossible or dropped.
+    // Moments of the shards are merged exactly, so estimates (exact=false) are never sharded
+    const auto finite_only = std::is_integral_v<N> || (!keep_nans && !keep_infs);
+    const auto compute_moments = metrics.contains("variance") || metrics.contains("skewness") ||
+                                 metrics.contains("kurtosis");
+    if (finite_only && (exact || !compute_moments) && n_threads > 1) {
+      return aggregate_genome_wide_pixels<N>(sel, path, n_threads, metrics);
+    }
+  }
+
   if (keep_nans && keep_infs) {
     return PixelAggregator{}.compute<N, true, true>(sel, metrics, exact);
   }
@@ -304,10 +1882,11 @@ template <typename N, typename PixelSelector>
   return PixelAggregator{}.compute<N, false, false>(sel, metrics, exact);
 }
 
-[[nodiscard]] static Stats aggregate_pixels(const PixelSelector::SelectorVar& sel,
-                                            const PixelSelector::PixelVar& count, bool keep_nans,
+[[nodiscard]] static Stats aggregate_pixels(const PixelSelector& sel, bool keep_nans,
                                             bool keep_infs, bool exact,
                                             const phmap::flat_hash_set<std::string>& metrics) {
+  const auto n_threads =
+      can_partition_genome_wide_query(sel.selector, sel.n_threads) ? sel.n_threads : 1;
   return std::visit(
       [&](const auto& sel_ptr) {
         assert(sel_ptr);
@@ -315,17 +1894,20 @@ template <typename N, typename PixelSelector>
             [&]([[maybe_unused]] const auto& count_) {
               using CountT = remove_cvref_t<decltype(count_)>;
               using N = std::conditional_t<std::is_floating_point_v<CountT>, double, std::int64_t>;
-              return aggregate_pixels<N>(*sel_ptr, keep_nans, keep_infs, exact, metrics);
+              return aggregate_pixels<N>(*sel_ptr, sel.cache_path, n_threads, keep_nans,
+                                         keep_infs, exact, metrics);
             },
-            count);
+            sel.pixel_count);
       },
-      sel);
+      sel.selector);
 }
 
 nb::dict PixelSelector::describe(const std::vector<std::string>& metrics, bool keep_nans,
                                  bool keep_infs, bool exact) const {
-  const auto stats = aggregate_pixels(selector, pixel_count, keep_nans, keep_infs, exact,
-                                      {metrics.begin(), metrics.end()});
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.describe"};
+  const auto stats = run_without_gil([&]() {
+    return aggregate_pixels(*this, keep_nans, keep_infs, exact, {metrics.begin(), metrics.end()});
+  });
 
   using StatsDict =
       nanobind::typed<nanobind::dict, std::string, std::variant<std::int64_t, double>>;
@@ -368,41 +1950,62 @@ nb::dict PixelSelector::describe(const std::vector<std::string>& metrics, bool k
 }
 
 std::int64_t PixelSelector::nnz(bool keep_nans, bool keep_infs) const {
-  return *aggregate_pixels(selector, pixel_count, keep_nans, keep_infs, false, {"nnz"}).nnz;
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.nnz"};
+  return *run_without_gil([&]() {
+            return aggregate_pixels(*this, keep_nans, keep_infs, false, {"nnz"});
+          }).nnz;
 }
 
 nb::object PixelSelector::sum(bool keep_nans, bool keep_infs) const {
-  const auto stats = aggregate_pixels(selector, pixel_count, keep_nans, keep_infs, false, {"sum"});
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.sum"};
+  const auto stats = run_without_gil([&]() {
+    return aggregate_pixels(*this, keep_nans, keep_infs, false, {"sum"});
+  });
   return std::visit([](const auto n) -> nb::object { return nb::cast(n); }, *stats.sum);
 }
 
 nb::object PixelSelector::min(bool keep_nans, bool keep_infs) const {
-  const auto stats = aggregate_pixels(selector, pixel_count, keep_nans, keep_infs, false, {"min"});
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.min"};
+  const auto stats = run_without_gil([&]() {
+    return aggregate_pixels(*this, keep_nans, keep_infs, false, {"min"});
+  });
   return std::visit([](const auto n) -> nb::object { return nb::cast(n); }, *stats.min);
 }
 
 nb::object PixelSelector::max(bool keep_nans, bool keep_infs) const {
-  const auto stats = aggregate_pixels(selector, pixel_count, keep_nans, keep_infs, false, {"max"});
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.max"};
+  const auto stats = run_without_gil([&]() {
+    return aggregate_pixels(*this, keep_nans, keep_infs, false, {"max"});
+  });
   return std::visit([](const auto n) -> nb::object { return nb::cast(n); }, *stats.max);
 }
 
 double PixelSelector::mean(bool keep_nans, bool keep_infs) const {
-  return *aggregate_pixels(selector, pixel_count, keep_nans, keep_infs, false, {"mean"}).mean;
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.mean"};
+  return *run_without_gil([&]() {
+            return aggregate_pixels(*this, keep_nans, keep_infs, false, {"mean"});
+          }).mean;
 }
 
 double PixelSelector::variance(bool keep_nans, bool keep_infs, bool exact) const {
-  return *aggregate_pixels(selector, pixel_count, keep_nans, keep_infs, exact, {"variance"})
-              .variance;
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.variance"};
+  return *run_without_gil([&]() {
+            return aggregate_pixels(*this, keep_nans, keep_infs, exact, {"variance"});
+          }).variance;
 }
 
 double PixelSelector::skewness(bool keep_nans, bool keep_infs, bool exact) const {
-  return *aggregate_pixels(selector, pixel_count, keep_nans, keep_infs, exact, {"skewness"})
-              .skewness;
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.skewness"};
+  return *run_without_gil([&]() {
+            return aggregate_pixels(*this, keep_nans, keep_infs, exact, {"skewness"});
+          }).skewness;
 }
 
 double PixelSelector::kurtosis(bool keep_nans, bool keep_infs, bool exact) const {
-  return *aggregate_pixels(selector, pixel_count, keep_nans, keep_infs, exact, {"kurtosis"})
-              .kurtosis;
+  [[maybe_unused]] const profiling::Operation op{"PixelSelector.kurtosis"};
+  return *run_without_gil([&]() {
+            return aggregate_pixels(*this, keep_nans, keep_infs, exact, {"kurtosis"});
+          }).kurtosis;
 }
 
 auto PixelSelector::parse_span(std::string_view span) -> QuerySpan {
@@ -426,6 +2029,35 @@ auto PixelSelector::parse_count_type(std::string_view type) -> PixelVar {
   return map_dtype_to_type(type);
 }
 
+void PixelSelector::validate_count_type(std::string_view type) {
+  if (type != "int" && type != "int32" && type != "uint32" && type != "float" &&
+      type != "float32" && type != "float64") {
+    throw std::runtime_error(
+        R"(count_type should be one of "int", "int32", "uint32", "float", "float32", or )"
+        R"("float64")");
+  }
+}
+
+std::string_view PixelSelector::promote_count_type(std::string_view type,
+                                                   bool normalized) noexcept {
+  if (normalized && (type == "int" || type == "int32" || type == "uint32")) {
+    return "float";
+  }
+  return type;
+}
+
+auto PixelSelector::parse_transform(std::optional<std::string_view> transform) -> Transform {
+  if (!transform.has_value()) {
+    return Transform::NONE;
+  }
+  if (*transform == "oe") {
+    return Transform::OBSERVED_OVER_EXPECTED;
+  }
+
+  throw std::runtime_error(fmt::format(
+      FMT_STRING("unrecognized transform \"{}\". Supported transforms are: oe"), *transform));
+}
+
 std::string_view PixelSelector::count_type_to_str(const PixelVar& var) {
   // NOLINTBEGIN(*-avoid-magic-numbers)
   static_assert(sizeof(float) == 4);
@@ -467,6 +2099,14 @@ std::string_view PixelSelector::count_type_to_str(const PixelVar& var) {
 }
 
 void PixelSelector::bind(nb::module_& m) {
+  nb::class_<PixelChunkIterator>(m, "PixelChunkIterator",
+                                 "Iterator over chunks of pixels stored as numpy arrays.")
+      .def(
+          "__iter__", [](PixelChunkIterator& it) -> PixelChunkIterator& { return it; },
+          nb::rv_policy::reference_internal)
+      .def("__next__", &PixelChunkIterator::next, nb::sig("def __next__(self) -> dict"),
+           nb::rv_policy::take_ownership);
+
   auto sel = nb::class_<PixelSelector>(
       m, "PixelSelector",
       "Class representing pixels overlapping with the given genomic intervals.");
@@ -488,27 +2128,100 @@ void PixelSelector::bind(nb::module_& m) {
   sel.def("__iter__", &PixelSelector::make_iterable, nb::keep_alive<0, 1>(),
           nb::sig("def __iter__(self) -> hictkpy.PixelIterator"),
           "Return an iterator over the selected pixels.", nb::rv_policy::take_ownership);
+  sel.def("iter_chunks", &PixelSelector::iter_chunks, nb::keep_alive<0, 1>(),
+          nb::arg("chunk_size") = PixelSelector::default_batch_size,
+          nb::sig("def iter_chunks(self, chunk_size: int = 256000) -> hictkpy.PixelChunkIterator"),
+          "Return an iterator over chunks of at most chunk_size pixels.\n"
+          "Each chunk is a dictionary mapping column names (bin1_id, bin2_id, and count) to numpy "
+          "arrays. When the selector was created with join=True, chunks also contain the genomic "
+          "coordinates of each pixel (chrom1_id, start1, end1, chrom2_id, start2, and end2). "
+          "Chromosome IDs refer to the chromosomes returned by File.chromosomes().",
+          nb::rv_policy::move);
 
   sel.def("to_arrow", &PixelSelector::to_arrow, nb::arg("query_span") = "upper_triangle",
-          nb::sig("def to_arrow(self, query_span: str = \"upper_triangle\") -> pyarrow.Table"),
-          "Retrieve interactions as a pyarrow.Table.", nb::rv_policy::take_ownership);
+          nb::arg("transform") = nb::none(), nb::arg("columns") = nb::none(),
+          nb::sig("def to_arrow(self, query_span: str = \"upper_triangle\", transform: str | None "
+                  "= None, columns: collections.abc.Sequence[str] | None = None) -> pyarrow.Table"),
+          "Retrieve interactions as a pyarrow.Table.\n"
+          "When transform=\"oe\", counts are replaced by the ratio of observed over expected "
+          "interactions (see expected()). Expected values are computed while interactions are "
+          "being read.\n"
+          "When columns is provided, the table only contains the given columns, in the given "
+          "order. Valid columns are: bin1_id, bin2_id, chrom1, start1, end1, chrom2, start2, end2, "
+          "and count. Genomic coordinates are computed from bin IDs, so only the requested columns "
+          "are materialized (regardless of the value of join passed to File.fetch()). Chromosome "
+          "columns are always dictionary-encoded.",
+          nb::rv_policy::take_ownership);
+  sel.def("to_arrow_stream", &PixelSelector::to_arrow_stream,
+          nb::arg("batch_size") = PixelSelector::default_batch_size,
+          nb::sig("def to_arrow_stream(self, batch_size: int = 256000) -> pyarrow.RecordBatchReader"),
+          "Retrieve interactions as a pyarrow.RecordBatchReader.\n"
+          "Interactions are read lazily, in batches of at most batch_size pixels. "
+          "Interactions are always restricted to the upper triangle of the query.",
+          nb::rv_policy::take_ownership);
+  sel.def("__arrow_c_stream__", &PixelSelector::arrow_c_stream,
+          nb::arg("requested_schema") = nb::none(),
+          nb::sig("def __arrow_c_stream__(self, requested_schema: object | None = None) -> object"),
+          "Export interactions through the Arrow PyCapsule interface (see to_arrow_stream()).",
+          nb::rv_policy::take_ownership);
   sel.def("to_pandas", &PixelSelector::to_pandas, nb::arg("query_span") = "upper_triangle",
-          nb::sig("def to_pandas(self, query_span: str = \"upper_triangle\") -> pandas.DataFrame"),
-          "Retrieve interactions as a pandas DataFrame.", nb::rv_policy::take_ownership);
+          nb::arg("columns") = nb::none(),
+          nb::sig("def to_pandas(self, query_span: str = \"upper_triangle\", columns: "
+                  "collections.abc.Sequence[str] | None = None) -> pandas.DataFrame"),
+          "Retrieve interactions as a pandas DataFrame (see to_arrow() for the meaning of "
+          "columns).",
+          nb::rv_policy::take_ownership);
   sel.def("to_df", &PixelSelector::to_df, nb::arg("query_span") = "upper_triangle",
-          nb::sig("def to_df(self, query_span: str = \"upper_triangle\") -> pandas.DataFrame"),
+          nb::arg("columns") = nb::none(),
+          nb::sig("def to_df(self, query_span: str = \"upper_triangle\", columns: "
+                  "collections.abc.Sequence[str] | None = None) -> pandas.DataFrame"),
           "Alias to to_pandas().", nb::rv_policy::take_ownership);
-  sel.def("to_numpy", &PixelSelector::to_numpy, nb::arg("query_span") = "full",
-          nb::sig("def to_numpy(self, query_span: str = \"full\") -> numpy.ndarray"),
-          "Retrieve interactions as a numpy 2D matrix.", nb::rv_policy::move);
+  sel.def("to_numpy",
+          nb::overload_cast<std::string_view, const nb::object&, std::optional<std::string_view>>(
+              &PixelSelector::to_numpy, nb::const_),
+          nb::arg("query_span") = "full", nb::arg("out") = nb::none(),
+          nb::arg("transform") = nb::none(),
+          nb::sig("def to_numpy(self, query_span: str = \"full\", out: numpy.ndarray | None = "
+                  "None, transform: str | None = None) -> numpy.ndarray"),
+          "Retrieve interactions as a numpy 2D matrix. When out is provided, interactions are "
+          "written directly to the given array (e.g. a numpy.memmap or a view of a larger "
+          "matrix), which should have the same dtype as the selector count_type and the same "
+          "shape as the matrix being fetched. In this case, out is returned.\n"
+          "When transform=\"oe\", the matrix contains the ratio of observed over expected "
+          "interactions (see expected()) and its dtype is always float64.",
+          nb::rv_policy::move);
+  sel.def("to_band", &PixelSelector::to_band,
+          nb::sig("def to_band(self) -> numpy.ndarray"),
+          "Retrieve the interactions overlapping the band as a numpy 2D matrix using banded "
+          "storage. The matrix has shape (num_bins, max_distance + 1), where max_distance is "
+          "expressed in bins, and element (i, k) stores the interactions between the i-th and "
+          "(i + k)-th bins of the query. Elements past the end of the query are set to 0.\n"
+          "Only available for selectors returned by File.fetch() with max_distance.",
+          nb::rv_policy::move);
+  sel.def("expected", &PixelSelector::expected,
+          nb::sig("def expected(self) -> pandas.DataFrame"),
+          "Compute the expected number of interactions as a function of the distance from the "
+          "diagonal.\n"
+          "Return a pandas.DataFrame with one row per diagonal and the following columns: dist "
+          "(the distance from the diagonal in bins), n_valid (the number of pixels in the "
+          "diagonal that do not overlap bins with non-finite weights), count.sum, and count.avg "
+          "(i.e. count.sum / n_valid). Expected values are computed from the interactions "
+          "overlapping the current query, which should be a cis query where range1 and range2 "
+          "are identical.",
+          nb::rv_policy::take_ownership);
   sel.def(
       "to_coo", &PixelSelector::to_coo, nb::arg("query_span") = "upper_triangle",
       nb::sig("def to_coo(self, query_span: str = \"upper_triangle\") -> scipy.sparse.coo_matrix"),
-      "Retrieve interactions as a SciPy COO matrix.", nb::rv_policy::take_ownership);
+      "Retrieve interactions as a SciPy COO matrix.\n"
+      "Row and column indices are stored as 32-bit integers whenever the matrix shape allows it.",
+      nb::rv_policy::take_ownership);
   sel.def(
       "to_csr", &PixelSelector::to_csr, nb::arg("query_span") = "upper_triangle",
       nb::sig("def to_csr(self, query_span: str = \"upper_triangle\") -> scipy.sparse.csr_matrix"),
-      "Retrieve interactions as a SciPy CSR matrix.", nb::rv_policy::move);
+      "Retrieve interactions as a SciPy CSR matrix.\n"
+      "Indices and index pointers are stored as 32-bit integers whenever the matrix shape and "
+      "number of non-zero entries allow it.",
+      nb::rv_policy::take_ownership);
 
   static const std::vector<std::string> known_metrics(PixelAggregator::valid_metrics.begin(),
                                                       PixelAggregator::valid_metrics.end());
@@ -0,0 +1,374 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#include "hictkpy/profiling.hpp"
+
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "hictkpy/nanobind.hpp"
+
+namespace nb = nanobind;
+
+namespace hictkpy::profiling {
+
+namespace {
+struct QueryRegistry {
+  std::mutex mtx{};
+  std::deque<QueryStats> queries{};
+  std::size_t max_queries{100'000};
+};
+}  // namespace
+
+static std::atomic<bool>& enabled_flag() noexcept {
+  static std::atomic<bool> enabled{false};
+  return enabled;
+}
+
+static std::atomic<Clock::rep>& epoch() noexcept {
+  static std::atomic<Clock::rep> epoch_{Clock::now().time_since_epoch().count()};
+  return epoch_;
+}
+
+static QueryRegistry& get_registry() {
+  static QueryRegistry registry{};
+  return registry;
+}
+
+// Stats for the operation running on the current thread (nullptr when no operation is running or
+// when profiling is disabled)
+static thread_local QueryStats* current_query{};  // NOLINT(*-avoid-non-const-global-variables)
+
+[[nodiscard]] static std::int64_t to_us(Clock::duration d) noexcept {
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+[[nodiscard]] static std::int64_t us_since_epoch(Clock::time_point t) noexcept {
+  const Clock::time_point epoch_{Clock::duration{epoch().load(std::memory_order_relaxed)}};
+  return to_us(t - epoch_);
+}
+
+[[nodiscard]] static double us_to_seconds(std::int64_t us) noexcept {
+  return static_cast<double>(us) / 1.0e6;
+}
+
+std::int64_t QueryStats::stage_duration_us(std::string_view name) const noexcept {
+  std::int64_t duration{};
+  for (const auto& stage : stages) {
+    if (stage.name == name) {
+      duration += stage.duration_us;
+    }
+  }
+  return duration;
+}
+
+std::int64_t QueryStats::gil_held_us() const noexcept {
+  if (!started_with_gil) {
+    return stage_duration_us("gil_acquired");
+  }
+  return std::max(std::int64_t{0}, duration_us - stage_duration_us("gil_released"));
+}
+
+std::string QueryStats::repr() const {
+  return fmt::format(FMT_STRING("QueryStats(operation={}; duration={:.6f}s; gil_held={:.6f}s)"),
+                     operation, us_to_seconds(duration_us), us_to_seconds(gil_held_us()));
+}
+
+nb::dict QueryStats::stages_to_dict() const {
+  // Stages are aggregated by name
+  nb::dict stages_py{};
+  for (const auto& stage : stages) {
+    if (!stages_py.contains(stage.name.c_str())) {
+      stages_py[stage.name.c_str()] = us_to_seconds(stage_duration_us(stage.name));
+    }
+  }
+  stages_py["gil_held"] = us_to_seconds(gil_held_us());
+  return stages_py;
+}
+
+nb::dict QueryStats::counters_to_dict() const {
+  nb::dict counters_py{};
+  for (const auto& [name, value] : counters) {
+    counters_py[name.c_str()] = value;
+  }
+  return counters_py;
+}
+
+nb::dict QueryStats::to_dict() const {
+  nb::dict stats{};
+  stats["operation"] = operation;
+  stats["thread_id"] = thread_id;
+  stats["start"] = us_to_seconds(start_us);
+  stats["duration"] = us_to_seconds(duration_us);
+  stats["stages"] = stages_to_dict();
+  stats["counters"] = counters_to_dict();
+  return stats;
+}
+
+bool is_enabled() noexcept { return enabled_flag().load(std::memory_order_relaxed); }
+
+void enable(std::size_t max_queries) {
+  if (max_queries == 0) {
+    throw std::runtime_error("max_queries should be greater than 0");
+  }
+  auto& registry = get_registry();
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+    registry.max_queries = max_queries;
+    while (registry.queries.size() > registry.max_queries) {
+      registry.queries.pop_front();
+    }
+  }
+  enabled_flag().store(true, std::memory_order_relaxed);
+}
+
+void disable() noexcept { enabled_flag().store(false, std::memory_order_relaxed); }
+
+void reset() {
+  auto& registry = get_registry();
+  [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+  registry.queries.clear();
+  epoch().store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+std::vector<QueryStats> get_queries() {
+  auto& registry = get_registry();
+  [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+  return {registry.queries.begin(), registry.queries.end()};
+}
+
+Operation::Operation(std::string_view name) {
+  if (!is_enabled() || current_query) {
+    return;
+  }
+
+  _stats = std::make_unique<QueryStats>();
+  _stats->operation = std::string{name};
+  _stats->thread_id = std::hash<std::thread::id>{}(std::this_thread::get_id());
+  _stats->started_with_gil = PyGILState_Check() != 0;
+  _start = Clock::now();
+  _stats->start_us = us_since_epoch(_start);
+  current_query = _stats.get();
+}
+
+Operation::~Operation() noexcept {
+  if (!_stats) {
+    return;
+  }
+
+  current_query = nullptr;
+  _stats->duration_us = to_us(Clock::now() - _start);
+
+  try {
+    auto& registry = get_registry();
+    [[maybe_unused]] const auto lck = std::scoped_lock(registry.mtx);
+    registry.queries.emplace_back(std::move(*_stats));
+    while (registry.queries.size() > registry.max_queries) {
+      registry.queries.pop_front();
+    }
+  } catch (...) {  // NOLINT
+    // profiling should never cause an operation to fail
+  }
+}
+
+Stage::Stage(std::string_view name) noexcept : _stats(current_query), _name(name) {
+  if (_stats) {
+    _start = Clock::now();
+  }
+}
+
+Stage::~Stage() noexcept {
+  if (!_stats) {
+    return;
+  }
+
+  try {
+    _stats->stages.push_back(
+        {std::string{_name}, us_since_epoch(_start), to_us(Clock::now() - _start)});
+  } catch (...) {  // NOLINT
+    // profiling should never cause an operation to fail
+  }
+}
+
+void add_counter(std::string_view name, std::int64_t value) noexcept {
+  if (!current_query) {
+    return;
+  }
+
+  auto& counters = current_query->counters;
+  auto it = std::find_if(counters.begin(), counters.end(),
+                         [&](const auto& kv) { return kv.first == name; });
+  try {
+    if (it == counters.end()) {
+      counters.emplace_back(std::string{name}, value);
+    } else {
+      it->second += value;
+    }
+  } catch (...) {  // NOLINT
+    // profiling should never cause an operation to fail
+  }
+}
+
+// Aggregate the recorded queries by operation
+[[nodiscard]] static nb::dict summary() {
+  struct Summary {
+    std::int64_t calls{};
+    std::int64_t duration_us{};
+    std::map<std::string, std::int64_t> stages{};
+    std::map<std::string, std::int64_t> counters{};
+  };
+
+  std::map<std::string, Summary> summaries{};
+  for (const auto& query : get_queries()) {
+    auto& s = summaries[query.operation];
+    ++s.calls;
+    s.duration_us += query.duration_us;
+    for (const auto& stage : query.stages) {
+      s.stages[stage.name] += stage.duration_us;
+    }
+    s.stages["gil_held"] += query.gil_held_us();
+    for (const auto& [name, value] : query.counters) {
+      s.counters[name] += value;
+    }
+  }
+
+  nb::dict summary_py{};
+  for (const auto& [operation, s] : summaries) {
+    nb::dict stages{};
+    for (const auto& [name, duration] : s.stages) {
+      stages[name.c_str()] = us_to_seconds(duration);
+    }
+    nb::dict counters{};
+    for (const auto& [name, value] : s.counters) {
+      counters[name.c_str()] = value;
+    }
+
+    nb::dict entry{};
+    entry["calls"] = s.calls;
+    entry["total_time"] = us_to_seconds(s.duration_us);
+    entry["stages"] = stages;
+    entry["counters"] = counters;
+    summary_py[operation.c_str()] = entry;
+  }
+  return summary_py;
+}
+
+// Names of operations, stages, and counters are all defined by hictkpy and never contain characters
+// that need to be escaped
+[[nodiscard]] static std::string to_chrome_trace_event(std::string_view name, std::string_view cat,
+                                                       std::int64_t start_us,
+                                                       std::int64_t duration_us,
+                                                       std::uint64_t thread_id,
+                                                       std::string_view args = "{}") {
+  return fmt::format(
+      FMT_STRING(
+          R"({{"name":"{}","cat":"{}","ph":"X","ts":{},"dur":{},"pid":0,"tid":{},"args":{}}})"),
+      name, cat, start_us, duration_us, thread_id, args);
+}
+
+// Serialize the recorded queries using the Chrome trace event format
+// (see https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU)
+[[nodiscard]] static std::string to_chrome_trace(
+    const std::optional<std::filesystem::path>& path) {
+  std::vector<std::string> events{};
+  for (const auto& query : get_queries()) {
+    std::vector<std::string> counters{};
+    counters.reserve(query.counters.size());
+    for (const auto& [name, value] : query.counters) {
+      counters.emplace_back(fmt::format(FMT_STRING(R"("{}":{})"), name, value));
+    }
+    events.emplace_back(to_chrome_trace_event(
+        query.operation, "operation", query.start_us, query.duration_us, query.thread_id,
+        fmt::format(FMT_STRING("{{{}}}"), fmt::join(counters, ","))));
+    for (const auto& stage : query.stages) {
+      events.emplace_back(to_chrome_trace_event(stage.name, "stage", stage.start_us,
+                                                stage.duration_us, query.thread_id));
+    }
+  }
+
+  auto trace =
+      fmt::format(FMT_STRING(R"({{"traceEvents":[{}],"displayTimeUnit":"ms"}})"),
+                  fmt::join(events, ","));
+
+  if (path.has_value()) {
+    std::ofstream ofs{*path};
+    if (!ofs) {
+      throw std::runtime_error(
+          fmt::format(FMT_STRING("failed to open file \"{}\" for writing"), path->string()));
+    }
+    ofs << trace;
+  }
+
+  return trace;
+}
+
+void declare_profiling_module(nb::module_& m) {
+  auto profiling = m.def_submodule(
+      "profiling",
+      "Opt-in profiler recording how long the stages of PixelSelector operations and FileWriter "
+      "calls take.");
+
+  auto stats = nb::class_<QueryStats>(profiling, "QueryStats",
+                                      "Class representing the timings and counters recorded for "
+                                      "a single operation.");
+  stats.def("__repr__", &QueryStats::repr, nb::rv_policy::move);
+  stats.def_ro("operation", &QueryStats::operation, "Name of the operation.");
+  stats.def_ro("thread_id", &QueryStats::thread_id,
+               "Identifier of the thread that ran the operation.");
+  stats.def_prop_ro(
+      "start", [](const QueryStats& s) { return us_to_seconds(s.start_us); },
+      "Time when the operation started in seconds (relative to when the profiler was last "
+      "reset).");
+  stats.def_prop_ro(
+      "duration", [](const QueryStats& s) { return us_to_seconds(s.duration_us); },
+      "Duration of the operation in seconds.");
+  stats.def_prop_ro(
+      "stages", &QueryStats::stages_to_dict,
+      "Time spent in each stage of the operation in seconds.");
+  stats.def_prop_ro(
+      "counters", &QueryStats::counters_to_dict,
+      "Counters recorded by the operation (e.g. the number of pixels processed).");
+  stats.def("to_dict", &QueryStats::to_dict, "Return the recorded stats as a dictionary.",
+            nb::rv_policy::take_ownership);
+
+  profiling.def("enable", &enable, nb::arg("max_queries") = 100'000,
+                "Start profiling operations. Only the most recent max_queries operations are "
+                "kept.");
+  profiling.def("disable", &disable, "Stop profiling operations.");
+  profiling.def("is_enabled", &is_enabled, "Test whether profiling is enabled.");
+  profiling.def("reset", &reset, "Discard all operations recorded so far.");
+  profiling.def("queries", &get_queries,
+                "Get the list of QueryStats for the operations recorded so far.");
+  profiling.def("summary", &summary,
+                "Get a dictionary mapping each operation to the number of calls, the total time "
+                "spent in the operation and in each of its stages (in seconds), and the sum of "
+                "its counters.",
+                nb::rv_policy::take_ownership);
+  profiling.def("to_chrome_trace", &to_chrome_trace, nb::arg("path") = nb::none(),
+                "Serialize the operations recorded so far to a JSON string using the Chrome trace "
+                "event format (see e.g. chrome://tracing or https://ui.perfetto.dev). When path is "
+                "provided, the trace is also written to the given file.");
+}
+
+}  // namespace hictkpy::profiling
@@ -0,0 +1,509 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#include "hictkpy/query_cache.hpp"
+
+#include <arrow/table.h>
+#include <arrow/util/byte_size.h>
+#include <fmt/format.h>
+#include <libdeflate.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <hictk/file.hpp>
+#include <ios>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace hictkpy {
+
+namespace {
+struct CompressorDeleter {
+  void operator()(libdeflate_compressor* ptr) const noexcept { libdeflate_free_compressor(ptr); }
+};
+
+struct DecompressorDeleter {
+  void operator()(libdeflate_decompressor* ptr) const noexcept {
+    libdeflate_free_decompressor(ptr);
+  }
+};
+}  // namespace
+
+QueryCache::QueryCache() : _session_id(std::random_device{}()) {}
+
+QueryCache::~QueryCache() noexcept {
+  // No other thread can be using the cache at this point, so files can be removed directly
+  std::error_code ec{};
+  for (const auto& entry : _spilled_entries) {
+    if (!entry.unwritten) {
+      std::filesystem::remove(entry.path, ec);
+    }
+  }
+  for (const auto& path : _pending_removals) {
+    std::filesystem::remove(path, ec);
+  }
+}
+
+bool QueryCache::enabled() const noexcept {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _settings.capacity_bytes != 0;
+}
+
+auto QueryCache::get(const std::string& key, const std::filesystem::path& path)
+    -> std::optional<Value> {
+  if (key.empty() || !enabled()) {
+    return {};
+  }
+
+  const auto mtime = get_mtime(path);
+  if (!mtime.has_value()) {
+    return {};
+  }
+
+  std::optional<SpilledEntry> spilled{};
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+    if (auto match = _index.find(key); match != _index.end()) {
+      if (match->second->mtime == *mtime) {
+        ++_stats.hits;
+        _entries.splice(_entries.begin(), _entries, match->second);
+        return match->second->value;
+      }
+      ++_stats.invalidations;
+      erase_entry(match->second);
+    }
+
+    spilled = take_spilled_entry(key, *mtime);
+    if (!spilled.has_value()) {
+      ++_stats.misses;
+    }
+  }
+
+  if (!spilled.has_value()) {
+    process_pending_io();
+    return {};
+  }
+
+  auto value = load_spilled_entry(*spilled);
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+    if (value.has_value()) {
+      ++_stats.hits;
+      ++_stats.spill_hits;
+      // Move the entry back to memory: this may in turn spill other entries
+      const auto size_bytes = compute_size_bytes(key, *value);
+      insert(Entry{key, *mtime, *value, size_bytes});
+    } else {
+      ++_stats.misses;
+    }
+  }
+  process_pending_io();
+  return value;
+}
+
+void QueryCache::put(std::string key, const std::filesystem::path& path, Value value) {
+  if (key.empty() || !enabled()) {
+    return;
+  }
+
+  const auto mtime = get_mtime(path);
+  if (!mtime.has_value()) {
+    return;
+  }
+
+  const auto size_bytes = compute_size_bytes(key, value);
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+    insert(Entry{std::move(key), *mtime, std::move(value), size_bytes});
+  }
+  process_pending_io();
+}
+
+auto QueryCache::encode(const void* data, std::size_t size_bytes, std::int64_t num_rows,
+                        std::int64_t num_cols) const -> std::shared_ptr<const DenseMatrix> {
+  const auto compression_level = [&]() {
+    [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+    return _settings.compression_level;
+  }();
+
+  auto matrix = std::make_shared<DenseMatrix>();
+  matrix->num_rows = num_rows;
+  matrix->num_cols = num_cols;
+  matrix->uncompressed_bytes = size_bytes;
+
+  if (compression_level != 0 && size_bytes != 0) {
+    const std::unique_ptr<libdeflate_compressor, CompressorDeleter> compressor{
+        libdeflate_alloc_compressor(compression_level)};
+    if (!compressor) {
+      throw std::bad_alloc();
+    }
+
+    matrix->data.resize(libdeflate_deflate_compress_bound(compressor.get(), size_bytes));
+    const auto compressed_size = libdeflate_deflate_compress(
+        compressor.get(), data, size_bytes, matrix->data.data(), matrix->data.size());
+    // Matrices that do not compress well are stored as they are
+    if (compressed_size != 0 && compressed_size < size_bytes) {
+      matrix->data.resize(compressed_size);
+      matrix->data.shrink_to_fit();
+      matrix->compressed = true;
+      return matrix;
+    }
+  }
+
+  matrix->data.resize(size_bytes);
+  if (size_bytes != 0) {
+    std::memcpy(matrix->data.data(), data, size_bytes);
+  }
+  return matrix;
+}
+
+void QueryCache::decode(const DenseMatrix& matrix, void* buffer) {
+  if (!matrix.compressed) {
+    assert(matrix.data.size() == matrix.uncompressed_bytes);
+    if (!matrix.data.empty()) {
+      std::memcpy(buffer, matrix.data.data(), matrix.data.size());
+    }
+    return;
+  }
+
+  const std::unique_ptr<libdeflate_decompressor, DecompressorDeleter> decompressor{
+      libdeflate_alloc_decompressor()};
+  if (!decompressor) {
+    throw std::bad_alloc();
+  }
+
+  const auto status =
+      libdeflate_deflate_decompress(decompressor.get(), matrix.data.data(), matrix.data.size(),
+                                    buffer, matrix.uncompressed_bytes, nullptr);
+  if (status != LIBDEFLATE_SUCCESS) {
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("failed to decompress matrix from the query cache: libdeflate "
+                               "returned error code {}"),
+                    static_cast<int>(status)));
+  }
+}
+
+std::size_t QueryCache::size() const noexcept {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _entries.size();
+}
+
+std::size_t QueryCache::size_bytes() const noexcept {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _size_bytes;
+}
+
+std::size_t QueryCache::capacity_bytes() const noexcept {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _settings.capacity_bytes;
+}
+
+std::size_t QueryCache::num_spilled_entries() const noexcept {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _spilled_entries.size();
+}
+
+std::size_t QueryCache::spilled_bytes() const noexcept {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _spilled_bytes;
+}
+
+auto QueryCache::stats() const noexcept -> Stats {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _stats;
+}
+
+void QueryCache::set_settings(Settings settings) {
+  if (settings.compression_level < 0 || settings.compression_level > max_compression_level) {
+    throw std::runtime_error(fmt::format(
+        FMT_STRING("query cache compression level should be between 0 and {}, found {}"),
+        max_compression_level, settings.compression_level));
+  }
+  if (!settings.spill_dir.empty()) {
+    std::error_code ec{};
+    std::filesystem::create_directories(settings.spill_dir, ec);
+    if (ec) {
+      throw std::runtime_error(fmt::format(
+          FMT_STRING("unable to create folder \"{}\" to spill the query cache to disk: {}"),
+          settings.spill_dir.string(), ec.message()));
+    }
+  }
+
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+    if (settings.capacity_bytes == 0) {
+      _index.clear();
+      _entries.clear();
+      _size_bytes = 0;
+    }
+    if (settings.capacity_bytes == 0 || settings.spill_dir != _settings.spill_dir) {
+      clear_spilled_entries();
+    }
+    _settings = std::move(settings);
+
+    while (_size_bytes > _settings.capacity_bytes) {
+      evict_lru();
+    }
+    while (_spilled_bytes > _settings.spill_capacity_bytes) {
+      erase_spilled_entry(std::prev(_spilled_entries.end()));
+    }
+  }
+  process_pending_io();
+}
+
+void QueryCache::clear() {
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+    _index.clear();
+    _entries.clear();
+    _size_bytes = 0;
+    clear_spilled_entries();
+  }
+  process_pending_io();
+}
+
+void QueryCache::erase(const hictk::File& f) {
+  const auto prefix = make_key_prefix(f);
+  const auto has_prefix = [&](const std::string& key) {
+    return std::string_view{key}.substr(0, prefix.size()) == prefix;
+  };
+
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+    for (auto it = _entries.begin(); it != _entries.end();) {
+      if (has_prefix(it->key)) {
+        auto next = std::next(it);
+        erase_entry(it);
+        it = next;
+      } else {
+        ++it;
+      }
+    }
+    for (auto it = _spilled_entries.begin(); it != _spilled_entries.end();) {
+      if (has_prefix(it->key)) {
+        auto next = std::next(it);
+        erase_spilled_entry(it);
+        it = next;
+      } else {
+        ++it;
+      }
+    }
+  }
+  process_pending_io();
+}
+
+std::string QueryCache::make_key_prefix(const hictk::File& f) {
+  return fmt::format(FMT_STRING("{}\t{}\t"), f.uri(), f.resolution());
+}
+
+auto QueryCache::get_mtime(const std::filesystem::path& path) noexcept
+    -> std::optional<std::filesystem::file_time_type> {
+  std::error_code ec{};
+  const auto mtime = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return {};
+  }
+  return mtime;
+}
+
+std::size_t QueryCache::compute_size_bytes(const std::string& key, const Value& value) {
+  return key.size() +
+         std::visit(
+             [](const auto& v) -> std::size_t {
+               using T = std::decay_t<decltype(v)>;
+               if constexpr (std::is_same_v<T, Table>) {
+                 return static_cast<std::size_t>(arrow::util::TotalBufferSize(*v));
+               } else {
+                 return v->data.size();
+               }
+             },
+             value);
+}
+
+auto QueryCache::load_spilled_entry(const SpilledEntry& entry) -> std::optional<Value> {
+  if (entry.unwritten) {
+    // the matrix has not been written to disk yet: the file is removed once the write completes
+    return Value{entry.unwritten};
+  }
+
+  auto matrix = std::make_shared<DenseMatrix>(entry.matrix);
+  matrix->data.resize(entry.size_bytes);
+  std::ifstream ifs(entry.path, std::ios::binary);
+  ifs.read(reinterpret_cast<char*>(matrix->data.data()),  // NOLINT(*-reinterpret-cast)
+           static_cast<std::streamsize>(matrix->data.size()));
+  const auto ok = !!ifs;
+  ifs.close();
+  std::error_code ec{};
+  std::filesystem::remove(entry.path, ec);
+  if (!ok) {
+    return {};
+  }
+  return Value{std::move(matrix)};
+}
+
+bool QueryCache::write_spilled_matrix(const std::filesystem::path& path,
+                                      const DenseMatrix& matrix) {
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs.write(reinterpret_cast<const char*>(matrix.data.data()),  // NOLINT(*-reinterpret-cast)
+            static_cast<std::streamsize>(matrix.data.size()));
+  ofs.close();
+  return !!ofs;
+}
+
+void QueryCache::insert(Entry entry) {
+  if (auto match = _index.find(entry.key); match != _index.end()) {
+    erase_entry(match->second);
+  }
+  if (auto match = _spill_index.find(entry.key); match != _spill_index.end()) {
+    erase_spilled_entry(match->second);
+  }
+
+  if (entry.size_bytes > _settings.capacity_bytes) {
+    // results that do not fit in memory can still be spilled to disk
+    spill(entry);
+    return;
+  }
+
+  while (_size_bytes + entry.size_bytes > _settings.capacity_bytes) {
+    evict_lru();
+  }
+
+  _size_bytes += entry.size_bytes;
+  _entries.emplace_front(std::move(entry));
+  _index.emplace(_entries.front().key, _entries.begin());
+}
+
+auto QueryCache::take_spilled_entry(const std::string& key, std::filesystem::file_time_type mtime)
+    -> std::optional<SpilledEntry> {
+  auto match = _spill_index.find(key);
+  if (match == _spill_index.end()) {
+    return {};
+  }
+
+  auto it = match->second;
+  if (it->mtime != mtime) {
+    ++_stats.invalidations;
+    erase_spilled_entry(it);
+    return {};
+  }
+
+  auto entry = std::move(*it);
+  _spilled_bytes -= entry.size_bytes;
+  _spill_index.erase(match);
+  _spilled_entries.erase(it);
+  return entry;
+}
+
+void QueryCache::evict_lru() {
+  assert(!_entries.empty());
+  auto it = std::prev(_entries.end());
+  spill(*it);
+  erase_entry(it);
+  ++_stats.evictions;
+}
+
+void QueryCache::spill(Entry& entry) {
+  const auto* matrix = std::get_if<std::shared_ptr<const DenseMatrix>>(&entry.value);
+  if (_settings.spill_dir.empty() || !matrix || entry.size_bytes > _settings.spill_capacity_bytes) {
+    return;
+  }
+
+  while (_spilled_bytes + entry.size_bytes > _settings.spill_capacity_bytes) {
+    erase_spilled_entry(std::prev(_spilled_entries.end()));
+  }
+
+  auto path = _settings.spill_dir /
+              fmt::format(FMT_STRING("hictkpy-query-cache-{:016x}-{}.bin"), _session_id,
+                          _spill_counter++);
+  _pending_writes.emplace_back(PendingWrite{entry.key, path, *matrix});
+
+  DenseMatrix metadata{(*matrix)->num_rows, (*matrix)->num_cols, (*matrix)->uncompressed_bytes,
+                       (*matrix)->compressed, {}};
+  _spilled_entries.emplace_front(SpilledEntry{entry.key, entry.mtime, std::move(path),
+                                              std::move(metadata), (*matrix)->data.size(),
+                                              *matrix});
+  _spill_index.insert_or_assign(entry.key, _spilled_entries.begin());
+  _spilled_bytes += (*matrix)->data.size();
+}
+
+void QueryCache::erase_entry(std::list<Entry>::iterator it) {
+  _size_bytes -= it->size_bytes;
+  _index.erase(it->key);
+  _entries.erase(it);
+}
+
+void QueryCache::erase_spilled_entry(std::list<SpilledEntry>::iterator it) {
+  // files of entries that are still being written are removed by process_pending_io()
+  if (!it->unwritten) {
+    _pending_removals.emplace_back(std::move(it->path));
+  }
+  _spilled_bytes -= it->size_bytes;
+  _spill_index.erase(it->key);
+  _spilled_entries.erase(it);
+}
+
+void QueryCache::clear_spilled_entries() {
+  while (!_spilled_entries.empty()) {
+    erase_spilled_entry(_spilled_entries.begin());
+  }
+}
+
+void QueryCache::process_pending_io() {
+  std::vector<PendingWrite> writes{};
+  std::vector<std::filesystem::path> removals{};
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+    std::swap(writes, _pending_writes);
+    std::swap(removals, _pending_removals);
+  }
+
+  std::error_code ec{};
+  for (const auto& path : removals) {
+    std::filesystem::remove(path, ec);
+  }
+
+  for (const auto& write : writes) {
+    const auto ok = write_spilled_matrix(write.path, *write.matrix);
+    const auto keep_file = [&]() {
+      [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+      auto match = _spill_index.find(write.key);
+      if (match == _spill_index.end() || match->second->path != write.path) {
+        // the entry was dropped or moved back to memory while it was being written
+        return false;
+      }
+      if (!ok) {
+        // spilling is best-effort: entries that cannot be written to disk are simply dropped
+        erase_spilled_entry(match->second);
+        return false;
+      }
+      match->second->unwritten.reset();
+      return true;
+    }();
+    if (!keep_file) {
+      std::filesystem::remove(write.path, ec);
+    }
+  }
+}
+
+QueryCache& get_query_cache() {
+  static QueryCache cache{};
+  return cache;
+}
+
+}  // namespace hictkpy
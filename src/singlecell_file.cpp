@@ -2,22 +2,57 @@
 //
 // SPDX-License-Identifier: MIT
 
+#ifdef _WIN32
+// Workaround bug several symbol redefinition errors due to something including <winsock.h>
+#include <winsock2.h>
+#endif
+
 #include "hictkpy/singlecell_file.hpp"
 
+#include <BS_thread_pool.hpp>
+#include <arrow/array.h>
+#include <arrow/buffer.h>
+#include <arrow/builder.h>
+#include <arrow/chunked_array.h>
+#include <arrow/table.h>
+#include <arrow/type.h>
 #include <fmt/format.h>
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <future>
+#include <hictk/balancing/methods.hpp>
 #include <hictk/bin_table.hpp>
+#include <hictk/cooler/cooler.hpp>
 #include <hictk/cooler/singlecell_cooler.hpp>
+#include <hictk/cooler/utils.hpp>
 #include <hictk/cooler/validation.hpp>
 #include <hictk/file.hpp>
+#include <hictk/genomic_interval.hpp>
+#include <hictk/pixel.hpp>
+#include <hictk/transformers/common.hpp>
+#include <hictk/transformers/to_dataframe.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
 #include <vector>
 
 #include "hictkpy/bin_table.hpp"
+#include "hictkpy/common.hpp"
+#include "hictkpy/file.hpp"
+#include "hictkpy/locking.hpp"
 #include "hictkpy/nanobind.hpp"
+#include "hictkpy/pixel_selector.hpp"
 #include "hictkpy/reference.hpp"
+#include "hictkpy/to_pyarrow.hpp"
 
 namespace nb = nanobind;
 
@@ -28,6 +63,7 @@ bool is_scool_file(const std::filesystem::path& path) {
 }
 
 static void ctor(hictk::cooler::SingleCellFile* fp, const std::filesystem::path& path) {
+  file::ensure_local_uri(path);
   new (fp) hictk::cooler::SingleCellFile{path};
 }
 
@@ -85,8 +121,8 @@ static nb::dict get_attrs(const hictk::cooler::SingleCellFile& sclr) {
   return py_attrs;
 }
 
-static hictk::File getitem(const hictk::cooler::SingleCellFile& sclr, std::string_view cell_id) {
-  return hictk::File(sclr.open(cell_id));
+static FileHandle getitem(const hictk::cooler::SingleCellFile& sclr, std::string_view cell_id) {
+  return FileHandle{hictk::File(sclr.open(cell_id))};
 }
 
 static std::vector<std::string> get_cells(const hictk::cooler::SingleCellFile& sclr) {
@@ -97,6 +133,248 @@ static std::vector<std::string> get_cells(const hictk::cooler::SingleCellFile& s
   return cells;
 }
 
+// Return the list of cells to be processed, making sure that all cells exist
+[[nodiscard]] static std::vector<std::string> select_cells(
+    const hictk::cooler::SingleCellFile& sclr, std::optional<std::vector<std::string>> cells) {
+  if (!cells.has_value()) {
+    return {sclr.cells().begin(), sclr.cells().end()};
+  }
+
+  for (const auto& cell : *cells) {
+    if (!sclr.cells().contains(cell)) {
+      throw std::runtime_error(
+          fmt::format(FMT_STRING("unable to find cell \"{}\" in file {}"), cell, sclr.path()));
+    }
+  }
+
+  return std::move(*cells);
+}
+
+[[nodiscard]] static std::shared_ptr<arrow::Array> make_cell_dictionary(
+    const std::vector<std::string>& cells) {
+  arrow::StringBuilder builder{};
+  auto status = builder.AppendValues(cells);
+  if (!status.ok()) {
+    throw std::runtime_error(status.ToString());
+  }
+
+  auto result = builder.Finish();
+  if (!result.ok()) {
+    throw std::runtime_error(result.status().ToString());
+  }
+  return result.MoveValueUnsafe();
+}
+
+template <typename N>
+[[nodiscard]] static std::shared_ptr<arrow::Table> make_cell_table(
+    const std::vector<hictk::ThinPixel<N>>& pixels, std::shared_ptr<const hictk::BinTable> bins,
+    hictk::transformers::DataFrameFormat format, hictk::transformers::QuerySpan span,
+    std::int32_t cell_idx, const std::shared_ptr<arrow::Array>& cell_dictionary) {
+  auto table = hictk::transformers::ToDataFrame(pixels.begin(), pixels.end(), format,
+                                                std::move(bins), span)();
+
+  // Cell IDs are dictionary-encoded: all tables share the same dictionary
+  std::vector<std::int32_t> indices(static_cast<std::size_t>(table->num_rows()), cell_idx);
+  const auto indices_arr = std::make_shared<arrow::Int32Array>(
+      table->num_rows(), arrow::Buffer::FromVector(std::move(indices)), nullptr, 0, 0);
+
+  const auto type = arrow::dictionary(arrow::int32(), arrow::utf8());
+  auto cell_id_col = arrow::DictionaryArray::FromArrays(type, indices_arr, cell_dictionary);
+  if (!cell_id_col.ok()) {
+    throw std::runtime_error(cell_id_col.status().ToString());
+  }
+
+  auto result =
+      table->AddColumn(0, arrow::field("cell_id", type, false),
+                       std::make_shared<arrow::ChunkedArray>(cell_id_col.MoveValueUnsafe()));
+  if (!result.ok()) {
+    throw std::runtime_error(result.status().ToString());
+  }
+  return result.MoveValueUnsafe();
+}
+
+template <typename N>
+[[nodiscard]] static std::shared_ptr<arrow::Table> fetch_cell_table(
+    const hictk::cooler::SingleCellFile& sclr, std::string_view cell,
+    const std::optional<hictk::GenomicInterval>& gi1,
+    const std::optional<hictk::GenomicInterval>& gi2,
+    const hictk::balancing::Method& normalization, hictk::transformers::DataFrameFormat format,
+    hictk::transformers::QuerySpan span, std::int32_t cell_idx,
+    const std::shared_ptr<arrow::Array>& cell_dictionary) {
+  std::vector<hictk::ThinPixel<N>> pixels{};
+  {
+    // Only reading interactions requires synchronization: converting pixels to an arrow::Table
+    // can proceed in parallel with queries running on other threads.
+    // Cells are opened through the file handle owned by sclr.
+    [[maybe_unused]] const auto lck = std::scoped_lock(*get_hdf5_mutex());
+    const auto clr = sclr.open(cell);
+    if (!gi1.has_value()) {
+      const auto sel = clr.fetch(normalization);
+      pixels.assign(sel.template begin<N>(), sel.template end<N>());
+    } else {
+      const auto sel = clr.fetch(gi1->chrom().name(), gi1->start(), gi1->end(),
+                                 gi2->chrom().name(), gi2->start(), gi2->end(), normalization);
+      pixels.assign(sel.template begin<N>(), sel.template end<N>());
+    }
+  }
+
+  // All cells share the same table of bins
+  return make_cell_table(pixels, sclr.bins_ptr(), format, span, cell_idx, cell_dictionary);
+}
+
+static nb::object fetch_all(const hictk::cooler::SingleCellFile& sclr,
+                            std::optional<std::string_view> range1,
+                            std::optional<std::string_view> range2,
+                            std::optional<std::vector<std::string>> cells,
+                            std::optional<std::string_view> normalization,
+                            std::string_view count_type, bool join, std::string_view query_type,
+                            std::string_view query_span, std::size_t n_threads) {
+  std::ignore = import_pyarrow_checked();
+
+  PixelSelector::validate_count_type(count_type);
+
+  if (query_type != "UCSC" && query_type != "BED") {
+    throw std::runtime_error("query_type should be either UCSC or BED");
+  }
+
+  if (n_threads == 0) {
+    throw std::runtime_error("n_threads should be a positive number");
+  }
+
+  const hictk::balancing::Method normalization_method{normalization.value_or("NONE")};
+  count_type = PixelSelector::promote_count_type(
+      count_type, normalization_method != hictk::balancing::Method::NONE());
+
+  const auto count = PixelSelector::parse_count_type(count_type);
+  const auto format = join ? PixelSelector::PixelFormat::BG2 : PixelSelector::PixelFormat::COO;
+  const auto span = PixelSelector::parse_span(query_span);
+  const auto query_type_ =
+      query_type == "UCSC" ? hictk::GenomicInterval::Type::UCSC : hictk::GenomicInterval::Type::BED;
+
+  std::optional<hictk::GenomicInterval> gi1{};
+  std::optional<hictk::GenomicInterval> gi2{};
+  if (range1.has_value() && !range1->empty()) {
+    if (!range2.has_value() || range2->empty()) {
+      range2 = range1;
+    }
+    gi1 = hictk::GenomicInterval::parse(sclr.chromosomes(), std::string{*range1}, query_type_);
+    gi2 = hictk::GenomicInterval::parse(sclr.chromosomes(), std::string{*range2}, query_type_);
+  }
+
+  const auto cells_ = select_cells(sclr, std::move(cells));
+
+  auto table = [&]() {
+    [[maybe_unused]] const nb::gil_scoped_release release{};
+    const auto cell_dictionary = make_cell_dictionary(cells_);
+
+    return std::visit(
+        [&]([[maybe_unused]] auto count_) -> std::shared_ptr<arrow::Table> {
+          using N = std::conditional_t<std::is_same_v<decltype(count_), long double>, double,
+                                       decltype(count_)>;
+          if (cells_.empty()) {
+            return make_cell_table(std::vector<hictk::ThinPixel<N>>{}, sclr.bins_ptr(), format,
+                                   span, 0, cell_dictionary);
+          }
+
+          std::vector<std::shared_ptr<arrow::Table>> tables(cells_.size());
+          {
+            BS::thread_pool tpool(
+                conditional_static_cast<BS::concurrency_t>(std::min(n_threads, cells_.size())));
+            std::vector<std::future<void>> workers(cells_.size());
+            for (std::size_t i = 0; i < cells_.size(); ++i) {
+              workers[i] = tpool.submit_task([&, i]() {
+                tables[i] = fetch_cell_table<N>(sclr, cells_[i], gi1, gi2, normalization_method,
+                                                format, span, static_cast<std::int32_t>(i),
+                                                cell_dictionary);
+              });
+            }
+            // Rethrow exceptions (if any) only after all workers have returned
+            tpool.wait();
+            for (auto& worker : workers) {
+              worker.get();
+            }
+          }
+
+          auto result = arrow::ConcatenateTables(tables);
+          if (!result.ok()) {
+            throw std::runtime_error(result.status().ToString());
+          }
+          return result.MoveValueUnsafe();
+        },
+        count);
+  }();
+
+  return export_pyarrow_table(std::move(table));
+}
+
+template <typename N>
+static void merge_cells(const hictk::cooler::SingleCellFile& sclr,
+                        const std::vector<hictk::cooler::File>& clrs, std::string_view uri,
+                        bool overwrite_if_exists, std::size_t chunk_size,
+                        std::uint32_t compression_lvl) {
+  std::vector<hictk::cooler::PixelSelector::iterator<N>> heads{};
+  std::vector<hictk::cooler::PixelSelector::iterator<N>> tails{};
+
+  for (const auto& clr : clrs) {
+    auto first = clr.template begin<N>();
+    auto last = clr.template end<N>();
+    if (first != last) {
+      heads.emplace_back(std::move(first));
+      tails.emplace_back(std::move(last));
+    }
+  }
+
+  hictk::cooler::utils::merge(heads, tails, sclr.bins(), uri,
+                              sclr.attributes().assembly.value_or("unknown"), overwrite_if_exists,
+                              chunk_size, 10'000'000, compression_lvl);
+}
+
+static FileHandle aggregate(const hictk::cooler::SingleCellFile& sclr,
+                            const std::filesystem::path& path,
+                            std::optional<std::vector<std::string>> cells, bool overwrite,
+                            std::size_t chunk_size, std::uint32_t compression_lvl) {
+  if (chunk_size == 0) {
+    throw std::runtime_error("chunk_size should be a positive number");
+  }
+
+  if (compression_lvl > 9) {
+    throw std::runtime_error("compression_lvl should be a number between 0 and 9");
+  }
+
+  const auto cells_ = select_cells(sclr, std::move(cells));
+  if (cells_.empty()) {
+    throw std::runtime_error("cells should contain at least one cell");
+  }
+
+  if (!overwrite && std::filesystem::exists(path)) {
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("unable to aggregate cells into file \"{}\": file already exists. "
+                               "Pass overwrite=True to overwrite existing files."),
+                    path.string()));
+  }
+
+  return run_without_gil(*get_hdf5_mutex(), [&]() {
+    std::vector<hictk::cooler::File> clrs{};
+    clrs.reserve(cells_.size());
+    bool float_pixels = false;
+    for (const auto& cell : cells_) {
+      clrs.emplace_back(sclr.open(cell));
+      float_pixels |= clrs.back().has_float_pixels();
+    }
+
+    // Pixels from all cells are merged in a single pass, streaming the output to disk in chunks
+    if (float_pixels) {
+      merge_cells<double>(sclr, clrs, path.string(), overwrite, chunk_size, compression_lvl);
+    } else {
+      merge_cells<std::int32_t>(sclr, clrs, path.string(), overwrite, chunk_size,
+                                compression_lvl);
+    }
+    clrs.clear();
+
+    return file::open(path, sclr.resolution());
+  });
+}
+
 void declare_singlecell_file_class(nb::module_& m) {
   auto cooler = m.def_submodule("cooler");
 
@@ -125,6 +403,35 @@ void declare_singlecell_file_class(nb::module_& m) {
   scell_file.def("__getitem__", &singlecell_file::getitem, nb::arg("cell_id"),
                  "Open the Cooler file corresponding to the cell ID given as input.",
                  nb::rv_policy::move);
+  scell_file.def(
+      "fetch_all", &singlecell_file::fetch_all, nb::arg("range1") = nb::none(),
+      nb::arg("range2") = nb::none(), nb::arg("cells") = nb::none(),
+      nb::arg("normalization") = nb::none(), nb::arg("count_type") = "int",
+      nb::arg("join") = false, nb::arg("query_type") = "UCSC",
+      nb::arg("query_span") = "upper_triangle", nb::arg("n_threads") = 1,
+      "Fetch interactions overlapping a region of interest for all cells (or for the given list "
+      "of cells).\n"
+      "Interactions are returned as a single pyarrow.Table, with an additional cell_id column "
+      "(dictionary-encoded) mapping each interaction to the cell it belongs to.\n"
+      "Use n_threads to process multiple cells in parallel. Please note that reading from .scool "
+      "files is always serialized.",
+      nb::sig("def fetch_all(self, range1: str | None = None, range2: str | None = None, cells: "
+              "collections.abc.Sequence[str] | None = None, normalization: str | None = None, "
+              "count_type: str = 'int', join: bool = False, query_type: str = 'UCSC', "
+              "query_span: str = 'upper_triangle', n_threads: int = 1) -> pyarrow.Table"),
+      nb::rv_policy::take_ownership);
+  scell_file.def(
+      "aggregate", &singlecell_file::aggregate, nb::arg("path"), nb::arg("cells") = nb::none(),
+      nb::arg("overwrite") = false, nb::arg("chunk_size") = 500'000,
+      nb::arg("compression_lvl") = 6,
+      "Aggregate interactions from all cells (or from the given list of cells) into a pseudo-bulk "
+      "Cooler file.\n"
+      "Interactions are merged in a single pass and written to disk in chunks of chunk_size "
+      "pixels. Returns the newly created file.",
+      nb::sig("def aggregate(self, path: str | os.PathLike, cells: collections.abc.Sequence[str] | "
+              "None = None, overwrite: bool = False, chunk_size: int = 500000, compression_lvl: "
+              "int = 6) -> hictkpy.File"),
+      nb::rv_policy::move);
 }
 
 }  // namespace hictkpy::singlecell_file
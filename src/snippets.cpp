@@ -0,0 +1,443 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#ifdef _WIN32
+// Workaround bug several symbol redefinition errors due to something including <winsock.h>
+#include <winsock2.h>
+#endif
+
+#include "hictkpy/snippets.hpp"
+
+#include <BS_thread_pool.hpp>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <hictk/balancing/methods.hpp>
+#include <hictk/balancing/weights.hpp>
+#include <hictk/chromosome.hpp>
+#include <hictk/file.hpp>
+#include <hictk/genomic_interval.hpp>
+#include <hictk/hic.hpp>
+#include <hictk/pixel.hpp>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include "hictkpy/cache_config.hpp"
+#include "hictkpy/common.hpp"
+#include "hictkpy/locking.hpp"
+#include "hictkpy/weight_cache.hpp"
+
+namespace hictkpy {
+
+// Clusters are capped so that the scratch buffer used to process a cluster stays small
+static constexpr std::size_t max_windows_per_cluster{64};
+
+// Window expressed in the coordinates of the chromosome pair it is read from, i.e. with
+// chrom1_id <= chrom2_id and, for cis windows, with row0 <= col0.
+// transposed is true when the window requested by the user is the transpose of this window
+struct CanonicalWindow {
+  std::size_t index{};
+  std::uint32_t chrom1_id{};
+  std::uint32_t chrom2_id{};
+  std::int64_t row0{};
+  std::int64_t col0{};
+  bool transposed{false};
+};
+
+// Group of nearby windows from the same chromosome pair, read with a single query.
+// Rows and columns are relative to the first bin of each chromosome and are clipped to the
+// chromosome boundaries (the query is empty when none of the windows overlaps the chromosomes)
+struct WindowCluster {
+  std::size_t first{};
+  std::size_t last{};
+  std::int64_t row_start{};
+  std::int64_t row_end{};
+  std::int64_t col_start{};
+  std::int64_t col_end{};
+
+  [[nodiscard]] bool empty() const noexcept {
+    return row_start >= row_end || col_start >= col_end;
+  }
+};
+
+// Chromosomes, bins, and weights required to initialize and fill windows
+struct SnippetContext {
+  std::uint32_t resolution{};
+  std::int64_t width{};
+  std::vector<hictk::Chromosome> chromosomes{};  // indexed by chromosome ID
+  std::vector<std::uint64_t> chrom_offsets{};    // ID of the first bin of each chromosome
+  std::vector<std::int64_t> num_bins{};          // number of bins of each chromosome
+  std::shared_ptr<const std::vector<double>> weights{};
+  hictk::balancing::Method normalization{};
+
+  // Check whether the given bin (relative to the first bin of its chromosome) is within the
+  // chromosome boundaries and is not masked
+  [[nodiscard]] bool is_valid_bin(std::uint32_t chrom_id, std::int64_t bin) const {
+    if (bin < 0 || bin >= num_bins[chrom_id]) {
+      return false;
+    }
+    return !weights ||
+           std::isfinite((*weights)[chrom_offsets[chrom_id] + static_cast<std::uint64_t>(bin)]);
+  }
+};
+
+[[nodiscard]] static std::int64_t compute_num_bins(const hictk::Chromosome& chrom,
+                                                   std::uint32_t resolution) noexcept {
+  return static_cast<std::int64_t>((chrom.size() + resolution - 1) / resolution);
+}
+
+[[nodiscard]] static std::int64_t find_center_bin(const hictk::GenomicInterval& anchor,
+                                                  std::uint32_t resolution) noexcept {
+  const auto midpoint = anchor.start() + ((anchor.end() - anchor.start()) / 2);
+  const auto num_bins = compute_num_bins(anchor.chrom(), resolution);
+  return std::min(static_cast<std::int64_t>(midpoint / resolution), num_bins - 1);
+}
+
+std::vector<SnippetWindow> make_snippet_windows(const hictk::File& f,
+                                                const std::vector<hictk::GenomicInterval>& anchors1,
+                                                const std::vector<hictk::GenomicInterval>& anchors2,
+                                                std::uint64_t flank_bins) {
+  assert(anchors1.size() == anchors2.size());
+  assert(f.resolution() != 0);
+
+  const auto flank = static_cast<std::int64_t>(flank_bins);
+  std::vector<SnippetWindow> windows(anchors1.size());
+  for (std::size_t i = 0; i < windows.size(); ++i) {
+    const auto& anchor1 = anchors1[i];
+    const auto& anchor2 = anchors2[i];
+    windows[i] = {anchor1.chrom().id(), anchor2.chrom().id(),
+                  find_center_bin(anchor1, f.resolution()) - flank,
+                  find_center_bin(anchor2, f.resolution()) - flank};
+  }
+  return windows;
+}
+
+[[nodiscard]] static SnippetContext make_snippet_context(
+    const hictk::File& f, std::uint64_t width, const hictk::balancing::Method& normalization) {
+  SnippetContext ctx{f.resolution(), static_cast<std::int64_t>(width)};
+  const auto& chroms = f.chromosomes();
+  ctx.chromosomes.resize(chroms.size());
+  ctx.chrom_offsets.resize(chroms.size(), 0);
+  ctx.num_bins.resize(chroms.size(), 0);
+  for (const auto& chrom : chroms) {
+    ctx.chromosomes[chrom.id()] = chrom;
+    if (!chrom.is_all()) {
+      ctx.chrom_offsets[chrom.id()] = f.bins().map_to_bin_id(chrom, 0);
+      ctx.num_bins[chrom.id()] = compute_num_bins(chrom, f.resolution());
+    }
+  }
+
+  ctx.normalization = normalization;
+  if (normalization != hictk::balancing::Method::NONE()) {
+    // Check for the normalization up front, so that clusters can be read without worrying about
+    // missing normalization vectors
+    const auto norm_found = [&]() {
+      [[maybe_unused]] const auto lck = lock_file(*get_file_mutex(f));
+      return f.has_normalization(normalization.to_string());
+    }();
+    if (!norm_found) {
+      throw std::runtime_error(
+          fmt::format(FMT_STRING("unable to find {} normalization vectors in file \"{}\""),
+                      normalization.to_string(), f.uri()));
+    }
+    ctx.weights = get_weight_cache().get(f, normalization.to_string(),
+                                         hictk::balancing::Weights::Type::MULTIPLICATIVE);
+  }
+  return ctx;
+}
+
+[[nodiscard]] static CanonicalWindow make_canonical_window(const SnippetWindow& window,
+                                                           std::size_t index) noexcept {
+  const auto cis = window.chrom1_id == window.chrom2_id;
+  const auto transpose = window.chrom1_id > window.chrom2_id || (cis && window.row0 > window.col0);
+  if (transpose) {
+    return {index, window.chrom2_id, window.chrom1_id, window.col0, window.row0, true};
+  }
+  return {index, window.chrom1_id, window.chrom2_id, window.row0, window.col0, false};
+}
+
+// Sort windows by chromosome pair and by their coordinates
+[[nodiscard]] static std::vector<CanonicalWindow> sort_windows(
+    const std::vector<SnippetWindow>& windows) {
+  std::vector<CanonicalWindow> sorted_windows(windows.size());
+  for (std::size_t i = 0; i < windows.size(); ++i) {
+    sorted_windows[i] = make_canonical_window(windows[i], i);
+  }
+
+  std::sort(sorted_windows.begin(), sorted_windows.end(), [](const auto& w1, const auto& w2) {
+    return std::tie(w1.chrom1_id, w1.chrom2_id, w1.row0, w1.col0) <
+           std::tie(w2.chrom1_id, w2.chrom2_id, w2.row0, w2.col0);
+  });
+  return sorted_windows;
+}
+
+// Group consecutive (sorted) windows into clusters.
+// A window is added to the current cluster as long as the area of the bounding box of the cluster
+// does not exceed twice the total area of its windows: this way, windows overlapping (or close to)
+// each other are read with a single query, while windows far apart are read independently
+[[nodiscard]] static std::vector<WindowCluster> cluster_windows(
+    const std::vector<CanonicalWindow>& windows, const SnippetContext& ctx) {
+  const auto width = ctx.width;
+  const auto window_area = width * width;
+
+  std::vector<WindowCluster> clusters{};
+  for (std::size_t i = 0; i < windows.size();) {
+    const auto& w = windows[i];
+    WindowCluster cluster{i, i + 1, w.row0, w.row0 + width, w.col0, w.col0 + width};
+    auto area = window_area;
+
+    for (++i; i < windows.size() && i - cluster.first < max_windows_per_cluster; ++i) {
+      const auto& next = windows[i];
+      if (next.chrom1_id != w.chrom1_id || next.chrom2_id != w.chrom2_id) {
+        break;
+      }
+      const auto row_end = std::max(cluster.row_end, next.row0 + width);
+      const auto col_start = std::min(cluster.col_start, next.col0);
+      const auto col_end = std::max(cluster.col_end, next.col0 + width);
+      const auto bbox_area = (row_end - cluster.row_start) * (col_end - col_start);
+      if (bbox_area > 2 * (area + window_area)) {
+        break;
+      }
+      cluster.last = i + 1;
+      cluster.row_end = row_end;
+      cluster.col_start = col_start;
+      cluster.col_end = col_end;
+      area += window_area;
+    }
+
+    cluster.row_start = std::max(cluster.row_start, std::int64_t{0});
+    cluster.row_end = std::min(cluster.row_end, ctx.num_bins[w.chrom1_id]);
+    cluster.col_start = std::max(cluster.col_start, std::int64_t{0});
+    cluster.col_end = std::min(cluster.col_end, ctx.num_bins[w.chrom2_id]);
+    clusters.emplace_back(cluster);
+  }
+  return clusters;
+}
+
+// Fill the scratch buffer of each window of the cluster with 0s, or with NaNs for rows and columns
+// that are outside the chromosome boundaries or that are masked
+static void init_cluster_buffer(const std::vector<CanonicalWindow>& windows,
+                                const WindowCluster& cluster, const SnippetContext& ctx,
+                                std::vector<double>& buffer) {
+  const auto width = static_cast<std::size_t>(ctx.width);
+  buffer.resize((cluster.last - cluster.first) * width * width);
+
+  std::vector<bool> valid_cols(width);
+  for (auto k = cluster.first; k < cluster.last; ++k) {
+    const auto& w = windows[k];
+    auto* window_buffer = buffer.data() + ((k - cluster.first) * width * width);
+    for (std::size_t j = 0; j < width; ++j) {
+      valid_cols[j] = ctx.is_valid_bin(w.chrom2_id, w.col0 + static_cast<std::int64_t>(j));
+    }
+    for (std::size_t i = 0; i < width; ++i) {
+      const auto valid_row = ctx.is_valid_bin(w.chrom1_id, w.row0 + static_cast<std::int64_t>(i));
+      for (std::size_t j = 0; j < width; ++j) {
+        window_buffer[(i * width) + j] =
+            valid_row && valid_cols[j] ? 0.0 : std::numeric_limits<double>::quiet_NaN();
+      }
+    }
+  }
+}
+
+// Copy the interaction between the given bins to all windows of the cluster overlapping it
+static void scatter_pixel(const std::vector<CanonicalWindow>& windows, const WindowCluster& cluster,
+                          std::int64_t width, std::int64_t row, std::int64_t col, double count,
+                          std::vector<double>& buffer) {
+  // Windows in the cluster are sorted by row0: only windows with row0 in (row - width, row] can
+  // overlap the given row
+  const auto first = windows.begin() + static_cast<std::ptrdiff_t>(cluster.first);
+  const auto last = windows.begin() + static_cast<std::ptrdiff_t>(cluster.last);
+  auto it = std::lower_bound(first, last, row - width + 1,
+                             [](const auto& w, std::int64_t row0) { return w.row0 < row0; });
+  for (; it != last && it->row0 <= row; ++it) {
+    const auto j = col - it->col0;
+    if (j >= 0 && j < width) {
+      const auto i = row - it->row0;
+      const auto offset = static_cast<std::size_t>((std::distance(first, it) * width * width) +
+                                                   (i * width) + j);
+      buffer[offset] = count;
+    }
+  }
+}
+
+// Read the interactions overlapping the given cluster and copy them to the scratch buffer of each
+// window
+template <typename FileT>
+static void read_cluster(const FileT& f, const std::vector<CanonicalWindow>& windows,
+                         const WindowCluster& cluster, const SnippetContext& ctx,
+                         std::vector<double>& buffer) {
+  init_cluster_buffer(windows, cluster, ctx, buffer);
+  if (cluster.empty()) {
+    return;
+  }
+
+  const auto& chrom1 = ctx.chromosomes[windows[cluster.first].chrom1_id];
+  const auto& chrom2 = ctx.chromosomes[windows[cluster.first].chrom2_id];
+  const auto resolution = static_cast<std::int64_t>(ctx.resolution);
+  const auto start1 = static_cast<std::uint32_t>(cluster.row_start * resolution);
+  const auto end1 = static_cast<std::uint32_t>(
+      std::min(cluster.row_end * resolution, static_cast<std::int64_t>(chrom1.size())));
+  const auto start2 = static_cast<std::uint32_t>(cluster.col_start * resolution);
+  const auto end2 = static_cast<std::uint32_t>(
+      std::min(cluster.col_end * resolution, static_cast<std::int64_t>(chrom2.size())));
+
+  const auto sel =
+      f.fetch(chrom1.name(), start1, end1, chrom2.name(), start2, end2, ctx.normalization);
+
+  const auto offset1 = ctx.chrom_offsets[chrom1.id()];
+  const auto offset2 = ctx.chrom_offsets[chrom2.id()];
+  const auto cis = chrom1 == chrom2;
+  std::for_each(sel.template begin<double>(), sel.template end<double>(), [&](const auto& p) {
+    const auto row = static_cast<std::int64_t>(p.bin1_id - offset1);
+    const auto col = static_cast<std::int64_t>(p.bin2_id - offset2);
+    scatter_pixel(windows, cluster, ctx.width, row, col, p.count, buffer);
+    // Only interactions from the upper triangle are stored: windows overlapping the lower
+    // triangle are filled using the transpose of the stored interactions
+    if (cis && row != col) {
+      scatter_pixel(windows, cluster, ctx.width, col, row, p.count, buffer);
+    }
+  });
+}
+
+// Collect the windows processed by one thread: windows are either copied to the output stack, or
+// added to the running sums used to compute the pileup
+class SnippetSink {
+  std::int64_t _width{};
+  double* _stack{};
+  std::vector<double> _sum{};
+  std::vector<std::uint64_t> _count{};
+
+ public:
+  SnippetSink(std::int64_t width, double* stack)
+      : _width(width),
+        _stack(stack),
+        _sum(stack ? 0 : static_cast<std::size_t>(width * width), 0.0),
+        _count(stack ? 0 : static_cast<std::size_t>(width * width), 0) {}
+
+  void add(const std::vector<CanonicalWindow>& windows, const WindowCluster& cluster,
+           const std::vector<double>& buffer) {
+    const auto width = static_cast<std::size_t>(_width);
+    for (auto k = cluster.first; k < cluster.last; ++k) {
+      const auto& w = windows[k];
+      const auto* src = buffer.data() + ((k - cluster.first) * width * width);
+      for (std::size_t i = 0; i < width; ++i) {
+        for (std::size_t j = 0; j < width; ++j) {
+          const auto dest_offset = w.transposed ? (j * width) + i : (i * width) + j;
+          add(w.index, dest_offset, src[(i * width) + j]);
+        }
+      }
+    }
+  }
+
+  // Add the sums computed by another sink (only used when computing pileups)
+  void merge(const SnippetSink& other) noexcept {
+    for (std::size_t i = 0; i < _sum.size(); ++i) {
+      _sum[i] += other._sum[i];
+      _count[i] += other._count[i];
+    }
+  }
+
+  [[nodiscard]] std::vector<double> pileup() const {
+    std::vector<double> avg(_sum.size());
+    for (std::size_t i = 0; i < avg.size(); ++i) {
+      avg[i] = _count[i] == 0 ? std::numeric_limits<double>::quiet_NaN()
+                              : _sum[i] / static_cast<double>(_count[i]);
+    }
+    return avg;
+  }
+
+ private:
+  void add(std::size_t window_index, std::size_t offset, double value) noexcept {
+    if (_stack) {
+      const auto width = static_cast<std::size_t>(_width);
+      _stack[(window_index * width * width) + offset] = value;
+    } else if (std::isfinite(value)) {
+      _sum[offset] += value;
+      ++_count[offset];
+    }
+  }
+};
+
+std::vector<double> fetch_snippets(const hictk::File& f, const std::vector<SnippetWindow>& windows,
+                                   std::uint64_t width,
+                                   const hictk::balancing::Method& normalization, bool pileup,
+                                   std::size_t n_threads) {
+  assert(n_threads != 0);
+  const auto ctx = make_snippet_context(f, width, normalization);
+  const auto sorted_windows = sort_windows(windows);
+  const auto clusters = cluster_windows(sorted_windows, ctx);
+
+  std::vector<double> stack(pileup ? 0 : windows.size() * width * width);
+  SnippetSink sink(ctx.width, pileup ? nullptr : stack.data());
+
+  // Reading Cooler files is serialized process-wide (see get_hdf5_mutex()), so there is nothing
+  // to gain by processing clusters in parallel
+  const auto num_workers = f.is_hic() ? std::min(n_threads, clusters.size()) : std::size_t{1};
+  if (num_workers <= 1) {
+    const auto mtx = get_file_mutex(f);
+    std::vector<double> buffer{};
+    for (const auto& cluster : clusters) {
+      {
+        [[maybe_unused]] const auto lck = std::scoped_lock(*mtx);
+        optimize_deferred_file_cache(f);
+        std::visit([&](const auto& ff) { read_cluster(ff, sorted_windows, cluster, ctx, buffer); },
+                   f.get());
+      }
+      sink.add(sorted_windows, cluster, buffer);
+    }
+    return pileup ? sink.pileup() : stack;
+  }
+
+  const auto& hf = f.get<hictk::hic::File>();
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(*get_file_mutex(f));
+    optimize_deferred_file_cache(f);
+  }
+  // Workers split the cache budget of f
+  const auto cache_capacity = compute_worker_file_cache_size(f.bins_ptr(), num_workers);
+  std::atomic<std::size_t> next_cluster{0};
+  std::vector<SnippetSink> sinks(num_workers, sink);
+
+  BS::thread_pool tpool(conditional_static_cast<BS::concurrency_t>(num_workers));
+  std::vector<std::future<void>> workers(num_workers);
+  for (std::size_t i = 0; i < num_workers; ++i) {
+    workers[i] = tpool.submit_task([&, i]() {
+      // Each worker reads interactions using its own file handle. Clusters are handed out in
+      // order, so that each worker visits windows that are close to each other
+      const hictk::hic::File hf_(hf.path(), hf.resolution(), hf.matrix_type(), hf.matrix_unit(),
+                                 cache_capacity);
+      std::vector<double> buffer{};
+      for (auto k = next_cluster++; k < clusters.size(); k = next_cluster++) {
+        read_cluster(hf_, sorted_windows, clusters[k], ctx, buffer);
+        sinks[i].add(sorted_windows, clusters[k], buffer);
+      }
+    });
+  }
+  // Rethrow exceptions (if any) only after all workers have returned
+  tpool.wait();
+  for (auto& worker : workers) {
+    worker.get();
+  }
+
+  if (!pileup) {
+    return stack;
+  }
+  for (const auto& s : sinks) {
+    sink.merge(s);
+  }
+  return sink.pileup();
+}
+
+}  // namespace hictkpy
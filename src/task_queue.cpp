@@ -0,0 +1,118 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#include "hictkpy/task_queue.hpp"
+
+#include <Python.h>
+
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "hictkpy/nanobind.hpp"
+
+namespace nb = nanobind;
+
+namespace hictkpy {
+
+BoundedTaskQueue::BoundedTaskQueue(std::size_t capacity_bytes) : _capacity(capacity_bytes) {
+  if (_capacity == 0) {
+    throw std::runtime_error("queue capacity should be a positive number");
+  }
+  _worker = std::thread([this]() { run(); });
+}
+
+BoundedTaskQueue::~BoundedTaskQueue() noexcept {
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+    _stop = true;
+  }
+  _task_queued_cv.notify_all();
+  _task_done_cv.notify_all();
+
+  if (_worker.joinable()) {
+    // The task being processed may need to acquire the GIL
+    std::optional<nb::gil_scoped_release> gil{};
+    if (PyGILState_Check() != 0) {
+      gil.emplace();
+    }
+    _worker.join();
+  }
+}
+
+std::size_t BoundedTaskQueue::capacity() const noexcept { return _capacity; }
+
+std::size_t BoundedTaskQueue::pending_bytes() const {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _pending_bytes;
+}
+
+void BoundedTaskQueue::submit(Task task, std::size_t size_bytes) {
+  std::unique_lock lck(_mtx);
+  rethrow_exception_unlocked();
+
+  _task_done_cv.wait(lck, [&]() {
+    return _exception || _pending_bytes == 0 || _pending_bytes + size_bytes <= _capacity;
+  });
+  rethrow_exception_unlocked();
+
+  _tasks.emplace_back(QueuedTask{std::move(task), size_bytes});
+  _pending_bytes += size_bytes;
+  lck.unlock();
+  _task_queued_cv.notify_one();
+}
+
+void BoundedTaskQueue::wait() {
+  std::unique_lock lck(_mtx);
+  _task_done_cv.wait(lck, [&]() { return _exception || (_tasks.empty() && !_busy); });
+  rethrow_exception_unlocked();
+}
+
+void BoundedTaskQueue::run() {
+  std::unique_lock lck(_mtx);
+  while (true) {
+    _task_queued_cv.wait(lck, [&]() { return _stop || !_tasks.empty(); });
+    if (_stop) {
+      return;
+    }
+
+    auto [task, size] = std::move(_tasks.front());
+    _tasks.pop_front();
+    _busy = true;
+    lck.unlock();
+
+    std::exception_ptr exception{};
+    try {
+      task();
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    // make sure resources owned by the task are released before waking up producers
+    task = nullptr;
+
+    lck.lock();
+    _busy = false;
+    _pending_bytes -= size;
+    if (exception) {
+      _exception = exception;
+      for (const auto& t : _tasks) {
+        _pending_bytes -= t.size;
+      }
+      _tasks.clear();
+    }
+    _task_done_cv.notify_all();
+  }
+}
+
+void BoundedTaskQueue::rethrow_exception_unlocked() {
+  if (_exception) {
+    std::rethrow_exception(_exception);
+  }
+}
+
+}  // namespace hictkpy
@@ -7,6 +7,7 @@
 #include <Python.h>
 #include <arrow/c/abi.h>
 #include <arrow/c/bridge.h>
+#include <arrow/record_batch.h>
 #include <arrow/table.h>
 #include <fmt/format.h>
 
@@ -16,10 +17,12 @@
 #include <cstdlib>
 #include <memory>
 #include <stdexcept>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "hictkpy/nanobind.hpp"
+#include "hictkpy/profiling.hpp"
 
 namespace nb = nanobind;
 
@@ -111,8 +114,104 @@ static void release_arrow_array_streamPyCapsule(PyObject* capsule) {
   return obj;
 }
 
+// Forward all calls to the wrapped reader while holding a reference to the Python object owning
+// the resources accessed by the reader (e.g. the File backing a PixelSelector).
+// The reference is released (with the GIL held) only once the consumer is done with the stream,
+// which may happen long after the capsule or the pyarrow.RecordBatchReader have been collected.
+class OwningRecordBatchReader : public arrow::RecordBatchReader {
+  std::shared_ptr<arrow::RecordBatchReader> _reader{};
+  nb::object _owner{};
+
+ public:
+  OwningRecordBatchReader(std::shared_ptr<arrow::RecordBatchReader> reader, nb::object owner)
+      : _reader(std::move(reader)), _owner(std::move(owner)) {
+    assert(_reader);
+  }
+
+  OwningRecordBatchReader(const OwningRecordBatchReader&) = delete;
+  OwningRecordBatchReader(OwningRecordBatchReader&&) = delete;
+
+  ~OwningRecordBatchReader() noexcept override {
+    // The reader must be destroyed before the owner
+    _reader.reset();
+    if (!_owner.is_valid()) {
+      return;
+    }
+    if (!Py_IsInitialized()) {
+      // The interpreter is already gone: there is nothing left to decref
+      std::ignore = _owner.release();
+      return;
+    }
+    [[maybe_unused]] const nb::gil_scoped_acquire gil{};
+    _owner.reset();
+  }
+
+  OwningRecordBatchReader& operator=(const OwningRecordBatchReader&) = delete;
+  OwningRecordBatchReader& operator=(OwningRecordBatchReader&&) = delete;
+
+  [[nodiscard]] std::shared_ptr<arrow::Schema> schema() const override {
+    return _reader->schema();
+  }
+
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch>* batch) override {
+    return _reader->ReadNext(batch);
+  }
+
+  arrow::Status Close() override { return _reader->Close(); }
+};
+
+nb::object export_arrow_c_stream(std::shared_ptr<arrow::RecordBatchReader> reader,
+                                 nb::object owner) {
+  // https://arrow.apache.org/docs/format/CDataInterface/PyCapsuleInterface.html#arrowstream-export
+  assert(reader);
+  if (owner.is_valid() && !owner.is_none()) {
+    reader = std::make_shared<OwningRecordBatchReader>(std::move(reader), std::move(owner));
+  }
+  auto* array_stream = static_cast<ArrowArrayStream*>(malloc(sizeof(ArrowArrayStream)));
+  if (!array_stream) {
+    throw std::bad_alloc();
+  }
+
+  const auto status = arrow::ExportRecordBatchReader(std::move(reader), array_stream);
+  if (!status.ok()) {
+    free(array_stream);
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("Failed to export arrow::RecordBatchReader as ArrowArrayStream: {}"),
+                    status.message()));
+  }
+
+  auto* capsule = PyCapsule_New(static_cast<void*>(array_stream), "arrow_array_stream",
+                                release_arrow_array_streamPyCapsule);
+  if (!capsule) {
+    if (array_stream->release) {
+      array_stream->release(array_stream);
+    }
+    free(array_stream);
+    throw std::runtime_error("Failed to create PyCapsule for arrow_array_stream");
+  }
+
+  return nb::steal(capsule);
+}
+
+nb::object export_pyarrow_record_batch_reader(std::shared_ptr<arrow::RecordBatchReader> reader,
+                                              nb::object owner) {
+  const auto pa = import_pyarrow_checked();
+
+  auto obj = nb::module_::import_("types").attr("SimpleNamespace")();
+  obj.attr("__setattr__")(
+      "__arrow_c_stream__",
+      nb::cpp_function(
+          [capsule = export_arrow_c_stream(std::move(reader), std::move(owner))](
+              [[maybe_unused]] const nb::any& _) { return capsule; },
+          nb::arg("requested_schema") = nb::none()));
+
+  return nb::cast(pa.attr("RecordBatchReader").attr("from_stream")(obj),
+                  nb::rv_policy::take_ownership);
+}
+
 nb::object export_pyarrow_table(std::shared_ptr<arrow::Table> arrow_table) {
   assert(arrow_table);
+  [[maybe_unused]] const profiling::Stage stage{"export"};
 
   const auto pa = import_pyarrow_checked();
 
@@ -133,4 +232,35 @@ nb::object export_pyarrow_table(std::shared_ptr<arrow::Table> arrow_table) {
 }
 // NOLINTEND(*-owning-memory,*-no-malloc)
 
+std::shared_ptr<arrow::Table> import_pyarrow_table(const nb::object& df) {
+  // https://arrow.apache.org/docs/format/CDataInterface/PyCapsuleInterface.html#arrowstream-export
+  const auto pa = import_pyarrow_checked();
+
+  // pyarrow.table() takes care of converting pandas.DataFrames, pyarrow.RecordBatches as well as
+  // objects implementing the __arrow_c_stream__ protocol. pyarrow.Tables are returned as-is and
+  // numeric columns are not copied when possible
+  auto capsule = pa.attr("table")(df).attr("__arrow_c_stream__")();
+  auto* array_stream =
+      static_cast<ArrowArrayStream*>(PyCapsule_GetPointer(capsule.ptr(), "arrow_array_stream"));
+  if (!array_stream) {
+    throw nb::python_error();
+  }
+
+  // Importing the stream moves its content into the reader and marks the stream as released
+  auto reader = arrow::ImportRecordBatchReader(array_stream);
+  if (!reader.ok()) {
+    throw std::runtime_error(
+        fmt::format(FMT_STRING("Failed to import ArrowArrayStream as arrow::RecordBatchReader: {}"),
+                    reader.status().message()));
+  }
+
+  auto table = reader.ValueUnsafe()->ToTable();
+  if (!table.ok()) {
+    throw std::runtime_error(fmt::format(FMT_STRING("Failed to read arrow::Table: {}"),
+                                         table.status().message()));
+  }
+
+  return table.MoveValueUnsafe();
+}
+
 }  // namespace hictkpy
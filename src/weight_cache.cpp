@@ -0,0 +1,178 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#include "hictkpy/weight_cache.hpp"
+
+#include <fmt/format.h>
+
+#include <cassert>
+#include <cstddef>
+#include <filesystem>
+#include <hictk/balancing/weights.hpp>
+#include <hictk/file.hpp>
+#include <hictk/hic.hpp>
+#include <hictk/hic/common.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "hictkpy/locking.hpp"
+
+namespace hictkpy {
+
+WeightCache::WeightCache(std::size_t capacity_bytes) : _capacity_bytes(capacity_bytes) {}
+
+auto WeightCache::get(const hictk::File& f, std::string_view normalization,
+                      hictk::balancing::Weights::Type type) -> Value {
+  const auto read_weights = [&]() {
+    [[maybe_unused]] const auto lck = lock_file(*get_file_mutex(f));
+    return std::make_shared<const std::vector<double>>(
+        f.normalization(normalization).to_vector(type));
+  };
+
+  std::error_code ec{};
+  const auto mtime = std::filesystem::last_write_time(f.path(), ec);
+  if (ec) {
+    // weights are not cached when the modification time of the file cannot be determined
+    return read_weights();
+  }
+
+  auto key = make_key(f, normalization, type);
+  {
+    [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+    if (auto match = _index.find(key); match != _index.end()) {
+      if (match->second->mtime == mtime) {
+        ++_stats.hits;
+        _entries.splice(_entries.begin(), _entries, match->second);
+        return match->second->weights;
+      }
+      ++_stats.invalidations;
+      _size_bytes -= entry_size_bytes(*match->second);
+      _entries.erase(match->second);
+      _index.erase(match);
+    }
+    ++_stats.misses;
+  }
+
+  // Weights are read without holding the cache lock: in the worst case, two threads decode the same
+  // weights and the second one replaces the entry inserted by the first one
+  auto weights = read_weights();
+
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  if (auto match = _index.find(key); match != _index.end()) {
+    _size_bytes -= entry_size_bytes(*match->second);
+    _entries.erase(match->second);
+    _index.erase(match);
+  }
+
+  Entry entry{std::move(key), mtime, weights};
+  const auto entry_size = entry_size_bytes(entry);
+  if (entry_size > _capacity_bytes) {
+    // weights that do not fit in the cache are returned without being cached
+    return weights;
+  }
+
+  while (_size_bytes + entry_size > _capacity_bytes) {
+    evict_lru();
+  }
+
+  _entries.emplace_front(std::move(entry));
+  _index.emplace(_entries.front().key, _entries.begin());
+  _size_bytes += entry_size;
+
+  return weights;
+}
+
+std::size_t WeightCache::size() const noexcept {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _entries.size();
+}
+
+std::size_t WeightCache::size_bytes() const noexcept {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _size_bytes;
+}
+
+std::size_t WeightCache::capacity_bytes() const noexcept {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _capacity_bytes;
+}
+
+auto WeightCache::stats() const noexcept -> Stats {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  return _stats;
+}
+
+void WeightCache::set_capacity_bytes(std::size_t capacity_bytes) {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  _capacity_bytes = capacity_bytes;
+  while (_size_bytes > _capacity_bytes) {
+    evict_lru();
+  }
+}
+
+void WeightCache::clear() noexcept {
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  _index.clear();
+  _entries.clear();
+  _size_bytes = 0;
+}
+
+void WeightCache::erase(const hictk::File& f) {
+  const auto prefix = make_key_prefix(f);
+
+  [[maybe_unused]] const auto lck = std::scoped_lock(_mtx);
+  for (auto it = _entries.begin(); it != _entries.end();) {
+    if (std::string_view{it->key}.substr(0, prefix.size()) == prefix) {
+      _size_bytes -= entry_size_bytes(*it);
+      _index.erase(it->key);
+      it = _entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+std::string WeightCache::make_key(const hictk::File& f, std::string_view normalization,
+                                  hictk::balancing::Weights::Type type) {
+  const auto* type_str = type == hictk::balancing::Weights::Type::DIVISIVE ? "div" : "mult";
+  // Cooler files only store observed interactions in BP units
+  auto matrix_type = hictk::hic::MatrixType::observed;
+  auto matrix_unit = hictk::hic::MatrixUnit::BP;
+  if (f.is_hic()) {
+    const auto& hf = f.get<hictk::hic::File>();
+    matrix_type = hf.matrix_type();
+    matrix_unit = hf.matrix_unit();
+  }
+  return fmt::format(FMT_STRING("{}{}\t{}\t{}\t{}"), make_key_prefix(f), matrix_type,
+                     matrix_unit, normalization, type_str);
+}
+
+std::string WeightCache::make_key_prefix(const hictk::File& f) {
+  return fmt::format(FMT_STRING("{}\t{}\t"), f.uri(), f.resolution());
+}
+
+std::size_t WeightCache::entry_size_bytes(const Entry& entry) noexcept {
+  return entry.key.size() + (entry.weights->size() * sizeof(double));
+}
+
+void WeightCache::evict_lru() {
+  assert(!_entries.empty());
+  const auto& entry = _entries.back();
+  _size_bytes -= entry_size_bytes(entry);
+  _index.erase(entry.key);
+  _entries.pop_back();
+  ++_stats.evictions;
+}
+
+WeightCache& get_weight_cache() {
+  static WeightCache cache{};
+  return cache;
+}
+
+}  // namespace hictkpy
@@ -0,0 +1,253 @@
+// Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+//
+// SPDX-License-Identifier: MIT
+
+#include "hictkpy/zoomify.hpp"
+
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <fmt/std.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <hictk/balancing/methods.hpp>
+#include <hictk/cooler/cooler.hpp>
+#include <hictk/cooler/multires_cooler.hpp>
+#include <hictk/cooler/uri.hpp>
+#include <hictk/file.hpp>
+#include <hictk/hic/file_writer.hpp>
+#include <hictk/pixel.hpp>
+#include <hictk/reference.hpp>
+#include <hictk/tmpdir.hpp>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "hictkpy/locking.hpp"
+#include "hictkpy/multires_file.hpp"
+#include "hictkpy/nanobind.hpp"
+
+namespace nb = nanobind;
+
+namespace hictkpy::zoomify {
+
+[[nodiscard]] static std::filesystem::path get_file_path(const hictk::File& f) {
+  if (f.is_cooler()) {
+    return hictk::cooler::parse_cooler_uri(f.uri()).file_path;
+  }
+  return f.path();
+}
+
+[[nodiscard]] static std::string get_assembly(const hictk::File& f) {
+  if (f.is_cooler()) {
+    return f.get<hictk::cooler::File>().attributes().assembly.value_or("unknown");
+  }
+  return std::string{f.get<hictk::hic::File>().assembly()};
+}
+
+// Read all interactions from f and pass them to fx() in chunks of up to chunk_size pixels.
+// Pixels are sorted by their coordinates
+template <typename N, typename Fx>
+static void stream_pixels(const hictk::File& f, std::size_t chunk_size, Fx&& fx) {
+  std::vector<hictk::ThinPixel<N>> buffer{};
+  buffer.reserve(chunk_size);
+
+  std::visit(
+      [&](const auto& ff) {
+        const auto sel = ff.fetch(hictk::balancing::Method::NONE());
+        auto first = sel.template begin<N>();
+        auto last = sel.template end<N>();
+        for (; first != last; ++first) {
+          buffer.emplace_back(*first);
+          if (buffer.size() == chunk_size) {
+            fx(buffer);
+            buffer.clear();
+          }
+        }
+      },
+      f.get());
+
+  if (!buffer.empty()) {
+    fx(buffer);
+  }
+}
+
+template <typename N>
+static void zoomify_mcool(const hictk::File& src, const std::filesystem::path& dest,
+                          const std::vector<std::uint32_t>& resolutions, bool overwrite,
+                          std::size_t chunk_size, std::uint32_t compression_lvl) {
+  const auto chroms = src.chromosomes().remove_ALL();
+  const auto assembly = get_assembly(src);
+  const auto base_resolution = src.resolution();
+
+  auto mclr = hictk::cooler::MultiResFile::create(dest, chroms, overwrite);
+
+  const auto init_resolution = [&](std::uint32_t resolution) {
+    auto attrs = hictk::cooler::Attributes::init(resolution);
+    attrs.assembly = assembly;
+    return hictk::cooler::File::create<N>(mclr.init_resolution(resolution), chroms, resolution,
+                                          std::move(attrs),
+                                          hictk::cooler::DEFAULT_HDF5_CACHE_SIZE * 4,
+                                          compression_lvl);
+  };
+
+  SPDLOG_INFO(FMT_STRING("copying {} resolution from \"{}\""), base_resolution, src.uri());
+  {
+    auto clr = init_resolution(base_resolution);
+    stream_pixels<N>(src, chunk_size,
+                     [&](const auto& pixels) { clr.append_pixels(pixels.begin(), pixels.end()); });
+  }
+
+  // Each resolution is generated from the coarsest resolution that has already been processed and
+  // that is a divisor of the target resolution
+  std::vector<hictk::ThinPixel<N>> buffer(chunk_size);
+  std::vector<std::uint32_t> processed_resolutions{base_resolution};
+  for (const auto& resolution : resolutions) {
+    if (resolution == base_resolution) {
+      continue;
+    }
+    const auto coarsen_from = hictk::cooler::MultiResFile::compute_base_resolution(
+        processed_resolutions, resolution);
+    SPDLOG_INFO(FMT_STRING("generating {} resolution from {} ({}x)"), resolution, coarsen_from,
+                resolution / coarsen_from);
+
+    const auto clr1 = mclr.open(coarsen_from);
+    auto clr2 = init_resolution(resolution);
+    hictk::cooler::MultiResFile::coarsen(clr1, clr2, buffer);
+    processed_resolutions.push_back(resolution);
+  }
+}
+
+static void zoomify_hic(const hictk::File& src, const std::filesystem::path& dest,
+                        const std::vector<std::uint32_t>& resolutions, bool overwrite,
+                        std::size_t n_threads, std::size_t chunk_size,
+                        const std::filesystem::path& tmpdir, std::uint32_t compression_lvl,
+                        bool skip_all_vs_all_matrix) {
+  if (overwrite) {
+    std::filesystem::remove(dest);  // NOLINT
+  }
+
+  const hictk::internal::TmpDir tmpdir_{tmpdir, true};
+  hictk::hic::internal::HiCFileWriter w(dest.string(), src.chromosomes().remove_ALL(),
+                                        resolutions, get_assembly(src), n_threads, chunk_size,
+                                        tmpdir_(), compression_lvl, skip_all_vs_all_matrix);
+
+  // Interactions are read only once: coarser resolutions are generated by the writer
+  SPDLOG_INFO(FMT_STRING("reading interactions at {} resolution from \"{}\""), src.resolution(),
+              src.uri());
+  stream_pixels<float>(src, chunk_size, [&](const auto& pixels) {
+    w.add_pixels(src.resolution(), pixels.begin(), pixels.end());
+  });
+
+  SPDLOG_INFO(FMT_STRING("writing resolutions {} to file \"{}\"..."), fmt::join(resolutions, ", "),
+              dest);
+  w.serialize();
+}
+
+hictkpy::MultiResFile zoomify(const hictk::File& src, const std::filesystem::path& dest,
+                              std::vector<std::uint32_t> resolutions, bool overwrite,
+                              std::size_t n_threads, std::size_t chunk_size,
+                              const std::filesystem::path& tmpdir,
+                              std::optional<std::uint32_t> compression_lvl,
+                              bool skip_all_vs_all_matrix) {
+  if (n_threads == 0) {
+    throw std::runtime_error("n_threads should be a positive number");
+  }
+  if (chunk_size == 0) {
+    throw std::runtime_error("chunk_size should be a positive number");
+  }
+
+  const auto base_resolution = src.resolution();
+  if (base_resolution == 0) {
+    throw std::runtime_error("zoomifying files with variable bin sizes is not supported");
+  }
+
+  // The base resolution is always included in the output file
+  resolutions.push_back(base_resolution);
+  std::sort(resolutions.begin(), resolutions.end());
+  resolutions.erase(std::unique(resolutions.begin(), resolutions.end()), resolutions.end());
+
+  for (const auto& resolution : resolutions) {
+    if (resolution < base_resolution || resolution % base_resolution != 0) {
+      throw std::runtime_error(
+          fmt::format(FMT_STRING("resolution {} is not a multiple of base resolution {}"),
+                      resolution, base_resolution));
+    }
+  }
+
+  if (std::filesystem::exists(dest)) {
+    if (std::filesystem::equivalent(dest, get_file_path(src))) {
+      throw std::runtime_error(fmt::format(
+          FMT_STRING("unable to zoomify file \"{}\": dest cannot be the same file as src"), dest));
+    }
+    if (!overwrite) {
+      throw std::runtime_error(fmt::format(
+          FMT_STRING("unable to zoomify file \"{}\": file \"{}\" already exists. Pass "
+                     "overwrite=True to overwrite existing files."),
+          src.uri(), dest));
+    }
+  }
+
+  const auto output_is_hic = dest.extension() == ".hic";
+  // NOLINTNEXTLINE(*-avoid-magic-numbers)
+  const std::uint32_t default_compression_lvl = output_is_hic ? 10 : 6;
+  const auto compression_lvl_ = compression_lvl.value_or(default_compression_lvl);
+
+  // Reading from src (and writing .mcool files) requires synchronization
+  [[maybe_unused]] const auto lck = std::scoped_lock(*get_file_mutex(src));
+  std::unique_lock<FileMutex> hdf5_lck{};
+  if (!output_is_hic) {
+    hdf5_lck = std::unique_lock(*get_hdf5_mutex());
+  }
+
+  if (output_is_hic) {
+    zoomify_hic(src, dest, resolutions, overwrite, n_threads, chunk_size, tmpdir, compression_lvl_,
+                skip_all_vs_all_matrix);
+  } else if (src.is_hic()) {
+    zoomify_mcool<float>(src, dest, resolutions, overwrite, chunk_size, compression_lvl_);
+  } else {
+    std::visit(
+        [&]([[maybe_unused]] auto count) {
+          using N = decltype(count);
+          zoomify_mcool<N>(src, dest, resolutions, overwrite, chunk_size, compression_lvl_);
+        },
+        src.get<hictk::cooler::File>().pixel_variant());
+  }
+
+  return hictkpy::MultiResFile{dest};
+}
+
+void declare_zoomify_function(nb::module_& m) {
+  // NOLINTBEGIN(*-avoid-magic-numbers)
+  m.def("zoomify", &zoomify::zoomify, nb::call_guard<nb::gil_scoped_release>(), nb::arg("src"),
+        nb::arg("dest"), nb::arg("resolutions"), nb::arg("overwrite") = false,
+        nb::arg("n_threads") = 1, nb::arg("chunk_size") = 10'000'000,
+        nb::arg("tmpdir") = hictk::internal::TmpDir::default_temp_directory_path(),
+        nb::arg("compression_lvl") = nb::none(), nb::arg("skip_all_vs_all_matrix") = false,
+        "Create a multi-resolution file with the interactions from src coarsened to the given "
+        "resolutions.\n"
+        "The output format (.mcool or .hic) is inferred from the extension of dest, and the "
+        "resolution of src is always included in the output file. All resolutions should be "
+        "multiples of the resolution of src.\n"
+        "Interactions from src are read once, in chunks of chunk_size pixels. When creating .hic "
+        "files, all resolutions are generated at once using n_threads threads. When creating "
+        ".mcool files, each resolution is generated from the coarsest suitable resolution that "
+        "has already been written to dest.\n"
+        "compression_lvl defaults to 6 for .mcool files and to 10 for .hic files. "
+        "skip_all_vs_all_matrix is only used when creating .hic files.",
+        nb::sig("def zoomify(src: hictkpy.File, dest: str | os.PathLike, resolutions: "
+                "collections.abc.Sequence[int], overwrite: bool = False, n_threads: int = 1, "
+                "chunk_size: int = 10000000, tmpdir: str | os.PathLike = ..., compression_lvl: "
+                "int | None = None, skip_all_vs_all_matrix: bool = False) -> hictkpy.MultiResFile"),
+        nb::rv_policy::move);
+  // NOLINTEND(*-avoid-magic-numbers)
+}
+
+}  // namespace hictkpy::zoomify
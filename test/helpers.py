@@ -37,3 +37,36 @@ def scipy_avail() -> bool:
         return False
 
     return True
+
+
+def write_pairs(df, path, bgzip: bool = False):
+    """
+    Write the pixels from the given BG2 DataFrame to path in 4DN-DCIC pairs format (one pair per pixel).
+    When bgzip=True, the file is compressed using the BGZF format.
+    """
+    import struct
+    import zlib
+
+    lines = ["## pairs format v1.0\n", "#columns: readID chrom1 pos1 chrom2 pos2 strand1 strand2\n"]
+    for i, (chrom1, start1, chrom2, start2) in enumerate(
+        zip(df["chrom1"], df["start1"], df["chrom2"], df["start2"])
+    ):
+        lines.append(f"read{i}\t{chrom1}\t{start1 + 1}\t{chrom2}\t{start2 + 1}\t+\t-\n")
+    data = "".join(lines).encode()
+
+    if not bgzip:
+        with open(path, "wb") as f:
+            f.write(data)
+        return
+
+    def make_block(payload: bytes) -> bytes:
+        compressor = zlib.compressobj(6, zlib.DEFLATED, -15)
+        cdata = compressor.compress(payload) + compressor.flush()
+        header = struct.pack("<BBBBIBBHBBHH", 31, 139, 8, 4, 0, 0, 255, 6, 66, 67, 2, len(cdata) + 25)
+        return header + cdata + struct.pack("<II", zlib.crc32(payload), len(payload))
+
+    block_size = 16 << 10
+    with open(path, "wb") as f:
+        for start in range(0, len(data), block_size):
+            f.write(make_block(data[start : start + block_size]))
+        f.write(make_block(b""))
@@ -72,6 +72,55 @@ class TestClass:
         assert len(bins.get([1, 1])) == 2
         assert len(bins.get_ids(["chr1", "chr1"], [1, 1])) == 2
 
+    @pytest.mark.skipif(
+        not numpy_avail() or not pandas_avail() or not pyarrow_avail(),
+        reason="numpy, pandas or pyarrow are not available",
+    )
+    @pytest.mark.parametrize("n_threads", [1, 4])
+    def test_vectorized_getters_array_types(self, n_threads):
+        import numpy as np
+        import pandas as pd
+        import pyarrow as pa
+
+        chroms = {"chr1": 1000, "chr2": 500}
+        bins = hictkpy.BinTable(chroms, 100)
+
+        size = 250_000
+        rng = np.random.default_rng(0)
+        chrom_names = rng.choice(["chr1", "chr2"], size=size)
+        positions = rng.integers(0, 500, size=size)
+        expected = np.where(chrom_names == "chr1", 0, 10) + positions // 100
+
+        inputs = [
+            (chrom_names, positions),
+            (chrom_names.tolist(), positions.tolist()),
+            (pd.Series(chrom_names, dtype="category"), pd.Series(positions)),
+            (pa.array(chrom_names).dictionary_encode(), pa.array(positions, type=pa.uint32())),
+        ]
+        for chrom_names_, positions_ in inputs:
+            bin_ids = bins.get_ids(chrom_names_, positions_, n_threads=n_threads)
+            assert (bin_ids == expected).all()
+
+            df = bins.get(chrom_names_, positions_, n_threads=n_threads)
+            assert (df.index == expected).all()
+            assert (df["chrom"] == chrom_names).all()
+            assert (df["start"] == (positions // 100) * 100).all()
+
+        df = bins.get(expected, n_threads=n_threads)
+        assert (df["chrom"] == chrom_names).all()
+        assert (df["end"] == (positions // 100 + 1) * 100).all()
+
+        df = bins.merge(pd.DataFrame({"bin1_id": expected, "bin2_id": expected[::-1]}), n_threads=n_threads)
+        assert (df["chrom1"] == chrom_names).all()
+        assert (df["chrom2"] == chrom_names[::-1]).all()
+
+        with pytest.raises(Exception):
+            bins.get_ids(["chr1", "chr1"], [1])
+        with pytest.raises(Exception):
+            bins.get_ids(["chr1", "chr3"], [1, 1])
+        with pytest.raises(Exception):
+            bins.get_ids(["chr1", "chr1"], [1, -1])
+
     @pytest.mark.skipif(not pandas_avail() or not pyarrow_avail(), reason="pandas is not available")
     def test_merge(self):
         import pandas as pd
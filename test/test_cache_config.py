@@ -0,0 +1,217 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import gc
+import os
+import pathlib
+import shutil
+
+import pytest
+
+import hictkpy
+
+from .helpers import numpy_avail, pandas_avail, pyarrow_avail
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+
+@pytest.fixture
+def restore_cache_config():
+    config = hictkpy.get_cache_config()
+    yield
+    hictkpy.set_cache_config(config)
+
+
+@pytest.mark.usefixtures("restore_cache_config")
+class TestClass:
+    def test_cache_config(self, file, resolution):
+        config = hictkpy.CacheConfig(max_bytes=1 << 20, file_cache_bytes=1 << 10, weight_cache_bytes=1 << 16)
+        assert config.max_bytes == 1 << 20
+        assert config.file_cache_bytes == 1 << 10
+        assert config.weight_cache_bytes == 1 << 16
+        assert str(config).startswith("CacheConfig(")
+
+        hictkpy.set_cache_config(config)
+        config = hictkpy.get_cache_config()
+        assert config.max_bytes == 1 << 20
+        assert hictkpy.cache_stats()["weights"]["capacity_bytes"] == 1 << 16
+
+    def test_file_cache_size(self, file, resolution):
+        gc.collect()
+        f = hictkpy.File(file, resolution, cache_size=1_000_000)
+        assert f.cache_stats()["capacity_bytes"] == 1_000_000
+        assert f.fetch().sum() == 178_263_235
+
+        if f.is_hic():
+            assert 0 <= f.cache_stats()["hit_rate"] <= 1
+        else:
+            assert f.cache_stats()["hit_rate"] is None
+
+    def test_cache_budget(self, file, resolution):
+        gc.collect()
+        hictkpy.set_cache_config(hictkpy.CacheConfig())
+        num_files = hictkpy.cache_stats()["files"]["num_files"]
+        size_bytes = hictkpy.cache_stats()["files"]["size_bytes"]
+
+        budget = size_bytes + 3_000_000
+        hictkpy.set_cache_config(hictkpy.CacheConfig(max_bytes=budget, file_cache_bytes=2_000_000))
+
+        path = testdir / "data" / "cooler_test_file.mcool"
+        f1 = hictkpy.File(path, resolution)
+        f2 = hictkpy.File(path, resolution)
+        f3 = hictkpy.File(path, resolution)
+
+        assert f1.cache_stats()["capacity_bytes"] == 2_000_000
+        assert f2.cache_stats()["capacity_bytes"] == 1_000_000
+        assert f3.cache_stats()["capacity_bytes"] == 0
+        # files with small or empty caches can still be read
+        assert f3.fetch().sum() == 178_263_235
+
+        stats = hictkpy.cache_stats()["files"]
+        assert stats["num_files"] == num_files + 3
+        assert stats["size_bytes"] == budget
+        assert stats["capacity_bytes"] == budget
+
+        del f1, f2, f3
+        gc.collect()
+        assert hictkpy.cache_stats()["files"]["size_bytes"] == size_bytes
+
+    def test_weight_cache_stats(self, file, resolution):
+        hictkpy.set_cache_config(hictkpy.CacheConfig(weight_cache_bytes=0))
+        hictkpy.set_cache_config(hictkpy.CacheConfig())
+
+        f = hictkpy.File(file, resolution)
+        norm = "weight" if f.is_cooler() else "ICE"
+
+        stats1 = hictkpy.cache_stats()["weights"]
+        f.weights(norm)
+        f.weights(norm)
+        stats2 = hictkpy.cache_stats()["weights"]
+
+        assert stats2["misses"] == stats1["misses"] + 1
+        assert stats2["hits"] == stats1["hits"] + 1
+        assert stats2["num_entries"] == 1
+        assert stats2["size_bytes"] > 0
+
+    def test_weight_cache_invalidation(self, file, resolution, tmpdir):
+        path = pathlib.Path(tmpdir) / file.name
+        shutil.copy(file, path)
+
+        hictkpy.set_cache_config(hictkpy.CacheConfig())
+
+        f = hictkpy.File(path, resolution)
+        norm = "weight" if f.is_cooler() else "ICE"
+        w1 = f.weights(norm)
+        stats1 = hictkpy.cache_stats()["weights"]
+
+        mtime = path.stat().st_mtime
+        os.utime(path, (mtime + 10, mtime + 10))
+
+        w2 = hictkpy.File(path, resolution).weights(norm)
+        stats2 = hictkpy.cache_stats()["weights"]
+        assert stats2["invalidations"] == stats1["invalidations"] + 1
+        assert stats2["hits"] == stats1["hits"]
+        assert stats2["misses"] == stats1["misses"] + 1
+        assert len(w1) == len(w2)
+
+    @pytest.mark.skipif(
+        not numpy_avail() or not pandas_avail() or not pyarrow_avail(),
+        reason="either numpy, pandas, or pyarrow are not available",
+    )
+    def test_query_cache(self, file, resolution):
+        import numpy as np
+
+        hictkpy.set_cache_config(hictkpy.CacheConfig(query_cache_bytes=64 << 20))
+
+        f = hictkpy.File(file, resolution)
+        stats1 = hictkpy.cache_stats()["queries"]
+        m1 = f.fetch("chr2R:10,000,000-15,000,000").to_numpy()
+        m1[0, 0] = -1
+        m2 = f.fetch("chr2R\t10000000\t15000000", query_type="BED").to_numpy()
+        stats2 = hictkpy.cache_stats()["queries"]
+
+        assert stats2["misses"] == stats1["misses"] + 1
+        assert stats2["hits"] == stats1["hits"] + 1
+        assert stats2["num_entries"] == 1
+        # arrays returned by to_numpy() do not share their buffer with the query cache
+        assert m2[0, 0] != -1
+        assert np.array_equal(m2, f.fetch("chr2R:10,000,000-15,000,000").to_numpy())
+
+        # queries with different parameters do not share cache entries
+        m3 = f.fetch("chr2R:10,000,000-15,000,000").to_numpy("full")
+        assert not np.array_equal(m2, m3)
+        assert hictkpy.cache_stats()["queries"]["num_entries"] == 2
+
+        df1 = f.fetch("chr2R:10,000,000-15,000,000").to_df()
+        df2 = f.fetch("chr2R:10,000,000-15,000,000").to_df()
+        assert df1.equals(df2)
+        assert hictkpy.cache_stats()["queries"]["num_entries"] == 3
+
+        hictkpy.set_cache_config(hictkpy.CacheConfig())
+        assert hictkpy.cache_stats()["queries"]["num_entries"] == 0
+
+    @pytest.mark.skipif(not numpy_avail(), reason="numpy is not available")
+    def test_query_cache_invalidation(self, file, resolution, tmpdir):
+        import numpy as np
+
+        path = pathlib.Path(tmpdir) / file.name
+        shutil.copy(file, path)
+
+        hictkpy.set_cache_config(hictkpy.CacheConfig(query_cache_bytes=64 << 20, query_cache_compression_level=1))
+
+        f = hictkpy.File(path, resolution)
+        m1 = f.fetch("chr2R").to_numpy()
+        stats1 = hictkpy.cache_stats()["queries"]
+
+        mtime = path.stat().st_mtime
+        os.utime(path, (mtime + 10, mtime + 10))
+
+        m2 = f.fetch("chr2R").to_numpy()
+        stats2 = hictkpy.cache_stats()["queries"]
+        assert stats2["invalidations"] == stats1["invalidations"] + 1
+        assert stats2["hits"] == stats1["hits"]
+        assert np.array_equal(m1, m2)
+
+    @pytest.mark.skipif(not numpy_avail(), reason="numpy is not available")
+    def test_query_cache_spill(self, file, resolution, tmpdir):
+        import numpy as np
+
+        spill_dir = pathlib.Path(tmpdir) / "spill"
+        f = hictkpy.File(file, resolution)
+        m1 = f.fetch("chr2L:0-10,000,000").to_numpy()
+
+        # the cache is large enough to store a single matrix
+        hictkpy.set_cache_config(
+            hictkpy.CacheConfig(
+                query_cache_bytes=m1.nbytes + (1 << 10),
+                query_cache_spill_dir=str(spill_dir),
+                query_cache_spill_bytes=64 << 20,
+            )
+        )
+
+        f.fetch("chr2L:0-10,000,000").to_numpy()
+        f.fetch("chr2L:10,000,000-20,000,000").to_numpy()
+        stats1 = hictkpy.cache_stats()["queries"]
+        assert stats1["num_entries"] == 1
+        assert stats1["num_spilled_entries"] == 1
+        assert len(list(spill_dir.iterdir())) == 1
+
+        m2 = f.fetch("chr2L:0-10,000,000").to_numpy()
+        stats2 = hictkpy.cache_stats()["queries"]
+        assert stats2["spill_hits"] == stats1["spill_hits"] + 1
+        assert np.array_equal(m1, m2)
+
+        hictkpy.set_cache_config(hictkpy.CacheConfig())
+        assert len(list(spill_dir.iterdir())) == 0
+
+        with pytest.raises(RuntimeError, match="compression level"):
+            hictkpy.set_cache_config(hictkpy.CacheConfig(query_cache_compression_level=13))
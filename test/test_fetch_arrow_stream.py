@@ -0,0 +1,88 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import gc
+import pathlib
+
+import pytest
+
+import hictkpy
+
+from .helpers import pyarrow_avail
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+
+@pytest.mark.skipif(not pyarrow_avail(), reason="pyarrow is not available")
+class TestClass:
+    def test_genome_wide(self, file, resolution):
+        import pyarrow as pa
+
+        f = hictkpy.File(file, resolution)
+
+        reader = f.fetch().to_arrow_stream(batch_size=100_000)
+        assert isinstance(reader, pa.RecordBatchReader)
+
+        num_rows = 0
+        for batch in reader:
+            assert 0 < batch.num_rows <= 100_000
+            num_rows += batch.num_rows
+
+        assert num_rows == 890_384
+
+    def test_matches_to_arrow(self, file, resolution):
+        import pyarrow as pa
+
+        f = hictkpy.File(file, resolution)
+
+        for join in (False, True):
+            sel = f.fetch("chr2R:10,000,000-15,000,000", "chrX", join=join)
+            expected = sel.to_arrow()
+            found = sel.to_arrow_stream(batch_size=123).read_all()
+            assert found.schema == expected.schema
+            assert found.combine_chunks().equals(expected.combine_chunks())
+
+            found = pa.RecordBatchReader.from_stream(sel).read_all()
+            assert found.combine_chunks().equals(expected.combine_chunks())
+
+    def test_small_query(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        sel = f.fetch("chr2L:0-1")
+        table = sel.to_arrow_stream().read_all()
+        assert table.num_rows == sel.nnz()
+        assert table.schema == sel.to_arrow().schema
+
+    def test_outlives_file(self, file, resolution):
+        import pyarrow as pa
+
+        query = ("chr2R:10,000,000-15,000,000", "chrX")
+        expected = hictkpy.File(file, resolution).fetch(*query).to_arrow()
+
+        f = hictkpy.File(file, resolution)
+        sel = f.fetch(*query)
+        reader = sel.to_arrow_stream(batch_size=123)
+        del sel, f
+        gc.collect()
+        assert reader.read_all().combine_chunks().equals(expected.combine_chunks())
+
+        f = hictkpy.File(file, resolution)
+        reader = pa.RecordBatchReader.from_stream(f.fetch(*query))
+        del f
+        gc.collect()
+        assert reader.read_all().combine_chunks().equals(expected.combine_chunks())
+
+    def test_invalid_args(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        with pytest.raises(RuntimeError):
+            f.fetch().to_arrow_stream(batch_size=0)
@@ -0,0 +1,119 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pathlib
+
+import pytest
+
+import hictkpy
+
+from .helpers import numpy_avail, pandas_avail, pyarrow_avail, scipy_avail
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+
+def filter_band(df, max_distance_bins: int):
+    return df[(df["bin2_id"] - df["bin1_id"]).abs() <= max_distance_bins].reset_index(drop=True)
+
+
+@pytest.mark.skipif(
+    not numpy_avail() or not pandas_avail() or not pyarrow_avail(),
+    reason="either numpy, pandas, or pyarrow are not available",
+)
+class TestClass:
+    def test_band_df(self, file, resolution):
+        import pandas as pd
+
+        f = hictkpy.File(file, resolution)
+        for max_distance in [0, 500_000, 2_000_000, 100_000_000]:
+            sel = f.fetch("chr2R", max_distance=max_distance)
+            expected = filter_band(f.fetch("chr2R").to_df(), max_distance // resolution)
+            pd.testing.assert_frame_equal(sel.to_df(), expected)
+            assert sel.nnz() == len(expected)
+            assert sel.sum() == expected["count"].sum()
+
+    def test_band_balanced(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        norm = "weight" if f.is_cooler() else "ICE"
+        sel = f.fetch("chr2R:10,000,000-20,000,000", normalization=norm, max_distance=1_000_000)
+        expected = filter_band(f.fetch("chr2R:10,000,000-20,000,000", normalization=norm).to_df(), 10)
+
+        found = sel.to_df()
+        assert np.array_equal(found["bin1_id"], expected["bin1_id"])
+        assert np.array_equal(found["bin2_id"], expected["bin2_id"])
+        assert np.allclose(found["count"], expected["count"], equal_nan=True)
+
+    def test_band_numpy(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        sel = f.fetch("chr2R:10,000,000-20,000,000", max_distance=1_000_000)
+        m = sel.to_numpy()
+        assert m.shape == (100, 100)
+
+        i, j = np.indices(m.shape)
+        expected = f.fetch("chr2R:10,000,000-20,000,000").to_numpy()
+        expected[np.abs(i - j) > 10] = 0
+        assert np.array_equal(m, expected)
+
+        assert np.array_equal(sel.to_numpy(query_span="upper_triangle"), np.triu(expected))
+
+        out = np.empty_like(m)
+        assert sel.to_numpy(out=out) is out
+        assert np.array_equal(out, expected)
+
+    @pytest.mark.skipif(not scipy_avail(), reason="scipy is not available")
+    def test_band_csr(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        sel = f.fetch("chr2R:10,000,000-20,000,000", max_distance=1_000_000)
+        assert np.array_equal(sel.to_csr(query_span="full").toarray(), sel.to_numpy())
+
+    def test_band_storage(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        sel = f.fetch("chr2R:10,000,000-20,000,000", max_distance=1_000_000)
+        band = sel.to_band()
+        assert band.shape == (100, 11)
+
+        m = f.fetch("chr2R:10,000,000-20,000,000").to_numpy()
+        for k in range(band.shape[1]):
+            diag = np.diagonal(m, k)
+            assert np.array_equal(band[: len(diag), k], diag)
+            assert (band[len(diag) :, k] == 0).all()
+
+        with pytest.raises(RuntimeError, match="max_distance"):
+            f.fetch("chr2R:10,000,000-20,000,000").to_band()
+
+    def test_band_expected(self, file, resolution):
+        import pandas as pd
+
+        f = hictkpy.File(file, resolution)
+        expected = f.fetch("chr2R:10,000,000-20,000,000").expected()
+        found = f.fetch("chr2R:10,000,000-20,000,000", max_distance=1_000_000).expected()
+        pd.testing.assert_frame_equal(found, expected.iloc[:11])
+
+    def test_band_invalid_queries(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        with pytest.raises(RuntimeError, match="negative"):
+            f.fetch("chr2R", max_distance=-1)
+        with pytest.raises(RuntimeError, match="genome-wide"):
+            f.fetch(max_distance=1_000_000)
+        with pytest.raises(RuntimeError, match="identical"):
+            f.fetch("chr2R", "chrX", max_distance=1_000_000)
+        with pytest.raises(RuntimeError, match="identical"):
+            f.fetch("chr2R:0-10,000,000", "chr2R:5,000,000-15,000,000", max_distance=1_000_000)
@@ -88,3 +88,79 @@ class TestClass:
 
         m = f.fetch("chr2R\t10000000\t15000000", "chrX\t0\t10000000", query_type="BED").to_numpy()
         assert m.shape == (50, 100)
+
+    def test_out_param(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+
+        sel = f.fetch("chr2R:10,000,000-15,000,000")
+        expected = sel.to_numpy()
+        out = np.full_like(expected, -1)
+        m = sel.to_numpy(out=out)
+        assert m is out
+        assert np.array_equal(out, expected)
+
+        for query_span in ("upper_triangle", "lower_triangle"):
+            out = np.full_like(expected, -1)
+            sel.to_numpy(query_span, out=out)
+            assert np.array_equal(out, sel.to_numpy(query_span))
+
+        sel = f.fetch("chr2L:0-10,000,000", "chr2L:5,000,000-20,000,000", count_type="float")
+        expected = sel.to_numpy()
+        out = np.empty_like(expected)
+        sel.to_numpy(out=out)
+        assert np.array_equal(out, expected)
+
+        sel = f.fetch("chr2R:10,000,000-15,000,000", "chrX:0-10,000,000")
+        expected = sel.to_numpy()
+        out = np.empty_like(expected)
+        sel.to_numpy(out=out)
+        assert np.array_equal(out, expected)
+
+        norm = "weight" if f.is_cooler() else "ICE"
+        sel = f.fetch("chr2R:10,000,000-15,000,000", normalization=norm)
+        expected = sel.to_numpy()
+        out = np.empty_like(expected)
+        sel.to_numpy(out=out)
+        assert np.array_equal(out, expected, equal_nan=True)
+
+    def test_out_param_tiles(self, file, resolution, tmpdir):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        expected = f.fetch("chr2L:0-20,000,000").to_numpy()
+
+        path = pathlib.Path(tmpdir) / "matrix.npy"
+        out = np.lib.format.open_memmap(path, mode="w+", dtype=expected.dtype, shape=expected.shape)
+        step = 5_000_000
+        for start1 in range(0, 20_000_000, step):
+            for start2 in range(0, 20_000_000, step):
+                i0, i1 = start1 // resolution, (start1 + step) // resolution
+                j0, j1 = start2 // resolution, (start2 + step) // resolution
+                sel = f.fetch(f"chr2L:{start1}-{start1 + step}", f"chr2L:{start2}-{start2 + step}")
+                sel.to_numpy(out=out[i0:i1, j0:j1])
+        out.flush()
+        del out
+
+        assert np.array_equal(np.load(path), expected)
+
+    def test_out_param_invalid(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        sel = f.fetch("chr2R:10,000,000-15,000,000")
+
+        with pytest.raises(RuntimeError, match="wrong shape"):
+            sel.to_numpy(out=np.empty((10, 10), dtype=np.int32))
+
+        with pytest.raises(RuntimeError, match="dtype"):
+            sel.to_numpy(out=np.empty((50, 50), dtype=np.float64))
+
+        with pytest.raises(RuntimeError, match="dtype"):
+            sel.to_numpy(out=[[0] * 50] * 50)
+
+        out = np.empty((50, 50), dtype=np.int32)
+        out.flags.writeable = False
+        with pytest.raises(RuntimeError):
+            sel.to_numpy(out=out)
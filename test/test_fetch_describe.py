@@ -10,7 +10,7 @@ import pytest
 
 import hictkpy
 
-from .helpers import numpy_avail, pandas_avail
+from .helpers import numpy_avail, pandas_avail, scipy_avail
 
 
 def isclose(n1, n2) -> bool:
@@ -63,6 +63,28 @@ class TestClass:
 
         return chroms, resolution, pd.DataFrame({"bin1_id": bin1_ids, "bin2_id": bin2_ids, "count": counts})
 
+    @staticmethod
+    def generate_pixels_with_non_finite_values(seed: int = 0):
+        import numpy as np
+        import pandas as pd
+
+        chroms = {"chr1": 1000}
+        resolution = 10
+        num_bins = chroms["chr1"] // resolution
+
+        # upper-triangular matrix with 5050 pixels, so that pixels span multiple blocks of 4096 values
+        bin1_ids, bin2_ids = np.triu_indices(num_bins)
+        rng = np.random.default_rng(seed)
+        counts = rng.lognormal(mean=2.0, sigma=0.75, size=len(bin1_ids))
+
+        # scatter non-finite values across the entire matrix
+        idx = rng.choice(len(counts), size=30, replace=False)
+        counts[idx[:10]] = np.nan
+        counts[idx[10:20]] = np.inf
+        counts[idx[20:]] = -np.inf
+
+        return chroms, resolution, pd.DataFrame({"bin1_id": bin1_ids, "bin2_id": bin2_ids, "count": counts})
+
     @staticmethod
     def make_cooler_file(chroms, resolution, pixels, tmpdir) -> hictkpy.File:
         with tempfile.NamedTemporaryFile(dir=tmpdir, suffix=".cool") as tmpfile:
@@ -90,6 +112,64 @@ class TestClass:
         assert isclose(stats.get("skewness", -1), -2.598076367237896e-16)
         assert isclose(stats.get("kurtosis", -1), -1.2000000960000043)
 
+    def test_describe_all_finite_exact(self, tmpdir):
+        f = self.make_cooler_file(
+            *self.generate_pixels(insert_nan=False, insert_neg_inf=False, insert_pos_inf=False), tmpdir
+        )
+
+        sel = f.fetch(count_type="float")
+        stats = sel.describe(keep_nans=True, keep_infs=True, exact=True)
+
+        assert stats.get("nnz", -1) == 5_000
+        assert isclose(stats.get("mean", -1), 2499.623)
+        assert isclose(stats.get("variance", -1), 2083750.0)
+        assert isclose(stats.get("skewness", -1), 0.0)
+        assert isclose(stats.get("kurtosis", -1), -1.2000000960000043)
+
+        assert isclose(sel.variance(exact=True), 2083750.0)
+        assert isclose(sel.skewness(exact=True), 0.0)
+        assert isclose(sel.kurtosis(exact=True), -1.2000000960000043)
+
+        f = self.make_cooler_file(
+            *self.generate_pixels(insert_nan=True, insert_neg_inf=False, insert_pos_inf=False), tmpdir
+        )
+        stats = f.fetch(count_type="float").describe(keep_nans=True, keep_infs=True, exact=True)
+        assert isnan(stats.get("variance", -1))
+        assert isnan(stats.get("skewness", -1))
+        assert isnan(stats.get("kurtosis", -1))
+
+    @pytest.mark.skipif(not scipy_avail(), reason="scipy is not available")
+    def test_describe_drop_non_finite(self, tmpdir):
+        import numpy as np
+        import scipy.stats as ss
+
+        chroms, resolution, pixels = self.generate_pixels_with_non_finite_values()
+        f = self.make_cooler_file(chroms, resolution, pixels, tmpdir)
+
+        counts = pixels["count"].to_numpy()
+        assert len(counts) > 4096
+        counts = counts[np.isfinite(counts)]
+
+        sel = f.fetch(count_type="float")
+        stats = sel.describe()
+
+        assert stats.get("nnz", -1) == len(counts)
+        assert isclose(stats.get("sum", -1), counts.sum())
+        assert isclose(stats.get("min", -1), counts.min())
+        assert isclose(stats.get("max", -1), counts.max())
+        assert isclose(stats.get("mean", -1), counts.mean())
+        assert isclose(stats.get("variance", -1), np.var(counts, ddof=1))
+        assert isclose(stats.get("skewness", -1), ss.skew(counts))
+        assert isclose(stats.get("kurtosis", -1), ss.kurtosis(counts))
+
+        assert isclose(sel.variance(), np.var(counts, ddof=1))
+        assert isclose(sel.kurtosis(), ss.kurtosis(counts))
+
+        stats = sel.describe(["variance", "kurtosis"])
+        assert len(stats) == 2
+        assert isclose(stats.get("variance", -1), np.var(counts, ddof=1))
+        assert isclose(stats.get("kurtosis", -1), ss.kurtosis(counts))
+
     def test_describe_subset_finite(self, tmpdir):
         f = self.make_cooler_file(
             *self.generate_pixels(insert_nan=False, insert_neg_inf=False, insert_pos_inf=False), tmpdir
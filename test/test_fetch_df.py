@@ -31,6 +31,22 @@ class TestClass:
         assert df["count"].sum() == 119_208_613
         assert len(df) == 890_384
 
+    def test_genome_wide_parallel(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        for span in ["upper_triangle", "lower_triangle", "full"]:
+            for join in [False, True]:
+                expected = f.fetch(join=join).to_df(span)
+                df = f.fetch(join=join, n_threads=4).to_df(span)
+                assert df.equals(expected)
+
+        norm = "weight" if f.is_cooler() else "ICE"
+        expected = f.fetch(normalization=norm).to_arrow()
+        assert f.fetch(normalization=norm, n_threads=4).to_arrow().equals(expected)
+
+        with pytest.raises(RuntimeError, match="n_threads"):
+            f.fetch(n_threads=0)
+
     def test_cis(self, file, resolution):
         f = hictkpy.File(file, resolution)
 
@@ -103,6 +119,67 @@ class TestClass:
         df2.reset_index(inplace=True, drop=True)
         assert df1.equals(df2)
 
+    def test_columns(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        queries = [(), ("chr2R:10,000,000-15,000,000",), ("chr2R:10,000,000-15,000,000", "chrX:0-10,000,000")]
+        for query in queries:
+            bg2 = f.fetch(*query, join=True).to_df()
+            coo = f.fetch(*query).to_df()
+
+            columns = ["chrom1", "start1", "end1", "chrom2", "start2", "end2", "count"]
+            df = f.fetch(*query).to_df(columns=columns)
+            assert df.equals(bg2)
+
+            df = f.fetch(*query, join=True).to_df(columns=["count", "bin2_id", "chrom1", "start2"])
+            assert df.columns.tolist() == ["count", "bin2_id", "chrom1", "start2"]
+            assert df["chrom1"].dtype.name == "category"
+            assert df["count"].equals(coo["count"])
+            assert df["bin2_id"].equals(coo["bin2_id"])
+            assert df["chrom1"].equals(bg2["chrom1"])
+            assert df["start2"].equals(bg2["start2"])
+
+        sel = f.fetch("chr2R:10,000,000-15,000,000")
+        expected = f.fetch("chr2R:10,000,000-15,000,000", join=True).to_df("full")
+        df = sel.to_df("full", columns=["chrom1", "start1", "end1", "chrom2", "start2", "end2", "count"])
+        assert df.equals(expected)
+
+        with pytest.raises(RuntimeError, match="unknown column"):
+            sel.to_df(columns=["chrom3"])
+        with pytest.raises(RuntimeError, match="more than once"):
+            sel.to_df(columns=["count", "count"])
+        with pytest.raises(RuntimeError, match="at least one column"):
+            sel.to_df(columns=[])
+
+    @pytest.mark.skipif(not numpy_avail(), reason="numpy is not available")
+    def test_compact_types(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        expected = f.fetch("chr2R").to_df()
+
+        for count_type, dtype in [("int32", np.int32), ("uint32", np.uint32), ("float64", np.float64)]:
+            df = f.fetch("chr2R", count_type=count_type).to_df()
+            assert df["count"].dtype == dtype
+            assert (df["count"] == expected["count"]).all()
+
+        df = f.fetch("chr2R", bin_id_type="uint32").to_df()
+        assert df["bin1_id"].dtype == np.uint32
+        assert df["bin2_id"].dtype == np.uint32
+        assert (df["bin1_id"] == expected["bin1_id"]).all()
+        assert (df["bin2_id"] == expected["bin2_id"]).all()
+
+        df = f.fetch(bin_id_type="uint32", n_threads=2).to_df("full")
+        assert df["bin1_id"].dtype == np.uint32
+        assert len(df.columns) == 3
+
+        norm = "weight" if f.is_cooler() else "ICE"
+        df = f.fetch("chr2R", normalization=norm, count_type="uint32").to_df()
+        assert df["count"].dtype == np.float64
+
+        with pytest.raises(RuntimeError, match="bin_id_type"):
+            f.fetch(bin_id_type="int8")
+
     def test_balanced(self, file, resolution):
         f = hictkpy.File(file, resolution)
 
@@ -112,3 +189,21 @@ class TestClass:
             df = f.fetch("chr2R:10,000,000-15,000,000", normalization="ICE").to_df()
 
         assert math.isclose(59.349524704033215, df["count"].sum(), rel_tol=1.0e-5, abs_tol=1.0e-8)
+
+    @pytest.mark.skipif(not numpy_avail(), reason="numpy is not available")
+    def test_balanced_float32(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        norm = "weight" if f.is_cooler() else "ICE"
+
+        df = f.fetch("chr2R:10,000,000-15,000,000", normalization=norm, count_type="float32").to_df()
+        assert df["count"].dtype == np.float32
+        assert math.isclose(59.349524704033215, df["count"].sum(), rel_tol=1.0e-5, abs_tol=1.0e-8)
+
+        # int counts are promoted to float64 when fetching balanced interactions
+        df = f.fetch("chr2R:10,000,000-15,000,000", normalization=norm, count_type="int").to_df()
+        assert df["count"].dtype == np.float64
+
+        with pytest.raises(RuntimeError, match="count_type should be"):
+            f.fetch("chr2R:10,000,000-15,000,000", count_type="uint8")
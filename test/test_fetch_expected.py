@@ -0,0 +1,178 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pathlib
+
+import pytest
+
+import hictkpy
+
+from .helpers import numpy_avail, pandas_avail, pyarrow_avail
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+
+def get_normalization(f) -> str:
+    return "weight" if f.is_cooler() else "ICE"
+
+
+def compute_expected(sel, weights=None):
+    import numpy as np
+
+    df = sel.to_df()
+    first_bin_id = df["bin1_id"].min()
+    num_bins = df["bin2_id"].max() - first_bin_id + 1
+
+    df = df[np.isfinite(df["count"])]
+    sums = (
+        df.assign(dist=df["bin2_id"] - df["bin1_id"])
+        .groupby("dist")["count"]
+        .sum()
+        .reindex(np.arange(num_bins), fill_value=0)
+        .to_numpy(dtype=float)
+    )
+
+    if weights is None:
+        valid = np.ones(num_bins, dtype=bool)
+    else:
+        valid = np.isfinite(weights[first_bin_id : first_bin_id + num_bins])
+
+    n_valid = np.array([(valid[: num_bins - d] & valid[d:]).sum() for d in range(num_bins)])
+    with np.errstate(divide="ignore", invalid="ignore"):
+        return n_valid, sums, sums / n_valid
+
+
+@pytest.mark.skipif(
+    not numpy_avail() or not pandas_avail() or not pyarrow_avail(),
+    reason="either numpy, pandas, or pyarrow are not available",
+)
+class TestClass:
+    def test_expected(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        sel = f.fetch("chr2R:10,000,000-15,000,000")
+        df = sel.expected()
+
+        assert df.columns.tolist() == ["dist", "n_valid", "count.sum", "count.avg"]
+        assert len(df) == 50
+        assert df["dist"].tolist() == list(range(50))
+
+        n_valid, sums, avg = compute_expected(sel)
+        assert np.array_equal(df["n_valid"], n_valid)
+        assert np.allclose(df["count.sum"], sums)
+        assert np.allclose(df["count.avg"], avg)
+        assert df["count.sum"].sum() == sel.sum()
+
+    def test_expected_balanced(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        norm = get_normalization(f)
+        sel = f.fetch("chr2R:10,000,000-15,000,000", normalization=norm)
+        df = sel.expected()
+
+        n_valid, sums, avg = compute_expected(sel, f.weights(norm))
+        assert np.array_equal(df["n_valid"], n_valid)
+        assert np.allclose(df["count.sum"], sums)
+        assert np.allclose(df["count.avg"], avg, equal_nan=True)
+
+    def test_expected_invalid_queries(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        with pytest.raises(RuntimeError, match="genome-wide"):
+            f.fetch().expected()
+        with pytest.raises(RuntimeError, match="trans"):
+            f.fetch("chr2R:10,000,000-15,000,000", "chrX:0-10,000,000").expected()
+        with pytest.raises(RuntimeError, match="identical"):
+            f.fetch("chr2R:10,000,000-15,000,000", "chr2R:12,000,000-17,000,000").expected()
+
+    def test_expected_cis(self, file, resolution):
+        import pandas as pd
+
+        f = hictkpy.File(file, resolution)
+        norm = get_normalization(f)
+        df = f.expected_cis(normalization=norm)
+
+        assert df.columns.tolist() == ["chrom", "dist", "n_valid", "count.sum", "count.avg"]
+        assert df["chrom"].unique().tolist() == list(f.chromosomes().keys())
+
+        for chrom in f.chromosomes():
+            expected = f.fetch(chrom, normalization=norm).expected()
+            found = df[df["chrom"] == chrom].drop(columns="chrom").reset_index(drop=True)
+            pd.testing.assert_frame_equal(found, expected)
+
+        pd.testing.assert_frame_equal(f.expected_cis(normalization=norm, n_threads=4), df)
+
+        with pytest.raises(RuntimeError):
+            f.expected_cis(n_threads=0)
+
+    def test_oe_numpy(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        sel = f.fetch("chr2R:10,000,000-15,000,000")
+        m = sel.to_numpy(transform="oe")
+        assert m.dtype == np.float64
+        assert m.shape == (50, 50)
+
+        avg = sel.expected()["count.avg"].to_numpy()
+        obs = sel.to_numpy()
+        i, j = np.indices(obs.shape)
+        exp = avg[np.abs(i - j)]
+        with np.errstate(divide="ignore", invalid="ignore"):
+            expected = np.where(exp > 0, obs / exp, 0)
+        assert np.allclose(m, expected)
+
+        # the average of each diagonal of an O/E matrix is 1
+        for d in range(m.shape[0]):
+            if avg[d] > 0:
+                assert np.isclose(np.diagonal(m, d).mean(), 1.0)
+
+        out = np.empty_like(m)
+        assert sel.to_numpy(out=out, transform="oe") is out
+        assert np.array_equal(out, m)
+
+    def test_oe_numpy_balanced(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        sel = f.fetch("chr2R:10,000,000-15,000,000", normalization=get_normalization(f))
+        m = sel.to_numpy(transform="oe", query_span="upper_triangle")
+
+        df = sel.expected()
+        for d in range(m.shape[0]):
+            values = np.diagonal(m, d)
+            if df["n_valid"][d] > 0 and df["count.avg"][d] > 0:
+                assert np.isclose(np.nansum(values) / df["n_valid"][d], 1.0)
+
+    def test_oe_arrow(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        sel = f.fetch("chr2R:10,000,000-15,000,000")
+        avg = sel.expected()["count.avg"].to_numpy()
+
+        obs = sel.to_df()
+        oe = sel.to_arrow(transform="oe").to_pandas()
+        assert len(oe) == len(obs)
+        assert np.array_equal(oe["bin1_id"], obs["bin1_id"])
+        assert np.array_equal(oe["bin2_id"], obs["bin2_id"])
+        assert np.allclose(oe["count"], obs["count"] / avg[obs["bin2_id"] - obs["bin1_id"]])
+
+        oe_full = sel.to_arrow(query_span="full", transform="oe").to_pandas()
+        assert len(oe_full) == len(sel.to_df(query_span="full"))
+
+        with pytest.raises(RuntimeError, match="unrecognized transform"):
+            sel.to_arrow(transform="foo")
+        with pytest.raises(RuntimeError, match="unrecognized transform"):
+            sel.to_numpy(transform="foo")
@@ -0,0 +1,99 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pathlib
+
+import pytest
+
+import hictkpy
+
+from .helpers import numpy_avail
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+
+@pytest.mark.skipif(not numpy_avail(), reason="numpy is not available")
+class TestClass:
+    def test_genome_wide(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        total = 0
+        nnz = 0
+        for chunk in f.fetch().iter_chunks(chunk_size=100_000):
+            assert list(chunk.keys()) == ["bin1_id", "bin2_id", "count"]
+            assert 0 < len(chunk["count"]) <= 100_000
+            total += chunk["count"].sum()
+            nnz += len(chunk["count"])
+
+        assert total == 119_208_613
+        assert nnz == 890_384
+
+    def test_matches_iter(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+
+        sel = f.fetch("chr2R:10,000,000-15,000,000", "chrX")
+        chunks = list(sel.iter_chunks(chunk_size=123))
+        assert len(chunks) > 1
+
+        bin1_ids = np.concatenate([c["bin1_id"] for c in chunks])
+        bin2_ids = np.concatenate([c["bin2_id"] for c in chunks])
+        counts = np.concatenate([c["count"] for c in chunks])
+
+        pixels = list(sel)
+        assert len(pixels) == len(counts)
+        assert bin1_ids.dtype == np.uint64
+        assert counts.dtype == np.int32
+        assert np.array_equal(bin1_ids, [p.bin1_id for p in pixels])
+        assert np.array_equal(bin2_ids, [p.bin2_id for p in pixels])
+        assert np.array_equal(counts, [p.count for p in pixels])
+
+    def test_join(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        chroms = list(f.chromosomes().keys())
+        sel = f.fetch("chr2R:10,000,000-15,000,000", "chrX", join=True)
+        pixels = list(sel)
+
+        i = 0
+        for chunk in sel.iter_chunks(chunk_size=100):
+            assert len(chunk) == 9
+            for j in range(len(chunk["count"])):
+                p = pixels[i]
+                assert chroms[chunk["chrom1_id"][j]] == p.chrom1
+                assert chunk["start1"][j] == p.start1
+                assert chunk["end1"][j] == p.end1
+                assert chroms[chunk["chrom2_id"][j]] == p.chrom2
+                assert chunk["start2"][j] == p.start2
+                assert chunk["end2"][j] == p.end2
+                assert chunk["count"][j] == p.count
+                i += 1
+
+        assert i == len(pixels)
+
+    def test_balanced(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+
+        norm = "weight" if f.is_cooler() else "ICE"
+        sel = f.fetch("chr2R:10,000,000-15,000,000", normalization=norm)
+        counts = np.concatenate([c["count"] for c in sel.iter_chunks()])
+        assert counts.dtype == np.float64
+        assert np.isclose(np.nansum(counts), sel.sum())
+
+    def test_invalid_args(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        with pytest.raises(RuntimeError):
+            f.fetch().iter_chunks(chunk_size=0)
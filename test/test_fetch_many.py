@@ -0,0 +1,85 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pathlib
+
+import pytest
+
+import hictkpy
+
+from .helpers import pandas_avail, pyarrow_avail
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+
+@pytest.mark.skipif(not pandas_avail() or not pyarrow_avail(), reason="either pandas or pyarrow are not available")
+class TestClass:
+    def test_cis(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        ranges = ["chr2R:10,000,000-15,000,000", "chr2L", "chrX:0-5,000,000"]
+        df = f.fetch_many(ranges).to_pandas()
+
+        assert df.columns.tolist() == ["query_id", "bin1_id", "bin2_id", "count"]
+        assert df["query_id"].unique().tolist() == [0, 1, 2]
+        for i, query in enumerate(ranges):
+            expected = f.fetch(query).to_df()
+            found = df[df["query_id"] == i].drop(columns="query_id").reset_index(drop=True)
+            assert found.equals(expected)
+
+    def test_trans(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        ranges1 = ["chr2L:0-10,000,000", "chr2R"]
+        ranges2 = ["chr2R:10,000,000-15,000,000", "chrX"]
+        df = f.fetch_many(ranges1, ranges2, join=True).to_pandas()
+
+        assert len(df.columns) == 8
+        for i, (query1, query2) in enumerate(zip(ranges1, ranges2)):
+            expected = f.fetch(query1, query2, join=True).to_df()
+            found = df[df["query_id"] == i].drop(columns="query_id").reset_index(drop=True)
+            assert len(found) == len(expected)
+            assert found["count"].sum() == expected["count"].sum()
+
+    def test_multithreaded(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        ranges = [
+            f"{chrom}:{start}-{start + 2_500_000}" for chrom in ("chr2L", "chr2R") for start in range(0, 20_000_000, 2_500_000)
+        ]
+        expected = f.fetch_many(ranges, n_threads=1).to_pandas()
+        found = f.fetch_many(ranges, n_threads=4).to_pandas()
+        assert found.equals(expected)
+
+        norm = "weight" if f.is_cooler() else "ICE"
+        expected = f.fetch_many(ranges, normalization=norm, query_span="full").to_pandas()
+        found = f.fetch_many(ranges, normalization=norm, query_span="full", n_threads=4).to_pandas()
+        assert found.equals(expected)
+
+    def test_empty(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        df = f.fetch_many([]).to_pandas()
+        assert len(df) == 0
+        assert df.columns.tolist() == ["query_id", "bin1_id", "bin2_id", "count"]
+
+    def test_invalid_args(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        with pytest.raises(RuntimeError):
+            f.fetch_many(["chr2L"], ["chr2L", "chr2R"])
+
+        with pytest.raises(RuntimeError):
+            f.fetch_many(["chr2L"], n_threads=0)
+
+        with pytest.raises(RuntimeError):
+            f.fetch_many(["chr2L", "chrfoo"])
@@ -0,0 +1,103 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pathlib
+from concurrent.futures import ThreadPoolExecutor
+
+import pytest
+
+import hictkpy
+
+from .helpers import numpy_avail, pandas_avail, pyarrow_avail
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+queries = [
+    ("chr2L", "chr2L"),
+    ("chr2R:10,000,000-15,000,000", "chr2R:10,000,000-15,000,000"),
+    ("chr2L", "chr2R"),
+    ("chr2R:10,000,000-15,000,000", "chrX:0-10,000,000"),
+    ("chr3L", "chr3R"),
+    ("chrX", "chrX"),
+]
+
+
+class TestClass:
+    def test_describe(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        expected = [f.fetch(range1, range2).describe() for range1, range2 in queries]
+
+        with ThreadPoolExecutor(4) as tpool:
+            found = list(tpool.map(lambda q: f.fetch(*q).describe(), queries * 4))
+
+        assert found == expected * 4
+
+    def test_close(self, file, resolution):
+        expected = [hictkpy.File(file, resolution).fetch(*q).sum() for q in queries]
+
+        # files are opened, queried, and closed concurrently
+        with ThreadPoolExecutor(4) as tpool:
+            found = list(tpool.map(lambda q: hictkpy.File(file, resolution).fetch(*q).sum(), queries * 4))
+
+        assert found == expected * 4
+
+    def test_describe_genome_wide(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+        norm = "weight" if f.is_cooler() else "ICE"
+
+        # moments are only sharded when computed exactly
+        expected = f.fetch().describe(exact=True)
+        found = f.fetch(n_threads=4).describe(exact=True)
+        assert found.keys() == expected.keys()
+        assert found["nnz"] == expected["nnz"]
+        assert found["sum"] == expected["sum"]
+        assert found["min"] == expected["min"]
+        assert found["max"] == expected["max"]
+        for metric in ("mean", "variance", "skewness", "kurtosis"):
+            assert found[metric] == pytest.approx(expected[metric])
+
+        expected = f.fetch(normalization=norm).describe(exact=True)
+        found = f.fetch(normalization=norm, n_threads=4).describe(exact=True)
+        assert found["nnz"] == expected["nnz"]
+        for metric in ("sum", "min", "max", "mean", "variance", "skewness", "kurtosis"):
+            assert found[metric] == pytest.approx(expected[metric])
+
+        assert f.fetch(n_threads=4).describe() == f.fetch().describe()
+        assert f.fetch(n_threads=4).sum() == f.fetch().sum()
+        assert f.fetch(normalization=norm, n_threads=4).nnz() == f.fetch(normalization=norm).nnz()
+
+    @pytest.mark.skipif(not pandas_avail() or not pyarrow_avail(), reason="either pandas or pyarrow are not available")
+    def test_to_df(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        expected = [f.fetch(range1, range2).to_df() for range1, range2 in queries]
+
+        with ThreadPoolExecutor(4) as tpool:
+            found = list(tpool.map(lambda q: f.fetch(*q).to_df(), queries * 4))
+
+        for df1, df2 in zip(found, expected * 4):
+            assert df1.equals(df2)
+
+    @pytest.mark.skipif(not numpy_avail(), reason="numpy is not available")
+    def test_to_numpy(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+
+        expected = [f.fetch(range1, range2).to_numpy() for range1, range2 in queries]
+
+        with ThreadPoolExecutor(4) as tpool:
+            found = list(tpool.map(lambda q: f.fetch(*q).to_numpy(), queries * 4))
+
+        for m1, m2 in zip(found, expected * 4):
+            assert np.array_equal(m1, m2)
@@ -0,0 +1,115 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pathlib
+
+import pytest
+
+import hictkpy
+
+from .helpers import numpy_avail
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+
+def get_normalization(f) -> str:
+    return "weight" if f.is_cooler() else "ICE"
+
+
+@pytest.mark.skipif(not numpy_avail(), reason="numpy is not available")
+class TestClass:
+    def test_snippets(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        anchors1 = ["chr2R:10,000,000-10,100,000", "chr2R:12,000,000-12,100,000", "chr2L:5,000,000-5,100,000"]
+        anchors2 = ["chr2R:12,000,000-12,100,000", "chr2R:10,000,000-10,100,000", "chr2R:3,000,000-3,100,000"]
+
+        snippets = f.snippets(anchors1, anchors2, flank=500_000)
+        assert snippets.shape == (3, 11, 11)
+
+        # upper triangle
+        expected = f.fetch("chr2R:9,500,000-10,600,000", "chr2R:11,500,000-12,600,000").to_numpy()
+        assert np.array_equal(snippets[0], expected)
+        # lower triangle
+        assert np.array_equal(snippets[1], expected.T)
+        # trans
+        expected = f.fetch("chr2L:4,500,000-5,600,000", "chr2R:2,500,000-3,600,000").to_numpy()
+        assert np.array_equal(snippets[2], expected)
+        assert np.array_equal(f.snippets(anchors2[2:], anchors1[2:], flank=500_000)[0], expected.T)
+
+        # windows crossing the diagonal
+        snippets = f.snippets(["chr2R:10,000,000-10,100,000"], flank=500_000)
+        expected = f.fetch("chr2R:9,500,000-10,600,000").to_numpy()
+        assert np.array_equal(snippets[0], expected)
+
+    def test_snippets_out_of_bounds(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        snippets = f.snippets(["chr2L:0-100,000"], flank=500_000)
+        assert snippets.shape == (1, 11, 11)
+
+        assert np.isnan(snippets[0, :5, :]).all()
+        assert np.isnan(snippets[0, :, :5]).all()
+        expected = f.fetch("chr2L:0-600,000").to_numpy()
+        assert np.array_equal(snippets[0, 5:, 5:], expected)
+
+    def test_snippets_balanced(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        norm = get_normalization(f)
+        snippets = f.snippets(
+            ["chr2R:10,000,000-10,100,000"], ["chr2R:12,000,000-12,100,000"], flank=500_000, normalization=norm
+        )
+        expected = f.fetch("chr2R:9,500,000-10,600,000", "chr2R:11,500,000-12,600,000", normalization=norm).to_numpy()
+
+        weights = f.weights(norm)
+        first_bin1 = f.bins().get_id("chr2R", 9_500_000)
+        first_bin2 = f.bins().get_id("chr2R", 11_500_000)
+        masked1 = ~np.isfinite(weights[first_bin1 : first_bin1 + 11])
+        masked2 = ~np.isfinite(weights[first_bin2 : first_bin2 + 11])
+        expected[masked1, :] = np.nan
+        expected[:, masked2] = np.nan
+        assert np.allclose(snippets[0], expected, equal_nan=True)
+
+    def test_pileup(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+        anchors1 = [f"chr2R:{pos}-{pos + 1}" for pos in range(5_000_000, 15_000_000, 150_000)]
+        anchors2 = [f"chr2R:{pos + 1_000_000}-{pos + 1_000_001}" for pos in range(5_000_000, 15_000_000, 150_000)]
+
+        snippets = f.snippets(anchors1, anchors2, flank=1_000_000)
+        assert snippets.shape == (len(anchors1), 21, 21)
+        pileup = f.snippets(anchors1, anchors2, flank=1_000_000, pileup=True)
+        assert pileup.shape == (21, 21)
+        assert np.allclose(pileup, np.nanmean(snippets, axis=0))
+
+        if f.is_hic():
+            assert np.array_equal(f.snippets(anchors1, anchors2, flank=1_000_000, n_threads=4), snippets)
+            assert np.allclose(f.snippets(anchors1, anchors2, flank=1_000_000, pileup=True, n_threads=4), pileup)
+
+    def test_snippets_invalid_args(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        with pytest.raises(RuntimeError, match="same size"):
+            f.snippets(["chr2R:0-1"], ["chr2R:0-1", "chr2R:1-2"], flank=100_000)
+        with pytest.raises(RuntimeError, match="flank cannot be negative"):
+            f.snippets(["chr2R:0-1"], flank=-1)
+        with pytest.raises(RuntimeError, match="n_threads"):
+            f.snippets(["chr2R:0-1"], flank=100_000, n_threads=0)
+        with pytest.raises(Exception):
+            f.snippets(["chrXYZ:0-1"], flank=100_000)
+        with pytest.raises(RuntimeError, match="unable to find foo normalization vectors"):
+            f.snippets(["chr2R:0-1"], flank=100_000, normalization="foo")
@@ -86,3 +86,50 @@ class TestClass:
             m = f.fetch("chr2R:10,000,000-15,000,000", normalization="ICE").to_coo()
 
         assert math.isclose(59.349524704033215, m.sum(), rel_tol=1.0e-5, abs_tol=1.0e-8)
+
+    @pytest.mark.skipif(not numpy_avail(), reason="numpy is not available")
+    def test_matches_dense(self, file, resolution):
+        import numpy as np
+
+        f = hictkpy.File(file, resolution)
+
+        cis_spans = ["upper_triangle", "lower_triangle", "full"]
+        trans_spans = ["upper_triangle", "full"]
+        queries = [
+            ((), cis_spans),
+            (("chr2R:10,000,000-15,000,000",), cis_spans),
+            (("chr2L:0-10,000,000", "chr2L:5,000,000-20,000,000"), cis_spans),
+            (("chr2R:10,000,000-15,000,000", "chrX:0-10,000,000"), trans_spans),
+        ]
+        for query, spans in queries:
+            sel = f.fetch(*query)
+            for span in spans:
+                expected = sel.to_numpy(span)
+
+                coo = sel.to_coo(span)
+                assert coo.row.dtype == np.int32
+                assert coo.col.dtype == np.int32
+                assert np.array_equal(coo.toarray(), expected)
+
+                csr = sel.to_csr(span)
+                assert csr.indices.dtype == np.int32
+                assert csr.indptr.dtype == np.int32
+                assert csr.nnz == coo.nnz
+                assert np.array_equal(csr.toarray(), expected)
+
+    def test_genome_wide_parallel(self, file, resolution):
+        f = hictkpy.File(file, resolution)
+
+        for span in ["upper_triangle", "lower_triangle", "full"]:
+            expected = f.fetch().to_csr(span)
+            m = f.fetch(n_threads=4).to_csr(span)
+            assert m.has_sorted_indices
+            assert (m != expected).nnz == 0
+            assert (m.indptr == expected.indptr).all()
+
+    def test_invalid_span(self, file, resolution):
+        sel = hictkpy.File(file, resolution).fetch("chr2R:10,000,000-15,000,000", "chrX:0-10,000,000")
+        with pytest.raises(RuntimeError, match="lower_triangle"):
+            sel.to_coo("lower_triangle")
+        with pytest.raises(RuntimeError, match="lower_triangle"):
+            sel.to_csr("lower_triangle")
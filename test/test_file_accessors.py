@@ -41,6 +41,8 @@ class TestClass:
             assert f.attributes()["format"] == "HIC"
 
     def test_normalizations(self, file, resolution):
+        import numpy as np
+
         f = hictkpy.File(file, resolution)
 
         cooler_weights = ["KR", "SCALE", "VC", "VC_SQRT", "weight"]
@@ -57,6 +59,14 @@ class TestClass:
         weights = f.weights(name)
         assert len(weights) == f.nbins()
 
+        # weights are cached, but each call returns a copy of the cached weights
+        assert weights.flags.writeable
+        expected = weights.copy()
+        weights[:] = -1
+        weights2 = hictkpy.File(file, resolution).weights(name)
+        assert weights2.__array_interface__["data"][0] != weights.__array_interface__["data"][0]
+        assert np.array_equal(weights2, expected, equal_nan=True)
+
         if f.is_cooler():
             df = f.weights(cooler_weights)
             assert len(df.columns) == len(cooler_weights)
@@ -0,0 +1,97 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pathlib
+import shutil
+
+import pytest
+
+import hictkpy
+
+from .helpers import numpy_avail
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+
+def copy_file(file, tmpdir) -> pathlib.Path:
+    dest = pathlib.Path(tmpdir) / file.name
+    shutil.copy(file, dest)
+    return dest
+
+
+@pytest.mark.skipif(not numpy_avail(), reason="numpy is not available")
+class TestClass:
+    @pytest.mark.parametrize("method", ["ICE", "SCALE", "VC"])
+    def test_balance(self, file, resolution, method, tmpdir):
+        import numpy as np
+
+        path = copy_file(file, tmpdir)
+        f = hictkpy.File(path, resolution)
+
+        name = f"{method}_hictkpy"
+        assert not f.has_normalization(name)
+
+        f.balance(method, name=name)
+        assert f.has_normalization(name)
+        weights = f.weights(name)
+        assert len(weights) == f.nbins()
+        assert np.isfinite(weights).any()
+
+        # weights are visible to newly opened files
+        assert hictkpy.File(path, resolution).has_normalization(name)
+
+        sel = f.fetch("chr2R:10,000,000-15,000,000", normalization=name)
+        assert sel.sum() > 0
+
+        with pytest.raises(RuntimeError, match="already contains weights"):
+            f.balance(method, name=name)
+
+        f.balance(method, name=name, n_threads=2, in_memory=False, tmpdir=tmpdir, overwrite=True)
+        assert np.allclose(weights, f.weights(name), equal_nan=True)
+
+    def test_balance_cis(self, file, resolution, tmpdir):
+        path = copy_file(file, tmpdir)
+        f = hictkpy.File(path, resolution)
+
+        f.balance("ICE", mode="cis", name="ICE_cis")
+        assert len(f.weights("ICE_cis")) == f.nbins()
+
+    def test_balance_live_selectors(self, file, resolution, tmpdir):
+        path = copy_file(file, tmpdir)
+        f = hictkpy.File(path, resolution)
+
+        sel = f.fetch("chr2R:10,000,000-15,000,000")
+        expected = sel.sum()
+        it = iter(sel)
+        del sel
+        with pytest.raises(RuntimeError, match="PixelSelectors created from it are alive"):
+            f.balance("VC", name="VC_hictkpy")
+        assert not f.has_normalization("VC_hictkpy")
+        assert sum(p.count for p in it) == expected
+
+        del it
+        f.balance("VC", name="VC_hictkpy")
+        assert f.has_normalization("VC_hictkpy")
+        assert f.fetch("chr2R:10,000,000-15,000,000").sum() == expected
+
+    def test_balance_invalid_params(self, file, resolution, tmpdir):
+        path = copy_file(file, tmpdir)
+        f = hictkpy.File(path, resolution)
+
+        with pytest.raises(RuntimeError, match="method should be"):
+            f.balance("foo")
+        with pytest.raises(RuntimeError, match="mode should be"):
+            f.balance(mode="foo")
+        with pytest.raises(RuntimeError, match="n_threads"):
+            f.balance(n_threads=0)
+        with pytest.raises(RuntimeError, match="name cannot be"):
+            f.balance(name="NONE")
@@ -10,7 +10,7 @@ import pytest
 
 import hictkpy
 
-from .helpers import pandas_avail, pyarrow_avail
+from .helpers import pandas_avail, pyarrow_avail, write_pairs
 
 testdir = pathlib.Path(__file__).resolve().parent
 
@@ -152,3 +152,151 @@ class TestClass:
         gc.collect()
 
         assert pytest.approx(f.fetch(count_type="float").sum()) == expected_sum
+
+    def test_file_creation_multithreaded(self, file, resolution, tmpdir):
+        f = hictkpy.File(file, resolution)
+
+        df = f.fetch(join=True).to_df()
+        expected = f.fetch().to_df()
+
+        path = tmpdir / "test.cool"
+        w = hictkpy.cooler.FileWriter(path, f.bins(), n_threads=4)
+
+        # ingest all pixels at once and in random order to make sure pixels are sorted in parallel
+        w.add_pixels(df.sample(frac=1, random_state=0))
+
+        f = w.finalize("info", 100_000, 100_000)
+
+        del w
+        gc.collect()
+
+        assert f.fetch().to_df().equals(expected)
+
+    def test_file_creation_invalid_n_threads(self, file, resolution, tmpdir):
+        f = hictkpy.File(file, resolution)
+
+        path = tmpdir / "test.cool"
+        with pytest.raises(Exception):
+            hictkpy.cooler.FileWriter(path, f.bins(), n_threads=0)
+
+    def test_file_creation_pyarrow(self, file, resolution, tmpdir):
+        import pyarrow as pa
+
+        f = hictkpy.File(file, resolution)
+
+        expected = f.fetch().to_df()
+        table = f.fetch(join=True).to_arrow()
+
+        # store chromosome names as plain strings instead of using dictionary encoding
+        for col in ("chrom1", "chrom2"):
+            table = table.set_column(table.schema.get_field_index(col), col, table[col].cast(pa.string()))
+
+        path = tmpdir / "test.cool"
+        w = hictkpy.cooler.FileWriter(path, f.bins())
+
+        for batch in table.to_batches(max_chunksize=1000):
+            w.add_pixels(batch)
+
+        f = w.finalize("info", 100_000, 100_000)
+
+        del w
+        gc.collect()
+
+        assert f.fetch().to_df().equals(expected)
+
+    def test_file_creation_invalid_pixels(self, file, resolution, tmpdir):
+        f = hictkpy.File(file, resolution)
+
+        df = f.fetch(join=True).to_df()[:10].copy()
+        df["chrom1"] = "invalid"
+
+        path = tmpdir / "test.cool"
+        w = hictkpy.cooler.FileWriter(path, f.bins())
+        with pytest.raises(Exception):
+            w.add_pixels(df)
+
+    def test_file_creation_async(self, file, resolution, tmpdir):
+        f = hictkpy.File(file, resolution)
+
+        df = f.fetch(join=True).to_df()
+        expected = f.fetch().to_df()
+
+        path = tmpdir / "test.cool"
+        # use a small queue to make sure add_pixels() blocks once the queue is full
+        w = hictkpy.cooler.FileWriter(path, f.bins(), async_queue_bytes=64 << 10)
+
+        chunk_size = 1000
+        for start in range(0, len(df), chunk_size):
+            end = start + chunk_size
+            w.add_pixels(df[start:end])
+
+        f = w.finalize("info", 100_000, 100_000)
+        with pytest.raises(Exception):
+            w.add_pixels(df)
+        with pytest.raises(Exception):
+            w.finalize()
+
+        del w
+        gc.collect()
+
+        assert f.fetch().to_df().equals(expected)
+
+    @pytest.mark.parametrize("bgzip,n_threads", [(False, 1), (True, 1), (True, 3)])
+    def test_file_creation_pairs(self, file, resolution, tmpdir, bgzip, n_threads):
+        f = hictkpy.File(file, resolution)
+        if f.bins().type() != "fixed":
+            pytest.skip(f'BinTable of file "{file}" does not have fixed bins.')
+
+        df = f.fetch(join=True).to_df().head(5000)
+        pairs = tmpdir / ("test.pairs.gz" if bgzip else "test.pairs")
+        write_pairs(df, pairs, bgzip=bgzip)
+
+        path = tmpdir / "test.cool"
+        w = hictkpy.cooler.FileWriter(path, f.chromosomes(), f.resolution(), n_threads=n_threads)
+        w.add_pairs(pairs, chunk_size=1000)
+        w.add_pairs(pairs)
+        f = w.finalize()
+
+        del w
+        gc.collect()
+
+        assert f.fetch().nnz() == len(df)
+        assert f.fetch().sum() == 2 * len(df)
+
+    def test_file_creation_pairs_unknown_chroms(self, file, resolution, tmpdir):
+        f = hictkpy.File(file, resolution)
+        if f.bins().type() != "fixed":
+            pytest.skip(f'BinTable of file "{file}" does not have fixed bins.')
+
+        df = f.fetch(join=True).to_df().head(100)
+        df["chrom1"] = df["chrom1"].astype(str)
+        df.loc[0, "chrom1"] = "chrUnknown"
+        pairs = tmpdir / "test.pairs"
+        write_pairs(df, pairs)
+
+        path = tmpdir / "test.cool"
+        n_threads = 1
+        w = hictkpy.cooler.FileWriter(path, f.chromosomes(), f.resolution(), n_threads=n_threads)
+        with pytest.raises(Exception):
+            w.add_pairs(pairs)
+        w.add_pairs(pairs, drop_unknown_chroms=True)
+        f = w.finalize()
+
+        assert f.fetch().sum() == len(df) - 1
+
+    def test_file_creation_pairs_invalid_position(self, file, resolution, tmpdir):
+        f = hictkpy.File(file, resolution)
+        if f.bins().type() != "fixed":
+            pytest.skip(f'BinTable of file "{file}" does not have fixed bins.')
+
+        df = f.fetch(join=True).to_df().head(100)
+        df["start1"] = df["start1"].astype("int64")
+        # positions that do not fit in 32 bits should not wrap around
+        df.loc[0, "start1"] = 2**32 + 10
+        pairs = tmpdir / "test.pairs"
+        write_pairs(df, pairs)
+
+        path = tmpdir / "test.cool"
+        w = hictkpy.cooler.FileWriter(path, f.chromosomes(), f.resolution())
+        with pytest.raises(RuntimeError, match="invalid position"):
+            w.add_pairs(pairs)
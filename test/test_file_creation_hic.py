@@ -10,7 +10,7 @@ import pytest
 
 import hictkpy
 
-from .helpers import pandas_avail, pyarrow_avail
+from .helpers import pandas_avail, pyarrow_avail, write_pairs
 
 testdir = pathlib.Path(__file__).resolve().parent
 
@@ -128,3 +128,92 @@ class TestClass:
         gc.collect()
 
         assert f.fetch().sum() == expected_sum
+
+    def test_file_creation_async(self, file, resolution, tmpdir):
+        f = hictkpy.File(file, resolution)
+        if f.bins().type() != "fixed":
+            pytest.skip(f'BinTable of file "{file}" does not have fixed bins.')
+
+        df = f.fetch(join=True).to_df()
+        expected_sum = df["count"].sum()
+
+        path = tmpdir / "test.hic"
+        # use a small queue to make sure add_pixels() blocks once the queue is full
+        w = hictkpy.hic.FileWriter(path, f.chromosomes(), f.resolution(), async_queue_bytes=64 << 10)
+
+        chunk_size = 1000
+        for start in range(0, len(df), chunk_size):
+            end = start + chunk_size
+            w.add_pixels(df[start:end])
+
+        f = w.finalize()
+        with pytest.raises(Exception):
+            w.add_pixels(df)
+        with pytest.raises(Exception):
+            w.finalize()
+
+        del w
+        gc.collect()
+
+        assert f.fetch().sum() == expected_sum
+
+    def test_file_creation_async_error(self, file, resolution, tmpdir):
+        f = hictkpy.File(file, resolution)
+        if f.bins().type() != "fixed":
+            pytest.skip(f'BinTable of file "{file}" does not have fixed bins.')
+
+        df = f.fetch().to_df()[:10].copy()
+        # bin IDs are validated by the background thread
+        df["bin2_id"] = len(f.bins()) + 1
+
+        path = tmpdir / "test.hic"
+        w = hictkpy.hic.FileWriter(path, f.chromosomes(), f.resolution(), async_queue_bytes=64 << 10)
+        w.add_pixels(df)
+
+        with pytest.raises(Exception):
+            w.finalize()
+        with pytest.raises(Exception):
+            w.add_pixels(df)
+
+    @pytest.mark.parametrize("bgzip,n_threads", [(False, 1), (True, 1), (True, 3)])
+    def test_file_creation_pairs(self, file, resolution, tmpdir, bgzip, n_threads):
+        f = hictkpy.File(file, resolution)
+        if f.bins().type() != "fixed":
+            pytest.skip(f'BinTable of file "{file}" does not have fixed bins.')
+
+        df = f.fetch(join=True).to_df().head(5000)
+        pairs = tmpdir / ("test.pairs.gz" if bgzip else "test.pairs")
+        write_pairs(df, pairs, bgzip=bgzip)
+
+        path = tmpdir / "test.hic"
+        w = hictkpy.hic.FileWriter(path, f.chromosomes(), f.resolution(), n_threads=n_threads)
+        w.add_pairs(pairs, chunk_size=1000)
+        w.add_pairs(pairs)
+        f = w.finalize()
+
+        del w
+        gc.collect()
+
+        assert f.fetch().nnz() == len(df)
+        assert f.fetch().sum() == 2 * len(df)
+
+    def test_file_creation_pairs_unknown_chroms(self, file, resolution, tmpdir):
+        f = hictkpy.File(file, resolution)
+        if f.bins().type() != "fixed":
+            pytest.skip(f'BinTable of file "{file}" does not have fixed bins.')
+
+        df = f.fetch(join=True).to_df().head(100)
+        df["chrom1"] = df["chrom1"].astype(str)
+        df.loc[0, "chrom1"] = "chrUnknown"
+        pairs = tmpdir / "test.pairs"
+        write_pairs(df, pairs)
+
+        path = tmpdir / "test.hic"
+        n_threads = 1
+        w = hictkpy.hic.FileWriter(path, f.chromosomes(), f.resolution(), n_threads=n_threads)
+        with pytest.raises(Exception):
+            w.add_pairs(pairs)
+        w.add_pairs(pairs, drop_unknown_chroms=True)
+        f = w.finalize()
+
+        assert f.fetch().sum() == len(df) - 1
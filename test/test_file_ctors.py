@@ -40,3 +40,23 @@ class TestClass:
 
         with pytest.raises(RuntimeError, match=f"resolution is required and cannot be None when opening {ext} files"):
             hictkpy.File(file)
+
+    def test_remote_uri(self, file, resolution):
+        with pytest.raises(RuntimeError, match=r"remote URIs \(s3://\) is not supported"):
+            hictkpy.File(f"s3://bucket/{file.name}", resolution)
+        with pytest.raises(RuntimeError, match=r"remote URIs \(https://\) is not supported"):
+            hictkpy.MultiResFile(f"https://example.com/{file.name}")
+
+    def test_lazy(self, file, resolution):
+        f1 = hictkpy.File(file, resolution)
+        f2 = hictkpy.File(file, resolution, lazy=True)
+        assert f2.resolution() == resolution
+        assert f2.nbins() == f1.nbins()
+
+        assert f2.fetch("chr2R").sum() == f1.fetch("chr2R").sum()
+        assert f2.fetch().nnz() == f1.fetch().nnz()
+        if f2.is_hic():
+            assert f2.cache_stats()["capacity_bytes"] > 0
+
+        f3 = hictkpy.MultiResFile(file, lazy=True)
+        assert f3[resolution].fetch("chr2R").sum() == f1.fetch("chr2R").sum()
@@ -47,3 +47,28 @@ class TestClass:
 
         with pytest.raises(Exception):
             f[1234]  # noqa
+
+    def test_handle_cache(self, file, format):
+        f = hictkpy.MultiResFile(file)
+
+        assert f[100_000] is f[100_000]
+
+    def test_fetch(self, file, format):
+        f = hictkpy.MultiResFile(file)
+
+        expected = f[100_000].fetch("chr2L:0-20,000,000").sum()
+        assert f.fetch("chr2L:0-20,000,000").sum() == expected
+        assert f.fetch("chr2L:0-20,000,000", resolution=100_000).sum() == expected
+        assert f.fetch("chr2L:0-20,000,000", target_shape=(100, 100)).sum() == expected
+
+        if f.is_mcool():
+            expected = f[1_000_000].fetch("chr2L:0-20,000,000").sum()
+            sel = f.fetch("chr2L:0-20,000,000", target_shape=(10, 10))
+            assert sel.sum() == expected
+            assert sel.to_numpy().shape == (20, 20)
+
+        with pytest.raises(Exception):
+            f.fetch("chr2L:0-20,000,000", target_shape=(10, 10), resolution=100_000)
+
+        with pytest.raises(Exception):
+            f.fetch(resolution=1234)
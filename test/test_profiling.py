@@ -0,0 +1,135 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import json
+import pathlib
+
+import pytest
+
+import hictkpy
+
+from .helpers import numpy_avail, pandas_avail, pyarrow_avail
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+
+@pytest.fixture(autouse=True)
+def profiler():
+    hictkpy.profiling.reset()
+    hictkpy.profiling.enable()
+    yield hictkpy.profiling
+    hictkpy.profiling.disable()
+    hictkpy.profiling.reset()
+
+
+@pytest.mark.skipif(
+    not numpy_avail() or not pandas_avail() or not pyarrow_avail(),
+    reason="either numpy, pandas, or pyarrow are not available",
+)
+class TestClass:
+    def test_fetch(self, file, resolution, profiler):
+        f = hictkpy.File(file, resolution)
+        profiler.reset()
+        sel = f.fetch("chr2R")
+        df = sel.to_df()
+
+        queries = profiler.queries()
+        assert len(queries) == 1
+        stats = queries[0]
+        # to_df() is implemented in terms of to_arrow(): only the outermost operation is recorded
+        assert stats.operation == "PixelSelector.to_pandas"
+        assert stats.counters["pixels"] == len(df)
+        assert stats.duration > 0
+        for stage in ["lock_wait", "read", "export", "to_pandas", "gil_held"]:
+            assert stage in stats.stages
+            assert stats.stages[stage] <= stats.duration
+
+        sel.to_numpy()
+        sel.sum()
+        assert [q.operation for q in profiler.queries()] == [
+            "PixelSelector.to_pandas",
+            "PixelSelector.to_numpy",
+            "PixelSelector.sum",
+        ]
+
+    def test_open(self, file, resolution, profiler):
+        hictkpy.File(file, resolution)
+        queries = profiler.queries()
+        assert [q.operation for q in queries] == ["File.__init__"]
+        assert "open" in queries[0].stages
+        assert queries[0].stages["open"] <= queries[0].duration
+
+        profiler.reset()
+        f = hictkpy.MultiResFile(file, lazy=True)
+        f[resolution].fetch("chr2R").nnz()
+        operations = [q.operation for q in profiler.queries()]
+        assert operations[:2] == ["MultiResFile.__init__", "File.__init__"]
+        if f.is_hic():
+            # sizing the block cache is deferred until interactions are first read
+            assert "File.optimize_cache" in operations
+            assert "optimize_cache" not in profiler.queries()[1].stages
+
+    def test_disabled(self, file, resolution, profiler):
+        profiler.disable()
+        assert not profiler.is_enabled()
+        hictkpy.File(file, resolution).fetch("chr2R").nnz()
+        assert len(profiler.queries()) == 0
+
+    def test_max_queries(self, file, resolution, profiler):
+        profiler.enable(max_queries=2)
+        sel = hictkpy.File(file, resolution).fetch("chr2R")
+        for _ in range(5):
+            sel.nnz()
+        assert len(profiler.queries()) == 2
+
+        with pytest.raises(RuntimeError):
+            profiler.enable(max_queries=0)
+
+    def test_summary(self, file, resolution, profiler):
+        sel = hictkpy.File(file, resolution).fetch("chr2R")
+        sel.to_arrow()
+        sel.to_arrow()
+
+        summary = profiler.summary()
+        assert summary["PixelSelector.to_arrow"]["calls"] == 2
+        assert summary["PixelSelector.to_arrow"]["counters"]["pixels"] == 2 * sel.nnz()
+
+    def test_chrome_trace(self, file, resolution, profiler, tmpdir):
+        hictkpy.File(file, resolution).fetch("chr2R").to_arrow()
+
+        path = pathlib.Path(tmpdir) / "trace.json"
+        trace = json.loads(profiler.to_chrome_trace(path))
+        assert trace == json.loads(path.read_text())
+
+        names = [e["name"] for e in trace["traceEvents"]]
+        assert "PixelSelector.to_arrow" in names
+        assert "read" in names
+        assert all(e["ph"] == "X" for e in trace["traceEvents"])
+
+    def test_file_writer(self, file, resolution, profiler, tmpdir):
+        f = hictkpy.File(file, resolution)
+        df = f.fetch().to_df()
+        profiler.reset()
+
+        if f.is_cooler():
+            fmt = "cooler"
+            w = hictkpy.cooler.FileWriter(pathlib.Path(tmpdir) / "out.cool", f.chromosomes(), resolution)
+        else:
+            fmt = "hic"
+            w = hictkpy.hic.FileWriter(pathlib.Path(tmpdir) / "out.hic", f.chromosomes(), resolution)
+        w.add_pixels(df)
+        w.finalize()
+
+        queries = profiler.queries()
+        assert [q.operation for q in queries] == [f"{fmt}.FileWriter.add_pixels", f"{fmt}.FileWriter.finalize"]
+        assert queries[-2].counters["pixels"] == len(df)
+        assert "import" in queries[-2].stages
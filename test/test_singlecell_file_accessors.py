@@ -8,6 +8,8 @@ import pytest
 
 import hictkpy
 
+from .helpers import pandas_avail, pyarrow_avail
+
 testdir = pathlib.Path(__file__).resolve().parent
 
 pytestmark = pytest.mark.parametrize(
@@ -35,3 +37,44 @@ class TestClass:
 
         with pytest.raises(Exception):
             f["ABC"]  # noqa
+
+    @pytest.mark.skipif(not pyarrow_avail() or not pandas_avail(), reason="pyarrow or pandas is not available")
+    def test_fetch_all(self, file):
+        f = hictkpy.cooler.SingleCellFile(file)
+        cells = f.cells()
+        chrom = next(iter(f.chromosomes()))
+
+        df = f.fetch_all(chrom, n_threads=2).to_pandas()
+        assert df.columns.tolist() == ["cell_id", "bin1_id", "bin2_id", "count"]
+        assert set(df["cell_id"].unique()).issubset(cells)
+        for cell in cells:
+            expected = f[cell].fetch(chrom).sum()
+            assert df.loc[df["cell_id"] == cell, "count"].sum() == expected
+
+        df = f.fetch_all(chrom, cells=cells[:2], join=True).to_pandas()
+        assert set(df["cell_id"].unique()).issubset(cells[:2])
+        assert "chrom1" in df.columns
+        assert df["count"].sum() == sum(f[cell].fetch(chrom).sum() for cell in cells[:2])
+
+        assert len(f.fetch_all(cells=[])) == 0
+
+        with pytest.raises(Exception):
+            f.fetch_all(chrom, cells=["ABC"])
+
+    def test_aggregate(self, file, tmpdir):
+        f = hictkpy.cooler.SingleCellFile(file)
+        cells = f.cells()
+
+        path = pathlib.Path(tmpdir) / "pseudo_bulk.cool"
+        clr = f.aggregate(path)
+        assert clr.resolution() == f.resolution()
+        assert clr.fetch().sum() == sum(f[cell].fetch().sum() for cell in cells)
+
+        with pytest.raises(Exception):
+            f.aggregate(path)
+
+        clr = f.aggregate(path, cells=cells[:2], overwrite=True)
+        assert clr.fetch().sum() == sum(f[cell].fetch().sum() for cell in cells[:2])
+
+        with pytest.raises(Exception):
+            f.aggregate(path, cells=[], overwrite=True)
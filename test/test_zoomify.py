@@ -0,0 +1,55 @@
+# Copyright (C) 2024 Roberto Rossini <roberros@uio.no>
+#
+# SPDX-License-Identifier: MIT
+
+import pathlib
+
+import pytest
+
+import hictkpy
+
+testdir = pathlib.Path(__file__).resolve().parent
+
+pytestmark = pytest.mark.parametrize(
+    "file,resolution",
+    [
+        (testdir / "data" / "cooler_test_file.mcool", 100_000),
+        (testdir / "data" / "hic_test_file.hic", 100_000),
+    ],
+)
+
+
+class TestClass:
+    @pytest.mark.parametrize("ext", [".mcool", ".hic"])
+    def test_zoomify(self, file, resolution, tmpdir, ext):
+        f = hictkpy.File(file, resolution)
+        dest = pathlib.Path(tmpdir) / f"out{ext}"
+
+        mrf = hictkpy.zoomify(f, dest, [200_000, 1_000_000, 500_000], n_threads=2, chunk_size=25_000)
+        assert mrf.path() == dest
+        assert (mrf.resolutions() == [100_000, 200_000, 500_000, 1_000_000]).all()
+
+        expected = f.fetch().sum()
+        for res in mrf.resolutions():
+            assert mrf[res].fetch().sum() == pytest.approx(expected)
+
+        query = "chr2R:10,000,000-15,000,000"
+        expected = hictkpy.MultiResFile(file)[1_000_000].fetch(query).sum() if file.suffix == ".mcool" else None
+        if expected is not None:
+            assert mrf[1_000_000].fetch(query).sum() == pytest.approx(expected)
+
+    def test_zoomify_invalid_params(self, file, resolution, tmpdir):
+        f = hictkpy.File(file, resolution)
+        dest = pathlib.Path(tmpdir) / "out.mcool"
+
+        with pytest.raises(Exception):
+            hictkpy.zoomify(f, dest, [150_000])
+        with pytest.raises(Exception):
+            hictkpy.zoomify(f, dest, [50_000])
+        with pytest.raises(Exception):
+            hictkpy.zoomify(f, dest, [200_000], n_threads=0)
+
+        hictkpy.zoomify(f, dest, [200_000])
+        with pytest.raises(Exception):
+            hictkpy.zoomify(f, dest, [200_000])
+        hictkpy.zoomify(f, dest, [200_000], overwrite=True)
@@ -56,6 +56,7 @@ def main():
     process_module("hictkpy._hictkpy", os.path.join(args["output-dir"], "__init__.pyi"), args["force"])
     process_module("hictkpy._hictkpy.cooler", os.path.join(args["output-dir"], "cooler.pyi"), args["force"])
     process_module("hictkpy._hictkpy.hic", os.path.join(args["output-dir"], "hic.pyi"), args["force"])
+    process_module("hictkpy._hictkpy.profiling", os.path.join(args["output-dir"], "profiling.pyi"), args["force"])
 
 
 if __name__ == "__main__":